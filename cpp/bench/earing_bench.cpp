@@ -0,0 +1,554 @@
+/* Micro-benchmarks of the native kernels behind the MEX files, over channel
+ * counts, signal lengths, fiber counts and thread counts.
+ *
+ * Usage: earing_bench [options]
+ *
+ * Every case is timed --repeat times after a warm-up run, on synthetic inputs
+ * (a modulated firing probability, Bernoulli spike trains), and its best time
+ * is written as a CSV line:
+ *
+ *   kernel,channels,frames,fibers,threads,seconds,ns_per_sample,gb_per_s,speedup
+ *
+ * where a sample is one value of the kernel's main matrix (one time frame of
+ * one channel, or of one fiber for the spike kernels), gb_per_s counts the
+ * bytes read and written once, and speedup is the ns_per_sample of the same
+ * case in --baseline (the output of an earlier run, e.g. before a change)
+ * divided by the current one, empty if the case is not in the baseline.
+ * Kernels that are not threaded only run with 1 thread. For the synapse
+ * kernels, fibers is the number of parameter settings, and for the PSTH
+ * kernels the number of repetitions of one fiber per channel.
+ */
+
+#include "earing/an_ihc_synapse.hpp"
+#include "earing/auditory_nerve.hpp"
+#include "earing/parallel.hpp"
+#include "earing/random.hpp"
+#include "earing/recurrence.hpp"
+#include "earing/refractoriness.hpp"
+#include "earing/spike_analysis.hpp"
+#include "earing/spike_trains.hpp"
+#include "earing/synapse_sweep.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+using namespace earing;
+
+void usage() {
+    std::fprintf(stderr,
+        "Usage: earing_bench [options]\n"
+        "Options:\n"
+        "  --kernels a,b,...   subset of the kernels below (default all)\n"
+        "  --channels a,b,...  numbers of channels (default 8,64)\n"
+        "  --frames a,b,...    numbers of time frames (default 10000,100000)\n"
+        "  --fibers a,b,...    fibers per channel of the spike kernels (default 1,20)\n"
+        "  --threads a,b,...   numbers of threads (default 1 and the number of cores)\n"
+        "  --repeat N          timed runs per case, the best one is kept (default 5)\n"
+        "  --quick             a single small case per kernel, for a smoke test\n"
+        "  --baseline FILE     earlier output, for the speedup column\n"
+        "  --output FILE       where to write the CSV (default stdout)\n"
+        "Kernels:\n"
+        "  recurrence_scalar recurrence_column recurrence_full  (MAP_AN_forLoop_mex)\n"
+        "  reservoir_release                                    (MAP_finalForLoop_mex)\n"
+        "  spikes_thinning spikes_binning                       (MAP_AN_generatePoissonSpikeTrains)\n"
+        "  refractoriness                                       (MAP_applyRefractoriness_mex)\n"
+        "  rate_spike_train rate_spike_events spikes_to_isi subsample_spike_trains average_channels\n"
+        "                     (rateSpikeTrain dense and sparse, spikes2ISI, subsampleSpikeTrains, averageChannels)\n"
+        "  synapse_runs synapse_sweep   one synapse run per setting, or one sweep over all (--fibers settings)\n"
+        "  psth_loop psth     spike trains added one repetition at a time, or PSTH counts (--fibers repetitions)\n");
+}
+
+std::vector<double> parse_list(const char *s) {
+    std::vector<double> values;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        values.push_back(std::atof(item.c_str()));
+    }
+    return values;
+}
+
+std::vector<std::string> parse_names(const char *s) {
+    std::vector<std::string> names;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        names.push_back(item);
+    }
+    return names;
+}
+
+struct Case {
+    std::size_t channels, frames, fibers;
+    int threads;
+};
+
+/* A kernel on the inputs of one case: run is timed, reset (not timed) restores
+ * the inputs that run changes in place */
+struct Run {
+    std::function<void()> run, reset;
+    double samples = 0, bytes = 0;
+};
+
+struct Kernel {
+    std::string name;
+    bool threaded, uses_fibers;
+    std::function<Run(const Case &)> make;
+};
+
+/* Probability per bin, modulated at 1 kHz around 1e-3 (100 spikes/s at 1e5 Hz) */
+std::vector<double> firing_probability(std::size_t rows, std::size_t cols) {
+    std::vector<double> prob(rows * cols);
+    for (std::size_t col = 0; col < cols; col++) {
+        for (std::size_t row = 0; row < rows; row++) {
+            prob[row + col * rows] = 1e-3 * (1 + std::sin(2 * 3.14159265358979323846 * 1e-2 * col + row));
+        }
+    }
+    return prob;
+}
+
+/* Vertical spike trains (rows = frames) with a spike probability p per frame */
+std::vector<double> bernoulli_spikes(std::size_t rows, std::size_t cols, double p) {
+    std::vector<double> spikes(rows * cols);
+    RandomStream rng(1, 0);
+    for (double &s : spikes) {
+        s = rng.uniform() < p ? 1.0 : 0.0;
+    }
+    return spikes;
+}
+
+Run recurrence(const Case &c, CoefficientShape shape) {
+    const std::size_t n = c.channels * c.frames;
+    auto A = std::make_shared<std::vector<double>>(firing_probability(c.channels, c.frames));
+    auto C = std::make_shared<std::vector<double>>(shape == CoefficientShape::Scalar ? 1
+                                                   : shape == CoefficientShape::Column ? c.channels : n, 0.99);
+    auto matrix = std::make_shared<std::vector<double>>(n);
+    auto vector = std::make_shared<std::vector<double>>(c.channels);
+    Run r;
+    r.run = [=] {
+        first_order_recurrence(matrix->data(), vector->data(), C->data(), shape, A->data(), c.channels, c.frames,
+                               c.threads);
+    };
+    r.reset = [=] { std::fill(vector->begin(), vector->end(), 0.0); };
+    r.samples = (double)n;
+    r.bytes = (shape == CoefficientShape::Full ? 24.0 : 16.0) * n;
+    return r;
+}
+
+Run reservoirs(const Case &c) {
+    const std::size_t n = c.channels * c.frames;
+    auto release = std::make_shared<std::vector<double>>(firing_probability(c.channels, c.frames));
+    auto prob = std::make_shared<std::vector<double>>(n);
+    auto state = std::make_shared<std::vector<double>>(3 * c.channels);
+    /* Reservoir rates of the AN of EarSumner2002 at 1e5 Hz */
+    auto rates = std::make_shared<std::vector<double>>(4 * c.channels);
+    for (std::size_t row = 0; row < c.channels; row++) {
+        (*rates)[row] = 66.3e-5;
+        (*rates)[c.channels + row] = 3e-5;
+        (*rates)[2 * c.channels + row] = 6580e-5 + 20e-5;
+        (*rates)[3 * c.channels + row] = 6580e-5;
+    }
+    Run r;
+    r.run = [=] {
+        double *s = state->data();
+        const double *k = rates->data();
+        reservoir_release(prob->data(), release->data(), c.channels, c.frames, s, s + c.channels,
+                          s + 2 * c.channels, 4.0, k, k + c.channels, k + 2 * c.channels, k + 3 * c.channels);
+    };
+    r.reset = [=] {
+        std::fill(state->begin(), state->begin() + c.channels, 4.0);
+        std::fill(state->begin() + c.channels, state->end(), 0.0);
+    };
+    r.samples = (double)n;
+    r.bytes = 16.0 * n;
+    return r;
+}
+
+Run poisson_spikes(const Case &c, SpikeAlgorithm algo) {
+    const std::size_t n = c.channels * c.frames * c.fibers;
+    auto rate = std::make_shared<std::vector<double>>(firing_probability(c.channels, c.frames));
+    auto spikes = std::make_shared<std::vector<unsigned char>>(n);
+    Run r;
+    r.run = [=] {
+        generate_poisson_spike_trains(spikes->data(), rate->data(), c.channels, c.frames, (int)c.fibers, 75, algo, 1,
+                                      c.threads);
+    };
+    r.reset = [=] { std::fill(spikes->begin(), spikes->end(), 0); };
+    r.samples = (double)n;
+    r.bytes = 8.0 * c.channels * c.frames + n;
+    return r;
+}
+
+/* PSTH of c.fibers repetitions, as the former loop of AuditoryNerve.m: one
+ * run of spike trains per repetition, added to a double histogram */
+Run psth_loop(const Case &c) {
+    const std::size_t n = c.channels * c.frames;
+    auto rate = std::make_shared<std::vector<double>>(firing_probability(c.channels, c.frames));
+    auto spikes = std::make_shared<std::vector<unsigned char>>(n);
+    auto counts = std::make_shared<std::vector<double>>(n);
+    Run r;
+    r.run = [=] {
+        for (std::size_t rep = 0; rep < c.fibers; rep++) {
+            std::fill(spikes->begin(), spikes->end(), 0);
+            generate_poisson_spike_trains(spikes->data(), rate->data(), c.channels, c.frames, 1, 75,
+                                          SpikeAlgorithm::Thinning, 1 + rep, c.threads);
+            for (std::size_t k = 0; k < n; k++) {
+                (*counts)[k] += (*spikes)[k];
+            }
+        }
+    };
+    r.reset = [=] { std::fill(counts->begin(), counts->end(), 0.0); };
+    r.samples = (double)n * c.fibers;
+    r.bytes = 8.0 * n + 8.0 * n;
+    return r;
+}
+
+Run psth(const Case &c) {
+    const std::size_t n = c.channels * c.frames;
+    auto rate = std::make_shared<std::vector<double>>(firing_probability(c.channels, c.frames));
+    auto counts = std::make_shared<std::vector<std::uint16_t>>(n);
+    Run r;
+    r.run = [=] {
+        generate_poisson_psth(counts->data(), rate->data(), c.channels, c.frames, 1, (int)c.fibers, 75,
+                              SpikeAlgorithm::Thinning, 1, c.threads);
+    };
+    r.reset = [=] { std::fill(counts->begin(), counts->end(), 0); };
+    r.samples = (double)n * c.fibers;
+    r.bytes = 8.0 * n + 2.0 * n;
+    return r;
+}
+
+Run refractoriness(const Case &c) {
+    const std::size_t n = c.channels * c.frames;
+    auto prob = std::make_shared<std::vector<double>>(firing_probability(c.channels, c.frames));
+    auto probref = std::make_shared<std::vector<double>>(n);
+    auto W = std::make_shared<std::vector<double>>(refractory_weights(0.75e-3, 1e-5));
+    Run r;
+    r.run = [=] {
+        apply_refractoriness(prob->data(), probref->data(), c.channels, c.frames, W->data(), W->size(), c.threads);
+    };
+    r.reset = [] {};
+    r.samples = (double)n;
+    r.bytes = 16.0 * n;
+    return r;
+}
+
+/* Spike analysis kernels: spike trains of channels * fibers fibers, vertical */
+Run rate_windows(const Case &c) {
+    const std::size_t rows = c.frames, cols = c.channels * c.fibers, n = rows * cols;
+    auto spikes = std::make_shared<std::vector<double>>(bernoulli_spikes(rows, cols, 1e-2));
+    /* Hann windows of 40 frames every 20 frames, as in the rateSpikeTrain example */
+    const std::size_t n_window = 40;
+    auto window = std::make_shared<std::vector<double>>(n_window);
+    for (std::size_t j = 0; j < n_window; j++) {
+        (*window)[j] = 0.5 - 0.5 * std::cos(2 * 3.14159265358979323846 * (j + 1) / (n_window + 1));
+    }
+    auto begin = std::make_shared<std::vector<double>>();
+    for (std::size_t b = 0; b + n_window <= rows; b += 20) {
+        begin->push_back((double)b);
+    }
+    auto rate = std::make_shared<std::vector<double>>(begin->size() * cols);
+    Run r;
+    r.run = [=] {
+        rate_spike_train(spikes->data(), rows, cols, begin->data(), begin->size(), window->data(), n_window,
+                         rate->data(), c.threads);
+    };
+    r.reset = [] {};
+    r.samples = (double)n;
+    r.bytes = 8.0 * n + 8.0 * rate->size();
+    return r;
+}
+
+/* Same windows over the same spikes, as lists of spike frames */
+Run rate_events(const Case &c) {
+    const std::size_t rows = c.frames, cols = c.channels * c.fibers, n = rows * cols;
+    std::vector<double> dense = bernoulli_spikes(rows, cols, 1e-2);
+    auto trains = std::make_shared<SpikeTrains>();
+    trains->n_fibers = cols;
+    trains->n_frames = rows;
+    trains->fiber_start.push_back(0);
+    for (std::size_t col = 0; col < cols; col++) {
+        for (std::size_t row = 0; row < rows; row++) {
+            if (dense[row + col * rows] != 0) {
+                trains->frames.push_back(row);
+            }
+        }
+        trains->fiber_start.push_back(trains->frames.size());
+    }
+    const std::size_t n_window = 40;
+    auto window = std::make_shared<std::vector<double>>(n_window);
+    for (std::size_t j = 0; j < n_window; j++) {
+        (*window)[j] = 0.5 - 0.5 * std::cos(2 * 3.14159265358979323846 * (j + 1) / (n_window + 1));
+    }
+    auto begin = std::make_shared<std::vector<double>>();
+    for (std::size_t b = 0; b + n_window <= rows; b += 20) {
+        begin->push_back((double)b);
+    }
+    auto rate = std::make_shared<std::vector<double>>(begin->size() * cols);
+    Run r;
+    r.run = [=] {
+        rate_spike_events(*trains, begin->data(), begin->size(), window->data(), n_window, rate->data(), c.threads);
+    };
+    r.reset = [] {};
+    r.samples = (double)n;
+    r.bytes = 8.0 * trains->n_spikes() + 8.0 * rate->size();
+    return r;
+}
+
+Run isi(const Case &c) {
+    const std::size_t rows = c.frames, cols = c.channels * c.fibers, n = rows * cols;
+    auto spikes = std::make_shared<std::vector<double>>(bernoulli_spikes(rows, cols, 1e-2));
+    auto out = std::make_shared<std::vector<double>>(n);
+    Run r;
+    r.run = [=] { spikes_to_isi(spikes->data(), rows, cols, out->data(), c.threads); };
+    r.reset = [] {};
+    r.samples = (double)n;
+    r.bytes = 16.0 * n;
+    return r;
+}
+
+Run subsample(const Case &c) {
+    const std::size_t rows = c.frames, cols = c.channels * c.fibers, n = rows * cols;
+    auto original = std::make_shared<std::vector<double>>(bernoulli_spikes(rows, cols, 1e-2));
+    auto spikes = std::make_shared<std::vector<double>>(n);
+    Run r;
+    r.run = [=] { subsample_spike_trains(spikes->data(), rows, cols, 3, c.threads); };
+    r.reset = [=] { *spikes = *original; };
+    r.samples = (double)n;
+    r.bytes = 16.0 * n;
+    return r;
+}
+
+/* Receptor potential around rest, modulated at 1 kHz */
+std::shared_ptr<Matrix> receptor_potential(std::size_t rows, std::size_t cols) {
+    auto V = std::make_shared<Matrix>(rows, cols);
+    for (std::size_t col = 0; col < cols; col++) {
+        for (std::size_t row = 0; row < rows; row++) {
+            (*V)(row, col) = -0.055 + 0.01 * std::sin(2 * 3.14159265358979323846 * 1e-2 * col + row);
+        }
+    }
+    return V;
+}
+
+/* Settings of a ca_thresh sweep */
+std::vector<SynapseSetting> sweep_settings(std::size_t n) {
+    std::vector<SynapseSetting> settings(n);
+    for (std::size_t k = 0; k < n; k++) {
+        settings[k].ca_thresh = 1e-11 * (1 + k);
+    }
+    return settings;
+}
+
+/* Release rates and probabilities of firing (no spikes) of c.fibers settings */
+Run synapse_runs(const Case &c) {
+    auto V = receptor_potential(c.channels, c.frames);
+    auto synapse = std::make_shared<AnIhcSynapse>();
+    auto an = std::make_shared<AuditoryNerve>();
+    auto settings = std::make_shared<std::vector<SynapseSetting>>(sweep_settings(c.fibers));
+    synapse->n_fibers_per_type_per_channel = 0;
+    synapse->n_threads = c.threads;
+    Run r;
+    r.run = [=] {
+        for (const SynapseSetting &setting : *settings) {
+            synapse->ca_thresh = setting.ca_thresh;
+            synapse->run(*V, -0.055, 1e5);
+            an->run(*synapse, 1e5);
+        }
+    };
+    r.reset = [] {};
+    r.samples = (double)c.channels * c.frames * c.fibers;
+    r.bytes = (8.0 + 8.0 * c.fibers) * c.channels * c.frames;
+    return r;
+}
+
+Run synapse_sweep(const Case &c) {
+    auto V = receptor_potential(c.channels, c.frames);
+    auto sweep = std::make_shared<SynapseSweep>();
+    sweep->synapse.n_fibers_per_type_per_channel = 0;
+    sweep->settings = sweep_settings(c.fibers);
+    sweep->n_threads = c.threads;
+    Run r;
+    r.run = [=] {
+        sweep->init(-0.055, c.channels, 1e5);
+        sweep->apply(*V);
+    };
+    r.reset = [] {};
+    r.samples = (double)c.channels * c.frames * c.fibers;
+    r.bytes = (8.0 + 8.0 * c.fibers) * c.channels * c.frames;
+    return r;
+}
+
+Run average(const Case &c) {
+    const std::size_t n = c.channels * c.frames, n_features = std::max<std::size_t>(1, c.channels / 4);
+    auto feats = std::make_shared<std::vector<double>>(firing_probability(c.channels, c.frames));
+    auto mean = std::make_shared<std::vector<double>>(n_features * c.frames);
+    Run r;
+    r.run = [=] { average_channels(feats->data(), c.channels, c.frames, n_features, mean->data(), c.threads); };
+    r.reset = [] {};
+    r.samples = (double)n;
+    r.bytes = 8.0 * n + 8.0 * mean->size();
+    return r;
+}
+
+std::vector<Kernel> kernels() {
+    return {
+        {"recurrence_scalar", true, false, [](const Case &c) { return recurrence(c, CoefficientShape::Scalar); }},
+        {"recurrence_column", true, false, [](const Case &c) { return recurrence(c, CoefficientShape::Column); }},
+        {"recurrence_full", true, false, [](const Case &c) { return recurrence(c, CoefficientShape::Full); }},
+        {"reservoir_release", false, false, reservoirs},
+        {"spikes_thinning", true, true, [](const Case &c) { return poisson_spikes(c, SpikeAlgorithm::Thinning); }},
+        {"spikes_binning", true, true, [](const Case &c) { return poisson_spikes(c, SpikeAlgorithm::Binning); }},
+        {"refractoriness", true, false, refractoriness},
+        {"rate_spike_train", true, true, rate_windows},
+        {"rate_spike_events", true, true, rate_events},
+        {"spikes_to_isi", true, true, isi},
+        {"subsample_spike_trains", true, true, subsample},
+        {"average_channels", true, false, average},
+        {"synapse_runs", true, true, synapse_runs},
+        {"synapse_sweep", true, true, synapse_sweep},
+        {"psth_loop", true, true, psth_loop},
+        {"psth", true, true, psth},
+    };
+}
+
+std::string case_key(const std::string &kernel, const Case &c) {
+    std::ostringstream key;
+    key << kernel << ',' << c.channels << ',' << c.frames << ',' << c.fibers << ',' << c.threads;
+    return key.str();
+}
+
+/* ns_per_sample of every case of an earlier output */
+std::map<std::string, double> read_baseline(const std::string &path) {
+    std::ifstream in(path);
+    if (!in) {
+        throw std::runtime_error("Unable to read file " + path);
+    }
+    std::map<std::string, double> baseline;
+    std::string line;
+    while (std::getline(in, line)) {
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, ',')) {
+            fields.push_back(field);
+        }
+        if (fields.size() < 7 || fields[0] == "kernel") {
+            continue;
+        }
+        baseline[fields[0] + ',' + fields[1] + ',' + fields[2] + ',' + fields[3] + ',' + fields[4]] =
+            std::atof(fields[6].c_str());
+    }
+    return baseline;
+}
+
+/* Best time of repeat runs, in seconds */
+double best_time(Run &r, int repeat) {
+    r.reset();
+    r.run();
+    double best = INFINITY;
+    for (int k = 0; k < repeat; k++) {
+        r.reset();
+        auto t0 = std::chrono::steady_clock::now();
+        r.run();
+        auto t1 = std::chrono::steady_clock::now();
+        best = std::min(best, std::chrono::duration<double>(t1 - t0).count());
+    }
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::string> names;
+    std::vector<double> channels = {8, 64}, frames = {1e4, 1e5}, fibers = {1, 20};
+    std::vector<double> threads = {1, (double)num_threads()};
+    std::string baseline_path, output;
+    int repeat = 5;
+
+    for (int k = 1; k < argc; k++) {
+        std::string arg = argv[k];
+        bool has_value = k + 1 < argc;
+        if (arg == "--kernels" && has_value) { names = parse_names(argv[++k]); }
+        else if (arg == "--channels" && has_value) { channels = parse_list(argv[++k]); }
+        else if (arg == "--frames" && has_value) { frames = parse_list(argv[++k]); }
+        else if (arg == "--fibers" && has_value) { fibers = parse_list(argv[++k]); }
+        else if (arg == "--threads" && has_value) { threads = parse_list(argv[++k]); }
+        else if (arg == "--repeat" && has_value) { repeat = std::atoi(argv[++k]); }
+        else if (arg == "--quick") { channels = {8}; frames = {2000}; fibers = {2}; threads = {1, 2}; }
+        else if (arg == "--baseline" && has_value) { baseline_path = argv[++k]; }
+        else if (arg == "--output" && has_value) { output = argv[++k]; }
+        else if (arg == "-h" || arg == "--help") { usage(); return 0; }
+        else { usage(); return 2; }
+    }
+
+    try {
+        std::vector<Kernel> selected;
+        for (const Kernel &kernel : kernels()) {
+            if (names.empty() || std::find(names.begin(), names.end(), kernel.name) != names.end()) {
+                selected.push_back(kernel);
+            }
+        }
+        if (selected.size() < std::max<std::size_t>(names.size(), 1)) {
+            throw std::invalid_argument("Unknown kernel in --kernels");
+        }
+        std::map<std::string, double> baseline;
+        if (!baseline_path.empty()) {
+            baseline = read_baseline(baseline_path);
+        }
+        FILE *out = stdout;
+        if (!output.empty()) {
+            out = std::fopen(output.c_str(), "w");
+            if (out == nullptr) {
+                throw std::runtime_error("Unable to write to file " + output);
+            }
+        }
+
+        std::fprintf(out, "kernel,channels,frames,fibers,threads,seconds,ns_per_sample,gb_per_s,speedup\n");
+        for (const Kernel &kernel : selected) {
+            for (double n_channels : channels) {
+                for (double n_frames : frames) {
+                    for (double n_fibers : kernel.uses_fibers ? fibers : std::vector<double>{1}) {
+                        for (double n_threads : kernel.threaded ? threads : std::vector<double>{1}) {
+                            Case c = {(std::size_t)n_channels, (std::size_t)n_frames, (std::size_t)n_fibers,
+                                      (int)n_threads};
+                            Run r = kernel.make(c);
+                            double seconds = best_time(r, std::max(repeat, 1));
+                            double ns_per_sample = 1e9 * seconds / r.samples;
+                            std::string key = case_key(kernel.name, c);
+                            std::fprintf(out, "%s,%.6g,%.4g,%.4g,", key.c_str(), seconds, ns_per_sample,
+                                         r.bytes / seconds * 1e-9);
+                            auto it = baseline.find(key);
+                            if (it != baseline.end()) {
+                                std::fprintf(out, "%.4g", it->second / ns_per_sample);
+                            }
+                            std::fprintf(out, "\n");
+                            std::fflush(out);
+                        }
+                    }
+                }
+            }
+        }
+        if (out != stdout) {
+            std::fclose(out);
+        }
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "earing_bench: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
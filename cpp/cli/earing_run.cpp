@@ -0,0 +1,435 @@
+/* Command-line front end running the whole Sumner2002 ear model natively on a
+ * WAV file (resampled to 1e5 Hz) or a raw float64 buffer sampled at 1e5 Hz.
+ *
+ * Usage: earing_run [options] input.wav
+ *
+ * The requested stage output is written to --output as a headerless column-major
+ * matrix (rows = channels or fibers, columns = time frames), readable in Matlab
+ * with fread(fid, [rows, cols], 'double') ('single' with --single, 'uint8' for
+ * spikes). The events stage writes the spikes as a 2 x n_spikes double matrix
+ * of (fiber, frame) pairs, 1-based, for sparse(events(1,:), events(2,:), true).
+ * Its size is printed on stdout. With --chunk, the stimulus is processed (and
+ * the output written) chunk by chunk, in memory bounded by the chunk size.
+ * With --features, the stage output goes through a ProcessingAsr feature
+ * string (features.hpp) chunk by chunk, and the feature frames are written
+ * instead (rows = features, columns = frames, double), or, with --htk, to an
+ * HTK feature file as read by htkread.m and HTK (frames every --features frame
+ * period, parmKind --htk-kind, USER by default; add 1024 for compression).
+ * Outputs only appear once complete (AtomicFile).
+ *
+ * With --cache, the BM velocity, receptor potential and release rate are kept
+ * in a stage cache directory (stage_cache.hpp), so that runs on the same
+ * inputs with other synapse or AN parameters, stages or features start from
+ * the last stage they share.
+ *
+ * With --list, every input/output pair of a list file is run as above on
+ * parallel workers (batch.hpp), longest inputs first, existing outputs being
+ * skipped so that an interrupted batch resumes where it stopped.
+ */
+
+#include "earing/atomic_file.hpp"
+#include "earing/batch.hpp"
+#include "earing/ear_sumner2002.hpp"
+#include "earing/features.hpp"
+#include "earing/htk.hpp"
+#include "earing/parallel.hpp"
+#include "earing/stage_cache.hpp"
+#include "earing/stimulus.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+void usage() {
+    std::fprintf(stderr,
+        "Usage: earing_run [options] input.wav\n"
+        "       earing_run [options] --list FILE\n"
+        "Options:\n"
+        "  --raw              input is headerless little-endian float64 at 1e5 Hz\n"
+        "  --db X             sound level of the stimulus (default 80)\n"
+        "  --no-renormalise   use the stimulus as is (in Pascals)\n"
+        "  --bfs a,b,...      best frequencies (Hz)\n"
+        "  --n-bfs N          N log-spaced best frequencies between --bf-min and --bf-max\n"
+        "  --bf-min X         (default 100)\n"
+        "  --bf-max X         (default 8000)\n"
+        "  --fibers N         fibers per type per channel; 0 for probabilities only (default 1)\n"
+        "  --gmaxca X         synapse g_max^Ca\n"
+        "  --ca-thresh X      synapse calcium threshold\n"
+        "  --tauCa a,b,...    one tauCa per fiber type\n"
+        "  --spike-fs X       sample rate of the AN stages, at most 1e5 (fs / ceil(1e5 / X))\n"
+        "  --seed N           seed of the spike trains (default: random)\n"
+        "  --quantal          spikes from stochastic synapses (binomial vesicle release)\n"
+        "  --single           run the model in single precision (float32 stage outputs)\n"
+        "  --stage S          bm | rp | release | prob | probref | spikes | events (default prob)\n"
+        "  --output FILE      where to write the stage output\n"
+        "  --chunk N          process the stimulus in chunks of N samples\n"
+        "  --features F       write the features F of the stage output instead, e.g. r_l_d_dd\n"
+        "  --running-stats    z and ga from the frames seen so far, rather than held to the end\n"
+        "  --htk FILE         write the features to an HTK file\n"
+        "  --htk-kind N       HTK parmKind (default 9, USER; 1024 + 9 for compressed)\n"
+        "  --list FILE        run every 'input output' line of FILE (tab or space separated) in\n"
+        "                     parallel, skipping existing outputs; HTK outputs with --features\n"
+        "  --workers N        number of files run at once (default: number of cores)\n"
+        "  --cache DIR        reuse the bm, rp and release outputs stored in DIR, storing new ones\n"
+        "                     (not with --chunk)\n"
+        "  --cache-size MB    evict the least recently used entries of DIR beyond MB\n"
+        "  --profile          print the time and memory of every stage on stderr\n"
+        "  --profile-log FILE append them to a CSV file, labelled with the input file\n");
+}
+
+std::vector<double> parse_list(const char *s) {
+    std::vector<double> values;
+    std::stringstream ss(s);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        values.push_back(std::atof(item.c_str()));
+    }
+    return values;
+}
+
+/* Jobs of a --list file: one "input output" pair per line, separated by a tab
+ * (paths may then hold spaces) or by the first space; empty lines and lines
+ * starting with # are ignored */
+std::vector<earing::BatchJob> read_list(const std::string &path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Unable to read from file " + path);
+    }
+    std::vector<earing::BatchJob> jobs;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::size_t sep = line.find('\t');
+        if (sep == std::string::npos) {
+            sep = line.find(' ');
+        }
+        if (sep == std::string::npos) {
+            throw std::invalid_argument("No output for " + line + " in " + path);
+        }
+        earing::BatchJob job;
+        job.input = line.substr(0, sep);
+        job.output = line.substr(sep + 1);
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+/* Appends the time frames of the chosen stage (or of its features) to a file,
+ * chunk after chunk */
+class StageWriter {
+public:
+    StageWriter(const std::string &stage, const std::string &path, const std::string &features = "",
+                bool running_statistics = false, const std::string &htk = "", int htk_kind = earing::htk_user)
+        : stage_(stage), path_(path), features_(features), htk_path_(htk), htk_kind_(htk_kind) {
+        params_.running_statistics = running_statistics;
+        if (!features.empty()) {
+            earing::FeaturePipeline check(features, params_);
+        } else if (!htk.empty()) {
+            throw std::invalid_argument("--htk needs --features");
+        }
+        if (stage != "bm" && stage != "rp" && stage != "release" && stage != "prob" && stage != "probref" &&
+            stage != "spikes" && stage != "events") {
+            throw std::invalid_argument("Unknown stage " + stage);
+        }
+        if (!path.empty()) {
+            file_.reset(new earing::AtomicFile(path));
+        }
+    }
+
+    template <typename T>
+    void write(const earing::BasicEarSumner2002<T> &ear) {
+        type_ = sizeof(T) == sizeof(float) ? "float" : "double";
+        if (!features_.empty()) {
+            write_features(ear);
+            return;
+        }
+        if (stage_ == "spikes" || stage_ == "events") {
+            const earing::SpikeTrains &trains = ear.an.spike_trains;
+            if (stage_ == "spikes") {
+                std::vector<unsigned char> spikes(trains.n_fibers * trains.n_frames, 0);
+                earing::to_dense(trains, spikes.data());
+                write(spikes.data(), spikes.size());
+            } else {
+                std::vector<double> events(2 * trains.n_spikes());
+                for (std::size_t fiber = 0; fiber < trains.n_fibers; fiber++) {
+                    for (std::size_t k = trains.fiber_start[fiber]; k < trains.fiber_start[fiber + 1]; k++) {
+                        events[2 * k] = (double)(fiber + 1);
+                        events[2 * k + 1] = (double)(cols_ + trains.frames[k] + 1);
+                    }
+                }
+                write(events.data(), events.size());
+            }
+            rows_ = trains.n_fibers;
+            cols_ += trains.n_frames;
+            n_spikes_ += trains.n_spikes();
+            return;
+        }
+        const earing::BasicMatrix<T> &out = stage_output(ear);
+        rows_ = out.rows();
+        cols_ += out.cols();
+        write(out.data(), out.size());
+    }
+
+    /* Frames held back by the features until the end of the stimulus; the
+     * output files only appear then, complete */
+    void finish() {
+        if (pipeline_) {
+            pipeline_->finish();
+            write_frames();
+        }
+        if (htk_) {
+            htk_->close();
+        }
+        if (file_) {
+            file_->commit();
+        }
+    }
+
+    void summary() const {
+        if (!features_.empty()) {
+            std::printf("features %s of %s: %zu x %zu double\n", features_.c_str(), stage_.c_str(), rows_, cols_);
+        } else if (stage_ == "spikes") {
+            std::printf("spikes: %zu x %zu uint8, %zu spikes\n", rows_, cols_, n_spikes_);
+        } else if (stage_ == "events") {
+            std::printf("events: 2 x %zu double, %zu fibers x %zu frames\n", n_spikes_, rows_, cols_);
+        } else {
+            std::printf("%s: %zu x %zu %s\n", stage_.c_str(), rows_, cols_, type_);
+        }
+    }
+
+private:
+    template <typename T>
+    const earing::BasicMatrix<T> &stage_output(const earing::BasicEarSumner2002<T> &ear) const {
+        return stage_ == "bm" ? ear.drnl.response
+             : stage_ == "rp" ? ear.cilia.receptor_potential
+             : stage_ == "release" ? ear.synapse.vesicle_release_rate
+             : stage_ == "probref" ? ear.an.prob_firing_refractory
+             : ear.an.prob_firing;
+    }
+
+    /* The AN stages run at fs / decimation, known once the ear is initialised */
+    template <typename T>
+    void write_features(const earing::BasicEarSumner2002<T> &ear) {
+        if (!pipeline_) {
+            bool an_stage = stage_ != "bm" && stage_ != "rp" && stage_ != "release";
+            params_.fs = ear.fs / (an_stage ? ear.an.decimation : 1);
+            pipeline_.reset(new earing::FeaturePipeline(features_, params_));
+            if (!htk_path_.empty()) {
+                int period = (int)std::lround(pipeline_->frame_period() * 1e7);
+                htk_.reset(new earing::HtkWriter(htk_path_, htk_kind_, period));
+            }
+        }
+        if (stage_ == "spikes" || stage_ == "events") {
+            pipeline_->apply(ear.an.spike_trains);
+        } else {
+            pipeline_->apply(stage_output(ear));
+        }
+        write_frames();
+    }
+
+    void write_frames() {
+        const earing::Matrix &frames = pipeline_->frames;
+        if (!frames.empty()) {
+            rows_ = frames.rows();
+        }
+        cols_ += frames.cols();
+        write(frames.data(), frames.size());
+        if (htk_) {
+            htk_->write(frames);
+        }
+    }
+
+    template <typename U>
+    void write(const U *data, std::size_t n) {
+        if (file_ && std::fwrite(data, sizeof(U), n, file_->get()) != n) {
+            throw std::runtime_error("Unable to write to file " + path_);
+        }
+    }
+
+    std::string stage_, path_, features_, htk_path_;
+    int htk_kind_;
+    earing::FeatureParams params_;
+    std::unique_ptr<earing::FeaturePipeline> pipeline_;
+    std::unique_ptr<earing::HtkWriter> htk_;
+    const char *type_ = "double";
+    std::unique_ptr<earing::AtomicFile> file_;
+    std::size_t rows_ = 0, cols_ = 0, n_spikes_ = 0;
+};
+
+} // namespace
+
+int main(int argc, char **argv) {
+    using namespace earing;
+
+    std::string input, output, stage = "prob", profile_log, features, htk, list, cache_dir;
+    bool raw = false, renormalise = true, quantal = false, single = false, profile = false, running_stats = false;
+    double db = 80, bf_min = 100, bf_max = 8000, cache_size = 0;
+    int n_bfs = 0, fibers = 1, htk_kind = htk_user, workers = 0;
+    long chunk = 0;
+    std::vector<double> bfs, tauCa;
+    double gmaxca = NAN, ca_thresh = NAN, spike_fs = NAN;
+    const char *seed = nullptr;
+
+    for (int k = 1; k < argc; k++) {
+        std::string arg = argv[k];
+        bool has_value = k + 1 < argc;
+        if (arg == "--raw") { raw = true; }
+        else if (arg == "--no-renormalise") { renormalise = false; }
+        else if (arg == "--quantal") { quantal = true; }
+        else if (arg == "--single") { single = true; }
+        else if (arg == "--profile") { profile = true; }
+        else if (arg == "--running-stats") { running_stats = true; }
+        else if (arg == "--features" && has_value) { features = argv[++k]; }
+        else if (arg == "--htk" && has_value) { htk = argv[++k]; }
+        else if (arg == "--htk-kind" && has_value) { htk_kind = std::atoi(argv[++k]); }
+        else if (arg == "--profile-log" && has_value) { profile_log = argv[++k]; }
+        else if (arg == "--db" && has_value) { db = std::atof(argv[++k]); }
+        else if (arg == "--bfs" && has_value) { bfs = parse_list(argv[++k]); }
+        else if (arg == "--n-bfs" && has_value) { n_bfs = std::atoi(argv[++k]); }
+        else if (arg == "--bf-min" && has_value) { bf_min = std::atof(argv[++k]); }
+        else if (arg == "--bf-max" && has_value) { bf_max = std::atof(argv[++k]); }
+        else if (arg == "--fibers" && has_value) { fibers = std::atoi(argv[++k]); }
+        else if (arg == "--gmaxca" && has_value) { gmaxca = std::atof(argv[++k]); }
+        else if (arg == "--ca-thresh" && has_value) { ca_thresh = std::atof(argv[++k]); }
+        else if (arg == "--tauCa" && has_value) { tauCa = parse_list(argv[++k]); }
+        else if (arg == "--spike-fs" && has_value) { spike_fs = std::atof(argv[++k]); }
+        else if (arg == "--seed" && has_value) { seed = argv[++k]; }
+        else if (arg == "--stage" && has_value) { stage = argv[++k]; }
+        else if (arg == "--output" && has_value) { output = argv[++k]; }
+        else if (arg == "--chunk" && has_value) { chunk = std::atol(argv[++k]); }
+        else if (arg == "--list" && has_value) { list = argv[++k]; }
+        else if (arg == "--workers" && has_value) { workers = std::atoi(argv[++k]); }
+        else if (arg == "--cache" && has_value) { cache_dir = argv[++k]; }
+        else if (arg == "--cache-size" && has_value) { cache_size = std::atof(argv[++k]); }
+        else if (arg == "-h" || arg == "--help") { usage(); return 0; }
+        else if (!arg.empty() && arg[0] != '-' && input.empty()) { input = arg; }
+        else { usage(); return 2; }
+    }
+    if (input.empty() == list.empty()) {
+        usage();
+        return 2;
+    }
+
+    try {
+        if (bfs.empty()) {
+            bfs = default_best_frequencies();
+            if (n_bfs > 0) {
+                bfs.resize(n_bfs);
+                for (int k = 0; k < n_bfs; k++) {
+                    double w = n_bfs > 1 ? (double)k / (n_bfs - 1) : 0.0;
+                    bfs[k] = std::pow(10.0, std::log10(bf_min) + (std::log10(bf_max) - std::log10(bf_min)) * w);
+                }
+            }
+        }
+
+        /* Shared by the workers of a batch */
+        std::unique_ptr<StageCache> cache;
+        if (!cache_dir.empty()) {
+            if (chunk > 0) {
+                throw std::invalid_argument("--cache does not apply to --chunk runs");
+            }
+            cache.reset(new StageCache(cache_dir, (std::uint64_t)(cache_size * 1024 * 1024)));
+        }
+
+        /* Runs the model on one input file, writing to output or, with
+         * features, to htk_output if given */
+        std::mutex log_mutex;
+        auto process = [&](const std::string &in, const std::string &out, const std::string &htk_out,
+                           bool print_summary) {
+            StageWriter writer(stage, out, features, running_stats, htk_out, htk_kind);
+            Stimulus stimulus = raw ? read_raw(in) : read_wav(in);
+            auto run = [&](auto &ear) {
+                ear.db = db;
+                ear.renormalise = renormalise;
+                ear.synapse.n_fibers_per_type_per_channel = fibers;
+                if (!std::isnan(gmaxca)) { ear.synapse.gmaxca = gmaxca; }
+                if (!std::isnan(ca_thresh)) { ear.synapse.ca_thresh = ca_thresh; }
+                if (!tauCa.empty()) { ear.synapse.tauCa = tauCa; }
+                if (!std::isnan(spike_fs)) { ear.synapse.spikesTargetSampleRate = spike_fs; }
+                if (seed != nullptr) { ear.an.seed = std::strtoull(seed, nullptr, 10); }
+                ear.an.refractoriness = stage == "probref";
+                ear.an.quantal_release = quantal;
+                ear.profiling = profile || !profile_log.empty();
+                ear.cache = cache.get();
+                using Stage = typename std::decay_t<decltype(ear)>::Stage;
+                ear.cache_until = stage == "bm" ? Stage::bm
+                                : stage == "rp" ? Stage::rp
+                                : stage == "release" ? Stage::release : Stage::an;
+
+                if (chunk > 0) {
+                    ear.run_chunked(std::move(stimulus.samples), stimulus.fs, (std::size_t)chunk,
+                                    [&writer](const auto &e, std::size_t, std::size_t) { writer.write(e); });
+                } else {
+                    ear.run(std::move(stimulus.samples), stimulus.fs);
+                    writer.write(ear);
+                }
+                std::lock_guard<std::mutex> lock(log_mutex);
+                if (profile) { ear.profile.print(stderr); }
+                if (!profile_log.empty()) { ear.profile.append_csv(profile_log, in); }
+            };
+            if (single) {
+                EarSumner2002Single ear(bfs);
+                run(ear);
+            } else {
+                EarSumner2002 ear(bfs);
+                run(ear);
+            }
+            writer.finish();
+            if (print_summary) { writer.summary(); }
+        };
+
+        if (list.empty()) {
+            process(input, output, htk, true);
+            return 0;
+        }
+
+        /* Batch: every worker runs single-threaded stages unless there are
+         * more cores than workers */
+        std::vector<BatchJob> jobs = read_list(list);
+        for (BatchJob &job : jobs) {
+            job.cost = file_size(job.input);
+        }
+        int n_workers = workers > 0 ? workers : num_threads();
+        set_num_threads(std::max(1, num_threads() / n_workers));
+        bool htk_outputs = !features.empty();
+        BatchReport report = run_batch(
+            std::move(jobs),
+            [&](const BatchJob &job) {
+                process(job.input, htk_outputs ? "" : job.output, htk_outputs ? job.output : "", false);
+            },
+            n_workers,
+            [](const BatchJob &job, double seconds, bool failed, std::size_t finished, std::size_t total) {
+                std::fprintf(stderr, "[%zu/%zu] %s %s (%.2f s)\n", finished, total, failed ? "failed" : "done",
+                             job.input.c_str(), seconds);
+            });
+        for (const std::string &error : report.errors) {
+            std::fprintf(stderr, "earing_run: %s\n", error.c_str());
+        }
+        std::printf("batch: %zu done, %zu skipped, %zu failed in %.2f s\n", report.done, report.skipped,
+                    report.failed, report.seconds);
+        return report.failed > 0 ? 1 : 0;
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "earing_run: %s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
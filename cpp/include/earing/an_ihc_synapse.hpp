@@ -0,0 +1,90 @@
+#pragma once
+
+/* Vesicle release rate for each fiber type at each BF (see AnIhcSynapse.m and
+ * IhcPreSynapse.m). Each BF is replicated using a different fiber type to make
+ * a 'channel': channel = fiber_type * n_BFs + BF. Fiber types are specified in
+ * terms of tauCa. T is the sample type of the receptor potential, of the
+ * outputs and of the per-sample arithmetic, the state being double. */
+
+#include "earing/matrix.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace earing {
+
+template <typename T>
+class BasicAnIhcSynapse {
+public:
+    /* Calcium control (more calcium, greater release rate) */
+    double z      = 2e32;
+    double ECa    = 0.066;    /* calcium equilibrium potential */
+    double beta   = 400;      /* determine Ca channel opening */
+    double gamma  = 130;      /* determine Ca channel opening */
+    double tauM   = .75e-4;   /* calcium current time constant (s) */
+    std::vector<double> tauCa = {.75e-4};  /* one value per fiber type */
+    double power     = 3;         /* k(t) = z([Ca_2+](t)^power) */
+    double gmaxca    = 8.0e-9;    /* MSR fiber g_max^ca */
+    double ca_thresh = 4.48e-11;  /* MSR fiber calcium threshold */
+
+    /* Reservoir parameters, read by AuditoryNerve */
+    double y = 10;       /* replenishment rate */
+    double l = 2580;     /* loss rate */
+    double x = 66.3;     /* reprocessing rate */
+    double r = 6580;     /* recovery rate */
+    double M = 10;       /* maximum vesicles at synapse */
+    double refractory_period = 0.75e-3;
+    double spikesTargetSampleRate = 100000;
+    int n_fibers_per_type_per_channel = 2;  /* set to 0 for output_mode='PROB' */
+
+    /* Set by init() */
+    double dt = 0;                    /* time frame: 1/fs */
+    std::size_t n_BFs = 0;
+    std::size_t n_AN_fiber_types = 0;
+    std::size_t n_AN_channels = 0;
+    std::vector<double> tauCas;       /* one tauCa per channel */
+    std::vector<double> ICaCurrent;   /* startup currents */
+    std::vector<double> kt0;          /* release rate at startup */
+
+    /* State carried between calls to apply(), initialised at rest. mICa does
+     * not depend on the fiber type, so it is kept once per BF */
+    std::vector<double> mICaCurrent;  /* one per BF */
+    std::vector<double> CaCurrent;    /* one per channel */
+
+    /* mICa (one row per BF) and synapticCa (one row per channel) are only kept
+     * if keep_intermediates is set; otherwise apply() writes the release rate
+     * only */
+    bool keep_intermediates = false;
+    BasicMatrix<T> mICa;
+    BasicMatrix<T> synapticCa;
+    BasicMatrix<T> vesicle_release_rate;  /* output */
+
+    int n_threads = 0;            /* 0: num_threads() */
+
+    void init(double ihc_cilia_restingV, std::size_t n_BFs, double fs);
+
+    /* Process the next block of receptor potential; outputs hold this block only */
+    void apply(const BasicMatrix<T> &ihc_receptor_potential);
+
+    void run(const BasicMatrix<T> &ihc_receptor_potential, double ihc_cilia_restingV, double fs);
+
+    void clean() {
+        mICa.clear();
+        synapticCa.clear();
+        vesicle_release_rate.clear();
+    }
+
+private:
+    /* Advances mICa of BFs [b0, b1) and Ca of their channels over frames
+     * [c0, c1); m indexed by BF, Ca by channel */
+    void run_kernel(const BasicMatrix<T> &ihc_receptor_potential, std::size_t b0, std::size_t b1, std::size_t c0,
+                    std::size_t c1, double *m, double *Ca);
+
+    /* Per fiber type, set by init(): Ca decay 1 - dt / tauCa, and dt / tauCa */
+    std::vector<double> C_;
+    std::vector<T> one_minus_C_;
+};
+
+using AnIhcSynapse = BasicAnIhcSynapse<double>;
+
+} // namespace earing
@@ -0,0 +1,34 @@
+#pragma once
+
+/* Output file written under a temporary name (path + ".part") and renamed
+ * over path by commit(): path either does not exist or is complete, whatever
+ * happens to the process, so that a batch can be resumed by checking which
+ * outputs exist (see batch.hpp). */
+
+#include <cstdio>
+#include <string>
+
+namespace earing {
+
+class AtomicFile {
+public:
+    /* Throws std::runtime_error if the temporary file cannot be created */
+    explicit AtomicFile(const std::string &path);
+    AtomicFile(const AtomicFile &) = delete;
+    AtomicFile &operator=(const AtomicFile &) = delete;
+    /* Removes the temporary file if commit() was not called */
+    ~AtomicFile();
+
+    FILE *get() const { return file_; }
+    const std::string &path() const { return path_; }
+
+    /* Closes the file and renames it to path. Throws std::runtime_error on
+     * failure, the temporary file being removed */
+    void commit();
+
+private:
+    std::string path_, part_;
+    FILE *file_ = nullptr;
+};
+
+} // namespace earing
@@ -0,0 +1,125 @@
+#pragma once
+
+/* Each row of the AN matrices represents one AN fiber (see AuditoryNerve.m).
+ * The probability of firing is obtained from the cleft/available/reprocess
+ * vesicle reservoirs; spikes are then optionally generated from it. T is the
+ * sample type of the release rate and of the probabilities of firing, the
+ * reservoirs being double. */
+
+#include "earing/matrix.hpp"
+#include "earing/profile.hpp"
+#include "earing/quantal_release.hpp"
+#include "earing/refractoriness.hpp"
+#include "earing/spike_trains.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace earing {
+
+template <typename T>
+class BasicAnIhcSynapse;
+
+/* Deterministic reservoir model (formerly MAP_finalForLoop_mex): for each time
+ * frame and row,
+ *   ejected = release_prob * available, prob_firing = ejected
+ * and the reservoirs available, cleft and reprocess (one value per row) are
+ * updated in place. T (of prob_firing and release_prob) is double or float,
+ * the reservoirs are double. */
+template <typename T>
+void reservoir_release(T *prob_firing, const T *release_prob, std::size_t rows, std::size_t cols,
+                       double *available, double *cleft, double *reprocess, double M,
+                       const double *xdt, const double *ydt, const double *rdt_plus_ldt, const double *rdt);
+
+/* Decimated reservoir model (vectInd of MAP_finalForLoop_mex): release_prob is
+ * averaged over groups of `decimation` frames (boxcar anti-aliasing filter)
+ * and the reservoirs are stepped once per group, so release_prob and the
+ * reservoir rates should be scaled by the decimated dt. prob_sum (one value
+ * per row) and n_summed carry an incomplete group from one call to the next;
+ * if flush, a trailing incomplete group is averaged over its own length
+ * instead. Returns the number of columns written to prob_firing, and to
+ * decimated_prob (the averaged release_prob) if not null. */
+template <typename T>
+std::size_t decimated_reservoir_release(T *prob_firing, const T *release_prob, std::size_t rows,
+                                        std::size_t cols, std::size_t decimation, double *prob_sum,
+                                        std::size_t &n_summed, bool flush, double *available, double *cleft,
+                                        double *reprocess, double M, const double *xdt, const double *ydt,
+                                        const double *rdt_plus_ldt, const double *rdt,
+                                        T *decimated_prob = nullptr);
+
+/* Averages of release_prob over the groups of `decimation` frames, carried
+ * and flushed as in decimated_reservoir_release (which steps the reservoirs
+ * on them), written to decimated_prob. Returns the number of columns written */
+template <typename T>
+std::size_t decimate_release_prob(T *decimated_prob, const T *release_prob, std::size_t rows, std::size_t cols,
+                                  std::size_t decimation, double *prob_sum, std::size_t &n_summed, bool flush);
+
+template <typename T>
+class BasicAuditoryNerve {
+public:
+    /* PROB = synapse vesicle release probability, SPIKE = spikes generation */
+    std::string output_mode = "SPIKE";
+    SpikeAlgorithm spike_algorithm = SpikeAlgorithm::Thinning;
+    /* Seed of the spike trains (see spike_trains.hpp); set it for reproducible spikes */
+    std::uint64_t seed = random_seed();
+
+    std::size_t n_fibers_per_channel = 1;
+    std::size_t n_channels = 0;
+    std::size_t n_fibers = 0;
+    /* The AN runs at fs / decimation, the smallest rate not below
+     * synapse.spikesTargetSampleRate; dt is its time frame */
+    std::size_t decimation = 1;
+    double dt = 0;
+    int lengthAbsRefractory = 0;
+    double M = 0;
+    std::vector<double> ydt, ldt, xdt, rdt, rdt_plus_ldt;
+
+    /* Reservoirs */
+    std::vector<double> cleft, available, reprocess;
+    /* Incomplete decimation group carried between calls to apply() */
+    std::vector<double> prob_sum;
+    std::size_t n_summed = 0;
+
+    /* If true, spikes are fired by n_fibers_per_channel stochastic synapses per
+     * channel (see quantal_release.hpp) rather than drawn from prob_firing */
+    bool quantal_release = false;
+
+    /* If true, also computes the probability of firing with refractoriness */
+    bool refractoriness = false;
+
+    BasicMatrix<T> prob_firing;
+    BasicMatrix<T> prob_firing_refractory;  /* see refractoriness.hpp */
+    SpikeTrains spike_trains;  /* output of run_spike, n_fibers spike trains over the block */
+
+    /* Sets the parameters and the reservoirs at their startup values */
+    void init(const BasicAnIhcSynapse<T> &synapse, double fs);
+
+    /* Process the next block of vesicle release rate; outputs hold this block
+     * only, i.e. the decimation groups completed by it. If flush (last block of
+     * the signal), a trailing incomplete group gives one more column, averaged
+     * over its own length, so that a signal of N frames gives ceil(N /
+     * decimation) columns as in AuditoryNerve.m. Given a profile, the an_prob,
+     * an_refractoriness and an_spikes steps are recorded in it */
+    void apply(const BasicMatrix<T> &vesicle_release_rate, Profile *profile = nullptr, bool flush = false);
+
+    void run(const BasicAnIhcSynapse<T> &synapse, double fs);
+    void run_spike();
+    void run_prob_refractoriness();
+
+    void clean() {
+        prob_firing.clear();
+        prob_firing_refractory.clear();
+        spike_trains.clear();
+    }
+
+private:
+    SpikeGenerator spike_generator_;
+    QuantalRelease quantal_release_;
+    RefractoryProbability refractory_;
+};
+
+using AuditoryNerve = BasicAuditoryNerve<double>;
+
+} // namespace earing
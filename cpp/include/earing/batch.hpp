@@ -0,0 +1,52 @@
+#pragma once
+
+/* Runs the utterances of a dataset on parallel workers (earing_run --list).
+ *
+ * Jobs are sorted by decreasing cost (e.g. the size of their input, i.e. its
+ * duration) and dealt round-robin to one queue per worker. Workers take the
+ * largest job of their own queue, then steal the smallest one left in the
+ * queue of another worker: long utterances start first and short ones fill the
+ * tail, so that no long utterance is left for the end.
+ *
+ * A job whose output already exists is skipped: work(job) must write its
+ * output atomically (AtomicFile, HtkWriter), so that an interrupted batch
+ * can be resumed by running it again. A job throwing an exception is counted
+ * as failed and the others go on.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace earing {
+
+struct BatchJob {
+    std::string input;
+    std::string output;
+    std::uint64_t cost = 0;
+};
+
+struct BatchReport {
+    std::size_t done = 0;
+    std::size_t skipped = 0;   /* output already there */
+    std::size_t failed = 0;
+    std::vector<std::string> errors;  /* "input: message" of the failed jobs */
+    double seconds = 0;
+};
+
+/* Called after every job run, done (or failed), from the worker that ran it
+ * but never concurrently: job, seconds it took, number of jobs finished so far
+ * and number of jobs to run */
+using BatchProgress =
+    std::function<void(const BatchJob &job, double seconds, bool failed, std::size_t finished, std::size_t total)>;
+
+/* n_workers <= 0 for num_threads() (parallel.hpp) */
+BatchReport run_batch(std::vector<BatchJob> jobs, const std::function<void(const BatchJob &)> &work,
+                      int n_workers = 0, const BatchProgress &progress = BatchProgress());
+
+/* Size of the file in bytes, 0 if it does not exist */
+std::uint64_t file_size(const std::string &path);
+
+} // namespace earing
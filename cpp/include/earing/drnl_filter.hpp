@@ -0,0 +1,73 @@
+#pragma once
+
+/* Dual-resonance nonlinear filterbank: applies and sums the linear and
+ * nonlinear paths of each best frequency (see matlab/filters/nonlinear/).
+ * Parameters taken from Sumner & O'Mard 2003 "A nonlinear filter-bank model of
+ * the guinea-pig cochlear nerve: Rate responses".
+ *
+ * All best frequencies go through the cascades together, one time step at a
+ * time, in the lanes of IirFilterBanks; blocks of best frequencies are spread
+ * over n_threads threads (n_threads <= 0 for num_threads()). The filter states
+ * are double whatever the sample type T of the response. */
+
+#include "earing/filters.hpp"
+#include "earing/matrix.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace earing {
+
+template <typename T>
+class BasicDRNLFilter {
+public:
+    /* parameter = 10 ^ (p0 + m * log10(BF)) */
+    struct Parameters {
+        double BWnl, a, b, CFlin, BWlin, Glin;
+    };
+    Parameters p0 = {0.8, 1.87, -5.65, 0.339, 1.3, 5.68};
+    Parameters m = {0.58, 0.45, 0.875, 0.895, 0.53, -0.97};
+
+    double c = 0.1;          /* compression exponent */
+    int gt_linCascade = 3;   /* number of times each filter is applied */
+    int gt_nonlinCascade = 3;
+    int lp_linCascade = 4;
+    int lp_nonlinCascade = 4;
+    int lp_linOrder = 2;
+    int lp_nonlinOrder = 2;
+
+    int n_threads = 0;
+
+    std::vector<double> frequencies;  /* best frequencies */
+    BasicMatrix<T> response;          /* output: BM velocity */
+
+    explicit BasicDRNLFilter(std::vector<double> best_frequencies = {});
+
+    /* Compute the filter coefficients and reset the filter states */
+    void init(double fs);
+
+    void run(const double *input_velocity, std::size_t n);
+
+    /* Filter n samples into response (n_BFs x n, column-major), keeping the
+     * filter states so that the next call continues the signal */
+    void apply(const double *input_velocity, T *response, std::size_t n);
+
+    std::size_t n_BFs() const { return frequencies.size(); }
+    void clean() { response.clear(); }
+
+private:
+    /* Per best frequency */
+    std::vector<double> linGain_, a_, b_, CtS_;
+    IirFilterBank gt_lin_, lp_lin_;          /* linear path */
+    IirFilterBank gt_nonlin_first_;          /* nonlinear path, before compression */
+    IirFilterBank gt_nonlin_second_, lp_nonlin_;
+    std::vector<double> lin_, nonlin_;       /* linear and nonlinear paths at the current time step */
+
+    static double evaluateParameter(double p0, double m, double BF);
+    static IirCoefficients gammatone_coefficients(double bw, double cf, double dt);
+    void apply_lanes(const double *input_velocity, T *out, std::size_t n, std::size_t l0, std::size_t l1);
+};
+
+using DRNLFilter = BasicDRNLFilter<double>;
+
+} // namespace earing
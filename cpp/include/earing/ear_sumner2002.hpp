@@ -0,0 +1,118 @@
+#pragma once
+
+/* ear.run uses the cochlear model from Sumner2002 to simulate CN activation
+ * (see matlab/models/ear/sumner2002/EarSumner2002.m):
+ * - init_input:    resamples the input to 1e5 Hz (as Matlab's resample) and
+ *                  renormalises it to the given sound level
+ * - ome.run:       simulates the stapes velocity
+ * - drnl.run:      simulates the basilar membrane velocity
+ * - cilia.run:     simulates the IHC cilia potential and resting voltage
+ * - synapse.run:   simulates the synapses molecular variations
+ * - an.run:        simulates the probability of firing (and optionally the spikes)
+ *
+ * The stimulus can also be processed in consecutive chunks (run_chunked), the
+ * filter memories, IHC and synapse states and AN reservoirs being carried from
+ * one chunk to the next: the stage outputs then only hold the current chunk,
+ * so that peak memory depends on the chunk size, not on the stimulus length.
+ *
+ * The stage outputs hold samples of type T: EarSumner2002 (double) is the
+ * reference, EarSumner2002Single (float) halves the memory and bandwidth of
+ * every stage matrix, the filter states, IHC/synapse states and AN reservoirs
+ * staying double (see test_single_precision for its accuracy).
+ *
+ * Setting profiling fills profile with the cost of every stage (profile.hpp).
+ *
+ * Setting cache makes run() store the BM velocity, receptor potential and
+ * release rate in a StageCache (stage_cache.hpp), and start from the last of
+ * them already stored for the same stimulus and upstream parameters.
+ */
+
+#include "earing/an_ihc_synapse.hpp"
+#include "earing/auditory_nerve.hpp"
+#include "earing/drnl_filter.hpp"
+#include "earing/ihc_cilia.hpp"
+#include "earing/outer_middle_ear.hpp"
+#include "earing/profile.hpp"
+#include "earing/stage_cache.hpp"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace earing {
+
+/* 10.^(linspace(log10(100), log10(8000), 128)) */
+std::vector<double> default_best_frequencies();
+
+template <typename T>
+class BasicEarSumner2002 {
+public:
+    static constexpr double fs = 1e5;  /* Hz; expected as input to model */
+
+    double db = 80;
+    bool renormalise = true;  /* renormalise the stimulus to db before running */
+
+    /* If true, every stage (ome, bm, cilia, synapse, then an_prob,
+     * an_refractoriness and an_spikes within the AN) records its wall time,
+     * throughput and memory in profile, accumulated over the chunks since
+     * init_stream() */
+    bool profiling = false;
+    Profile profile;
+
+    /* If set, run() (not run_chunked) loads and stores the outputs of the bm,
+     * cilia and synapse stages in cache; their intermediates (keep_intermediates)
+     * are then only kept for the stages that actually ran */
+    StageCache *cache = nullptr;
+
+    /* Cached stage outputs, in the order they are computed */
+    enum class Stage { bm, rp, release, an };
+    /* Output that run() should leave in the ear when using cache: outputs after
+     * it are not looked up, so that a stored release rate does not leave an
+     * empty BM velocity behind (the outputs before the loaded one are empty) */
+    Stage cache_until = Stage::an;
+
+    OuterMiddleEar ome;
+    BasicDRNLFilter<T> drnl;
+    BasicIhcCilia<T> cilia;
+    BasicAnIhcSynapse<T> synapse;
+    BasicAuditoryNerve<T> an;
+
+    explicit BasicEarSumner2002(std::vector<double> best_frequencies = default_best_frequencies());
+
+    const std::vector<double> &best_frequencies() const { return drnl.frequencies; }
+
+    /* Resamples the stimulus to 1e5 Hz if stimulus_fs is not (see resample in
+     * stimulus.hpp), then renormalises it */
+    std::vector<double> init_input(std::vector<double> stimulus, double stimulus_fs) const;
+
+    void run(std::vector<double> stimulus, double stimulus_fs = fs);
+
+    /* Called after each chunk; the stage outputs of ear hold the time frames
+     * [first_frame, first_frame + n_frames) */
+    using ChunkSink =
+        std::function<void(const BasicEarSumner2002 &ear, std::size_t first_frame, std::size_t n_frames)>;
+
+    void run_chunked(std::vector<double> stimulus, double stimulus_fs, std::size_t chunk_size,
+                     const ChunkSink &sink);
+
+    /* Reset every stage to its startup state, before the first run_chunk() */
+    void init_stream();
+
+    /* Process the next n samples of an (already renormalised) stimulus; last
+     * flushes the incomplete decimation group of the AN (see
+     * AuditoryNerve::apply) at the end of the stimulus */
+    void run_chunk(const double *stimulus, std::size_t n, bool last = false);
+
+    void clean();
+
+private:
+    /* run_chunk(), looking the stage outputs up in cache if keys (bm, rp and
+     * release) are given */
+    void run_stages(const double *stimulus, std::size_t n, bool last, const std::string *keys);
+};
+
+using EarSumner2002 = BasicEarSumner2002<double>;
+using EarSumner2002Single = BasicEarSumner2002<float>;
+
+} // namespace earing
@@ -0,0 +1,167 @@
+/* C interface to the native ear model library, used by the MEX gateways in
+ * mex/. All matrices are column-major (Matlab layout) and all functions work
+ * in place on buffers allocated by the caller. Functions returning int give 0
+ * on success and a negative value on invalid arguments; functions returning a
+ * pointer give NULL instead. No C++ exception crosses this interface: any
+ * failure of the library (out of memory, threads that cannot be started...)
+ * also gives -1 or NULL.
+ *
+ * The functions ending in _single are the same for Matlab single arrays: their
+ * signal matrices are float, while states that accumulate over time (the
+ * reservoirs, the refractory history, the recurrence within a call) and
+ * parameters (W, windows, rates) stay double.
+ */
+
+#ifndef EARING_EARING_H
+#define EARING_EARING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Default number of threads of the parallel kernels, see earing/parallel.hpp.
+ * n_threads <= 0 restores EARING_NUM_THREADS or the number of cores */
+int earing_num_threads(void);
+void earing_set_num_threads(int n_threads);
+
+/* See earing/recurrence.hpp. C is C_rows x C_cols: 1 x 1, rows x 1 or rows x cols.
+ * n_threads <= 0 for the default */
+int earing_first_order_recurrence(double *matrix, double *vector, const double *C, size_t C_rows,
+                                  size_t C_cols, const double *A, size_t rows, size_t cols, int n_threads);
+int earing_first_order_recurrence_single(float *matrix, float *vector, const float *C, size_t C_rows,
+                                         size_t C_cols, const float *A, size_t rows, size_t cols, int n_threads);
+
+/* See reservoir_release in earing/auditory_nerve.hpp */
+int earing_reservoir_release(double *prob_firing, const double *release_prob, size_t rows, size_t cols,
+                             double *available, double *cleft, double *reprocess, double M,
+                             const double *xdt, const double *ydt, const double *rdt_plus_ldt,
+                             const double *rdt);
+int earing_reservoir_release_single(float *prob_firing, const float *release_prob, size_t rows, size_t cols,
+                                    double *available, double *cleft, double *reprocess, double M,
+                                    const double *xdt, const double *ydt, const double *rdt_plus_ldt,
+                                    const double *rdt);
+
+/* See decimated_reservoir_release in earing/auditory_nerve.hpp, over a whole
+ * signal: prob_firing has ceil(cols / decimation) columns, the last group
+ * being averaged over its own length. Returns -1 if decimation is 0 */
+int earing_decimated_reservoir_release(double *prob_firing, const double *release_prob, size_t rows, size_t cols,
+                                       size_t decimation, double *available, double *cleft, double *reprocess,
+                                       double M, const double *xdt, const double *ydt,
+                                       const double *rdt_plus_ldt, const double *rdt);
+int earing_decimated_reservoir_release_single(float *prob_firing, const float *release_prob, size_t rows,
+                                              size_t cols, size_t decimation, double *available, double *cleft,
+                                              double *reprocess, double M, const double *xdt, const double *ydt,
+                                              const double *rdt_plus_ldt, const double *rdt);
+
+/* See earing/refractoriness.hpp. W has n_W values; n_threads <= 0 for the default */
+int earing_apply_refractoriness(const double *prob, double *probref, size_t rows, size_t cols, const double *W,
+                                size_t n_W, int n_threads);
+int earing_apply_refractoriness_single(const float *prob, float *probref, size_t rows, size_t cols, const double *W,
+                                       size_t n_W, int n_threads);
+
+/* Non-deterministic seed, different at each call, see earing/random.hpp */
+unsigned long long earing_random_seed(void);
+
+/* See earing/spike_trains.hpp. algo is 1 (thinning) or 2 (binning); n_threads <= 0 for the default */
+int earing_generate_poisson_spike_trains(unsigned char *spikes, const double *rate, size_t rows, size_t cols,
+                                         int n_fibers, int abs_refractory_bins, int algo,
+                                         unsigned long long seed, int n_threads);
+/* PSTH of n_repetitions repetitions of every fiber: counts is (n_fibers * rows)
+ * x cols, zero-initialised; returns -1 if n_repetitions is not in [1, 65535] */
+int earing_generate_poisson_psth(uint16_t *counts, const double *rate, size_t rows, size_t cols, int n_fibers,
+                                 int n_repetitions, int abs_refractory_bins, int algo, unsigned long long seed,
+                                 int n_threads);
+
+/* Spike trains as lists of spike frames, see SpikeTrains in earing/spike_trains.hpp */
+typedef struct earing_spike_trains earing_spike_trains;
+
+/* Same arguments as earing_generate_poisson_spike_trains; NULL on invalid
+ * arguments. To be freed with earing_free_spike_trains */
+earing_spike_trains *earing_generate_poisson_spike_events(const double *rate, size_t rows, size_t cols,
+                                                          int n_fibers, int abs_refractory_bins, int algo,
+                                                          unsigned long long seed, int n_threads);
+size_t earing_spike_trains_count(const earing_spike_trains *trains);
+/* Matlab sparse form of the (n_fibers * rows) x cols spike matrix: col_start
+ * has cols + 1 values, row_index earing_spike_trains_count values (0-based) */
+int earing_spike_trains_csc(const earing_spike_trains *trains, size_t *col_start, size_t *row_index);
+/* Spikes of fiber f are frames[fiber_start[f]] ... frames[fiber_start[f + 1] - 1] (0-based);
+ * fiber_start has n_fibers * rows + 1 values */
+void earing_spike_trains_lists(const earing_spike_trains *trains, size_t *fiber_start, size_t *frames);
+void earing_free_spike_trains(earing_spike_trains *trains);
+
+/* See earing/quantal_release.hpp, over a whole signal: release_prob is rows x
+ * cols, averaged over groups of decimation frames first if decimation > 1 (as
+ * in earing_decimated_reservoir_release). The reservoirs (one value per row)
+ * are the starting values of every fiber, and are not changed. NULL on invalid
+ * arguments. To be freed with earing_free_spike_trains */
+earing_spike_trains *earing_quantal_release(const double *release_prob, size_t rows, size_t cols,
+                                            size_t decimation, int n_fibers, int abs_refractory_bins,
+                                            const double *available, const double *cleft,
+                                            const double *reprocess, double M, const double *xdt,
+                                            const double *ydt, const double *rdt_plus_ldt, const double *rdt,
+                                            unsigned long long seed, int n_threads);
+earing_spike_trains *earing_quantal_release_single(const float *release_prob, size_t rows, size_t cols,
+                                                   size_t decimation, int n_fibers, int abs_refractory_bins,
+                                                   const double *available, const double *cleft,
+                                                   const double *reprocess, double M, const double *xdt,
+                                                   const double *ydt, const double *rdt_plus_ldt,
+                                                   const double *rdt, unsigned long long seed, int n_threads);
+
+/* See earing/spike_analysis.hpp; n_threads <= 0 for the default. rate is
+ * n_begin x cols; returns -1 if a window goes past the spike trains */
+int earing_rate_spike_train(const double *spikes, size_t rows, size_t cols, const double *begin, size_t n_begin,
+                            const double *window, size_t n_window, double *rate, int n_threads);
+int earing_rate_spike_train_single(const float *spikes, size_t rows, size_t cols, const double *begin,
+                                   size_t n_begin, const double *window, size_t n_window, float *rate, int n_threads);
+/* Same over sparse spike trains (Matlab sparse: col_start has cols + 1 values,
+ * values NULL for logical spikes); returns -1 if a window goes past the spike
+ * trains or if begin decreases */
+int earing_rate_spike_events(const size_t *col_start, const size_t *row_index, const double *values, size_t rows,
+                             size_t cols, const double *begin, size_t n_begin, const double *window, size_t n_window,
+                             double *rate, int n_threads);
+int earing_spikes_to_isi(const double *spikes, size_t rows, size_t cols, double *isi, int n_threads);
+/* Returns -1 if n is 0 */
+int earing_subsample_spike_trains(double *spikes, size_t rows, size_t cols, size_t n, int n_threads);
+/* Event versions over sparse spike trains (Matlab sparse, every stored element
+ * being a spike). isi is cols x rows, 1 / interval if inverse is non-zero.
+ * out_row_index has room for col_start[cols] values, the kept spikes ending at
+ * out_col_start[cols]; returns -1 if n is 0 */
+int earing_isi_spike_events(const size_t *col_start, const size_t *row_index, size_t rows, size_t cols, double *isi,
+                            int inverse, int n_threads);
+int earing_subsample_spike_events(const size_t *col_start, const size_t *row_index, size_t cols, size_t n,
+                                  size_t *out_col_start, size_t *out_row_index, int n_threads);
+/* Spikes of each column in frames [first_frame, last_frame) */
+int earing_spike_counts(const size_t *col_start, const size_t *row_index, size_t cols, size_t first_frame,
+                        size_t last_frame, size_t *counts, int n_threads);
+/* mean is n_features x cols; returns -1 unless rows > n_features > 0 */
+int earing_average_channels(const double *feats, size_t rows, size_t cols, size_t n_features, double *mean,
+                            int n_threads);
+int earing_average_channels_single(const float *feats, size_t rows, size_t cols, size_t n_features, float *mean,
+                                   int n_threads);
+
+/* HTK feature files, see earing/htk.hpp. features are n_features x n_frames
+ * (one column per frame); functions return -1 if the file cannot be read or
+ * written, is not a consistent HTK file, or on any other failure (e.g. a
+ * header too large to allocate) */
+typedef struct {
+    size_t n_frames;
+    size_t n_features;
+    int samp_period; /* in units of 100 ns */
+    int parm_kind;
+} earing_htk_header;
+
+/* Reads the header only */
+int earing_htk_read_header(const char *path, earing_htk_header *header);
+/* Also returns -1 if the file does not hold n_features x n_frames values */
+int earing_htk_read(const char *path, double *features, size_t n_features, size_t n_frames);
+int earing_htk_write(const char *path, const double *features, size_t n_features, size_t n_frames, int parm_kind,
+                     int samp_period);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* EARING_EARING_H */
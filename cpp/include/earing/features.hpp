@@ -0,0 +1,100 @@
+#pragma once
+
+/* Streaming version of ProcessingAsr.run (matlab/processings/@ProcessingAsr):
+ * a feature string such as "r_l_d_dd" is compiled into a chain of steps that
+ * consume the AN output block by block (e.g. from run_chunked) and emit
+ * feature frames as soon as they are complete, without holding the whole
+ * utterance at the AN sample rate.
+ *
+ * Steps (names as in ProcessingAsr.run_single_features):
+ * - r, rate:            Hann-windowed rate, rate_window_duration windows every
+ *                       rate_time_step, as calculateRate (windows starting at
+ *                       frames 1, 1 + hop, ... and fully inside the input)
+ * - l, l0, log10:       log10(1 + x);   l3, log1000: log10(1 + 1000 x)
+ * - lu:                 log10(x), floored at log_threshold_value, minus it
+ * - d, dct:             first dct_num_coeff coefficients of the orthonormal DCT-II
+ * - dd, delta_delta:    appends deltas and delta-deltas (replicated first and
+ *                       last frames), each frame being delayed by
+ *                       deltadelta_delta + deltadelta_ddelta frames
+ * - e, energy:          prepends sum(x.^2);   el, logenergy: log10(1 + sum(x.^2))
+ * - f, fr, sfr, avgneigh: averages neighbouring rows into avg_n_features rows
+ * - z:                  cepstral mean normalisation
+ * - ga, gaussianization, batchNormalisation: mean 0 and variance 1 per row
+ * z and ga need statistics over the whole utterance: their frames are held
+ * (at the feature frame rate) until finish(), unless running_statistics is
+ * set, in which case the mean and variance of the frames seen so far are used
+ * and frames go through at once. A leading SPIKE or PROB (the input type of
+ * ProcessingAsr) is ignored; other steps throw std::invalid_argument.
+ */
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "earing/matrix.hpp"
+#include "earing/spike_trains.hpp"
+
+namespace earing {
+
+/* Defaults of ProcessingAsr */
+struct FeatureParams {
+    double fs = 1e5;                     /* Hz; sample rate of the AN output */
+    double rate_time_step = 10e-3;       /* s */
+    double rate_window_duration = 30e-3; /* s */
+    std::size_t dct_num_coeff = 13;
+    std::size_t deltadelta_delta = 2;
+    std::size_t deltadelta_ddelta = 2;
+    std::size_t avg_n_features = 31;
+    double log_threshold_value = -5;
+    bool running_statistics = false;     /* z and ga from the frames seen so far */
+};
+
+class FeaturePipeline {
+public:
+    /* Throws std::invalid_argument for unknown or unsupported steps */
+    explicit FeaturePipeline(const std::string &features, FeatureParams params = FeatureParams());
+    FeaturePipeline(FeaturePipeline &&) noexcept;
+    FeaturePipeline &operator=(FeaturePipeline &&) noexcept;
+    ~FeaturePipeline();
+
+    /* Output: the feature frames completed by the last call to apply() or
+     * finish(), one per column */
+    Matrix frames;
+
+    const std::vector<std::string> &steps() const { return names_; }
+
+    /* Seconds between output frames: the rate time step (rounded down to a
+     * number of input frames), or 1 / fs without r */
+    double frame_period() const;
+
+    /* Back to the start of an utterance */
+    void init();
+
+    /* Next columns of the AN output (prob_firing, rows = channels); T is
+     * double or float */
+    template <typename T>
+    void apply(const BasicMatrix<T> &an_output);
+
+    /* Next frames of spike trains (rows = fibers), added spike by spike to
+     * the rate windows: the first step must be r */
+    void apply(const SpikeTrains &spikes);
+
+    /* End of the utterance: frames held back by dd, z and ga */
+    void finish();
+
+    /* Windowed rate (r) and the steps after it, in features.cpp */
+    class Rate;
+    class Step;
+
+private:
+    /* Passes frames through the steps after the rate, into frames */
+    void run_steps(std::vector<std::vector<double>> batch, bool last);
+
+    FeatureParams params_;
+    std::vector<std::string> names_;
+    std::unique_ptr<Rate> rate_;
+    std::vector<std::unique_ptr<Step>> steps_;
+};
+
+} // namespace earing
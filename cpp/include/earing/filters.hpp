@@ -0,0 +1,67 @@
+#pragma once
+
+/* Linear IIR filtering, equivalent to Matlab's filter(b, a, x), and the
+ * Butterworth designs (Matlab's butter) used by the outer-middle ear and the
+ * DRNL low-pass filters.
+ */
+
+#include <cstddef>
+#include <vector>
+
+namespace earing {
+
+struct IirCoefficients {
+    std::vector<double> b;  /* numerator */
+    std::vector<double> a;  /* denominator, a[0] = 1 after normalisation */
+};
+
+/* Direct form II transposed, as Matlab's filter(). The state is kept between
+ * calls to apply(), so a signal can be filtered in several pieces. */
+class IirFilter {
+public:
+    IirFilter() = default;
+    explicit IirFilter(const IirCoefficients &coefficients);
+
+    void apply(const double *input, double *output, std::size_t n);
+    void reset();
+
+private:
+    friend class IirFilterBank;
+
+    std::vector<double> b_;
+    std::vector<double> a_;
+    std::vector<double> state_;
+};
+
+/* The same cascade of IIR filters applied to several signals (lanes) at once,
+ * each lane with its own coefficients, all of the same order. Coefficients and
+ * states are stored structure-of-arrays, so that a time step of all lanes is a
+ * vectorised loop; the arithmetic of each lane is the one of IirFilter. */
+class IirFilterBank {
+public:
+    IirFilterBank() = default;
+    /* coefficients[lane], each filter applied cascade times in a row */
+    IirFilterBank(const std::vector<IirCoefficients> &coefficients, int cascade);
+
+    /* One time step of lanes [l0, l1): x[lane] is filtered in place */
+    void step(double *x, std::size_t l0, std::size_t l1);
+    void reset();
+
+    std::size_t lanes() const { return lanes_; }
+
+private:
+    std::size_t lanes_ = 0;
+    std::size_t order_ = 0;
+    int cascade_ = 0;
+    std::vector<double> b_, a_;  /* (order + 1) x lanes */
+    std::vector<double> state_;  /* cascade x (order + 1) x lanes */
+    std::vector<double> y_;      /* output of the current filter, per lane */
+};
+
+/* butter(order, wn) with wn normalised to the Nyquist frequency (0 < wn < 1) */
+IirCoefficients butter_lowpass(int order, double wn);
+
+/* butter(order, [w1 w2]): band-pass of order 2 * order */
+IirCoefficients butter_bandpass(int order, double w1, double w2);
+
+} // namespace earing
@@ -0,0 +1,82 @@
+#pragma once
+
+/* HTK feature files (HTKBook 5.10), as matlab/htk/htkread.m and htkwrite.m:
+ * a big-endian header (nSamples, sampPeriod, sampSize, parmKind) followed by
+ * the frames, as float32 or, if parmKind has the compression bit, as int16
+ * with per-feature scales A and offsets B (value = (B + int16) / A). CRC is
+ * not supported. Features are returned and taken as matrices of n_features
+ * rows and one column per frame, which is the layout of the file.
+ *
+ * Reads memory-map the file; read_htk_header reads the 12 header bytes only,
+ * e.g. to rescan an output folder without loading its features.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "earing/atomic_file.hpp"
+#include "earing/matrix.hpp"
+
+namespace earing {
+
+/* Compression bit of parmKind (_C) */
+constexpr int htk_compressed = 02000;
+/* parmKind of user-defined features, as written by Htk.save */
+constexpr int htk_user = 9;
+
+struct HtkHeader {
+    std::size_t n_frames = 0;    /* without the 4 frames holding A and B when compressed */
+    std::size_t n_features = 0;
+    int samp_period = 100000;    /* in units of 100 ns */
+    int parm_kind = htk_user;
+
+    bool compressed() const { return (parm_kind & htk_compressed) != 0; }
+};
+
+/* Throw std::runtime_error if the file cannot be read or is not a
+ * consistent HTK file */
+HtkHeader read_htk_header(const std::string &path);
+Matrix read_htk(const std::string &path, HtkHeader *header = nullptr);
+
+/* Throws std::runtime_error if the file cannot be written */
+void write_htk(const std::string &path, const Matrix &features, int parm_kind = htk_user,
+               int samp_period = 100000);
+
+/* Writes the frames of a file block by block, e.g. as they come out of a
+ * FeaturePipeline. Uncompressed frames go to the file at once, nSamples
+ * being set by close(); compressed files need the range of every feature over
+ * all frames, so their frames are kept until close(). The output is the same
+ * as write_htk on all the frames (and as htkwrite.m, except that a constant
+ * feature is written exactly rather than divided by a zero range).
+ *
+ * The file is written as an AtomicFile: it only appears, complete, at
+ * close(), and a writer destroyed before (e.g. by an exception) leaves no
+ * file behind. */
+class HtkWriter {
+public:
+    /* Throws std::runtime_error if the file cannot be written */
+    HtkWriter(const std::string &path, int parm_kind = htk_user, int samp_period = 100000);
+    HtkWriter(const HtkWriter &) = delete;
+    HtkWriter &operator=(const HtkWriter &) = delete;
+    ~HtkWriter();
+
+    /* Next frames, one per column. Throws std::invalid_argument if the number
+     * of features changes, std::runtime_error on write errors */
+    void write(const Matrix &frames);
+
+    /* Writes what remains and the header, and renames the file to its path */
+    void close();
+
+    const HtkHeader &header() const { return header_; }
+
+private:
+    std::string path_;
+    std::unique_ptr<AtomicFile> file_;
+    HtkHeader header_;
+    std::vector<double> held_;  /* frames of a compressed file */
+};
+
+} // namespace earing
@@ -0,0 +1,83 @@
+#pragma once
+
+/* IHC cilia activity and receptor potential (see IhcCilia.m).
+ * Parameters taken from Sumner et al. 2002 "A revised model of the inner-hair
+ * cell and auditory-nerve complex". T is the sample type of the BM velocity,
+ * of the outputs and of the per-sample arithmetic, the state being double. */
+
+#include "earing/matrix.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace earing {
+
+template <typename T>
+class BasicIhcCilia {
+public:
+    /* Receptor Potential parameters */
+    double Et   =  0.1;       /* endocochlear potential (V) */
+    double Ek   = -70.45e-3;  /* potassium reversal potential (V) */
+    double G0   =  1.974e-9;  /* resting conductance */
+    double Gk   =  18e-9;     /* potassium conductance (S) */
+    double Rpc  =  0.04;      /* correction, Rp/(Rt + Rp) */
+    double Gmax =  8e-9;      /* max. mechanical conductance (S) */
+    double s0   =  85e-9;     /* displacement sensitivity (/m) */
+    double u0   =  7e-9;      /* displacement offset (m) */
+    double s1   =  5e-9;      /* displacement sensitivity (/m) */
+    double u1   =  7e-9;      /* displacement offset (m) */
+    double Cab  =  6e-12;     /* total capacitance (F) */
+    double tc   =  2.13e-3;   /* cilia/BM time constant (s) */
+    double C    =  16;        /* gain factor (dB) */
+
+    /* Derived by init_restingV() */
+    double C_s = 0;           /* scalar version of C */
+    double Ga = 0;            /* leakage */
+    double Ekp = 0;
+    double restingCiliaCond = 0;
+    double restingV = 0;
+    double dt = 0;            /* time frame: 1/fs */
+
+    /* Cilia displacement and apical conductance are only kept if
+     * keep_intermediates is set; otherwise apply() writes the receptor
+     * potential only */
+    bool keep_intermediates = false;
+    BasicMatrix<T> cilia_displacement;
+    BasicMatrix<T> Gu;
+    BasicMatrix<T> receptor_potential;
+
+    int n_threads = 0;          /* 0: num_threads() */
+
+    /* State carried between calls to apply() */
+    std::vector<double> uNow;
+    std::vector<double> IHC_Vnow;
+
+    BasicIhcCilia() { init_restingV(); }
+
+    /* To be called again if any parameter is changed after construction */
+    void init_restingV();
+
+    /* Reset the state: cilia at rest, receptor potential at restingV */
+    void init(std::size_t n_BFs, double fs);
+
+    /* Process the next block of BM velocity; outputs hold this block only */
+    void apply(const BasicMatrix<T> &bm_velocity);
+
+    void run(const BasicMatrix<T> &bm_velocity, double fs);
+
+    void clean() {
+        cilia_displacement.clear();
+        Gu.clear();
+        receptor_potential.clear();
+    }
+
+private:
+    /* Advances displacement u and potential V of BFs [r0, r1) over frames
+     * [c0, c1), u and V indexed by BF */
+    void run_kernel(const BasicMatrix<T> &bm_velocity, std::size_t r0, std::size_t r1, std::size_t c0, std::size_t c1,
+                    double *u, double *V);
+};
+
+using IhcCilia = BasicIhcCilia<double>;
+
+} // namespace earing
@@ -0,0 +1,30 @@
+#pragma once
+
+/* Read-only view of a whole file, memory-mapped where possible (read into
+ * memory otherwise), as used by the HTK reader and the stage cache. */
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace earing {
+
+class MappedFile {
+public:
+    /* Throws std::runtime_error if the file cannot be read */
+    explicit MappedFile(const std::string &path);
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile();
+
+    const unsigned char *data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    const unsigned char *data_ = nullptr;
+    std::size_t size_ = 0;
+    bool mapped_ = true;
+    std::vector<unsigned char> copy_;
+};
+
+} // namespace earing
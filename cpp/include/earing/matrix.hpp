@@ -0,0 +1,58 @@
+#pragma once
+
+/* Column-major matrix, laid out as in Matlab: element (row, col) is stored at
+ * data()[row + col * rows()]. Rows are channels (or fibers), columns are time
+ * frames, so that a MEX gateway can hand its mxArray buffers over without copy.
+ */
+
+#include <cstddef>
+#include <vector>
+
+namespace earing {
+
+template <typename T>
+class BasicMatrix {
+public:
+    BasicMatrix() = default;
+    BasicMatrix(std::size_t rows, std::size_t cols, T value = T())
+        : rows_(rows), cols_(cols), values_(rows * cols, value) {}
+
+    std::size_t rows() const { return rows_; }
+    std::size_t cols() const { return cols_; }
+    std::size_t size() const { return values_.size(); }
+    bool empty() const { return values_.empty(); }
+    /* Memory allocated for the values */
+    std::size_t bytes() const { return values_.capacity() * sizeof(T); }
+
+    T *data() { return values_.data(); }
+    const T *data() const { return values_.data(); }
+
+    /* Pointer to the first element of column (time frame) col */
+    T *col(std::size_t col) { return values_.data() + col * rows_; }
+    const T *col(std::size_t col) const { return values_.data() + col * rows_; }
+
+    T &operator()(std::size_t row, std::size_t col) { return values_[row + col * rows_]; }
+    const T &operator()(std::size_t row, std::size_t col) const { return values_[row + col * rows_]; }
+
+    void assign(std::size_t rows, std::size_t cols, T value = T()) {
+        rows_ = rows;
+        cols_ = cols;
+        values_.assign(rows * cols, value);
+    }
+
+    /* Release the memory (equivalent of ear.clean() in Matlab) */
+    void clear() {
+        rows_ = 0;
+        cols_ = 0;
+        std::vector<T>().swap(values_);
+    }
+
+private:
+    std::size_t rows_ = 0;
+    std::size_t cols_ = 0;
+    std::vector<T> values_;
+};
+
+using Matrix = BasicMatrix<double>;
+
+} // namespace earing
@@ -0,0 +1,39 @@
+#pragma once
+
+/* Models the transformation sound pressure -> stapes velocity
+ * (see matlab/models/ear/components/OuterMiddleEar.m) */
+
+#include "earing/filters.hpp"
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace earing {
+
+class OuterMiddleEar {
+public:
+    /* Each row: gain (dB), filter order, lower and upper cut-off (Hz) */
+    std::vector<std::array<double, 4>> externalResonanceFilters = {
+        {0, 1, 4000, 25000},
+        {0, 1, 4000, 25000},
+        {0, 1, 700, 30000},
+        {0, 1, 700, 30000}};
+    double stapes_scalar = 1.4e-10;
+
+    std::vector<double> stapes_velocity;  /* output */
+
+    void init_external_filters(double fs);
+    void run(const double *stimulus, std::size_t n, double fs);
+
+    /* Filter n samples, keeping the filter states for the next call */
+    void apply_filters(const double *stimulus, double *stapes_velocity, std::size_t n);
+
+    void clean() { std::vector<double>().swap(stapes_velocity); }
+
+private:
+    std::vector<IirFilter> external_filters_;
+    std::vector<double> gain_scalar_;
+};
+
+} // namespace earing
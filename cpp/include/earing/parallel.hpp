@@ -0,0 +1,102 @@
+#pragma once
+
+/* Minimal fork-join parallelism over index ranges, used to spread channels (or
+ * fibers) across cores, and over time for recurrences over few channels. */
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+namespace earing {
+
+/* Default number of threads: the EARING_NUM_THREADS environment variable if
+ * set, the number of hardware threads otherwise */
+int num_threads();
+void set_num_threads(int n_threads);
+
+/* Split [0, n) into at most n_threads contiguous ranges (n_threads <= 0 for
+ * num_threads()), each starting at a multiple of align and holding at least
+ * grain items, and run body(begin, end) on each of them in parallel. */
+void parallel_for(std::size_t n, const std::function<void(std::size_t begin, std::size_t end)> &body,
+                  int n_threads = 0, std::size_t grain = 1, std::size_t align = 1);
+
+/* Runs kernel(state, c0, c1), which advances the state vector over frames
+ * [c0, c1) and writes the outputs of these frames, over [0, n_frames) as a
+ * single call would, but with the frames split in blocks run in parallel
+ * (blocks of at least min_block frames).
+ *
+ * Every block but the first starts speculatively from the initial state. It is
+ * then rerun from the end state of the previous block until its state becomes
+ * identical to the speculative one, from which point the speculative outputs
+ * are those of a sequential run. Results are thus identical to a sequential
+ * run whatever the number of threads, and the method pays off for recurrences
+ * that forget their initial state (leaky integrators, stable filters). */
+template <class Kernel>
+void parallel_in_time(std::vector<double> &state, std::size_t n_frames, const Kernel &kernel, int n_threads = 0,
+                      std::size_t min_block = 1 << 14) {
+    const std::size_t threads = (std::size_t)(n_threads > 0 ? n_threads : num_threads());
+    const std::size_t n_blocks = std::min(threads, n_frames / std::max<std::size_t>(min_block, 1));
+    if (n_blocks <= 1) {
+        kernel(state.data(), 0, n_frames);
+        return;
+    }
+    /* States are compared every kCheck frames */
+    const std::size_t kCheck = 64;
+    auto first = [&](std::size_t b) { return n_frames * b / n_blocks; };
+
+    /* Speculative run: checkpoints[b] holds the states at first(b) + j * kCheck */
+    std::vector<std::vector<double>> checkpoints(n_blocks), ends(n_blocks);
+    parallel_for(
+        n_blocks,
+        [&](std::size_t b0, std::size_t b1) {
+            for (std::size_t b = b0; b < b1; b++) {
+                std::vector<double> s = state;
+                if (b == 0) {
+                    kernel(s.data(), 0, first(1));
+                }
+                for (std::size_t c = first(b); b > 0 && c < first(b + 1); c += kCheck) {
+                    checkpoints[b].insert(checkpoints[b].end(), s.begin(), s.end());
+                    kernel(s.data(), c, std::min(c + kCheck, first(b + 1)));
+                }
+                ends[b] = std::move(s);
+            }
+        },
+        (int)n_blocks);
+
+    /* Rerun of block b from state s, until it joins the speculative run if
+     * join; returns its actual end state */
+    auto rerun = [&](std::size_t b, std::vector<double> s, bool join) {
+        std::size_t j = 0;
+        for (std::size_t c = first(b); c < first(b + 1); c += kCheck, j++) {
+            if (join && std::equal(s.begin(), s.end(), checkpoints[b].begin() + j * s.size())) {
+                return ends[b];
+            }
+            kernel(s.data(), c, std::min(c + kCheck, first(b + 1)));
+        }
+        return s;
+    };
+    std::vector<std::vector<double>> actual_ends(n_blocks);
+    actual_ends[0] = ends[0];
+    parallel_for(
+        n_blocks - 1,
+        [&](std::size_t b0, std::size_t b1) {
+            for (std::size_t b = b0 + 1; b < b1 + 1; b++) {
+                actual_ends[b] = rerun(b, ends[b - 1], true);
+            }
+        },
+        (int)n_blocks);
+
+    /* If a rerun did not join the speculative run, the next block started from
+     * a wrong state: redo it entirely, as the outputs of the wrong rerun may
+     * extend further than the join of the right one (rarely happens for
+     * forgetting recurrences) */
+    for (std::size_t b = 1; b < n_blocks; b++) {
+        if (actual_ends[b - 1] != ends[b - 1]) {
+            actual_ends[b] = rerun(b, actual_ends[b - 1], false);
+        }
+    }
+    state = actual_ends[n_blocks - 1];
+}
+
+} // namespace earing
@@ -0,0 +1,61 @@
+#pragma once
+
+/* Per-stage instrumentation of a run (EarSumner2002::profile): wall time,
+ * throughput, bytes held by the stage outputs and peak resident set of the
+ * process, accumulated over the chunks of a run. Stages record themselves
+ * only when given a Profile, so that an unprofiled run pays nothing.
+ */
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace earing {
+
+struct StageProfile {
+    std::string stage;
+    std::size_t calls = 0;     /* one per chunk */
+    double seconds = 0;        /* wall time, summed over the calls */
+    std::size_t samples = 0;   /* stimulus samples processed */
+    std::size_t bytes = 0;     /* held by the stage outputs after its last call */
+    std::size_t peak_rss = 0;  /* peak resident set of the process after its last call, in bytes */
+
+    double samples_per_second() const { return seconds > 0 ? samples / seconds : 0; }
+};
+
+class Profile {
+public:
+    std::vector<StageProfile> stages;  /* in the order of their first call */
+
+    void clear() { stages.clear(); }
+
+    /* Adds one call of stage */
+    void record(const char *stage, double seconds, std::size_t samples, std::size_t bytes);
+
+    /* One line per stage: stage, calls, seconds, samples/s, bytes, peak RSS */
+    void print(FILE *out) const;
+
+    /* Appends one CSV line per stage to path (with a header if the file is
+     * new or empty), label identifying the run, e.g. the input file:
+     *   label,stage,calls,seconds,samples,samples_per_second,bytes,peak_rss
+     * Throws std::runtime_error if the file cannot be written. */
+    void append_csv(const std::string &path, const std::string &label) const;
+};
+
+/* Peak resident set size of the process in bytes, 0 where unsupported */
+std::size_t peak_resident_set();
+
+/* Wall time since construction */
+class Stopwatch {
+public:
+    double seconds() const {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+private:
+    std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+};
+
+} // namespace earing
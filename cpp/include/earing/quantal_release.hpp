@@ -0,0 +1,69 @@
+#pragma once
+
+/* Stochastic version of the reservoir model of auditory_nerve.hpp (the
+ * commented-out path of the former MAP_finalForLoop_mex): every fiber has its
+ * own synapse, whose vesicle counts evolve by binomial (quantal) draws at each
+ * time frame:
+ *   replenish   ~ B(floor(M - available), ydt)
+ *   ejected     ~ B(available, release_prob)
+ *   reprocessed ~ B(floor(reprocess), xdt)
+ * the reuptake and loss from the cleft staying deterministic. A fiber fires
+ * when at least one vesicle is ejected out of its refractory period, drawn as
+ * in spike_trains.hpp (uniform between R_A and 2 * R_A frames).
+ *
+ * release_prob is a rows x cols column-major array (one row per channel); the
+ * fibers n_fibers * row ... n_fibers * (row + 1) - 1 share its row 'row', the
+ * reservoir rates and the starting reservoirs of that row. Every fiber draws
+ * from its own random stream, number first_stream + fiber, of the given seed,
+ * and fibers are simulated in parallel (n_threads <= 0 for num_threads()) with
+ * results that do not depend on the number of threads.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "earing/random.hpp"
+#include "earing/spike_trains.hpp"
+
+namespace earing {
+
+/* Simulates consecutive blocks of the same synapses: reservoirs and refractory
+ * periods carry over from one block to the next. */
+class QuantalRelease {
+public:
+    QuantalRelease() = default;
+    /* available, cleft, reprocess, xdt, ydt, rdt_plus_ldt and rdt have one value per row */
+    QuantalRelease(std::size_t rows, int n_fibers, const double *available, const double *cleft,
+                   const double *reprocess, double M, const double *xdt, const double *ydt,
+                   const double *rdt_plus_ldt, const double *rdt, int abs_refractory_bins, std::uint64_t seed,
+                   std::uint64_t first_stream = 0, int n_threads = 0);
+
+    /* Spikes of the rows * n_fibers fibers over the next cols frames; T is
+     * double or float */
+    template <typename T>
+    void apply(const T *release_prob, std::size_t cols, SpikeTrains &trains);
+
+    /* Reservoirs, one value per fiber */
+    const std::vector<double> &available() const { return available_; }
+    const std::vector<double> &cleft() const { return cleft_; }
+    const std::vector<double> &reprocess() const { return reprocess_; }
+
+private:
+    /* Appends the spikes of fiber within the block to frames */
+    template <typename T>
+    void fiber_spikes(const T *release_prob, std::size_t cols, std::size_t fiber,
+                      std::vector<std::size_t> &frames);
+
+    std::size_t rows_ = 0;
+    int n_fibers_ = 1;
+    double M_ = 0;
+    std::vector<double> xdt_, ydt_, rdt_plus_ldt_, rdt_;  /* per row */
+    int abs_refractory_bins_ = 0;
+    int n_threads_ = 0;
+    std::vector<double> available_, cleft_, reprocess_;  /* per fiber */
+    std::vector<std::size_t> dead_bins_;                 /* remaining refractory bins per fiber */
+    std::vector<RandomStream> streams_;                  /* one per fiber */
+};
+
+} // namespace earing
@@ -0,0 +1,93 @@
+#pragma once
+
+/* Counter-based random numbers (Philox4x32-10, Salmon et al. 2011): the n-th
+ * block of a stream is a pure function of (seed, stream, n), so that every
+ * fiber has its own stream that can be regenerated alone, and fibers can be
+ * generated in any order or on any number of threads with identical results.
+ */
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace earing {
+
+/* Four 32-bit random words, block number counter of stream of seed */
+inline std::array<std::uint32_t, 4> philox4x32(std::uint64_t seed, std::uint64_t stream, std::uint64_t counter) {
+    std::uint32_t c0 = (std::uint32_t)counter, c1 = (std::uint32_t)(counter >> 32);
+    std::uint32_t c2 = (std::uint32_t)stream, c3 = (std::uint32_t)(stream >> 32);
+    std::uint32_t k0 = (std::uint32_t)seed, k1 = (std::uint32_t)(seed >> 32);
+    for (int round = 0; round < 10; round++) {
+        std::uint64_t p0 = (std::uint64_t)0xD2511F53u * c0;
+        std::uint64_t p1 = (std::uint64_t)0xCD9E8D57u * c2;
+        std::uint32_t hi0 = (std::uint32_t)(p0 >> 32), lo0 = (std::uint32_t)p0;
+        std::uint32_t hi1 = (std::uint32_t)(p1 >> 32), lo1 = (std::uint32_t)p1;
+        c0 = hi1 ^ c1 ^ k0;
+        c1 = lo1;
+        c2 = hi0 ^ c3 ^ k1;
+        c3 = lo0;
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    return {c0, c1, c2, c3};
+}
+
+/* Blocks computed at once by philox4x32_lanes */
+constexpr std::size_t kPhiloxLanes = 8;
+
+/* philox4x32 of blocks first ... first + kPhiloxLanes - 1 of a stream, word j
+ * of block first + lane being w[j][lane], the blocks being computed in SIMD
+ * lanes */
+void philox4x32_lanes(std::uint64_t seed, std::uint64_t stream, std::uint64_t first,
+                      std::uint32_t w[4][kPhiloxLanes]);
+
+/* Sequence of uniform random variables of one stream */
+class RandomStream {
+public:
+    RandomStream() = default;
+    RandomStream(std::uint64_t seed, std::uint64_t stream) : seed_(seed), stream_(stream) {}
+
+    /* Uniform random variable between 0+ and 1, with 53 random bits */
+    double uniform() {
+        if (next_ == 2) {
+            std::array<std::uint32_t, 4> w = philox4x32(seed_, stream_, counter_++);
+            values_[0] = to_uniform(to_bits(w[0], w[1]));
+            values_[1] = to_uniform(to_bits(w[2], w[3]));
+            next_ = 0;
+        }
+        return values_[next_++];
+    }
+
+    /* Number of uniform variables drawn so far */
+    std::uint64_t position() const { return 2 * counter_ + next_ - 2; }
+    /* Continues the stream from the given position */
+    void seek(std::uint64_t position) {
+        counter_ = position / 2;
+        next_ = 2;
+        if (position % 2 == 1) {
+            uniform();
+        }
+    }
+
+    /* Uniform variables position ... position + n - 1 of the stream as their
+     * 53 random bits b (see to_uniform), computed kPhiloxLanes blocks at a
+     * time; the stream does not move */
+    void bits(std::uint64_t position, std::uint64_t *out, std::size_t n) const;
+
+    /* The uniform variable of 53 random bits */
+    static double to_uniform(std::uint64_t bits) { return (double)(bits + 1) * 0x1p-53; }
+
+private:
+    static std::uint64_t to_bits(std::uint32_t lo, std::uint32_t hi) { return ((std::uint64_t)hi << 32 | lo) >> 11; }
+
+    std::uint64_t seed_ = 0;
+    std::uint64_t stream_ = 0;
+    std::uint64_t counter_ = 0;
+    double values_[2] = {0, 0};
+    int next_ = 2;
+};
+
+/* Non-deterministic seed, different at each call (for unseeded runs) */
+std::uint64_t random_seed();
+
+} // namespace earing
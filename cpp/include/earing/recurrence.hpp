@@ -0,0 +1,39 @@
+#pragma once
+
+/* First-order linear recurrence used for the cilia displacement, mICa,
+ * synaptic Ca and the receptor potential (formerly MAP_AN_forLoop_mex):
+ *
+ *   vector[row] = vector[row] * C + A(row, col);   matrix(row, col) = vector[row]
+ *
+ * for every time frame col, where C is a scalar, a column (one value per row)
+ * or a full matrix of the size of A. vector holds the state and is updated in
+ * place, so that consecutive calls continue the recurrence.
+ *
+ * Rows are independent: they are split in blocks across n_threads threads
+ * (n_threads <= 0 for num_threads(), see parallel.hpp) and each block goes
+ * through time in cache-sized tiles. With few rows and many frames, the time
+ * axis is split instead: the recurrence being linear, blocks of frames are run
+ * in parallel from a zero state, and the contribution of the state entering
+ * each block (propagated from block to block) is added afterwards. The mode
+ * depends on the shape only, and the result does not depend on the number of
+ * threads.
+ *
+ * T is double or float (Matlab single arrays); with float, the recurrence is
+ * still carried in double within a call, vector being only rounded at its end.
+ */
+
+#include <cstddef>
+
+namespace earing {
+
+enum class CoefficientShape {
+    Scalar,  /* C is a double (IHCciliaDisplacement, mICa) */
+    Column,  /* C has one value per row (synapticCa) */
+    Full     /* C has the size of matrix (IHC_RP) */
+};
+
+template <typename T>
+void first_order_recurrence(T *matrix, T *vector, const T *C, CoefficientShape shape, const T *A,
+                            std::size_t rows, std::size_t cols, int n_threads = 0);
+
+} // namespace earing
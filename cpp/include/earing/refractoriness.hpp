@@ -0,0 +1,74 @@
+#pragma once
+
+/* Probability of firing with refractoriness, corrected equation (3) of Meddis
+ * & Hewitt 1991 (formerly MAP_applyRefractoriness_mex, see
+ * MAP_addRefractoriness.m):
+ *
+ *   probref(row, t) = prob(row, t) * (1 - sum_{k=1}^{n_W} W[k-1] * probref(row, t-k))
+ *
+ * with probref = 0 before the first frame. Rows are independent and are split
+ * across threads; each thread goes through time for blocks of rows, keeping the
+ * last n_W frames of probref in a ring buffer.
+ *
+ * When W is piecewise linear with few pieces (the linear relative refractory
+ * period of refract1, or the Heaviside refract2), the sum over each piece is
+ * updated recursively in O(1) per frame instead of being recomputed over the
+ * n_W past frames; these running sums are recomputed exactly at regular
+ * intervals, so that rounding errors do not accumulate.
+ */
+
+#include <cstddef>
+#include <vector>
+
+namespace earing {
+
+/* Wfull of MAP_addRefractoriness.m: W[k-1] = 1 - refract1(k dt, refractory_period)
+ * for k = 1 ... floor(2 refractory_period / dt) */
+std::vector<double> refractory_weights(double refractory_period, double dt);
+
+class RefractoryProbability {
+public:
+    RefractoryProbability() = default;
+    RefractoryProbability(std::vector<double> W, std::size_t rows, int n_threads = 0);
+
+    /* Empty history (probref = 0 before the next frame) */
+    void init();
+    /* Next cols frames of the rows x cols column-major prob; the history
+     * carries over from one call to the next. T is double or float (the
+     * history is kept in double) */
+    template <typename T>
+    void apply(const T *prob, T *probref, std::size_t cols);
+
+    /* Whether the O(1) recursive update is used */
+    bool recursive() const { return recursive_; }
+
+private:
+    /* W[k-1] = alpha + beta * k for k = first ... last */
+    struct Piece {
+        std::size_t first, last;
+        double alpha, beta;
+    };
+
+    template <typename T>
+    void apply_direct(const T *prob, T *probref, std::size_t cols, std::size_t r0, std::size_t r1);
+    template <typename T>
+    void apply_recursive(const T *prob, T *probref, std::size_t cols, std::size_t r0, std::size_t r1);
+    /* Running sums of the pieces from the ring buffer, for frame t */
+    void resync(std::size_t t, std::size_t r0, std::size_t r1);
+
+    std::vector<double> W_;
+    std::vector<Piece> pieces_;
+    bool recursive_ = true;
+    std::size_t rows_ = 0;
+    int n_threads_ = 0;
+    std::size_t t_ = 0;            /* frames processed since init */
+    std::vector<double> ring_;     /* (n_W + 1) x rows, frame t in slot t mod (n_W + 1) */
+    std::vector<double> sums_;     /* per piece: sum of probref, sum of k * probref (2 x rows) */
+};
+
+/* Whole signal at once; T is double or float, W being double */
+template <typename T>
+void apply_refractoriness(const T *prob, T *probref, std::size_t rows, std::size_t cols, const double *W,
+                          std::size_t n_W, int n_threads = 0);
+
+} // namespace earing
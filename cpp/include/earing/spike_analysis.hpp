@@ -0,0 +1,95 @@
+#pragma once
+
+/* Post-processing of spike trains, dense or sparse, and of feature matrices
+ * (formerly the bodies of rateSpikeTrain.c, spikes2ISI.c, subsampleSpikeTrains.c
+ * and averageChannels.c). All matrices are column-major; columns are independent
+ * and are split across n_threads threads (n_threads <= 0 for num_threads(),
+ * see parallel.hpp), with results that do not depend on the number of threads.
+ * rate_spike_train and average_channels also take float matrices (Matlab
+ * single arrays), their sums being accumulated in double.
+ */
+
+#include <cstddef>
+
+#include "earing/spike_trains.hpp"
+
+namespace earing {
+
+/* Windowed rate of vertical spike trains (rows = time frames, one train per
+ * column): rate is n_begin x cols, with
+ *   rate(k, col) = sum_j window[j] * spikes(begin[k] + j, col)
+ * begin holding the 0-based first frame of every window (rateSpikeTrain uses
+ * its beginInd as is). Throws std::invalid_argument if a window goes past the
+ * last frame. */
+template <typename T>
+void rate_spike_train(const T *spikes, std::size_t rows, std::size_t cols, const double *begin, std::size_t n_begin,
+                      const double *window, std::size_t n_window, T *rate, int n_threads = 0);
+
+/* rate_spike_train over sparse vertical spike trains, in compressed sparse
+ * column form (Matlab sparse): the spikes of column col are at the increasing
+ * frames row_index[col_start[col]] ... row_index[col_start[col + 1] - 1], with
+ * the given values (nullptr for ones, as for logical spikes). Every spike is
+ * added to the windows it falls in only, so that the cost scales with the
+ * number of spikes rather than with rows * n_window, and the result is the
+ * same as with the dense trains. begin must be non-decreasing; throws
+ * std::invalid_argument otherwise or if a window goes past the last frame. */
+void rate_spike_events(const std::size_t *col_start, const std::size_t *row_index, const double *values,
+                       std::size_t rows, std::size_t cols, const double *begin, std::size_t n_begin,
+                       const double *window, std::size_t n_window, double *rate, int n_threads = 0);
+
+/* Same, for the n_fibers spike trains of trains over its n_frames frames:
+ * rate is n_begin x n_fibers */
+void rate_spike_events(const SpikeTrains &trains, const double *begin, std::size_t n_begin, const double *window,
+                       std::size_t n_window, double *rate, int n_threads = 0);
+
+/* Interspike intervals of vertical spike trains: every frame gets the length of
+ * the interval it belongs to, an interval running from a spike (>= 0.5) to the
+ * frame before the next one (the first from frame 0, the last to the end). */
+void spikes_to_isi(const double *spikes, std::size_t rows, std::size_t cols, double *isi, int n_threads = 0);
+
+/* Keeps one spike (== 1) out of every n of each column of vertical spike
+ * trains, starting with the first one, and clears the others in place.
+ * Throws std::invalid_argument if n is 0. */
+void subsample_spike_trains(double *spikes, std::size_t rows, std::size_t cols, std::size_t n, int n_threads = 0);
+
+/* Event versions of spikes_to_isi and subsample_spike_trains, and spike
+ * counts, over sparse vertical spike trains in compressed sparse column form
+ * as for rate_spike_events (or over SpikeTrains, the columns then being the
+ * fibers), every stored element being a spike (logical sparse, or ones). The
+ * trains are never expanded to a dense matrix and, but for writing the ISI
+ * output (one value per frame), the cost is proportional to the number of
+ * spikes. Trains are split across threads. */
+
+/* spikes_to_isi of the sparse trains, transposed: isi is cols x rows, row col
+ * holding the intervals of train col frame by frame (the layout of the
+ * features of ProcessingAsr, and of the AN outputs). If inverse, 1 / interval
+ * instead (the 'ri' features). */
+void isi_spike_events(const std::size_t *col_start, const std::size_t *row_index, std::size_t rows,
+                      std::size_t cols, double *isi, bool inverse = false, int n_threads = 0);
+/* isi is n_fibers x n_frames */
+void isi_spike_events(const SpikeTrains &trains, double *isi, bool inverse = false, int n_threads = 0);
+
+/* Keeps one spike out of every n of each column, starting with the first one,
+ * as subsample_spike_trains: out_col_start (cols + 1 values) and out_row_index
+ * (room for col_start[cols] values) receive the kept spikes, whose number is
+ * returned. Throws std::invalid_argument if n is 0. */
+std::size_t subsample_spike_events(const std::size_t *col_start, const std::size_t *row_index, std::size_t cols,
+                                   std::size_t n, std::size_t *out_col_start, std::size_t *out_row_index,
+                                   int n_threads = 0);
+SpikeTrains subsample_spike_events(const SpikeTrains &trains, std::size_t n, int n_threads = 0);
+
+/* Number of spikes of each column in frames [first_frame, last_frame) */
+void spike_counts(const std::size_t *col_start, const std::size_t *row_index, std::size_t cols,
+                  std::size_t first_frame, std::size_t last_frame, std::size_t *counts, int n_threads = 0);
+void spike_counts(const SpikeTrains &trains, std::size_t first_frame, std::size_t last_frame, std::size_t *counts,
+                  int n_threads = 0);
+
+/* Means of consecutive groups of rows: mean is n_features x cols, group k
+ * averaging rows k * n ... (k + 1) * n - 1 with n = floor(rows / n_features),
+ * the last group also taking the remaining rows. Throws
+ * std::invalid_argument unless rows > n_features > 0. */
+template <typename T>
+void average_channels(const T *feats, std::size_t rows, std::size_t cols, std::size_t n_features, T *mean,
+                      int n_threads = 0);
+
+} // namespace earing
@@ -0,0 +1,135 @@
+#pragma once
+
+/* Inhomogeneous Poisson spike trains with a stochastic refractory period
+ * (formerly the body of MAP_AN_generatePoissonSpikeTrains.c).
+ *
+ * rate is a rows x cols column-major array, each row being the firing rate (in
+ * number of spikes per bin) of a channel. The fibers (rows of the spike trains)
+ * n_fibers * row ... n_fibers * (row + 1) - 1 are generated with the law of
+ * rate's row 'row'. Spike trains are produced either as lists of spike frames
+ * per fiber (SpikeTrains), or as a dense column-major array of
+ * (n_fibers * rows) x cols bytes, which must be zero-initialised.
+ *
+ * Refractoriness is implemented as a uniform distribution between R_A and
+ * 2 * R_A (R_A = abs_refractory_bins): after a spike, this value is drawn and
+ * generation resumes at the end of this refractory period, so that the cost of
+ * thinning scales with the number of spikes. 0 means no refractoriness.
+ *
+ * Every fiber draws from its own random stream (see random.hpp), number
+ * first_stream + fiber row, of the given seed: a fiber can be regenerated
+ * alone from its rate row with the same seed and stream, and fibers are
+ * generated in parallel (n_threads <= 0 for num_threads()) with results that do
+ * not depend on the number of threads. Both outputs hold the same spikes.
+ *
+ * PSTH: with n_repetitions > 1, every fiber is generated n_repetitions times,
+ * repetition r of fiber row being row r * n_fibers * rows + row of the outputs
+ * above (stream first_stream + that row). The counts output adds the
+ * repetitions up instead, as the number of spikes of each fiber in each bin,
+ * without keeping their spike trains: fibers are spread over threads, or the
+ * repetitions when there are few fibers. Random states are kept per fiber and
+ * repetition (about 50 bytes each) for the next block.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "earing/random.hpp"
+
+namespace earing {
+
+/* Binning compares batches of uniform variables, generated in SIMD lanes,
+ * with the rate of the channel over as many bins, as integers (its rate row
+ * being converted once per thread for all its fibers): this is the same
+ * Bernoulli trial per bin, with the same numbers, as a loop over bins. */
+enum class SpikeAlgorithm {
+    Thinning = 1,  /* simulates exponential inter-event times at the maximal rate */
+    Binning = 2    /* one Bernoulli trial per bin */
+};
+
+/* Spike frames of n_fibers fibers over n_frames time frames: the spikes of
+ * fiber f are frames[fiber_start[f]] ... frames[fiber_start[f + 1] - 1], in
+ * increasing order. */
+struct SpikeTrains {
+    std::size_t n_fibers = 0;
+    std::size_t n_frames = 0;
+    std::vector<std::size_t> fiber_start;  /* n_fibers + 1 values */
+    std::vector<std::size_t> frames;
+
+    std::size_t n_spikes() const { return frames.size(); }
+    void clear() { *this = SpikeTrains(); }
+};
+
+/* Compressed sparse column form (Matlab sparse) of the n_fibers x n_frames
+ * spike matrix: col_start has n_frames + 1 values, row_index n_spikes() */
+void to_csc(const SpikeTrains &trains, std::size_t *col_start, std::size_t *row_index);
+/* Sets the spikes of a zero-initialised n_fibers x n_frames array */
+void to_dense(const SpikeTrains &trains, unsigned char *spikes);
+
+/* Generates consecutive blocks of the same spike trains: the refractory
+ * period still running at the end of a block carries over to the next one.
+ * Throws std::invalid_argument if n_repetitions is not in [1, 65535]. */
+class SpikeGenerator {
+public:
+    SpikeGenerator() = default;
+    SpikeGenerator(std::size_t rows, int n_fibers, int abs_refractory_bins, SpikeAlgorithm algo,
+                   std::uint64_t seed, std::uint64_t first_stream = 0, int n_threads = 0, int n_repetitions = 1);
+
+    /* T is double or float */
+    template <typename T>
+    void apply(const T *rate, std::size_t cols, SpikeTrains &trains);
+    template <typename T>
+    void apply(unsigned char *spikes, const T *rate, std::size_t cols);
+    /* Adds the spikes of the n_repetitions repetitions to counts, a
+     * zero-initialised (n_fibers * rows) x cols column-major array */
+    template <typename T>
+    void apply(std::uint16_t *counts, const T *rate, std::size_t cols);
+
+private:
+    struct Workspace;  /* buffers of a thread */
+
+    /* Calls sink(row, frames) with the spikes within the block of the streams
+     * row = r * n_fibers * rows + fiber, for fiber in [f0, f1) and r in [r0, r1):
+     * once per stream, in this order, if ordered, otherwise possibly several
+     * times per stream, in any order */
+    template <typename T, typename Sink>
+    void fibers_spikes(const T *rate, std::size_t cols, std::size_t f0, std::size_t f1, std::size_t r0,
+                       std::size_t r1, const std::vector<double> &lambdaMax, bool ordered, Workspace &workspace,
+                       Sink &&sink);
+    /* Appends the spikes of row within the block to frames, by thinning */
+    template <typename T>
+    void thinning_spikes(const T *rate, std::size_t cols, std::size_t row, double lambdaMax,
+                         std::vector<std::size_t> &frames);
+    /* Appends the spikes of row in the columns [from, c1) to frames, by
+     * binning, threshold[col - c0] being the threshold of column col; returns
+     * the first column out of the refractory period, at least c1 */
+    std::size_t binning_spikes(const std::uint64_t *threshold, std::size_t c0, std::size_t c1, std::size_t from,
+                               std::size_t row, std::uint64_t *bits, std::vector<std::size_t> &frames);
+    template <typename T>
+    std::vector<double> max_rates(const T *rate, std::size_t cols) const;
+
+    std::size_t rows_ = 0;
+    int n_fibers_ = 1;
+    int abs_refractory_bins_ = 0;
+    SpikeAlgorithm algo_ = SpikeAlgorithm::Thinning;
+    int n_threads_ = 0;
+    int n_repetitions_ = 1;
+    std::vector<std::size_t> dead_bins_;  /* remaining refractory bins per fiber and repetition */
+    std::vector<RandomStream> streams_;   /* one per fiber and repetition */
+};
+
+SpikeTrains generate_poisson_spike_events(const double *rate, std::size_t rows, std::size_t cols, int n_fibers,
+                                          int abs_refractory_bins, SpikeAlgorithm algo, std::uint64_t seed,
+                                          int n_threads = 0);
+
+void generate_poisson_spike_trains(unsigned char *spikes, const double *rate, std::size_t rows,
+                                   std::size_t cols, int n_fibers, int abs_refractory_bins,
+                                   SpikeAlgorithm algo, std::uint64_t seed, int n_threads = 0);
+
+/* PSTH of n_repetitions repetitions: counts is (n_fibers * rows) x cols,
+ * zero-initialised */
+void generate_poisson_psth(std::uint16_t *counts, const double *rate, std::size_t rows, std::size_t cols,
+                           int n_fibers, int n_repetitions, int abs_refractory_bins, SpikeAlgorithm algo,
+                           std::uint64_t seed, int n_threads = 0);
+
+} // namespace earing
@@ -0,0 +1,87 @@
+#pragma once
+
+/* Content-addressed on-disk cache of stage outputs, so that runs differing
+ * only in their later stages (e.g. a sweep over synapse parameters, or several
+ * processings of a dataset) skip the stages they share.
+ *
+ * An output is stored under a key naming the stage and a Fingerprint of
+ * everything it depends on: the (renormalised) stimulus and the parameters of
+ * the stages up to it (see BasicEarSumner2002::cache). Each entry is one file
+ * of the cache directory, <key>.stage: a 32-byte header (magic, sample size,
+ * byte order mark, rows, cols) followed by the column-major samples as in
+ * memory, read back through a MappedFile. Entries are written as AtomicFiles,
+ * so a cache can be shared by the workers of a batch.
+ *
+ * With a budget (max_bytes > 0), the least recently used entries (loads touch
+ * their file) are removed once the directory exceeds it.
+ */
+
+#include "earing/matrix.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace earing {
+
+/* 128-bit FNV-1a hash of the bytes and values fed to it. Not cryptographic,
+ * but accidental collisions are out of reach of any cache */
+class Fingerprint {
+public:
+    Fingerprint &add(const void *bytes, std::size_t n);
+    Fingerprint &add(double x) { return add(&x, sizeof x); }
+    Fingerprint &add(const std::vector<double> &x);
+    Fingerprint &add(const std::string &s);
+
+    /* 32 hexadecimal digits */
+    std::string hex() const;
+
+private:
+    /* FNV-1a 128-bit offset basis */
+    std::uint64_t hi_ = 0x6c62272e07bb0142ULL;
+    std::uint64_t lo_ = 0x62b821756295c58dULL;
+};
+
+class StageCache {
+public:
+    /* Creates the directory if needed; max_bytes 0 for no budget. Throws
+     * std::runtime_error if the directory cannot be created */
+    explicit StageCache(const std::string &directory, std::uint64_t max_bytes = 0);
+
+    const std::string &directory() const { return directory_; }
+    std::uint64_t max_bytes() const { return max_bytes_; }
+
+    /* Reads the entry key into out; false (out unchanged) if there is none, or
+     * none of sample type T */
+    template <typename T>
+    bool load(const std::string &key, BasicMatrix<T> &out);
+
+    /* Writes x as the entry key, then evicts what exceeds the budget. Outputs
+     * larger than the budget are not stored. Throws std::runtime_error if the
+     * entry cannot be written */
+    template <typename T>
+    void store(const std::string &key, const BasicMatrix<T> &x);
+
+    /* Removes the least recently used entries until the cache fits max_bytes */
+    void evict();
+
+    /* Total size of the entries */
+    std::uint64_t bytes() const;
+
+    std::size_t hits() const { return hits_; }
+    std::size_t misses() const { return misses_; }
+
+private:
+    std::string entry_path(const std::string &key) const;
+    void evict_locked();
+
+    std::string directory_;
+    std::uint64_t max_bytes_;
+    std::mutex mutex_;  /* serialises stores and evictions */
+    std::atomic<std::size_t> hits_{0}, misses_{0};
+};
+
+} // namespace earing
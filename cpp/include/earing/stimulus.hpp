@@ -0,0 +1,32 @@
+#pragma once
+
+/* Reading of the stimulus and renormalisation to a given sound level
+ * (see matlab/models/ear/sumner2002/audioread_at_given_dB.m) */
+
+#include <string>
+#include <vector>
+
+namespace earing {
+
+struct Stimulus {
+    std::vector<double> samples;  /* first channel only, as in [-1, 1] for PCM */
+    double fs = 0;                /* Hz */
+};
+
+/* PCM (8, 16, 24 or 32 bits) or IEEE float WAV file. Throws std::runtime_error */
+Stimulus read_wav(const std::string &path);
+
+/* Headerless little-endian float64 samples, assumed to be at fs */
+Stimulus read_raw(const std::string &path, double fs = 1e5);
+
+/* Matlab's resample(x, p, q) from fs to target_fs (p / q being the ratio of
+ * the rates rounded to Hz, in lowest terms): polyphase filter by a
+ * Kaiser-windowed (beta = 5) ideal low-pass of 2 * 10 * max(p, q) + 1 taps,
+ * delay compensated, ceil(size * p / q) samples */
+std::vector<double> resample(const std::vector<double> &x, double fs, double target_fs);
+
+/* Renormalise the stimulus to level_dB_SPL, the rms being computed on the
+ * high-energy samples only (to remain meaningful despite long silences) */
+void renormalise_to_dB(std::vector<double> &stimulus, double fs, double level_dB_SPL);
+
+} // namespace earing
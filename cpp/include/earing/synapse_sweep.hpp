@@ -0,0 +1,88 @@
+#pragma once
+
+/* Synapse (and AN) run for K parameter settings at once, on one receptor
+ * potential, e.g. for a sweep over the calcium threshold or fiber types
+ * defined by (gmaxca, ca_thresh, tauCa).
+ *
+ * The stages up to the receptor potential run once instead of K times. mICa
+ * does not depend on the settings either: it is computed once per BF, and the
+ * synaptic Ca and release rate of the K settings are then computed in the
+ * inner loop, over contiguous lanes (row bf * K + k holds setting k at BF bf),
+ * BFs being spread over threads as in AnIhcSynapse. The AN then runs once on
+ * the K * n_BFs rows, its reservoirs being the only cost that stays K times
+ * that of a run. Outputs have K times the rows of a run: long stimuli can be
+ * given to apply() in blocks, the states carrying over.
+ */
+
+#include "earing/an_ihc_synapse.hpp"
+#include "earing/auditory_nerve.hpp"
+#include "earing/matrix.hpp"
+#include "earing/profile.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace earing {
+
+/* Synapse parameters varied by a sweep (see AnIhcSynapse) */
+struct SynapseSetting {
+    double gmaxca = 8.0e-9;
+    double ca_thresh = 4.48e-11;
+    double tauCa = .75e-4;
+};
+
+template <typename T>
+class BasicSynapseSweep {
+public:
+    /* Parameters shared by the settings, its gmaxca, ca_thresh and tauCa being
+     * ignored: calcium control, reservoirs (read by the AN), fibers. init()
+     * sets its n_BFs, n_AN_channels and kt0 to those of the K * n_BFs rows */
+    BasicAnIhcSynapse<T> synapse;
+    /* Runs on row bf * K + k; configure its seed, refractoriness, etc. before init() */
+    BasicAuditoryNerve<T> an;
+    std::vector<SynapseSetting> settings;
+
+    int n_threads = 0;  /* 0: num_threads() */
+
+    BasicMatrix<T> vesicle_release_rate;  /* output, n_BFs * K rows */
+
+    /* Reset the states at rest. Throws std::invalid_argument if there are no
+     * settings */
+    void init(double ihc_cilia_restingV, std::size_t n_BFs, double fs);
+
+    /* Process the next block of receptor potential, then the AN on its release
+     * rates; outputs hold this block only. Given a profile, the synapse_sweep
+     * step is recorded in it, and the AN steps as in AuditoryNerve::apply
+     * (flush on the last block as well) */
+    void apply(const BasicMatrix<T> &ihc_receptor_potential, Profile *profile = nullptr, bool flush = false);
+
+    void run(const BasicMatrix<T> &ihc_receptor_potential, double ihc_cilia_restingV, double fs);
+
+    std::size_t n_settings() const { return settings.size(); }
+    std::size_t n_BFs() const { return n_BFs_; }
+
+    /* Rows of setting k in output (vesicle_release_rate, an.prob_firing or
+     * an.prob_firing_refractory), one per BF, as the synapse and AN of a run
+     * with this setting would give them */
+    BasicMatrix<T> setting_output(const BasicMatrix<T> &output, std::size_t k) const;
+
+    void clean() {
+        vesicle_release_rate.clear();
+        an.clean();
+    }
+
+private:
+    void run_kernel(const BasicMatrix<T> &ihc_receptor_potential, std::size_t b0, std::size_t b1, std::size_t c0,
+                    std::size_t c1, double *m, double *Ca);
+
+    double dt_ = 0;
+    std::size_t n_BFs_ = 0;
+    /* Per setting: gmaxca, Ca decay 1 - dt / tauCa, dt / tauCa and ca_thresh^power */
+    std::vector<double> gmaxca_, C_, one_minus_C_, thresh_;
+    /* State: mICa per BF, Ca per row */
+    std::vector<double> mICaCurrent_, CaCurrent_;
+};
+
+using SynapseSweep = BasicSynapseSweep<double>;
+
+} // namespace earing
@@ -0,0 +1,133 @@
+#include "earing/an_ihc_synapse.hpp"
+
+#include "earing/parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace earing {
+
+template <typename T>
+void BasicAnIhcSynapse<T>::init(double ihc_cilia_restingV, std::size_t n_BFs_, double fs) {
+    dt = 1 / fs;
+    n_BFs = n_BFs_;
+    n_AN_fiber_types = tauCa.size();
+    n_AN_channels = n_AN_fiber_types * n_BFs;
+
+    C_.resize(n_AN_fiber_types);
+    one_minus_C_.resize(n_AN_fiber_types);
+    for (std::size_t type = 0; type < n_AN_fiber_types; type++) {
+        C_[type] = 1 - dt / tauCa[type];
+        one_minus_C_[type] = (T)(1 - C_[type]);
+    }
+
+    tauCas.resize(n_AN_channels);
+    for (std::size_t ch = 0; ch < n_AN_channels; ch++) {
+        tauCas[ch] = tauCa[ch / n_BFs];
+    }
+
+    /* Proportion (0 - 1) of Ca channels open at IHCrestingV and corresponding
+     * startup currents */
+    double m0 = 1 / (1 + std::exp(-gamma * ihc_cilia_restingV) / beta);
+    mICaCurrent.assign(n_BFs, m0);
+    ICaCurrent.assign(n_AN_channels, gmaxca * std::pow(m0, 3) * (ihc_cilia_restingV - ECa));
+
+    CaCurrent.resize(n_AN_channels);
+    kt0.resize(n_AN_channels);
+    for (std::size_t ch = 0; ch < n_AN_channels; ch++) {
+        CaCurrent[ch] = -ICaCurrent[ch] * tauCas[ch];
+        kt0[ch] = z * std::pow(CaCurrent[ch], power);
+    }
+}
+
+template <typename T>
+void BasicAnIhcSynapse<T>::run(const BasicMatrix<T> &ihc_receptor_potential, double ihc_cilia_restingV, double fs) {
+    init(ihc_cilia_restingV, ihc_receptor_potential.rows(), fs);
+    apply(ihc_receptor_potential);
+}
+
+template <typename T>
+void BasicAnIhcSynapse<T>::apply(const BasicMatrix<T> &ihc_receptor_potential) {
+    std::size_t signal_length = ihc_receptor_potential.cols();
+
+    vesicle_release_rate.assign(n_AN_channels, signal_length);
+    if (keep_intermediates) {
+        mICa.assign(n_BFs, signal_length);
+        synapticCa.assign(n_AN_channels, signal_length);
+    } else {
+        mICa.clear();
+        synapticCa.clear();
+    }
+
+    /* BFs (with all their fiber types) are independent: spread them across
+     * threads when there are enough, otherwise split time */
+    const std::size_t kRowAlign = 8;
+    const std::size_t threads = (std::size_t)(n_threads > 0 ? n_threads : num_threads());
+    if (n_BFs >= kRowAlign * threads || threads == 1) {
+        parallel_for(
+            n_BFs,
+            [&](std::size_t b0, std::size_t b1) {
+                run_kernel(ihc_receptor_potential, b0, b1, 0, signal_length, mICaCurrent.data(), CaCurrent.data());
+            },
+            n_threads, kRowAlign, kRowAlign);
+        return;
+    }
+    std::vector<double> state(mICaCurrent);
+    state.insert(state.end(), CaCurrent.begin(), CaCurrent.end());
+    parallel_in_time(
+        state, signal_length,
+        [&](double *s, std::size_t c0, std::size_t c1) {
+            run_kernel(ihc_receptor_potential, 0, n_BFs, c0, c1, s, s + n_BFs);
+        },
+        n_threads);
+    std::copy(state.begin(), state.begin() + n_BFs, mICaCurrent.begin());
+    std::copy(state.begin() + n_BFs, state.end(), CaCurrent.begin());
+}
+
+template <typename T>
+void BasicAnIhcSynapse<T>::run_kernel(const BasicMatrix<T> &ihc_receptor_potential, std::size_t b0, std::size_t b1,
+                                      std::size_t c0, std::size_t c1, double *m, double *Ca) {
+    const double c = 1 - dt / tauM;
+    /* Per-sample terms in the sample type, the state m and Ca in double */
+    const T gamma_ = (T)gamma, beta_ = (T)beta, gmaxca_ = (T)gmaxca, ECa_ = (T)ECa, z_ = (T)z, power_ = (T)power;
+    const T one_minus_c = (T)(1 - c);
+    const T thresh = (T)std::pow(ca_thresh, power);
+    const bool cube = power == 3;
+    T *mi = keep_intermediates ? mICa.data() : nullptr;
+    T *ca = keep_intermediates ? synapticCa.data() : nullptr;
+    T *rate = vesicle_release_rate.data();
+
+    for (std::size_t col = c0; col < c1; col++) {
+        const T *V = ihc_receptor_potential.data() + col * n_BFs;
+        const std::size_t offset = col * n_AN_channels;
+        for (std::size_t bf = b0; bf < b1; bf++) {
+            /* mICa, shared by all fiber types */
+            T mICaINF = 1 / (1 + std::exp(-gamma_ * V[bf]) / beta_);
+            double mi_ = m[bf] * c + mICaINF * one_minus_c;
+            m[bf] = mi_;
+            T m_ = (T)mi_;
+            T ICa = gmaxca_ * (m_ * m_ * m_) * (V[bf] - ECa_);
+            if (mi) {
+                mi[col * n_BFs + bf] = m_;
+            }
+
+            /* Synaptic Ca and vesicle release rate, per fiber type */
+            for (std::size_t type = 0; type < n_AN_fiber_types; type++) {
+                std::size_t ch = type * n_BFs + bf;
+                double v = Ca[ch] * C_[type] + ICa * one_minus_C_[type];
+                Ca[ch] = v;
+                T ca_ = (T)-v;
+                T k = cube ? ca_ * ca_ * ca_ : std::pow(ca_, power_);
+                rate[offset + ch] = std::max(z_ * (k - thresh), (T)0);
+                if (ca) {
+                    ca[offset + ch] = ca_;
+                }
+            }
+        }
+    }
+}
+
+template class BasicAnIhcSynapse<double>;
+template class BasicAnIhcSynapse<float>;
+
+} // namespace earing
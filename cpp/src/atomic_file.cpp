@@ -0,0 +1,38 @@
+#include "earing/atomic_file.hpp"
+
+#include <stdexcept>
+
+namespace earing {
+
+AtomicFile::AtomicFile(const std::string &path) : path_(path), part_(path + ".part") {
+    file_ = std::fopen(part_.c_str(), "wb");
+    if (file_ == nullptr) {
+        throw std::runtime_error("Unable to write to file " + part_);
+    }
+}
+
+AtomicFile::~AtomicFile() {
+    if (file_ != nullptr) {
+        std::fclose(file_);
+        std::remove(part_.c_str());
+    }
+}
+
+void AtomicFile::commit() {
+    if (file_ == nullptr) {
+        return;
+    }
+    bool ok = std::fclose(file_) == 0;
+    file_ = nullptr;
+    if (ok && std::rename(part_.c_str(), path_.c_str()) != 0) {
+        /* rename() replaces path atomically on POSIX, but fails on Windows if it exists */
+        std::remove(path_.c_str());
+        ok = std::rename(part_.c_str(), path_.c_str()) == 0;
+    }
+    if (!ok) {
+        std::remove(part_.c_str());
+        throw std::runtime_error("Unable to write to file " + path_);
+    }
+}
+
+} // namespace earing
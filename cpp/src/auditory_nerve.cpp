@@ -0,0 +1,235 @@
+#include "earing/auditory_nerve.hpp"
+
+#include "earing/an_ihc_synapse.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace earing {
+
+namespace {
+
+/* One time frame of the reservoir model for one row; returns the ejected vesicles */
+inline double step_reservoir(double release_prob, double &available, double &cleft, double &reprocess, double M,
+                             double xdt, double ydt, double rdt_plus_ldt, double rdt) {
+    /* Number of missing vesicles (non-negative) */
+    double M_q = M - available;
+    if (M_q < 0) { M_q = 0; }
+
+    double ejected      = release_prob * available;
+    double reuptakelost = rdt_plus_ldt * cleft;
+    double reuptake     = rdt * cleft;
+    double reprocessed  = xdt * reprocess;
+    double replenish    = ydt * M_q;
+
+    available = available + replenish - ejected + reprocessed;
+    cleft     = cleft + ejected - reuptakelost;
+    reprocess = reprocess + reuptake - reprocessed;
+    return ejected;
+}
+
+/* Adds the columns of release_prob to the incomplete group of prob_sum; for
+ * each group completed (and a trailing one if flush), prob_sum holds its
+ * average when group(n_out) is called, n_out counting the groups of the call */
+template <typename T, typename Group>
+std::size_t for_each_decimation_group(const T *release_prob, std::size_t rows, std::size_t cols,
+                                      std::size_t decimation, double *prob_sum, std::size_t &n_summed, bool flush,
+                                      Group &&group) {
+    std::size_t n_out = 0;
+    for (std::size_t col = 0; col < cols; col++) {
+        for (std::size_t row = 0; row < rows; row++) {
+            prob_sum[row] += release_prob[col * rows + row];
+        }
+        if (++n_summed == decimation || (flush && col + 1 == cols)) {
+            for (std::size_t row = 0; row < rows; row++) {
+                prob_sum[row] /= (double)n_summed;
+            }
+            group(n_out);
+            std::fill(prob_sum, prob_sum + rows, 0.0);
+            n_summed = 0;
+            n_out++;
+        }
+    }
+    return n_out;
+}
+
+} // namespace
+
+template <typename T>
+void reservoir_release(T *prob_firing, const T *release_prob, std::size_t rows, std::size_t cols,
+                       double *available, double *cleft, double *reprocess, double M,
+                       const double *xdt, const double *ydt, const double *rdt_plus_ldt, const double *rdt) {
+    std::size_t ind = 0;
+    for (std::size_t col = 0; col < cols; col++) {
+        for (std::size_t row = 0; row < rows; row++, ind++) {
+            prob_firing[ind] = (T)step_reservoir(release_prob[ind], available[row], cleft[row], reprocess[row], M,
+                                                 xdt[row], ydt[row], rdt_plus_ldt[row], rdt[row]);
+        }
+    }
+}
+
+template <typename T>
+std::size_t decimated_reservoir_release(T *prob_firing, const T *release_prob, std::size_t rows,
+                                        std::size_t cols, std::size_t decimation, double *prob_sum,
+                                        std::size_t &n_summed, bool flush, double *available, double *cleft,
+                                        double *reprocess, double M, const double *xdt, const double *ydt,
+                                        const double *rdt_plus_ldt, const double *rdt, T *decimated_prob) {
+    return for_each_decimation_group(release_prob, rows, cols, decimation, prob_sum, n_summed, flush,
+                                     [&](std::size_t n_out) {
+        if (decimated_prob != nullptr) {
+            std::copy(prob_sum, prob_sum + rows, decimated_prob + n_out * rows);
+        }
+        for (std::size_t row = 0; row < rows; row++) {
+            prob_firing[n_out * rows + row] = (T)step_reservoir(prob_sum[row], available[row], cleft[row],
+                                                                reprocess[row], M, xdt[row], ydt[row],
+                                                                rdt_plus_ldt[row], rdt[row]);
+        }
+    });
+}
+
+template <typename T>
+std::size_t decimate_release_prob(T *decimated_prob, const T *release_prob, std::size_t rows, std::size_t cols,
+                                  std::size_t decimation, double *prob_sum, std::size_t &n_summed, bool flush) {
+    return for_each_decimation_group(release_prob, rows, cols, decimation, prob_sum, n_summed, flush,
+                                     [&](std::size_t n_out) {
+        std::copy(prob_sum, prob_sum + rows, decimated_prob + n_out * rows);
+    });
+}
+
+template void reservoir_release(double *, const double *, std::size_t, std::size_t, double *, double *, double *,
+                                double, const double *, const double *, const double *, const double *);
+template void reservoir_release(float *, const float *, std::size_t, std::size_t, double *, double *, double *,
+                                double, const double *, const double *, const double *, const double *);
+template std::size_t decimated_reservoir_release(double *, const double *, std::size_t, std::size_t, std::size_t,
+                                                 double *, std::size_t &, bool, double *, double *, double *,
+                                                 double, const double *, const double *, const double *,
+                                                 const double *, double *);
+template std::size_t decimated_reservoir_release(float *, const float *, std::size_t, std::size_t, std::size_t,
+                                                 double *, std::size_t &, bool, double *, double *, double *,
+                                                 double, const double *, const double *, const double *,
+                                                 const double *, float *);
+template std::size_t decimate_release_prob(double *, const double *, std::size_t, std::size_t, std::size_t, double *,
+                                           std::size_t &, bool);
+template std::size_t decimate_release_prob(float *, const float *, std::size_t, std::size_t, std::size_t, double *,
+                                           std::size_t &, bool);
+
+template <typename T>
+void BasicAuditoryNerve<T>::init(const BasicAnIhcSynapse<T> &synapse, double fs) {
+    if (synapse.n_fibers_per_type_per_channel > 0) {
+        n_fibers_per_channel = synapse.n_fibers_per_type_per_channel;
+        output_mode = "SPIKE";
+    } else {
+        n_fibers_per_channel = 1;
+        output_mode = "PROB";
+    }
+    n_channels = synapse.n_AN_channels;
+    n_fibers = n_channels * n_fibers_per_channel;
+    decimation = (std::size_t)std::max(1.0, std::ceil(fs / synapse.spikesTargetSampleRate));
+    dt = decimation / fs;
+
+    ydt.assign(n_channels, synapse.y * dt);
+    ldt.assign(n_channels, synapse.l * dt);
+    xdt.assign(n_channels, synapse.x * dt);
+    rdt.assign(n_channels, synapse.r * dt);
+    rdt_plus_ldt.assign(n_channels, (synapse.r + synapse.l) * dt);
+    M = std::round(synapse.M);
+    lengthAbsRefractory = (int)std::round(synapse.refractory_period / dt);
+
+    /* Starting values for reservoirs */
+    cleft.resize(n_channels);
+    available.resize(n_channels);
+    reprocess.resize(n_channels);
+    for (std::size_t ch = 0; ch < n_channels; ch++) {
+        double kt0 = synapse.kt0[ch];
+        cleft[ch] = kt0 * synapse.y * synapse.M / (synapse.y * (synapse.l + synapse.r) + kt0 * synapse.l);
+        available[ch] = std::round(cleft[ch] * (synapse.l + synapse.r) / kt0);  /* must be integer */
+        reprocess[ch] = cleft[ch] * synapse.r / synapse.x;
+    }
+    prob_sum.assign(n_channels, 0.0);
+    n_summed = 0;
+    spike_generator_ =
+        SpikeGenerator(n_channels, (int)n_fibers_per_channel, lengthAbsRefractory, spike_algorithm, seed);
+    if (quantal_release) {
+        quantal_release_ = QuantalRelease(n_channels, (int)n_fibers_per_channel, available.data(), cleft.data(),
+                                          reprocess.data(), M, xdt.data(), ydt.data(), rdt_plus_ldt.data(),
+                                          rdt.data(), lengthAbsRefractory, seed);
+    }
+    if (refractoriness) {
+        refractory_ = RefractoryProbability(refractory_weights(lengthAbsRefractory * dt, dt), n_channels);
+    }
+}
+
+template <typename T>
+void BasicAuditoryNerve<T>::run(const BasicAnIhcSynapse<T> &synapse, double fs) {
+    init(synapse, fs);
+    apply(synapse.vesicle_release_rate, nullptr, true);
+}
+
+template <typename T>
+void BasicAuditoryNerve<T>::apply(const BasicMatrix<T> &vesicle_release_rate, Profile *profile, bool flush) {
+    std::size_t cols = vesicle_release_rate.cols();
+    Stopwatch watch;
+    BasicMatrix<T> prob_release(vesicle_release_rate.rows(), cols);
+    for (std::size_t ind = 0; ind < prob_release.size(); ind++) {
+        prob_release.data()[ind] = vesicle_release_rate.data()[ind] * dt;
+    }
+    if (decimation == 1) {
+        prob_firing.assign(n_channels, cols);
+        reservoir_release(prob_firing.data(), prob_release.data(), n_channels, cols,
+                          available.data(), cleft.data(), reprocess.data(), M,
+                          xdt.data(), ydt.data(), rdt_plus_ldt.data(), rdt.data());
+    } else {
+        std::size_t n_out = (n_summed + cols) / decimation;
+        if (flush && cols > 0 && (n_summed + cols) % decimation != 0) {
+            n_out++;
+        }
+        prob_firing.assign(n_channels, n_out);
+        BasicMatrix<T> decimated(quantal_release ? n_channels : 0, n_out);
+        decimated_reservoir_release(prob_firing.data(), prob_release.data(), n_channels, cols, decimation,
+                                    prob_sum.data(), n_summed, flush, available.data(), cleft.data(),
+                                    reprocess.data(), M, xdt.data(), ydt.data(), rdt_plus_ldt.data(), rdt.data(),
+                                    quantal_release ? decimated.data() : nullptr);
+        prob_release = std::move(decimated);
+    }
+    if (profile != nullptr) {
+        profile->record("an_prob", watch.seconds(), cols, prob_firing.bytes() + prob_release.bytes());
+        watch = Stopwatch();
+    }
+
+    if (refractoriness) {
+        run_prob_refractoriness();
+        if (profile != nullptr) {
+            profile->record("an_refractoriness", watch.seconds(), cols, prob_firing_refractory.bytes());
+            watch = Stopwatch();
+        }
+    }
+    if (output_mode == "SPIKE") {
+        if (quantal_release) {
+            quantal_release_.apply(prob_release.data(), prob_firing.cols(), spike_trains);
+        } else {
+            run_spike();
+        }
+        if (profile != nullptr) {
+            profile->record("an_spikes", watch.seconds(), cols,
+                            (spike_trains.fiber_start.capacity() + spike_trains.frames.capacity()) *
+                                sizeof(std::size_t));
+        }
+    }
+}
+
+template <typename T>
+void BasicAuditoryNerve<T>::run_prob_refractoriness() {
+    prob_firing_refractory.assign(prob_firing.rows(), prob_firing.cols());
+    refractory_.apply(prob_firing.data(), prob_firing_refractory.data(), prob_firing.cols());
+}
+
+template <typename T>
+void BasicAuditoryNerve<T>::run_spike() {
+    spike_generator_.apply(prob_firing.data(), prob_firing.cols(), spike_trains);
+}
+
+template class BasicAuditoryNerve<double>;
+template class BasicAuditoryNerve<float>;
+
+} // namespace earing
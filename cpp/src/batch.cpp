@@ -0,0 +1,116 @@
+#include "earing/batch.hpp"
+
+#include "earing/parallel.hpp"
+#include "earing/profile.hpp"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace earing {
+
+namespace {
+
+/* Jobs (indices) of a worker, taken from the front by the worker and from the
+ * back by thieves */
+class JobQueue {
+public:
+    void push(std::size_t job) { jobs_.push_back(job); }
+
+    bool take(std::size_t &job, bool steal) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (jobs_.empty()) {
+            return false;
+        }
+        if (steal) {
+            job = jobs_.back();
+            jobs_.pop_back();
+        } else {
+            job = jobs_.front();
+            jobs_.pop_front();
+        }
+        return true;
+    }
+
+private:
+    std::mutex mutex_;
+    std::deque<std::size_t> jobs_;
+};
+
+} // namespace
+
+std::uint64_t file_size(const std::string &path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return file ? (std::uint64_t)file.tellg() : 0;
+}
+
+BatchReport run_batch(std::vector<BatchJob> jobs, const std::function<void(const BatchJob &)> &work, int n_workers,
+                      const BatchProgress &progress) {
+    Stopwatch clock;
+    BatchReport report;
+    std::vector<BatchJob> todo;
+    for (BatchJob &job : jobs) {
+        if (std::ifstream(job.output).good()) {
+            report.skipped++;
+        } else {
+            todo.push_back(std::move(job));
+        }
+    }
+    std::stable_sort(todo.begin(), todo.end(), [](const BatchJob &a, const BatchJob &b) { return a.cost > b.cost; });
+
+    std::size_t workers = std::min(todo.size(), (std::size_t)(n_workers > 0 ? n_workers : num_threads()));
+    std::vector<JobQueue> queues(workers);
+    for (std::size_t k = 0; k < todo.size(); k++) {
+        queues[k % workers].push(k);
+    }
+
+    std::mutex report_mutex;
+    auto worker = [&](std::size_t w) {
+        for (;;) {
+            std::size_t k = 0;
+            bool found = queues[w].take(k, false);
+            for (std::size_t v = 1; !found && v < workers; v++) {
+                found = queues[(w + v) % workers].take(k, true);
+            }
+            if (!found) {
+                return;
+            }
+            Stopwatch job_clock;
+            std::string error;
+            try {
+                work(todo[k]);
+            } catch (const std::exception &e) {
+                error = e.what();
+            } catch (...) {
+                error = "unknown error";
+            }
+            std::lock_guard<std::mutex> lock(report_mutex);
+            if (error.empty()) {
+                report.done++;
+            } else {
+                report.failed++;
+                report.errors.push_back(todo[k].input + ": " + error);
+            }
+            if (progress) {
+                progress(todo[k], job_clock.seconds(), !error.empty(), report.done + report.failed, todo.size());
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (std::size_t w = 1; w < workers; w++) {
+        threads.emplace_back(worker, w);
+    }
+    if (workers > 0) {
+        worker(0);
+    }
+    for (std::thread &t : threads) {
+        t.join();
+    }
+    report.seconds = clock.seconds();
+    return report;
+}
+
+} // namespace earing
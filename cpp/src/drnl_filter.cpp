@@ -0,0 +1,138 @@
+#include "earing/drnl_filter.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <utility>
+
+#include "earing/parallel.hpp"
+
+namespace earing {
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+
+/* Best frequencies are handed to threads in multiples of a cache line of doubles */
+constexpr std::size_t kLaneAlign = 8;
+
+} // namespace
+
+template <typename T>
+BasicDRNLFilter<T>::BasicDRNLFilter(std::vector<double> best_frequencies)
+    : frequencies(std::move(best_frequencies)) {}
+
+template <typename T>
+double BasicDRNLFilter<T>::evaluateParameter(double p0, double m, double BF) {
+    return std::pow(10.0, p0 + m * std::log10(BF));
+}
+
+template <typename T>
+IirCoefficients BasicDRNLFilter<T>::gammatone_coefficients(double bw, double cf, double dt) {
+    /* See GammaToneFilter.get_coefficients */
+    double phi = 2 * pi * bw * dt;
+    double theta = 2 * pi * cf * dt;
+    double cos_theta = std::cos(theta);
+    double sin_theta = std::sin(theta);
+    double alpha = -std::exp(-phi) * cos_theta;
+    double b1 = 2 * alpha;
+    double b2 = std::exp(-2 * phi);
+    std::complex<double> z1(1 + alpha * cos_theta, -alpha * sin_theta);
+    std::complex<double> z2(1 + b1 * cos_theta, -b1 * sin_theta);
+    std::complex<double> z3(b2 * std::cos(2 * theta), -b2 * std::sin(2 * theta));
+    double a0 = std::abs((z2 + z3) / z1);
+
+    IirCoefficients coefficients;
+    coefficients.b = {a0, alpha * a0};
+    coefficients.a = {1.0, b1, b2};
+    return coefficients;
+}
+
+template <typename T>
+void BasicDRNLFilter<T>::init(double fs) {
+    double dt = 1 / fs;
+    double nyquist = fs / 2;
+    const std::size_t n = frequencies.size();
+    linGain_.resize(n);
+    a_.resize(n);
+    b_.resize(n);
+    CtS_.resize(n);
+    std::vector<IirCoefficients> gt_lin(n), gt_nonlin(n), lp_lin(n), lp_nonlin(n);
+    for (std::size_t k = 0; k < n; k++) {
+        double BF = frequencies[k];
+        a_[k] = evaluateParameter(p0.a, m.a, BF);
+        b_[k] = evaluateParameter(p0.b, m.b, BF);
+        /* Compression threshold of Mark's broken stick */
+        CtS_[k] = std::exp(std::log(a_[k] / b_[k]) / (c - 1));
+        linGain_[k] = evaluateParameter(p0.Glin, m.Glin, BF);
+        double linCF = evaluateParameter(p0.CFlin, m.CFlin, BF);
+
+        gt_lin[k] = gammatone_coefficients(evaluateParameter(p0.BWlin, m.BWlin, BF), linCF, dt);
+        gt_nonlin[k] = gammatone_coefficients(evaluateParameter(p0.BWnl, m.BWnl, BF), BF, dt);
+        lp_lin[k] = butter_lowpass(lp_linOrder, linCF / nyquist);
+        lp_nonlin[k] = butter_lowpass(lp_nonlinOrder, BF / nyquist);
+    }
+    gt_lin_ = IirFilterBank(gt_lin, gt_linCascade);
+    lp_lin_ = IirFilterBank(lp_lin, lp_linCascade);
+    gt_nonlin_first_ = IirFilterBank(gt_nonlin, gt_nonlinCascade);
+    gt_nonlin_second_ = IirFilterBank(gt_nonlin, gt_nonlinCascade);
+    lp_nonlin_ = IirFilterBank(lp_nonlin, lp_nonlinCascade);
+    lin_.assign(n, 0.0);
+    nonlin_.assign(n, 0.0);
+}
+
+template <typename T>
+void BasicDRNLFilter<T>::run(const double *input_velocity, std::size_t n) {
+    response.assign(n_BFs(), n);
+    apply(input_velocity, response.data(), n);
+}
+
+template <typename T>
+void BasicDRNLFilter<T>::apply(const double *input_velocity, T *out, std::size_t n) {
+    parallel_for(
+        n_BFs(), [&](std::size_t l0, std::size_t l1) { apply_lanes(input_velocity, out, n, l0, l1); },
+        n_threads, kLaneAlign, kLaneAlign);
+}
+
+template <typename T>
+void BasicDRNLFilter<T>::apply_lanes(const double *input_velocity, T *out, std::size_t n, std::size_t l0,
+                                     std::size_t l1) {
+    const std::size_t n_BFs_ = n_BFs();
+    double *lin = lin_.data(), *nonlin = nonlin_.data();
+    for (std::size_t t = 0; t < n; t++) {
+        const double x = input_velocity[t];
+
+        /* Linear path: gain, gammatone, low-pass */
+        for (std::size_t k = l0; k < l1; k++) {
+            lin[k] = x * linGain_[k];
+        }
+        gt_lin_.step(lin, l0, l1);
+        lp_lin_.step(lin, l0, l1);
+
+        /* Nonlinear path: gammatone, compression, gammatone and low-pass */
+        std::fill(nonlin + l0, nonlin + l1, x);
+        gt_nonlin_first_.step(nonlin, l0, l1);
+        for (std::size_t k = l0; k < l1; k++) {
+            /* Mark's compression algorithm (broken stick) */
+            double abs_x = std::fabs(nonlin[k]);
+            if (abs_x < CtS_[k]) {
+                nonlin[k] = a_[k] * nonlin[k];
+            } else {
+                double sign = nonlin[k] > 0 ? 1.0 : (nonlin[k] < 0 ? -1.0 : 0.0);
+                nonlin[k] = sign * b_[k] * std::pow(abs_x, c);
+            }
+        }
+        gt_nonlin_second_.step(nonlin, l0, l1);
+        lp_nonlin_.step(nonlin, l0, l1);
+
+        T *response = out + t * n_BFs_;
+        for (std::size_t k = l0; k < l1; k++) {
+            response[k] = (T)(lin[k] + nonlin[k]);
+        }
+    }
+}
+
+template class BasicDRNLFilter<double>;
+template class BasicDRNLFilter<float>;
+
+} // namespace earing
@@ -0,0 +1,207 @@
+#include "earing/ear_sumner2002.hpp"
+
+#include "earing/stimulus.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+namespace earing {
+
+std::vector<double> default_best_frequencies() {
+    std::vector<double> bf(128);
+    double lo = std::log10(100.0), hi = std::log10(8000.0);
+    for (std::size_t k = 0; k < bf.size(); k++) {
+        bf[k] = std::pow(10.0, lo + (hi - lo) * k / (bf.size() - 1));
+    }
+    return bf;
+}
+
+namespace {
+
+/* Everything the outputs of a stage depend on, for the stage cache. To be
+ * extended with any parameter added to these stages */
+void add_parameters(Fingerprint &fp, const OuterMiddleEar &ome) {
+    for (const std::array<double, 4> &filter : ome.externalResonanceFilters) {
+        fp.add(filter.data(), sizeof filter);
+    }
+    fp.add(ome.stapes_scalar);
+}
+
+template <typename T>
+void add_parameters(Fingerprint &fp, const BasicDRNLFilter<T> &drnl) {
+    fp.add(&drnl.p0, sizeof drnl.p0).add(&drnl.m, sizeof drnl.m).add(drnl.c);
+    int cascades[] = {drnl.gt_linCascade, drnl.gt_nonlinCascade, drnl.lp_linCascade, drnl.lp_nonlinCascade,
+                      drnl.lp_linOrder, drnl.lp_nonlinOrder};
+    fp.add(cascades, sizeof cascades).add(drnl.frequencies);
+}
+
+template <typename T>
+void add_parameters(Fingerprint &fp, const BasicIhcCilia<T> &cilia) {
+    double p[] = {cilia.Et, cilia.Ek, cilia.G0, cilia.Gk, cilia.Rpc, cilia.Gmax, cilia.s0,
+                  cilia.u0, cilia.s1, cilia.u1, cilia.Cab, cilia.tc, cilia.C};
+    fp.add(p, sizeof p);
+}
+
+template <typename T>
+void add_parameters(Fingerprint &fp, const BasicAnIhcSynapse<T> &synapse) {
+    double p[] = {synapse.z, synapse.ECa, synapse.beta, synapse.gamma, synapse.tauM,
+                  synapse.power, synapse.gmaxca, synapse.ca_thresh};
+    fp.add(p, sizeof p).add(synapse.tauCa);
+}
+
+} // namespace
+
+template <typename T>
+BasicEarSumner2002<T>::BasicEarSumner2002(std::vector<double> best_frequencies)
+    : drnl(std::move(best_frequencies)) {}
+
+template <typename T>
+std::vector<double> BasicEarSumner2002<T>::init_input(std::vector<double> stimulus, double stimulus_fs) const {
+    if (std::fabs(stimulus_fs - fs) > 10) {
+        stimulus = resample(stimulus, stimulus_fs, fs);
+    }
+    if (renormalise) {
+        renormalise_to_dB(stimulus, fs, db);
+    }
+    return stimulus;
+}
+
+template <typename T>
+void BasicEarSumner2002<T>::run(std::vector<double> stimulus, double stimulus_fs) {
+    stimulus = init_input(std::move(stimulus), stimulus_fs);
+    init_stream();
+    if (cache == nullptr) {
+        run_chunk(stimulus.data(), stimulus.size(), true);
+        return;
+    }
+    /* Each key extends the fingerprint of the stage before */
+    Fingerprint fp;
+    std::uint32_t sample_bytes = sizeof(T);
+    fp.add(&sample_bytes, sizeof sample_bytes).add(stimulus);
+    add_parameters(fp, ome);
+    add_parameters(fp, drnl);
+    std::string keys[3];
+    keys[0] = "bm-" + fp.hex();
+    add_parameters(fp, cilia);
+    keys[1] = "rp-" + fp.hex();
+    add_parameters(fp, synapse);
+    keys[2] = "release-" + fp.hex();
+    run_stages(stimulus.data(), stimulus.size(), true, keys);
+}
+
+template <typename T>
+void BasicEarSumner2002<T>::run_chunked(std::vector<double> stimulus, double stimulus_fs, std::size_t chunk_size,
+                                        const ChunkSink &sink) {
+    if (chunk_size == 0) {
+        throw std::invalid_argument("run_chunked: chunk_size should be positive");
+    }
+    stimulus = init_input(std::move(stimulus), stimulus_fs);
+    init_stream();
+    for (std::size_t first = 0; first < stimulus.size(); first += chunk_size) {
+        std::size_t n = std::min(chunk_size, stimulus.size() - first);
+        run_chunk(stimulus.data() + first, n, first + n == stimulus.size());
+        sink(*this, first, n);
+    }
+}
+
+template <typename T>
+void BasicEarSumner2002<T>::init_stream() {
+    std::size_t n_BFs = drnl.n_BFs();
+    profile.clear();
+    ome.init_external_filters(fs);
+    drnl.init(fs);
+    cilia.init(n_BFs, fs);
+    synapse.init(cilia.restingV, n_BFs, fs);
+    an.init(synapse, fs);
+}
+
+template <typename T>
+void BasicEarSumner2002<T>::run_chunk(const double *stimulus, std::size_t n, bool last) {
+    run_stages(stimulus, n, last, nullptr);
+}
+
+template <typename T>
+void BasicEarSumner2002<T>::run_stages(const double *stimulus, std::size_t n, bool last,
+                                       const std::string *keys) {
+    Stopwatch watch;
+    /* Records the stage that just ran, when profiling */
+    auto lap = [&](const char *stage, std::size_t bytes) {
+        if (profiling) {
+            profile.record(stage, watch.seconds(), n, bytes);
+            watch = Stopwatch();
+        }
+    };
+
+    /* Stages to run: 0 from the OME, 1 from the cilia, 2 from the synapse, 3
+     * the AN only */
+    int first = 0;
+    if (keys != nullptr) {
+        BasicMatrix<T> *outputs[] = {&drnl.response, &cilia.receptor_potential, &synapse.vesicle_release_rate};
+        std::size_t rows[] = {drnl.n_BFs(), drnl.n_BFs(), synapse.n_AN_channels};
+        for (int stage = std::min((int)cache_until, 2); stage >= 0 && first == 0; stage--) {
+            if (cache->load(keys[stage], *outputs[stage]) && outputs[stage]->rows() == rows[stage] &&
+                outputs[stage]->cols() == n) {
+                first = stage + 1;
+            }
+        }
+        /* Outputs and intermediates of the stages skipped, from a previous run,
+         * but not the output just loaded */
+        if (first >= 1) { ome.clean(); }
+        if (first >= 2) {
+            drnl.clean();
+            cilia.cilia_displacement.clear();
+            cilia.Gu.clear();
+        }
+        if (first >= 3) {
+            cilia.clean();
+            synapse.mICa.clear();
+            synapse.synapticCa.clear();
+        }
+        lap("cache", 0);
+    }
+    /* Stores the output of a stage that ran */
+    auto store = [&](int stage, const BasicMatrix<T> &out) {
+        if (keys != nullptr) {
+            cache->store(keys[stage], out);
+            lap("cache", 0);
+        }
+    };
+
+    if (first < 1) {
+        ome.stapes_velocity.resize(n);
+        ome.apply_filters(stimulus, ome.stapes_velocity.data(), n);
+        lap("ome", ome.stapes_velocity.capacity() * sizeof(double));
+        drnl.run(ome.stapes_velocity.data(), n);
+        lap("bm", drnl.response.bytes());
+        store(0, drnl.response);
+    }
+    if (first < 2) {
+        cilia.apply(drnl.response);
+        lap("cilia", cilia.receptor_potential.bytes() + cilia.cilia_displacement.bytes() + cilia.Gu.bytes());
+        store(1, cilia.receptor_potential);
+    }
+    if (first < 3) {
+        synapse.apply(cilia.receptor_potential);
+        lap("synapse", synapse.vesicle_release_rate.bytes() + synapse.mICa.bytes() + synapse.synapticCa.bytes());
+        store(2, synapse.vesicle_release_rate);
+    }
+    an.apply(synapse.vesicle_release_rate, profiling ? &profile : nullptr, last);
+}
+
+template <typename T>
+void BasicEarSumner2002<T>::clean() {
+    ome.clean();
+    drnl.clean();
+    cilia.clean();
+    synapse.clean();
+    an.clean();
+}
+
+template class BasicEarSumner2002<double>;
+template class BasicEarSumner2002<float>;
+
+} // namespace earing
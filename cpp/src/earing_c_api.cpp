@@ -0,0 +1,403 @@
+#include "earing/earing.h"
+
+#include "earing/auditory_nerve.hpp"
+#include "earing/htk.hpp"
+#include "earing/parallel.hpp"
+#include "earing/quantal_release.hpp"
+#include "earing/random.hpp"
+#include "earing/recurrence.hpp"
+#include "earing/refractoriness.hpp"
+#include "earing/spike_analysis.hpp"
+#include "earing/spike_trains.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+using namespace earing;
+
+struct earing_spike_trains {
+    SpikeTrains trains;
+};
+
+namespace {
+
+/* No exception may cross the C interface (the MEX gateways would crash
+ * Matlab): body returns the status, and any exception (invalid arguments,
+ * std::bad_alloc, threads that cannot be started...) gives -1 */
+template <typename Body>
+int guarded(Body &&body) noexcept {
+    try {
+        return body();
+    } catch (...) {
+        return -1;
+    }
+}
+
+/* New spike trains filled by fill, NULL if it throws */
+template <typename Fill>
+earing_spike_trains *new_spike_trains(Fill &&fill) noexcept {
+    try {
+        std::unique_ptr<earing_spike_trains> out(new earing_spike_trains);
+        fill(out->trains);
+        return out.release();
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+/* Bodies of the entry points taking double or float (_single) matrices */
+
+template <typename T>
+int first_order_recurrence_entry(T *matrix, T *vector, const T *C, size_t C_rows, size_t C_cols, const T *A,
+                                 size_t rows, size_t cols, int n_threads) noexcept {
+    CoefficientShape shape;
+    if (C_rows == 1 && C_cols == 1) {
+        shape = CoefficientShape::Scalar;
+    } else if (C_rows == rows && C_cols == 1) {
+        shape = CoefficientShape::Column;
+    } else if (C_rows == rows && C_cols == cols) {
+        shape = CoefficientShape::Full;
+    } else {
+        return -1;
+    }
+    return guarded([&] {
+        first_order_recurrence(matrix, vector, C, shape, A, rows, cols, n_threads);
+        return 0;
+    });
+}
+
+template <typename T>
+int decimated_reservoir_release_entry(T *prob_firing, const T *release_prob, size_t rows, size_t cols,
+                                      size_t decimation, double *available, double *cleft, double *reprocess,
+                                      double M, const double *xdt, const double *ydt, const double *rdt_plus_ldt,
+                                      const double *rdt) noexcept {
+    if (decimation == 0) {
+        return -1;
+    }
+    return guarded([&] {
+        std::vector<double> prob_sum(rows, 0.0);
+        std::size_t n_summed = 0;
+        decimated_reservoir_release(prob_firing, release_prob, rows, cols, decimation, prob_sum.data(), n_summed,
+                                    true, available, cleft, reprocess, M, xdt, ydt, rdt_plus_ldt, rdt);
+        return 0;
+    });
+}
+
+template <typename T>
+earing_spike_trains *quantal_release_entry(const T *release_prob, size_t rows, size_t cols, size_t decimation,
+                                           int n_fibers, int abs_refractory_bins, const double *available,
+                                           const double *cleft, const double *reprocess, double M,
+                                           const double *xdt, const double *ydt, const double *rdt_plus_ldt,
+                                           const double *rdt, unsigned long long seed, int n_threads) noexcept {
+    if (n_fibers < 1 || decimation == 0) {
+        return nullptr;
+    }
+    return new_spike_trains([&](SpikeTrains &trains) {
+        /* Group averages of release_prob, as in earing_decimated_reservoir_release */
+        std::vector<T> decimated;
+        if (decimation > 1) {
+            std::vector<double> prob_sum(rows, 0.0);
+            std::size_t n_summed = 0;
+            decimated.resize(rows * ((cols + decimation - 1) / decimation));
+            cols = decimate_release_prob(decimated.data(), release_prob, rows, cols, decimation, prob_sum.data(),
+                                         n_summed, true);
+            release_prob = decimated.data();
+        }
+        QuantalRelease(rows, n_fibers, available, cleft, reprocess, M, xdt, ydt, rdt_plus_ldt, rdt,
+                       abs_refractory_bins, seed, 0, n_threads)
+            .apply(release_prob, cols, trains);
+    });
+}
+
+template <typename T>
+int average_channels_entry(const T *feats, size_t rows, size_t cols, size_t n_features, T *mean,
+                           int n_threads) noexcept {
+    if (n_features == 0 || rows <= n_features) {
+        return -1;
+    }
+    return guarded([&] {
+        average_channels(feats, rows, cols, n_features, mean, n_threads);
+        return 0;
+    });
+}
+
+} // namespace
+
+extern "C" {
+
+int earing_num_threads(void) {
+    return num_threads();
+}
+
+void earing_set_num_threads(int n_threads) {
+    set_num_threads(n_threads);
+}
+
+int earing_first_order_recurrence(double *matrix, double *vector, const double *C, size_t C_rows,
+                                  size_t C_cols, const double *A, size_t rows, size_t cols, int n_threads) {
+    return first_order_recurrence_entry(matrix, vector, C, C_rows, C_cols, A, rows, cols, n_threads);
+}
+
+int earing_first_order_recurrence_single(float *matrix, float *vector, const float *C, size_t C_rows,
+                                         size_t C_cols, const float *A, size_t rows, size_t cols, int n_threads) {
+    return first_order_recurrence_entry(matrix, vector, C, C_rows, C_cols, A, rows, cols, n_threads);
+}
+
+int earing_reservoir_release(double *prob_firing, const double *release_prob, size_t rows, size_t cols,
+                             double *available, double *cleft, double *reprocess, double M,
+                             const double *xdt, const double *ydt, const double *rdt_plus_ldt,
+                             const double *rdt) {
+    return guarded([&] {
+        reservoir_release(prob_firing, release_prob, rows, cols, available, cleft, reprocess, M,
+                          xdt, ydt, rdt_plus_ldt, rdt);
+        return 0;
+    });
+}
+
+int earing_reservoir_release_single(float *prob_firing, const float *release_prob, size_t rows, size_t cols,
+                                    double *available, double *cleft, double *reprocess, double M,
+                                    const double *xdt, const double *ydt, const double *rdt_plus_ldt,
+                                    const double *rdt) {
+    return guarded([&] {
+        reservoir_release(prob_firing, release_prob, rows, cols, available, cleft, reprocess, M,
+                          xdt, ydt, rdt_plus_ldt, rdt);
+        return 0;
+    });
+}
+
+int earing_decimated_reservoir_release(double *prob_firing, const double *release_prob, size_t rows, size_t cols,
+                                       size_t decimation, double *available, double *cleft, double *reprocess,
+                                       double M, const double *xdt, const double *ydt,
+                                       const double *rdt_plus_ldt, const double *rdt) {
+    return decimated_reservoir_release_entry(prob_firing, release_prob, rows, cols, decimation, available, cleft,
+                                             reprocess, M, xdt, ydt, rdt_plus_ldt, rdt);
+}
+
+int earing_decimated_reservoir_release_single(float *prob_firing, const float *release_prob, size_t rows,
+                                              size_t cols, size_t decimation, double *available, double *cleft,
+                                              double *reprocess, double M, const double *xdt, const double *ydt,
+                                              const double *rdt_plus_ldt, const double *rdt) {
+    return decimated_reservoir_release_entry(prob_firing, release_prob, rows, cols, decimation, available, cleft,
+                                             reprocess, M, xdt, ydt, rdt_plus_ldt, rdt);
+}
+
+int earing_apply_refractoriness(const double *prob, double *probref, size_t rows, size_t cols, const double *W,
+                                size_t n_W, int n_threads) {
+    return guarded([&] {
+        apply_refractoriness(prob, probref, rows, cols, W, n_W, n_threads);
+        return 0;
+    });
+}
+
+int earing_apply_refractoriness_single(const float *prob, float *probref, size_t rows, size_t cols, const double *W,
+                                       size_t n_W, int n_threads) {
+    return guarded([&] {
+        apply_refractoriness(prob, probref, rows, cols, W, n_W, n_threads);
+        return 0;
+    });
+}
+
+unsigned long long earing_random_seed(void) {
+    try {
+        return random_seed();
+    } catch (...) {
+        /* No random_device */
+        return (unsigned long long)std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+}
+
+int earing_generate_poisson_spike_trains(unsigned char *spikes, const double *rate, size_t rows, size_t cols,
+                                         int n_fibers, int abs_refractory_bins, int algo,
+                                         unsigned long long seed, int n_threads) {
+    if (n_fibers < 1 || (algo != 1 && algo != 2)) {
+        return -1;
+    }
+    return guarded([&] {
+        generate_poisson_spike_trains(spikes, rate, rows, cols, n_fibers, abs_refractory_bins,
+                                      static_cast<SpikeAlgorithm>(algo), seed, n_threads);
+        return 0;
+    });
+}
+
+int earing_generate_poisson_psth(uint16_t *counts, const double *rate, size_t rows, size_t cols, int n_fibers,
+                                 int n_repetitions, int abs_refractory_bins, int algo, unsigned long long seed,
+                                 int n_threads) {
+    if (n_fibers < 1 || (algo != 1 && algo != 2) || n_repetitions < 1 || n_repetitions > 65535) {
+        return -1;
+    }
+    return guarded([&] {
+        generate_poisson_psth(counts, rate, rows, cols, n_fibers, n_repetitions, abs_refractory_bins,
+                              static_cast<SpikeAlgorithm>(algo), seed, n_threads);
+        return 0;
+    });
+}
+
+earing_spike_trains *earing_generate_poisson_spike_events(const double *rate, size_t rows, size_t cols,
+                                                          int n_fibers, int abs_refractory_bins, int algo,
+                                                          unsigned long long seed, int n_threads) {
+    if (n_fibers < 1 || (algo != 1 && algo != 2)) {
+        return nullptr;
+    }
+    return new_spike_trains([&](SpikeTrains &trains) {
+        trains = generate_poisson_spike_events(rate, rows, cols, n_fibers, abs_refractory_bins,
+                                               static_cast<SpikeAlgorithm>(algo), seed, n_threads);
+    });
+}
+
+size_t earing_spike_trains_count(const earing_spike_trains *trains) {
+    return trains->trains.n_spikes();
+}
+
+int earing_spike_trains_csc(const earing_spike_trains *trains, size_t *col_start, size_t *row_index) {
+    return guarded([&] {
+        to_csc(trains->trains, col_start, row_index);
+        return 0;
+    });
+}
+
+void earing_spike_trains_lists(const earing_spike_trains *trains, size_t *fiber_start, size_t *frames) {
+    std::copy(trains->trains.fiber_start.begin(), trains->trains.fiber_start.end(), fiber_start);
+    std::copy(trains->trains.frames.begin(), trains->trains.frames.end(), frames);
+}
+
+void earing_free_spike_trains(earing_spike_trains *trains) {
+    delete trains;
+}
+
+earing_spike_trains *earing_quantal_release(const double *release_prob, size_t rows, size_t cols,
+                                            size_t decimation, int n_fibers, int abs_refractory_bins,
+                                            const double *available, const double *cleft,
+                                            const double *reprocess, double M, const double *xdt,
+                                            const double *ydt, const double *rdt_plus_ldt, const double *rdt,
+                                            unsigned long long seed, int n_threads) {
+    return quantal_release_entry(release_prob, rows, cols, decimation, n_fibers, abs_refractory_bins, available,
+                                 cleft, reprocess, M, xdt, ydt, rdt_plus_ldt, rdt, seed, n_threads);
+}
+
+earing_spike_trains *earing_quantal_release_single(const float *release_prob, size_t rows, size_t cols,
+                                                   size_t decimation, int n_fibers, int abs_refractory_bins,
+                                                   const double *available, const double *cleft,
+                                                   const double *reprocess, double M, const double *xdt,
+                                                   const double *ydt, const double *rdt_plus_ldt,
+                                                   const double *rdt, unsigned long long seed, int n_threads) {
+    return quantal_release_entry(release_prob, rows, cols, decimation, n_fibers, abs_refractory_bins, available,
+                                 cleft, reprocess, M, xdt, ydt, rdt_plus_ldt, rdt, seed, n_threads);
+}
+
+int earing_rate_spike_train(const double *spikes, size_t rows, size_t cols, const double *begin, size_t n_begin,
+                            const double *window, size_t n_window, double *rate, int n_threads) {
+    return guarded([&] {
+        rate_spike_train(spikes, rows, cols, begin, n_begin, window, n_window, rate, n_threads);
+        return 0;
+    });
+}
+
+int earing_rate_spike_train_single(const float *spikes, size_t rows, size_t cols, const double *begin,
+                                   size_t n_begin, const double *window, size_t n_window, float *rate,
+                                   int n_threads) {
+    return guarded([&] {
+        rate_spike_train(spikes, rows, cols, begin, n_begin, window, n_window, rate, n_threads);
+        return 0;
+    });
+}
+
+int earing_rate_spike_events(const size_t *col_start, const size_t *row_index, const double *values, size_t rows,
+                             size_t cols, const double *begin, size_t n_begin, const double *window, size_t n_window,
+                             double *rate, int n_threads) {
+    return guarded([&] {
+        rate_spike_events(col_start, row_index, values, rows, cols, begin, n_begin, window, n_window, rate,
+                          n_threads);
+        return 0;
+    });
+}
+
+int earing_spikes_to_isi(const double *spikes, size_t rows, size_t cols, double *isi, int n_threads) {
+    return guarded([&] {
+        spikes_to_isi(spikes, rows, cols, isi, n_threads);
+        return 0;
+    });
+}
+
+int earing_subsample_spike_trains(double *spikes, size_t rows, size_t cols, size_t n, int n_threads) {
+    if (n == 0) {
+        return -1;
+    }
+    return guarded([&] {
+        subsample_spike_trains(spikes, rows, cols, n, n_threads);
+        return 0;
+    });
+}
+
+int earing_isi_spike_events(const size_t *col_start, const size_t *row_index, size_t rows, size_t cols, double *isi,
+                            int inverse, int n_threads) {
+    return guarded([&] {
+        isi_spike_events(col_start, row_index, rows, cols, isi, inverse != 0, n_threads);
+        return 0;
+    });
+}
+
+int earing_subsample_spike_events(const size_t *col_start, const size_t *row_index, size_t cols, size_t n,
+                                  size_t *out_col_start, size_t *out_row_index, int n_threads) {
+    if (n == 0) {
+        return -1;
+    }
+    return guarded([&] {
+        subsample_spike_events(col_start, row_index, cols, n, out_col_start, out_row_index, n_threads);
+        return 0;
+    });
+}
+
+int earing_spike_counts(const size_t *col_start, const size_t *row_index, size_t cols, size_t first_frame,
+                        size_t last_frame, size_t *counts, int n_threads) {
+    return guarded([&] {
+        spike_counts(col_start, row_index, cols, first_frame, last_frame, counts, n_threads);
+        return 0;
+    });
+}
+
+int earing_average_channels(const double *feats, size_t rows, size_t cols, size_t n_features, double *mean,
+                            int n_threads) {
+    return average_channels_entry(feats, rows, cols, n_features, mean, n_threads);
+}
+
+int earing_average_channels_single(const float *feats, size_t rows, size_t cols, size_t n_features, float *mean,
+                                   int n_threads) {
+    return average_channels_entry(feats, rows, cols, n_features, mean, n_threads);
+}
+
+int earing_htk_read_header(const char *path, earing_htk_header *header) {
+    return guarded([&] {
+        HtkHeader h = read_htk_header(path);
+        header->n_frames = h.n_frames;
+        header->n_features = h.n_features;
+        header->samp_period = h.samp_period;
+        header->parm_kind = h.parm_kind;
+        return 0;
+    });
+}
+
+int earing_htk_read(const char *path, double *features, size_t n_features, size_t n_frames) {
+    return guarded([&] {
+        Matrix m = read_htk(path);
+        if (m.rows() != n_features || m.cols() != n_frames) {
+            return -1;
+        }
+        std::memcpy(features, m.data(), m.size() * sizeof(double));
+        return 0;
+    });
+}
+
+int earing_htk_write(const char *path, const double *features, size_t n_features, size_t n_frames, int parm_kind,
+                     int samp_period) {
+    return guarded([&] {
+        Matrix m(n_features, n_frames);
+        std::copy(features, features + n_features * n_frames, m.data());
+        write_htk(path, m, parm_kind, samp_period);
+        return 0;
+    });
+}
+
+} // extern "C"
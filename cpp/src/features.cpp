@@ -0,0 +1,555 @@
+#include "earing/features.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <initializer_list>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace earing {
+
+namespace {
+
+using Frame = std::vector<double>;
+
+const double pi = 3.14159265358979323846;
+
+/* Matlab linspace(-1, 1, n) */
+std::vector<double> delta_filter(std::size_t half_width) {
+    std::size_t n = 2 * half_width + 1;
+    std::vector<double> h(n, 1.0);
+    for (std::size_t k = 0; k + 1 < n; k++) {
+        h[k] = -1.0 + 2.0 * k / (n - 1);
+    }
+    return h;
+}
+
+} // namespace
+
+/* Frames in, frames out, possibly later */
+class FeaturePipeline::Step {
+public:
+    virtual ~Step() = default;
+    virtual void init() {}
+    /* Replaces batch by the frames this step outputs for it */
+    virtual void apply(std::vector<Frame> &batch) = 0;
+    /* Same, at the end of the utterance, adding the frames held back */
+    virtual void finish(std::vector<Frame> &batch) { apply(batch); }
+};
+
+/* calculateRate of ProcessingAsr, one window at a time: every window sums its
+ * frames in increasing order, as rate_spike_train, and is output (divided by
+ * the sum of the Hann window) as soon as its last frame has been seen */
+class FeaturePipeline::Rate {
+public:
+    explicit Rate(const FeatureParams &params)
+        : n_window_((std::size_t)std::floor(params.fs * params.rate_window_duration)),
+          hop_((std::size_t)std::floor(params.rate_time_step * params.fs)) {
+        if (n_window_ == 0 || hop_ == 0) {
+            throw std::invalid_argument("Feature r: rate window and time step must be at least one frame");
+        }
+        /* Matlab hann(n_window_): zero at both ends, 1 if a single frame */
+        window_.assign(n_window_, 1.0);
+        for (std::size_t j = 0; j < n_window_; j++) {
+            if (n_window_ > 1) {
+                window_[j] = 0.5 * (1 - std::cos(2 * pi * j / (n_window_ - 1)));
+            }
+            norm_ += window_[j];
+        }
+    }
+
+    std::size_t hop() const { return hop_; }
+
+    void init() {
+        rows_ = 0;
+        n_frames_ = 0;
+        next_begin_ = 1;  /* beginInd = 1:hop:..., used as 0-based offsets */
+        windows_.clear();
+    }
+
+    template <typename T>
+    void apply(const BasicMatrix<T> &x, std::vector<Frame> &out) {
+        check_rows(x.rows());
+        for (std::size_t col = 0; col < x.cols(); col++) {
+            std::size_t t = n_frames_;
+            open(t + 1);
+            const T *xc = x.col(col);
+            for (Window &w : windows_) {
+                double weight = window_[t - w.begin];
+                for (std::size_t row = 0; row < rows_; row++) {
+                    w.sum[row] += xc[row] * weight;
+                }
+            }
+            n_frames_++;
+            close(out);
+        }
+    }
+
+    void apply(const SpikeTrains &spikes, std::vector<Frame> &out) {
+        check_rows(spikes.n_fibers);
+        open(n_frames_ + spikes.n_frames);
+        for (std::size_t fiber = 0; fiber < spikes.n_fibers; fiber++) {
+            std::size_t first = 0;
+            for (std::size_t k = spikes.fiber_start[fiber]; k < spikes.fiber_start[fiber + 1]; k++) {
+                std::size_t t = n_frames_ + spikes.frames[k];
+                while (first < windows_.size() && windows_[first].begin + n_window_ <= t) {
+                    first++;
+                }
+                for (std::size_t w = first; w < windows_.size() && windows_[w].begin <= t; w++) {
+                    windows_[w].sum[fiber] += window_[t - windows_[w].begin];
+                }
+            }
+        }
+        n_frames_ += spikes.n_frames;
+        close(out);
+    }
+
+private:
+    struct Window {
+        std::size_t begin;
+        Frame sum;
+    };
+
+    void check_rows(std::size_t rows) {
+        if (n_frames_ == 0 && windows_.empty()) {
+            rows_ = rows;
+        } else if (rows != rows_) {
+            throw std::invalid_argument("Feature r: the number of rows changed between blocks");
+        }
+    }
+
+    /* Starts the windows beginning before frame end */
+    void open(std::size_t end) {
+        for (; next_begin_ < end; next_begin_ += hop_) {
+            windows_.push_back(Window{next_begin_, Frame(rows_, 0.0)});
+        }
+    }
+
+    /* Outputs the windows whose frames have all been seen */
+    void close(std::vector<Frame> &out) {
+        while (!windows_.empty() && windows_.front().begin + n_window_ <= n_frames_) {
+            Frame &sum = windows_.front().sum;
+            for (double &v : sum) {
+                v /= norm_;
+            }
+            out.push_back(std::move(sum));
+            windows_.pop_front();
+        }
+    }
+
+    std::size_t n_window_, hop_;
+    std::vector<double> window_;
+    double norm_ = 0;
+    std::size_t rows_ = 0, n_frames_ = 0, next_begin_ = 1;
+    std::deque<Window> windows_;
+};
+
+namespace {
+
+using Step = FeaturePipeline::Step;
+
+/* l, l3 and lu: element-wise */
+class Log : public Step {
+public:
+    Log(double gain, bool uplift, double threshold) : gain_(gain), uplift_(uplift), threshold_(threshold) {}
+
+    void apply(std::vector<Frame> &batch) override {
+        for (Frame &frame : batch) {
+            for (double &v : frame) {
+                if (uplift_) {
+                    v = std::log10(v);
+                    v = (v < threshold_ ? threshold_ : v) - threshold_;
+                } else {
+                    v = std::log10(1 + gain_ * v);
+                }
+            }
+        }
+    }
+
+private:
+    double gain_;
+    bool uplift_;
+    double threshold_;
+};
+
+/* d: first n_coeff coefficients of Matlab dct (orthonormal DCT-II) */
+class Dct : public Step {
+public:
+    explicit Dct(std::size_t n_coeff) : n_coeff_(n_coeff) {}
+
+    void apply(std::vector<Frame> &batch) override {
+        for (Frame &frame : batch) {
+            std::size_t n = frame.size();
+            if (n != n_) {
+                make_basis(n);
+            }
+            Frame y(n_coeff_, 0.0);
+            for (std::size_t k = 0; k < n_coeff_; k++) {
+                const double *b = basis_.data() + k * n;
+                double sum = 0;
+                for (std::size_t j = 0; j < n; j++) {
+                    sum += b[j] * frame[j];
+                }
+                y[k] = sum;
+            }
+            frame = std::move(y);
+        }
+    }
+
+private:
+    void make_basis(std::size_t n) {
+        if (n < n_coeff_) {
+            throw std::invalid_argument("Feature d: fewer rows than dct_num_coeff");
+        }
+        n_ = n;
+        basis_.resize(n_coeff_ * n);
+        for (std::size_t k = 0; k < n_coeff_; k++) {
+            double scale = std::sqrt((k == 0 ? 1.0 : 2.0) / n);
+            for (std::size_t j = 0; j < n; j++) {
+                basis_[j + k * n] = scale * std::cos(pi * (2 * j + 1) * k / (2.0 * n));
+            }
+        }
+    }
+
+    std::size_t n_coeff_, n_ = 0;
+    std::vector<double> basis_;  /* n_ x n_coeff_ */
+};
+
+/* dd: [x; deltas; ddeltas], deltas = conv2(x, linspace(-1, 1, 2 * delta + 1),
+ * 'same') on x padded with context = delta + ddelta copies of its first and
+ * last frames, and ddeltas the same on deltas. Frame t is output once frame
+ * t + context is known, or at the end with the last frame repeated. */
+class Deltas : public Step {
+public:
+    Deltas(std::size_t delta, std::size_t ddelta)
+        : d_(delta), dd_(ddelta), h_d_(delta_filter(delta)), h_dd_(delta_filter(ddelta)) {}
+
+    void init() override {
+        x_.clear();
+        deltas_.clear();
+        n_x_ = 0;
+        first_x_ = 0;
+        first_delta_ = d_;
+        next_delta_ = d_;
+        next_out_ = d_ + dd_;
+    }
+
+    void apply(std::vector<Frame> &batch) override {
+        std::vector<Frame> out;
+        for (Frame &frame : batch) {
+            if (n_x_ == 0) {
+                push(frame, d_ + dd_);
+            }
+            push(frame, 1);
+            emit(out);
+        }
+        batch = std::move(out);
+    }
+
+    void finish(std::vector<Frame> &batch) override {
+        apply(batch);
+        if (n_x_ > 0) {
+            Frame last = x_.back();
+            push(last, d_ + dd_);
+            emit(batch);
+        }
+    }
+
+private:
+    void push(const Frame &frame, std::size_t copies) {
+        for (std::size_t k = 0; k < copies; k++) {
+            x_.push_back(frame);
+        }
+        n_x_ += copies;
+    }
+
+    /* Padded indices: x_[0] is frame first_x_, deltas_[0] is first_delta_ */
+    void emit(std::vector<Frame> &out) {
+        for (; next_delta_ + d_ < n_x_; next_delta_++) {
+            Frame delta = convolve(x_, next_delta_ - first_x_, h_d_);
+            deltas_.push_back(std::move(delta));
+        }
+        for (; next_out_ + dd_ < next_delta_; next_out_++) {
+            const Frame &x = x_[next_out_ - first_x_];
+            const Frame &delta = deltas_[next_out_ - first_delta_];
+            Frame ddelta = convolve(deltas_, next_out_ - first_delta_, h_dd_);
+            Frame frame;
+            frame.reserve(3 * x.size());
+            frame.insert(frame.end(), x.begin(), x.end());
+            frame.insert(frame.end(), delta.begin(), delta.end());
+            frame.insert(frame.end(), ddelta.begin(), ddelta.end());
+            out.push_back(std::move(frame));
+        }
+        std::size_t keep_x = std::min(next_delta_ - d_, next_out_);
+        for (; first_x_ < keep_x; first_x_++) {
+            x_.pop_front();
+        }
+        for (; first_delta_ + dd_ < next_out_; first_delta_++) {
+            deltas_.pop_front();
+        }
+    }
+
+    /* conv2(., h, 'same') at frame t of frames, all its neighbours being known */
+    static Frame convolve(const std::deque<Frame> &frames, std::size_t t, const std::vector<double> &h) {
+        std::size_t half = h.size() / 2;
+        Frame y(frames[t].size(), 0.0);
+        for (std::size_t j = 0; j < h.size(); j++) {
+            const Frame &x = frames[t + half - j];
+            for (std::size_t row = 0; row < y.size(); row++) {
+                y[row] += h[j] * x[row];
+            }
+        }
+        return y;
+    }
+
+    std::size_t d_, dd_;
+    std::vector<double> h_d_, h_dd_;
+    std::deque<Frame> x_, deltas_;
+    std::size_t n_x_ = 0, first_x_ = 0, first_delta_ = 0, next_delta_ = 0, next_out_ = 0;
+};
+
+/* e and el: prepends the energy of the frame */
+class Energy : public Step {
+public:
+    explicit Energy(bool log) : log_(log) {}
+
+    void apply(std::vector<Frame> &batch) override {
+        for (Frame &frame : batch) {
+            double e = 0;
+            for (double v : frame) {
+                e += v * v;
+            }
+            frame.insert(frame.begin(), log_ ? std::log10(1 + e) : e);
+        }
+    }
+
+private:
+    bool log_;
+};
+
+/* f: averagingNeighbours of ProcessingAsr */
+class Average : public Step {
+public:
+    explicit Average(std::size_t n_features) : n_features_(n_features) {}
+
+    void apply(std::vector<Frame> &batch) override {
+        for (Frame &frame : batch) {
+            std::size_t n = n_features_ > 0 ? frame.size() / n_features_ : 0;
+            if (n == 0) {
+                throw std::invalid_argument("Feature f: fewer rows than avg_n_features");
+            }
+            Frame mean(n_features_);
+            for (std::size_t k = 0; k < n_features_; k++) {
+                std::size_t end = k + 1 < n_features_ ? (k + 1) * n : frame.size();
+                double sum = 0;
+                for (std::size_t row = k * n; row < end; row++) {
+                    sum += frame[row];
+                }
+                mean[k] = sum / (end - k * n);
+            }
+            frame = std::move(mean);
+        }
+    }
+
+private:
+    std::size_t n_features_;
+};
+
+/* z (scale false) and ga (scale true): every row minus its mean over the
+ * utterance, and divided by its standard deviation (normalised by N - 1, as
+ * Matlab var). Frames are held until the end, or, with running statistics,
+ * normalised by the mean and variance of the frames seen so far (Welford). */
+class Normalise : public Step {
+public:
+    Normalise(bool scale, bool running) : scale_(scale), running_(running) {}
+
+    void init() override {
+        held_.clear();
+        n_ = 0;
+        mean_.clear();
+        m2_.clear();
+    }
+
+    void apply(std::vector<Frame> &batch) override {
+        if (!running_) {
+            for (Frame &frame : batch) {
+                held_.push_back(std::move(frame));
+            }
+            batch.clear();
+            return;
+        }
+        for (Frame &frame : batch) {
+            if (n_ == 0) {
+                mean_.assign(frame.size(), 0.0);
+                m2_.assign(frame.size(), 0.0);
+            }
+            n_++;
+            for (std::size_t row = 0; row < frame.size(); row++) {
+                double d = frame[row] - mean_[row];
+                mean_[row] += d / n_;
+                m2_[row] += d * (frame[row] - mean_[row]);
+                double a = frame[row] - mean_[row];
+                if (scale_) {
+                    a = m2_[row] > 0 ? a / std::sqrt(m2_[row] / (n_ - 1)) : 0.0;
+                }
+                frame[row] = a;
+            }
+        }
+    }
+
+    void finish(std::vector<Frame> &batch) override {
+        apply(batch);
+        if (running_ || held_.empty()) {
+            return;
+        }
+        std::size_t rows = held_[0].size(), n = held_.size();
+        for (std::size_t row = 0; row < rows; row++) {
+            double sum = 0;
+            for (const Frame &frame : held_) {
+                sum += frame[row];
+            }
+            double mean = sum / n, ss = 0;
+            for (Frame &frame : held_) {
+                frame[row] -= mean;
+                ss += frame[row] * frame[row];
+            }
+            if (scale_) {
+                double sd = std::sqrt(ss / (n - 1));
+                for (Frame &frame : held_) {
+                    frame[row] /= sd;
+                }
+            }
+        }
+        batch = std::move(held_);
+        held_.clear();
+    }
+
+private:
+    bool scale_, running_;
+    std::vector<Frame> held_;
+    std::size_t n_ = 0;
+    std::vector<double> mean_, m2_;
+};
+
+bool is_one_of(const std::string &name, std::initializer_list<const char *> names) {
+    for (const char *n : names) {
+        if (name == n) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+FeaturePipeline::FeaturePipeline(const std::string &features, FeatureParams params) : params_(params) {
+    std::stringstream ss(features);
+    std::string name;
+    bool first = true;
+    while (std::getline(ss, name, '_')) {
+        bool input_type = first && (name == "SPIKE" || name == "PROB");
+        first = false;
+        if (name.empty() || input_type) {
+            continue;
+        }
+        if (is_one_of(name, {"r", "rate"})) {
+            if (!steps_.empty() || rate_) {
+                throw std::invalid_argument("Feature " + name + " must be the first step, applied once");
+            }
+            rate_.reset(new Rate(params_));
+        } else if (is_one_of(name, {"l", "l0", "log10"})) {
+            steps_.emplace_back(new Log(1, false, 0));
+        } else if (is_one_of(name, {"l3", "log1000"})) {
+            steps_.emplace_back(new Log(1000, false, 0));
+        } else if (name == "lu") {
+            steps_.emplace_back(new Log(1, true, params_.log_threshold_value));
+        } else if (is_one_of(name, {"d", "dct"})) {
+            steps_.emplace_back(new Dct(params_.dct_num_coeff));
+        } else if (is_one_of(name, {"dd", "delta_delta"})) {
+            steps_.emplace_back(new Deltas(params_.deltadelta_delta, params_.deltadelta_ddelta));
+        } else if (is_one_of(name, {"e", "energy"})) {
+            steps_.emplace_back(new Energy(false));
+        } else if (is_one_of(name, {"el", "logenergy"})) {
+            steps_.emplace_back(new Energy(true));
+        } else if (is_one_of(name, {"f", "fr", "sfr", "avgneigh"})) {
+            steps_.emplace_back(new Average(params_.avg_n_features));
+        } else if (name == "z") {
+            steps_.emplace_back(new Normalise(false, params_.running_statistics));
+        } else if (is_one_of(name, {"ga", "gaussianization", "batchNormalisation"})) {
+            steps_.emplace_back(new Normalise(true, params_.running_statistics));
+        } else {
+            throw std::invalid_argument("Feature " + name + " is not available natively");
+        }
+        names_.push_back(name);
+    }
+    init();
+}
+
+FeaturePipeline::FeaturePipeline(FeaturePipeline &&) noexcept = default;
+FeaturePipeline &FeaturePipeline::operator=(FeaturePipeline &&) noexcept = default;
+FeaturePipeline::~FeaturePipeline() = default;
+
+double FeaturePipeline::frame_period() const {
+    return (rate_ ? rate_->hop() : 1) / params_.fs;
+}
+
+void FeaturePipeline::init() {
+    if (rate_) {
+        rate_->init();
+    }
+    for (auto &step : steps_) {
+        step->init();
+    }
+    frames.clear();
+}
+
+template <typename T>
+void FeaturePipeline::apply(const BasicMatrix<T> &an_output) {
+    std::vector<Frame> batch;
+    if (rate_) {
+        rate_->apply(an_output, batch);
+    } else {
+        batch.resize(an_output.cols());
+        for (std::size_t col = 0; col < an_output.cols(); col++) {
+            batch[col].assign(an_output.col(col), an_output.col(col) + an_output.rows());
+        }
+    }
+    run_steps(std::move(batch), false);
+}
+
+void FeaturePipeline::apply(const SpikeTrains &spikes) {
+    if (!rate_) {
+        throw std::invalid_argument("Spike trains need the feature r first");
+    }
+    std::vector<Frame> batch;
+    rate_->apply(spikes, batch);
+    run_steps(std::move(batch), false);
+}
+
+void FeaturePipeline::finish() {
+    run_steps(std::vector<Frame>(), true);
+}
+
+void FeaturePipeline::run_steps(std::vector<Frame> batch, bool last) {
+    for (auto &step : steps_) {
+        if (last) {
+            step->finish(batch);
+        } else {
+            step->apply(batch);
+        }
+    }
+    frames.assign(batch.empty() ? 0 : batch[0].size(), batch.size());
+    for (std::size_t col = 0; col < batch.size(); col++) {
+        if (batch[col].size() != frames.rows()) {
+            throw std::invalid_argument("Features: frames of different sizes");
+        }
+        std::copy(batch[col].begin(), batch[col].end(), frames.col(col));
+    }
+}
+
+template void FeaturePipeline::apply(const BasicMatrix<double> &);
+template void FeaturePipeline::apply(const BasicMatrix<float> &);
+
+} // namespace earing
@@ -0,0 +1,180 @@
+#include "earing/filters.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+
+namespace earing {
+
+namespace {
+
+using cplx = std::complex<double>;
+
+const double pi = 3.14159265358979323846;
+
+/* Coefficients (highest power first) of the monic polynomial with given roots */
+std::vector<double> poly(const std::vector<cplx> &roots) {
+    std::vector<cplx> c(1, cplx(1.0, 0.0));
+    for (const cplx &r : roots) {
+        c.push_back(cplx(0.0, 0.0));
+        for (std::size_t k = c.size() - 1; k > 0; k--) {
+            c[k] -= r * c[k - 1];
+        }
+    }
+    std::vector<double> out(c.size());
+    for (std::size_t k = 0; k < c.size(); k++) {
+        out[k] = c[k].real();  /* roots come in conjugate pairs */
+    }
+    return out;
+}
+
+/* Poles of the analog Butterworth prototype (cutoff 1 rad/s) */
+std::vector<cplx> butter_prototype_poles(int order) {
+    std::vector<cplx> p;
+    for (int k = 1; k <= order; k++) {
+        p.push_back(std::polar(1.0, pi * (2.0 * k + order - 1) / (2.0 * order)));
+    }
+    return p;
+}
+
+/* Bilinear transform of an analog zpk system (Matlab uses fs = 2 in butter) */
+IirCoefficients bilinear(std::vector<cplx> z, std::vector<cplx> p, double k) {
+    const double fs2 = 4.0;  /* 2 * fs */
+    cplx num(1.0, 0.0), den(1.0, 0.0);
+    for (const cplx &zz : z) { num *= fs2 - zz; }
+    for (const cplx &pp : p) { den *= fs2 - pp; }
+    for (cplx &zz : z) { zz = (fs2 + zz) / (fs2 - zz); }
+    for (cplx &pp : p) { pp = (fs2 + pp) / (fs2 - pp); }
+    while (z.size() < p.size()) {
+        z.push_back(cplx(-1.0, 0.0));  /* zeros at infinity */
+    }
+    double gain = k * (num / den).real();
+
+    IirCoefficients coefficients;
+    coefficients.b = poly(z);
+    for (double &b : coefficients.b) { b *= gain; }
+    coefficients.a = poly(p);
+    return coefficients;
+}
+
+double prewarp(double wn) {
+    if (!(wn > 0.0 && wn < 1.0)) {
+        throw std::invalid_argument("butter: cutoff frequencies must be within (0, 1)");
+    }
+    return 4.0 * std::tan(pi * wn / 2.0);
+}
+
+} // namespace
+
+IirFilter::IirFilter(const IirCoefficients &coefficients)
+    : b_(coefficients.b), a_(coefficients.a) {
+    std::size_t n = std::max(b_.size(), a_.size());
+    if (a_.empty() || a_[0] == 0.0) {
+        throw std::invalid_argument("IirFilter: a(1) must be nonzero");
+    }
+    b_.resize(n, 0.0);
+    a_.resize(n, 0.0);
+    double a0 = a_[0];
+    for (std::size_t k = 0; k < n; k++) {
+        b_[k] /= a0;
+        a_[k] /= a0;
+    }
+    state_.assign(n, 0.0);
+}
+
+void IirFilter::apply(const double *input, double *output, std::size_t n) {
+    std::size_t order = b_.size() - 1;
+    for (std::size_t t = 0; t < n; t++) {
+        double x = input[t];
+        double y = b_[0] * x + state_[0];
+        for (std::size_t k = 1; k <= order; k++) {
+            state_[k - 1] = state_[k] + b_[k] * x - a_[k] * y;
+        }
+        output[t] = y;
+    }
+}
+
+void IirFilter::reset() {
+    std::fill(state_.begin(), state_.end(), 0.0);
+}
+
+IirFilterBank::IirFilterBank(const std::vector<IirCoefficients> &coefficients, int cascade)
+    : lanes_(coefficients.size()), cascade_(cascade) {
+    std::vector<IirFilter> filters(coefficients.begin(), coefficients.end());
+    for (const IirFilter &f : filters) {
+        order_ = std::max(order_, f.b_.size() - 1);
+    }
+    b_.assign((order_ + 1) * lanes_, 0.0);
+    a_.assign((order_ + 1) * lanes_, 0.0);
+    for (std::size_t lane = 0; lane < lanes_; lane++) {
+        /* Normalised coefficients, zero-padded to the common order */
+        for (std::size_t k = 0; k < filters[lane].b_.size(); k++) {
+            b_[k * lanes_ + lane] = filters[lane].b_[k];
+            a_[k * lanes_ + lane] = filters[lane].a_[k];
+        }
+    }
+    state_.assign(cascade_ * (order_ + 1) * lanes_, 0.0);
+    y_.assign(lanes_, 0.0);
+}
+
+void IirFilterBank::step(double *x, std::size_t l0, std::size_t l1) {
+    const std::size_t n = lanes_;
+    double *y = y_.data();
+    for (int s = 0; s < cascade_; s++) {
+        double *z = &state_[s * (order_ + 1) * n];
+        for (std::size_t lane = l0; lane < l1; lane++) {
+            y[lane] = b_[lane] * x[lane] + z[lane];
+        }
+        for (std::size_t k = 1; k <= order_; k++) {
+            const double *bk = &b_[k * n], *ak = &a_[k * n];
+            double *z_prev = &z[(k - 1) * n];
+            const double *z_k = &z[k * n];
+            for (std::size_t lane = l0; lane < l1; lane++) {
+                z_prev[lane] = z_k[lane] + bk[lane] * x[lane] - ak[lane] * y[lane];
+            }
+        }
+        std::copy(y + l0, y + l1, x + l0);
+    }
+}
+
+void IirFilterBank::reset() {
+    std::fill(state_.begin(), state_.end(), 0.0);
+}
+
+IirCoefficients butter_lowpass(int order, double wn) {
+    if (order < 1) {
+        throw std::invalid_argument("butter: order must be positive");
+    }
+    double u = prewarp(wn);
+    std::vector<cplx> p = butter_prototype_poles(order);
+    for (cplx &pp : p) { pp *= u; }
+    return bilinear({}, p, std::pow(u, order));
+}
+
+IirCoefficients butter_bandpass(int order, double w1, double w2) {
+    if (order < 1) {
+        throw std::invalid_argument("butter: order must be positive");
+    }
+    if (w1 >= w2) {
+        throw std::invalid_argument("butter: band edges must be increasing");
+    }
+    double u1 = prewarp(w1);
+    double u2 = prewarp(w2);
+    double bw = u2 - u1;
+    double w0_sq = u1 * u2;
+
+    /* Low-pass to band-pass: each prototype pole becomes the two roots of
+     * s^2 - p * bw * s + w0^2, and order zeros appear at the origin */
+    std::vector<cplx> p;
+    for (const cplx &pp : butter_prototype_poles(order)) {
+        cplx half = pp * bw / 2.0;
+        cplx root = std::sqrt(half * half - w0_sq);
+        p.push_back(half + root);
+        p.push_back(half - root);
+    }
+    std::vector<cplx> z(order, cplx(0.0, 0.0));
+    return bilinear(z, p, std::pow(bw, order));
+}
+
+} // namespace earing
@@ -0,0 +1,231 @@
+#include "earing/htk.hpp"
+
+#include "earing/mapped_file.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+namespace earing {
+
+namespace {
+
+const std::size_t header_bytes = 12;
+
+std::uint32_t get_be32(const unsigned char *p) {
+    return (std::uint32_t)p[0] << 24 | (std::uint32_t)p[1] << 16 | (std::uint32_t)p[2] << 8 | p[3];
+}
+
+std::uint16_t get_be16(const unsigned char *p) {
+    return (std::uint16_t)(p[0] << 8 | p[1]);
+}
+
+float get_float(const unsigned char *p) {
+    std::uint32_t u = get_be32(p);
+    float f;
+    std::memcpy(&f, &u, 4);
+    return f;
+}
+
+void put_be32(unsigned char *p, std::uint32_t v) {
+    p[0] = (unsigned char)(v >> 24);
+    p[1] = (unsigned char)(v >> 16);
+    p[2] = (unsigned char)(v >> 8);
+    p[3] = (unsigned char)v;
+}
+
+void put_be16(unsigned char *p, std::uint16_t v) {
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char)v;
+}
+
+void put_float(unsigned char *p, float f) {
+    std::uint32_t u;
+    std::memcpy(&u, &f, 4);
+    put_be32(p, u);
+}
+
+HtkHeader parse_header(const unsigned char *p, const std::string &path) {
+    HtkHeader header;
+    std::int32_t n_samples = (std::int32_t)get_be32(p);
+    header.samp_period = (std::int32_t)get_be32(p + 4);
+    int samp_size = (std::int16_t)get_be16(p + 8);
+    header.parm_kind = (std::int16_t)get_be16(p + 10);
+    int bytes = header.compressed() ? 2 : 4;
+    int extra = header.compressed() ? 4 : 0;
+    if (samp_size <= 0 || samp_size % bytes != 0 || n_samples < extra) {
+        throw std::runtime_error("Not an HTK file: " + path);
+    }
+    header.n_features = (std::size_t)(samp_size / bytes);
+    header.n_frames = (std::size_t)(n_samples - extra);
+    return header;
+}
+
+void encode_header(unsigned char *p, const HtkHeader &header) {
+    std::size_t bytes = header.compressed() ? 2 : 4;
+    std::size_t extra = header.compressed() ? 4 : 0;
+    put_be32(p, (std::uint32_t)(header.n_frames + extra));
+    put_be32(p + 4, (std::uint32_t)header.samp_period);
+    put_be16(p + 8, (std::uint16_t)(bytes * header.n_features));
+    put_be16(p + 10, (std::uint16_t)header.parm_kind);
+}
+
+void write_bytes(FILE *file, const std::vector<unsigned char> &bytes, const std::string &path) {
+    if (std::fwrite(bytes.data(), 1, bytes.size(), file) != bytes.size()) {
+        throw std::runtime_error("Unable to write to file " + path);
+    }
+}
+
+/* Compression of htkwrite.m: A = 2 * 32767 / (xmax - xmin), B = (xmax + xmin)
+ * * 32767 / (xmax - xmin), x -> round(A x - B), A and B being stored as float */
+std::vector<unsigned char> compress(const double *frames, std::size_t n_features, std::size_t n_frames) {
+    std::vector<double> A(n_features), B(n_features);
+    for (std::size_t f = 0; f < n_features; f++) {
+        double xmax = -INFINITY, xmin = INFINITY;
+        for (std::size_t t = 0; t < n_frames; t++) {
+            xmax = std::max(xmax, frames[f + t * n_features]);
+            xmin = std::min(xmin, frames[f + t * n_features]);
+        }
+        if (xmax > xmin) {
+            A[f] = 2 * 32767 / (xmax - xmin);
+            B[f] = (xmax + xmin) * 32767 / (xmax - xmin);
+        } else {
+            /* Constant (or no) frames: every value is encoded as 0 = B */
+            A[f] = 1;
+            B[f] = n_frames > 0 ? xmin : 0;
+        }
+    }
+    std::vector<unsigned char> bytes(8 * n_features + 2 * n_features * n_frames);
+    unsigned char *p = bytes.data();
+    for (std::size_t f = 0; f < n_features; f++, p += 4) {
+        put_float(p, (float)A[f]);
+    }
+    for (std::size_t f = 0; f < n_features; f++, p += 4) {
+        put_float(p, (float)B[f]);
+    }
+    for (std::size_t k = 0; k < n_features * n_frames; k++, p += 2) {
+        std::size_t f = k % n_features;
+        double x = std::round(A[f] * frames[k] - B[f]);
+        x = std::min(32767.0, std::max(-32768.0, x));
+        put_be16(p, (std::uint16_t)(std::int16_t)x);
+    }
+    return bytes;
+}
+
+std::vector<unsigned char> encode_floats(const double *frames, std::size_t n) {
+    std::vector<unsigned char> bytes(4 * n);
+    for (std::size_t k = 0; k < n; k++) {
+        put_float(bytes.data() + 4 * k, (float)frames[k]);
+    }
+    return bytes;
+}
+
+} // namespace
+
+HtkHeader read_htk_header(const std::string &path) {
+    unsigned char p[header_bytes];
+    FILE *file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        throw std::runtime_error("Unable to read from file " + path);
+    }
+    std::size_t n = std::fread(p, 1, header_bytes, file);
+    std::fclose(file);
+    if (n != header_bytes) {
+        throw std::runtime_error("Not an HTK file: " + path);
+    }
+    return parse_header(p, path);
+}
+
+Matrix read_htk(const std::string &path, HtkHeader *header) {
+    MappedFile file(path);
+    if (file.size() < header_bytes) {
+        throw std::runtime_error("Not an HTK file: " + path);
+    }
+    HtkHeader h = parse_header(file.data(), path);
+    std::size_t n = h.n_features * h.n_frames;
+    std::size_t expected = header_bytes + (h.compressed() ? 8 * h.n_features + 2 * n : 4 * n);
+    if (file.size() < expected) {
+        throw std::runtime_error("Truncated HTK file: " + path);
+    }
+    Matrix features(h.n_features, h.n_frames);
+    const unsigned char *p = file.data() + header_bytes;
+    double *out = features.data();
+    if (h.compressed()) {
+        std::vector<double> A(h.n_features), B(h.n_features);
+        for (std::size_t f = 0; f < h.n_features; f++) {
+            A[f] = get_float(p + 4 * f);
+            B[f] = get_float(p + 4 * (h.n_features + f));
+        }
+        p += 8 * h.n_features;
+        for (std::size_t k = 0; k < n; k++) {
+            std::size_t f = k % h.n_features;
+            out[k] = (B[f] + (std::int16_t)get_be16(p + 2 * k)) / A[f];
+        }
+    } else {
+        for (std::size_t k = 0; k < n; k++) {
+            out[k] = get_float(p + 4 * k);
+        }
+    }
+    if (header != nullptr) {
+        *header = h;
+    }
+    return features;
+}
+
+void write_htk(const std::string &path, const Matrix &features, int parm_kind, int samp_period) {
+    HtkWriter writer(path, parm_kind, samp_period);
+    writer.write(features);
+    writer.close();
+}
+
+HtkWriter::HtkWriter(const std::string &path, int parm_kind, int samp_period)
+    : path_(path), file_(new AtomicFile(path)) {
+    header_.parm_kind = parm_kind;
+    header_.samp_period = samp_period;
+    /* Rewritten by close() */
+    write_bytes(file_->get(), std::vector<unsigned char>(header_bytes, 0), path_);
+}
+
+HtkWriter::~HtkWriter() = default;
+
+void HtkWriter::write(const Matrix &frames) {
+    if (!file_) {
+        throw std::runtime_error("HTK file already closed: " + path_);
+    }
+    if (frames.cols() == 0) {
+        return;
+    }
+    if (header_.n_frames == 0) {
+        header_.n_features = frames.rows();
+    } else if (frames.rows() != header_.n_features) {
+        throw std::invalid_argument("HTK file " + path_ + ": the number of features changed");
+    }
+    header_.n_frames += frames.cols();
+    if (header_.compressed()) {
+        held_.insert(held_.end(), frames.data(), frames.data() + frames.size());
+    } else {
+        write_bytes(file_->get(), encode_floats(frames.data(), frames.size()), path_);
+    }
+}
+
+void HtkWriter::close() {
+    if (!file_) {
+        return;
+    }
+    std::unique_ptr<AtomicFile> file = std::move(file_);
+    if (header_.compressed()) {
+        write_bytes(file->get(), compress(held_.data(), header_.n_features, header_.n_frames), path_);
+        std::vector<double>().swap(held_);
+    }
+    std::vector<unsigned char> head(header_bytes);
+    encode_header(head.data(), header_);
+    if (std::fseek(file->get(), 0, SEEK_SET) != 0) {
+        throw std::runtime_error("Unable to write to file " + path_);
+    }
+    write_bytes(file->get(), head, path_);
+    file->commit();
+}
+
+} // namespace earing
@@ -0,0 +1,108 @@
+#include "earing/ihc_cilia.hpp"
+
+#include "earing/parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace earing {
+
+template <typename T>
+void BasicIhcCilia<T>::init_restingV() {
+    C_s = std::pow(10.0, C / 20);
+    Ga = G0 - Gmax / (1 + std::exp(u0 / s0) * (1 + std::exp(u1 / s1)));
+    restingCiliaCond = Ga + Gmax / (1 + std::exp(u0 / s0) * (1 + std::exp(u1 / s1)));
+    Ekp = Ek + Et * Rpc;
+    double Gu0 = restingCiliaCond;
+    restingV = (Gk * Ekp + Gu0 * Et) / (Gu0 + Gk);
+}
+
+template <typename T>
+void BasicIhcCilia<T>::init(std::size_t n_BFs, double fs) {
+    dt = 1 / fs;
+    uNow.assign(n_BFs, 0.0);
+    IHC_Vnow.assign(n_BFs, restingV);
+}
+
+template <typename T>
+void BasicIhcCilia<T>::run(const BasicMatrix<T> &bm_velocity, double fs) {
+    init(bm_velocity.rows(), fs);
+    apply(bm_velocity);
+}
+
+template <typename T>
+void BasicIhcCilia<T>::apply(const BasicMatrix<T> &bm_velocity) {
+    std::size_t n_BFs = bm_velocity.rows();
+    std::size_t signal_length = bm_velocity.cols();
+
+    receptor_potential.assign(n_BFs, signal_length);
+    if (keep_intermediates) {
+        cilia_displacement.assign(n_BFs, signal_length);
+        Gu.assign(n_BFs, signal_length);
+    } else {
+        cilia_displacement.clear();
+        Gu.clear();
+    }
+
+    /* Rows are independent: spread them across threads when there are enough,
+     * otherwise split time (e.g. a single BF over a long stimulus) */
+    const std::size_t kRowAlign = 8;
+    const std::size_t threads = (std::size_t)(n_threads > 0 ? n_threads : num_threads());
+    if (n_BFs >= kRowAlign * threads || threads == 1) {
+        parallel_for(
+            n_BFs,
+            [&](std::size_t r0, std::size_t r1) {
+                run_kernel(bm_velocity, r0, r1, 0, signal_length, uNow.data(), IHC_Vnow.data());
+            },
+            n_threads, kRowAlign, kRowAlign);
+        return;
+    }
+    std::vector<double> state(uNow);
+    state.insert(state.end(), IHC_Vnow.begin(), IHC_Vnow.end());
+    parallel_in_time(
+        state, signal_length,
+        [&](double *s, std::size_t c0, std::size_t c1) { run_kernel(bm_velocity, 0, n_BFs, c0, c1, s, s + n_BFs); },
+        n_threads);
+    std::copy(state.begin(), state.begin() + n_BFs, uNow.begin());
+    std::copy(state.begin() + n_BFs, state.end(), IHC_Vnow.begin());
+}
+
+template <typename T>
+void BasicIhcCilia<T>::run_kernel(const BasicMatrix<T> &bm_velocity, std::size_t r0, std::size_t r1, std::size_t c0,
+                                  std::size_t c1, double *u, double *V) {
+    const std::size_t n_BFs = bm_velocity.rows();
+    const double cParam = 1 - dt / tc;
+    /* Per-sample terms in the sample type, the state u and V in double */
+    const T dt_ = (T)dt, C_s_ = (T)C_s, Ga_ = (T)Ga, Gmax_ = (T)Gmax, u0_ = (T)u0, s0_ = (T)s0, u1_ = (T)u1,
+            s1_ = (T)s1, Gk_ = (T)Gk, Et_ = (T)Et, Ekp_ = (T)Ekp, Cab_ = (T)Cab;
+    const T *vel = bm_velocity.data();
+    T *rp = receptor_potential.data();
+    T *cd = keep_intermediates ? cilia_displacement.data() : nullptr;
+    T *gu = keep_intermediates ? Gu.data() : nullptr;
+    for (std::size_t col = c0; col < c1; col++) {
+        const std::size_t offset = col * n_BFs;
+        for (std::size_t row = r0; row < r1; row++) {
+            /* Cilia displacement: u = u * (1 - dt / tc) + dt * C_s * velocity */
+            double ui = u[row] * cParam + dt_ * vel[offset + row] * C_s_;
+            /* Apical conductance (Boltzmann function) */
+            T x = (T)ui;
+            T g = Ga_ + Gmax_ / (1 + std::exp(-(x - u0_) / s0_) * (1 + std::exp(-(x - u1_) / s1_)));
+            /* Receptor potential */
+            T leak = (-Gk_ - g) * dt_ / Cab_;
+            T drive = (g * Et_ + Gk_ * Ekp_) * dt_ / Cab_;
+            double v = V[row] * (1 + (double)leak) + drive;
+            u[row] = ui;
+            V[row] = v;
+            rp[offset + row] = (T)v;
+            if (cd) {
+                cd[offset + row] = x;
+                gu[offset + row] = g;
+            }
+        }
+    }
+}
+
+template class BasicIhcCilia<double>;
+template class BasicIhcCilia<float>;
+
+} // namespace earing
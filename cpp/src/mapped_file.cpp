@@ -0,0 +1,55 @@
+#include "earing/mapped_file.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace earing {
+
+MappedFile::MappedFile(const std::string &path) {
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = ::open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) != 0) {
+        if (fd >= 0) { ::close(fd); }
+        throw std::runtime_error("Unable to read from file " + path);
+    }
+    size_ = (std::size_t)st.st_size;
+    if (size_ > 0) {
+        void *p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            ::madvise(p, size_, MADV_SEQUENTIAL);
+            data_ = (const unsigned char *)p;
+        }
+    }
+    ::close(fd);
+    if (data_ != nullptr || size_ == 0) {
+        return;
+    }
+#endif
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Unable to read from file " + path);
+    }
+    copy_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    size_ = copy_.size();
+    data_ = copy_.data();
+    mapped_ = false;
+}
+
+MappedFile::~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+    if (mapped_ && data_ != nullptr) {
+        ::munmap((void *)data_, size_);
+    }
+#endif
+}
+
+} // namespace earing
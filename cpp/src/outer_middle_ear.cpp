@@ -0,0 +1,46 @@
+#include "earing/outer_middle_ear.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace earing {
+
+void OuterMiddleEar::init_external_filters(double fs) {
+    double nyquist = fs / 2;
+    double max_upper = 0.0;
+    for (const auto &f : externalResonanceFilters) {
+        max_upper = std::max(max_upper, f[3]);
+    }
+
+    external_filters_.clear();
+    gain_scalar_.clear();
+    for (const auto &f : externalResonanceFilters) {
+        double upper = nyquist < max_upper ? nyquist - 1 : f[3];
+        external_filters_.emplace_back(butter_bandpass((int)f[1], f[2] / nyquist, upper / nyquist));
+        gain_scalar_.push_back(std::pow(10.0, f[0] / 20));
+    }
+}
+
+void OuterMiddleEar::run(const double *stimulus, std::size_t n, double fs) {
+    init_external_filters(fs);
+    stapes_velocity.resize(n);
+    apply_filters(stimulus, stapes_velocity.data(), n);
+}
+
+void OuterMiddleEar::apply_filters(const double *stimulus, double *velocity, std::size_t n) {
+    std::copy(stimulus, stimulus + n, velocity);
+    for (std::size_t k = 0; k < external_filters_.size(); k++) {
+        external_filters_[k].apply(velocity, velocity, n);
+        double gain = gain_scalar_[k] * (k + 1 == external_filters_.size() ? stapes_scalar : 1.0);
+        for (std::size_t t = 0; t < n; t++) {
+            velocity[t] *= gain;
+        }
+    }
+    if (external_filters_.empty()) {
+        for (std::size_t t = 0; t < n; t++) {
+            velocity[t] *= stapes_scalar;
+        }
+    }
+}
+
+} // namespace earing
@@ -0,0 +1,83 @@
+#include "earing/parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace earing {
+
+namespace {
+
+int initial_num_threads() {
+    const char *env = std::getenv("EARING_NUM_THREADS");
+    if (env != nullptr && std::atoi(env) > 0) {
+        return std::atoi(env);
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+std::atomic<int> default_num_threads(initial_num_threads());
+
+} // namespace
+
+int num_threads() {
+    return default_num_threads.load();
+}
+
+void set_num_threads(int n_threads) {
+    default_num_threads = n_threads > 0 ? n_threads : initial_num_threads();
+}
+
+void parallel_for(std::size_t n, const std::function<void(std::size_t begin, std::size_t end)> &body,
+                  int n_threads, std::size_t grain, std::size_t align) {
+    if (n == 0) {
+        return;
+    }
+    std::size_t threads = (std::size_t)(n_threads > 0 ? n_threads : num_threads());
+    threads = std::min(threads, std::max<std::size_t>(1, n / std::max<std::size_t>(grain, 1)));
+    if (threads <= 1) {
+        body(0, n);
+        return;
+    }
+
+    /* Range boundaries, rounded to multiples of align */
+    std::vector<std::size_t> bounds(threads + 1, n);
+    for (std::size_t k = 0; k < threads; k++) {
+        std::size_t b = n * k / threads;
+        bounds[k] = std::min(n, (b + align - 1) / align * align);
+    }
+
+    std::vector<std::thread> workers;
+    std::vector<std::exception_ptr> errors(threads);
+    for (std::size_t k = 1; k < threads; k++) {
+        if (bounds[k] < bounds[k + 1]) {
+            workers.emplace_back([&, k]() {
+                try {
+                    body(bounds[k], bounds[k + 1]);
+                } catch (...) {
+                    errors[k] = std::current_exception();
+                }
+            });
+        }
+    }
+    try {
+        if (bounds[0] < bounds[1]) {
+            body(bounds[0], bounds[1]);
+        }
+    } catch (...) {
+        errors[0] = std::current_exception();
+    }
+    for (std::thread &w : workers) {
+        w.join();
+    }
+    for (std::exception_ptr &e : errors) {
+        if (e) {
+            std::rethrow_exception(e);
+        }
+    }
+}
+
+} // namespace earing
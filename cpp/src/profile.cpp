@@ -0,0 +1,76 @@
+#include "earing/profile.hpp"
+
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+namespace earing {
+
+void Profile::record(const char *stage, double seconds, std::size_t samples, std::size_t bytes) {
+    StageProfile *s = nullptr;
+    for (StageProfile &p : stages) {
+        if (p.stage == stage) {
+            s = &p;
+            break;
+        }
+    }
+    if (s == nullptr) {
+        stages.emplace_back();
+        s = &stages.back();
+        s->stage = stage;
+    }
+    s->calls++;
+    s->seconds += seconds;
+    s->samples += samples;
+    s->bytes = bytes;
+    s->peak_rss = peak_resident_set();
+}
+
+void Profile::print(FILE *out) const {
+    std::fprintf(out, "%-18s %6s %10s %12s %12s %12s\n", "stage", "calls", "seconds", "samples/s", "MB", "peak RSS MB");
+    for (const StageProfile &s : stages) {
+        std::fprintf(out, "%-18s %6zu %10.4f %12.4g %12.2f %12.2f\n", s.stage.c_str(), s.calls, s.seconds,
+                     s.samples_per_second(), s.bytes / 1048576.0, s.peak_rss / 1048576.0);
+    }
+}
+
+void Profile::append_csv(const std::string &path, const std::string &label) const {
+    /* Header for a new or empty file (the position of a stream opened with "a"
+     * is implementation-defined until the first write) */
+    std::error_code error;
+    bool new_file = std::filesystem::file_size(path, error) == 0 || error;
+    FILE *file = std::fopen(path.c_str(), "a");
+    if (file == nullptr) {
+        throw std::runtime_error("Unable to write to file " + path);
+    }
+    if (new_file) {
+        std::fprintf(file, "label,stage,calls,seconds,samples,samples_per_second,bytes,peak_rss\n");
+    }
+    for (const StageProfile &s : stages) {
+        std::fprintf(file, "%s,%s,%zu,%.6g,%zu,%.6g,%zu,%zu\n", label.c_str(), s.stage.c_str(), s.calls, s.seconds,
+                     s.samples, s.samples_per_second(), s.bytes, s.peak_rss);
+    }
+    std::fclose(file);
+}
+
+std::size_t peak_resident_set() {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return (std::size_t)usage.ru_maxrss;          /* bytes */
+#else
+    return (std::size_t)usage.ru_maxrss * 1024;   /* kilobytes */
+#endif
+#else
+    return 0;
+#endif
+}
+
+} // namespace earing
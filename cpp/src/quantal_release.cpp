@@ -0,0 +1,145 @@
+#include "earing/quantal_release.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "earing/parallel.hpp"
+
+namespace earing {
+
+namespace {
+
+/* a to the power n, n a small non-negative integer (intpow) */
+double intpow(double a, unsigned n) {
+    double result = 1;
+    for (; n > 0; n >>= 1, a *= a) {
+        if (n & 1) { result *= a; }
+    }
+    return result;
+}
+
+/* Binomial random variable B(floor(n), p), by inversion of its distribution:
+ * a single uniform, and usually a single term as n * p is small */
+double binomial(RandomStream &rng, double n, double p) {
+    if (!(n >= 1) || !(p > 0)) {
+        return 0;
+    }
+    unsigned trials = (unsigned)n;
+    if (p >= 1) {
+        return trials;
+    }
+    double u = rng.uniform();
+    double pk = intpow(1 - p, trials), cdf = pk;
+    unsigned k = 0;
+    while (u > cdf && k < trials) {
+        pk *= (double)(trials - k) / (k + 1) * p / (1 - p);
+        cdf += pk;
+        k++;
+    }
+    return k;
+}
+
+/* Calculate a random refractory period */
+std::size_t getRefractoryPeriod(RandomStream &rng, int AbsRefInt) {
+    return (std::size_t)(AbsRefInt + std::floor(rng.uniform() * AbsRefInt));
+}
+
+} // namespace
+
+QuantalRelease::QuantalRelease(std::size_t rows, int n_fibers, const double *available, const double *cleft,
+                               const double *reprocess, double M, const double *xdt, const double *ydt,
+                               const double *rdt_plus_ldt, const double *rdt, int abs_refractory_bins,
+                               std::uint64_t seed, std::uint64_t first_stream, int n_threads)
+    : rows_(rows), n_fibers_(n_fibers), M_(M), xdt_(xdt, xdt + rows), ydt_(ydt, ydt + rows),
+      rdt_plus_ldt_(rdt_plus_ldt, rdt_plus_ldt + rows), rdt_(rdt, rdt + rows),
+      abs_refractory_bins_(abs_refractory_bins), n_threads_(n_threads), dead_bins_(rows * n_fibers, 0) {
+    const std::size_t n_rows = rows * n_fibers;
+    available_.resize(n_rows);
+    cleft_.resize(n_rows);
+    reprocess_.resize(n_rows);
+    streams_.reserve(n_rows);
+    for (std::size_t fiber = 0; fiber < n_rows; fiber++) {
+        available_[fiber] = available[fiber / n_fibers];
+        cleft_[fiber] = cleft[fiber / n_fibers];
+        reprocess_[fiber] = reprocess[fiber / n_fibers];
+        streams_.emplace_back(seed, first_stream + fiber);
+    }
+}
+
+template <typename T>
+void QuantalRelease::fiber_spikes(const T *release_prob, std::size_t cols, std::size_t fiber,
+                                  std::vector<std::size_t> &frames) {
+    const std::size_t row = fiber / n_fibers_;
+    const double xdt = xdt_[row], ydt = ydt_[row], rdt_plus_ldt = rdt_plus_ldt_[row], rdt = rdt_[row];
+    const bool refractory = abs_refractory_bins_ >= 1;
+    RandomStream &rng = streams_[fiber];
+    double available = available_[fiber], cleft = cleft_[fiber], reprocess = reprocess_[fiber];
+    std::size_t alive_from = dead_bins_[fiber];
+
+    for (std::size_t col = 0; col < cols; col++) {
+        /* Number of missing vesicles (non-negative) */
+        double M_q = std::max(M_ - available, 0.0);
+
+        double replenish    = binomial(rng, M_q, ydt);
+        double ejected      = binomial(rng, available, release_prob[row + col * rows_]);
+        double reuptakelost = rdt_plus_ldt * cleft;
+        double reuptake     = rdt * cleft;
+        double reprocessed  = binomial(rng, reprocess, xdt);
+
+        available = available + replenish - ejected + reprocessed;
+        cleft     = cleft + ejected - reuptakelost;
+        reprocess = reprocess + reuptake - reprocessed;
+
+        if (ejected > 0 && col >= alive_from) {
+            frames.push_back(col);
+            if (refractory) {
+                alive_from = col + 1 + getRefractoryPeriod(rng, abs_refractory_bins_);
+            }
+        }
+    }
+
+    available_[fiber] = available;
+    cleft_[fiber] = cleft;
+    reprocess_[fiber] = reprocess;
+    /* Refractory bins carried over to the next block */
+    dead_bins_[fiber] = alive_from > cols ? alive_from - cols : 0;
+}
+
+template <typename T>
+void QuantalRelease::apply(const T *release_prob, std::size_t cols, SpikeTrains &trains) {
+    const std::size_t n_rows = streams_.size();
+
+    /* Fibers are split in parts simulated independently, then concatenated */
+    const std::size_t n_parts = std::min<std::size_t>(n_rows, 4 * (n_threads_ > 0 ? n_threads_ : num_threads()));
+    std::vector<std::vector<std::size_t>> part_frames(n_parts);
+    trains.n_fibers = n_rows;
+    trains.n_frames = cols;
+    trains.fiber_start.assign(n_rows + 1, 0);
+    parallel_for(
+        n_parts,
+        [&](std::size_t p0, std::size_t p1) {
+            for (std::size_t part = p0; part < p1; part++) {
+                for (std::size_t fiber = n_rows * part / n_parts; fiber < n_rows * (part + 1) / n_parts; fiber++) {
+                    fiber_spikes(release_prob, cols, fiber, part_frames[part]);
+                    trains.fiber_start[fiber + 1] = part_frames[part].size();
+                }
+            }
+        },
+        n_threads_);
+
+    /* fiber_start holds the end of each fiber within its part */
+    std::size_t offset = 0;
+    trains.frames.clear();
+    for (std::size_t part = 0; part < n_parts; part++) {
+        for (std::size_t fiber = n_rows * part / n_parts; fiber < n_rows * (part + 1) / n_parts; fiber++) {
+            trains.fiber_start[fiber + 1] += offset;
+        }
+        offset += part_frames[part].size();
+        trains.frames.insert(trains.frames.end(), part_frames[part].begin(), part_frames[part].end());
+    }
+}
+
+template void QuantalRelease::apply(const double *, std::size_t, SpikeTrains &);
+template void QuantalRelease::apply(const float *, std::size_t, SpikeTrains &);
+
+} // namespace earing
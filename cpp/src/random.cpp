@@ -0,0 +1,78 @@
+#include "earing/random.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <random>
+
+namespace earing {
+
+/* Each round is applied to all the lanes in turn, so that the compiler runs
+ * them in SIMD registers. The library is built for the baseline instruction
+ * set: on x86-64, this is also compiled for AVX2 and AVX-512, one of them being
+ * chosen when the library is loaded, according to the CPU. Not inlined, as its
+ * arrays would then be turned into scalars */
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__ELF__)
+__attribute__((target_clones("avx512f", "avx2", "default")))
+#endif
+void philox4x32_lanes(std::uint64_t seed, std::uint64_t stream, std::uint64_t first,
+                      std::uint32_t w[4][kPhiloxLanes]) {
+    std::uint32_t c0[kPhiloxLanes], c1[kPhiloxLanes], c2[kPhiloxLanes], c3[kPhiloxLanes];
+    for (std::size_t lane = 0; lane < kPhiloxLanes; lane++) {
+        c0[lane] = (std::uint32_t)(first + lane);
+        c1[lane] = (std::uint32_t)((first + lane) >> 32);
+        c2[lane] = (std::uint32_t)stream;
+        c3[lane] = (std::uint32_t)(stream >> 32);
+    }
+    std::uint32_t k0 = (std::uint32_t)seed, k1 = (std::uint32_t)(seed >> 32);
+    for (int round = 0; round < 10; round++) {
+        for (std::size_t lane = 0; lane < kPhiloxLanes; lane++) {
+            std::uint64_t p0 = (std::uint64_t)0xD2511F53u * c0[lane];
+            std::uint64_t p1 = (std::uint64_t)0xCD9E8D57u * c2[lane];
+            std::uint32_t hi0 = (std::uint32_t)(p0 >> 32), lo0 = (std::uint32_t)p0;
+            std::uint32_t hi1 = (std::uint32_t)(p1 >> 32), lo1 = (std::uint32_t)p1;
+            c0[lane] = hi1 ^ c1[lane] ^ k0;
+            c1[lane] = lo1;
+            c2[lane] = hi0 ^ c3[lane] ^ k1;
+            c3[lane] = lo0;
+        }
+        k0 += 0x9E3779B9u;
+        k1 += 0xBB67AE85u;
+    }
+    for (std::size_t lane = 0; lane < kPhiloxLanes; lane++) {
+        w[0][lane] = c0[lane];
+        w[1][lane] = c1[lane];
+        w[2][lane] = c2[lane];
+        w[3][lane] = c3[lane];
+    }
+}
+
+void RandomStream::bits(std::uint64_t position, std::uint64_t *out, std::size_t n) const {
+    std::uint32_t w[4][kPhiloxLanes];
+    std::uint64_t values[2 * kPhiloxLanes];
+    std::uint64_t block = position / 2;
+    std::size_t skip = position % 2;
+    for (std::size_t k = 0; k < n; block += kPhiloxLanes) {
+        philox4x32_lanes(seed_, stream_, block, w);
+        for (std::size_t lane = 0; lane < kPhiloxLanes; lane++) {
+            values[2 * lane] = to_bits(w[0][lane], w[1][lane]);
+            values[2 * lane + 1] = to_bits(w[2][lane], w[3][lane]);
+        }
+        std::size_t m = std::min(2 * kPhiloxLanes - skip, n - k);
+        std::copy(values + skip, values + skip + m, out + k);
+        k += m;
+        skip = 0;
+    }
+}
+
+std::uint64_t random_seed() {
+    /* The call counter keeps seeds distinct even if random_device is a
+     * deterministic implementation */
+    static std::atomic<std::uint64_t> calls(0);
+    std::random_device device;
+    std::uint64_t seed = (std::uint64_t)device() << 32 | device();
+    seed ^= (std::uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+    return seed ^ (++calls * 0x9E3779B97F4A7C15ull);
+}
+
+} // namespace earing
@@ -0,0 +1,188 @@
+#include "earing/recurrence.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include "earing/parallel.hpp"
+
+namespace earing {
+
+namespace {
+
+/* Rows are handed to threads in multiples of a cache line of doubles, so that
+ * two threads never write to the same line of matrix or vector. */
+constexpr std::size_t kRowAlign = 8;
+/* Below this many elements, the cost of starting threads dominates */
+constexpr std::size_t kMinElementsPerThread = 1 << 15;
+/* Tile of rows x columns processed at once: the state of kTileRows rows stays
+ * in L1 while kTileCols frames go through it. */
+constexpr std::size_t kTileRows = 512;
+constexpr std::size_t kTileCols = 256;
+/* Up to kScanMaxRows rows, long recurrences are split in time blocks of
+ * kScanBlockCols frames instead (chosen from the shape only, so that results
+ * do not depend on the number of threads) */
+constexpr std::size_t kScanMaxRows = 16;
+constexpr std::size_t kScanBlockCols = 8192;
+
+template <CoefficientShape shape, typename T>
+inline T coefficient(const T *C, std::size_t row, std::size_t ind) {
+    return shape == CoefficientShape::Scalar ? *C : shape == CoefficientShape::Column ? C[row] : C[ind];
+}
+
+/* Rows [r0, r1) of frames [c0, c1). The inner loop is over independent rows,
+ * which the compiler vectorises. The state vector is double whatever T. */
+template <CoefficientShape shape, typename T>
+void recurrence_tile(T *__restrict matrix, double *__restrict vector, const T *__restrict C,
+                     const T *__restrict A, std::size_t rows, std::size_t r0, std::size_t r1,
+                     std::size_t c0, std::size_t c1) {
+    for (std::size_t col = c0; col < c1; col++) {
+        const std::size_t offset = col * rows;
+        for (std::size_t row = r0; row < r1; row++) {
+            const double c = coefficient<shape>(C, row, offset + row);
+            vector[row] = vector[row] * c + A[offset + row];
+            matrix[offset + row] = (T)vector[row];
+        }
+    }
+}
+
+template <CoefficientShape shape, typename T>
+void recurrence_rows(T *matrix, double *vector, const T *C, const T *A, std::size_t rows,
+                     std::size_t cols, std::size_t r0, std::size_t r1) {
+    for (std::size_t c0 = 0; c0 < cols; c0 += kTileCols) {
+        const std::size_t c1 = std::min(cols, c0 + kTileCols);
+        for (std::size_t t0 = r0; t0 < r1; t0 += kTileRows) {
+            recurrence_tile<shape, T>(matrix, vector, C, A, rows, t0, std::min(r1, t0 + kTileRows), c0, c1);
+        }
+    }
+}
+
+/* Parallel-in-time scan. The recurrence is linear: over frames [c0, c1),
+ *   v(t) = local(t) + prod_{s = c0}^{t} C(s) * v(c0 - 1)
+ * where local is the recurrence started from 0. Blocks compute local and the
+ * products in parallel, the carries v(c0 - 1) are then propagated from block to
+ * block, and finally added in parallel. */
+template <CoefficientShape shape, typename T>
+void recurrence_scan(T *matrix, double *vector, const T *C, const T *A, std::size_t rows,
+                     std::size_t cols, int n_threads) {
+    const std::size_t n_blocks = (cols + kScanBlockCols - 1) / kScanBlockCols;
+    /* carry[b * rows + row] = v(first frame of block b - 1); product over block b */
+    std::vector<double> carry((n_blocks + 1) * rows), product(n_blocks * rows, 1.0);
+    std::copy(vector, vector + rows, carry.begin());
+
+    /* Block 0 starts from the actual state and needs no correction */
+    parallel_for(
+        n_blocks,
+        [&](std::size_t b0, std::size_t b1) {
+            std::vector<double> v(rows);
+            for (std::size_t b = b0; b < b1; b++) {
+                const std::size_t c0 = b * kScanBlockCols, c1 = std::min(cols, c0 + kScanBlockCols);
+                double *p = &product[b * rows];
+                if (b == 0) {
+                    std::copy(vector, vector + rows, v.begin());
+                } else {
+                    std::fill(v.begin(), v.end(), 0.0);
+                }
+                for (std::size_t col = c0; col < c1; col++) {
+                    const std::size_t offset = col * rows;
+                    for (std::size_t row = 0; row < rows; row++) {
+                        const double c = coefficient<shape>(C, row, offset + row);
+                        v[row] = v[row] * c + A[offset + row];
+                        matrix[offset + row] = (T)v[row];
+                        p[row] *= c;
+                    }
+                }
+            }
+        },
+        n_threads);
+
+    for (std::size_t b = 0; b < n_blocks; b++) {
+        const std::size_t last = (std::min(cols, (b + 1) * kScanBlockCols) - 1) * rows;
+        for (std::size_t row = 0; row < rows; row++) {
+            carry[(b + 1) * rows + row] =
+                b == 0 ? matrix[last + row] : product[b * rows + row] * carry[b * rows + row] + matrix[last + row];
+        }
+    }
+
+    parallel_for(
+        n_blocks - 1,
+        [&](std::size_t b0, std::size_t b1) {
+            std::vector<double> p(rows);
+            for (std::size_t b = b0 + 1; b < b1 + 1; b++) {
+                const std::size_t c0 = b * kScanBlockCols, c1 = std::min(cols, c0 + kScanBlockCols);
+                const double *v0 = &carry[b * rows];
+                std::fill(p.begin(), p.end(), 1.0);
+                for (std::size_t col = c0; col < c1; col++) {
+                    const std::size_t offset = col * rows;
+                    for (std::size_t row = 0; row < rows; row++) {
+                        p[row] *= coefficient<shape>(C, row, offset + row);
+                        if (v0[row] != 0) {  /* avoids inf * 0 for diverging recurrences */
+                            matrix[offset + row] = (T)(matrix[offset + row] + p[row] * v0[row]);
+                        }
+                    }
+                }
+            }
+        },
+        n_threads);
+
+    /* The state after the last frame, before its rounding to T */
+    std::copy(carry.begin() + n_blocks * rows, carry.end(), vector);
+}
+
+template <CoefficientShape shape, typename T>
+void recurrence(T *matrix, double *vector, const T *C, const T *A, std::size_t rows,
+                std::size_t cols, int n_threads) {
+    if (rows <= kScanMaxRows && cols >= 2 * kScanBlockCols) {
+        recurrence_scan<shape, T>(matrix, vector, C, A, rows, cols, n_threads);
+        return;
+    }
+    const std::size_t grain = std::max<std::size_t>(kRowAlign, kMinElementsPerThread / cols);
+    parallel_for(
+        rows,
+        [&](std::size_t r0, std::size_t r1) {
+            recurrence_rows<shape, T>(matrix, vector, C, A, rows, cols, r0, r1);
+        },
+        n_threads, grain, kRowAlign);
+}
+
+/* The state in double: vector itself, or a copy of a float vector */
+double *double_state(double *vector, std::size_t, std::vector<double> &) {
+    return vector;
+}
+
+double *double_state(float *vector, std::size_t rows, std::vector<double> &copy) {
+    copy.assign(vector, vector + rows);
+    return copy.data();
+}
+
+} // namespace
+
+template <typename T>
+void first_order_recurrence(T *matrix, T *vector, const T *C, CoefficientShape shape, const T *A,
+                            std::size_t rows, std::size_t cols, int n_threads) {
+    if (rows == 0 || cols == 0) {
+        return;
+    }
+    std::vector<double> copy;
+    double *state = double_state(vector, rows, copy);
+    switch (shape) {
+    case CoefficientShape::Scalar:
+        recurrence<CoefficientShape::Scalar>(matrix, state, C, A, rows, cols, n_threads);
+        break;
+    case CoefficientShape::Column:
+        recurrence<CoefficientShape::Column>(matrix, state, C, A, rows, cols, n_threads);
+        break;
+    case CoefficientShape::Full:
+        recurrence<CoefficientShape::Full>(matrix, state, C, A, rows, cols, n_threads);
+        break;
+    }
+    if (!copy.empty()) {
+        std::copy(copy.begin(), copy.end(), vector);
+    }
+}
+
+template void first_order_recurrence(double *, double *, const double *, CoefficientShape, const double *,
+                                     std::size_t, std::size_t, int);
+template void first_order_recurrence(float *, float *, const float *, CoefficientShape, const float *, std::size_t,
+                                     std::size_t, int);
+
+} // namespace earing
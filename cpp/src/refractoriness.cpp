@@ -0,0 +1,209 @@
+#include "earing/refractoriness.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "earing/parallel.hpp"
+
+namespace earing {
+
+namespace {
+
+/* Rows are handed to threads in multiples of a cache line of doubles */
+constexpr std::size_t kRowAlign = 8;
+/* Rows processed together by the direct sum: the ring buffer of the block
+ * (n_W x kTileRows doubles) stays in L1 */
+constexpr std::size_t kTileRows = 16;
+/* Above this many linear pieces, the direct sum is as fast */
+constexpr std::size_t kMaxPieces = 8;
+/* Running sums are recomputed exactly every kResync frames */
+constexpr std::size_t kResync = 4096;
+
+/* A refractory function with linear relative refractory period between T & 2T */
+double refract1(double t, double T) {
+    if (t <= T) {
+        return 0;
+    }
+    if (t > 2 * T) {
+        return 1;
+    }
+    return (t - T) / T;
+}
+
+} // namespace
+
+std::vector<double> refractory_weights(double refractory_period, double dt) {
+    if (!(refractory_period > 0) || !(dt > 0)) {
+        throw std::invalid_argument("Refractory period and dt should be positive");
+    }
+    std::size_t n_W = (std::size_t)std::floor(2 * refractory_period / dt);
+    std::vector<double> W(n_W);
+    for (std::size_t k = 1; k <= n_W; k++) {
+        W[k - 1] = 1 - refract1(k * dt, refractory_period);
+    }
+    return W;
+}
+
+RefractoryProbability::RefractoryProbability(std::vector<double> W, std::size_t rows, int n_threads)
+    : W_(std::move(W)), rows_(rows), n_threads_(n_threads) {
+    /* Split W in maximal linear pieces, skipping the ones that are zero */
+    double scale = 0;
+    for (double w : W_) {
+        scale = std::max(scale, std::fabs(w));
+    }
+    const double tol = 1e-12 * scale;
+    const std::size_t n_W = W_.size();
+    bool linear = true;
+    for (std::size_t first = 1; first <= n_W && linear;) {
+        std::size_t last = first;
+        double beta = 0;
+        if (first < n_W) {
+            last = first + 1;
+            beta = W_[last - 1] - W_[first - 1];
+        }
+        double alpha = W_[first - 1] - beta * first;
+        while (last < n_W && std::fabs(alpha + beta * (last + 1) - W_[last]) <= tol) {
+            last++;
+        }
+        /* Fit on the end points and check it on the whole piece */
+        if (last > first) {
+            beta = (W_[last - 1] - W_[first - 1]) / (last - first);
+            alpha = W_[first - 1] - beta * first;
+        }
+        bool zero = true;
+        for (std::size_t k = first; k <= last; k++) {
+            linear = linear && std::fabs(alpha + beta * k - W_[k - 1]) <= tol;
+            zero = zero && W_[k - 1] == 0;
+        }
+        if (!zero) {
+            pieces_.push_back(Piece{first, last, alpha, beta});
+        }
+        first = last + 1;
+    }
+    recursive_ = linear && pieces_.size() <= kMaxPieces;
+    if (!recursive_) {
+        pieces_.clear();
+    }
+    init();
+}
+
+void RefractoryProbability::init() {
+    t_ = 0;
+    ring_.assign((W_.size() + 1) * rows_, 0.0);
+    sums_.assign(2 * pieces_.size() * rows_, 0.0);
+}
+
+template <typename T>
+void RefractoryProbability::apply(const T *prob, T *probref, std::size_t cols) {
+    parallel_for(
+        rows_,
+        [&](std::size_t r0, std::size_t r1) {
+            if (recursive()) {
+                apply_recursive(prob, probref, cols, r0, r1);
+            } else {
+                apply_direct(prob, probref, cols, r0, r1);
+            }
+        },
+        n_threads_, kRowAlign, kRowAlign);
+    t_ += cols;
+}
+
+template <typename T>
+void RefractoryProbability::apply_direct(const T *prob, T *probref, std::size_t cols, std::size_t r0,
+                                         std::size_t r1) {
+    const std::size_t n_W = W_.size(), L = n_W + 1, n = rows_;
+    for (std::size_t b0 = r0; b0 < r1; b0 += kTileRows) {
+        const std::size_t b1 = std::min(r1, b0 + kTileRows);
+        for (std::size_t c = 0; c < cols; c++) {
+            const std::size_t t = t_ + c;
+            double *now = &ring_[(t % L) * n];
+            std::fill(now + b0, now + b1, 0.0);
+            for (std::size_t k = 1; k <= n_W; k++) {
+                const double w = W_[k - 1];
+                if (w == 0) {
+                    continue;
+                }
+                const double *past = &ring_[((t + L - k) % L) * n];
+                for (std::size_t row = b0; row < b1; row++) {
+                    now[row] += w * past[row];
+                }
+            }
+            for (std::size_t row = b0; row < b1; row++) {
+                now[row] = prob[row + c * n] * (1 - now[row]);
+                probref[row + c * n] = (T)now[row];
+            }
+        }
+    }
+}
+
+template <typename T>
+void RefractoryProbability::apply_recursive(const T *prob, T *probref, std::size_t cols,
+                                            std::size_t r0, std::size_t r1) {
+    const std::size_t L = W_.size() + 1, n = rows_;
+    for (std::size_t c = 0; c < cols; c++) {
+        const std::size_t t = t_ + c;
+        double *now = &ring_[(t % L) * n];
+        std::fill(now + r0, now + r1, 0.0);
+        for (std::size_t p = 0; p < pieces_.size(); p++) {
+            const double alpha = pieces_[p].alpha, beta = pieces_[p].beta;
+            const double *S0 = &sums_[2 * p * n], *S1 = &sums_[(2 * p + 1) * n];
+            for (std::size_t row = r0; row < r1; row++) {
+                now[row] += alpha * S0[row] + beta * S1[row];
+            }
+        }
+        for (std::size_t row = r0; row < r1; row++) {
+            now[row] = prob[row + c * n] * (1 - now[row]);
+            probref[row + c * n] = (T)now[row];
+        }
+
+        /* Slide the sums of each piece [a, b] to frame t + 1: frame t + 1 - a
+         * enters it, frame t - b leaves it. Frames before 0 are in slots not
+         * written yet, which hold zeros. */
+        for (std::size_t p = 0; p < pieces_.size(); p++) {
+            const double a = (double)pieces_[p].first, b = (double)pieces_[p].last;
+            const double *in = &ring_[((t + 1 + L - pieces_[p].first) % L) * n];
+            const double *out = &ring_[((t + L - pieces_[p].last) % L) * n];
+            double *S0 = &sums_[2 * p * n], *S1 = &sums_[(2 * p + 1) * n];
+            for (std::size_t row = r0; row < r1; row++) {
+                S1[row] += S0[row] + a * in[row] - (b + 1) * out[row];
+                S0[row] += in[row] - out[row];
+            }
+        }
+        if ((t + 1) % kResync == 0) {
+            resync(t + 1, r0, r1);
+        }
+    }
+}
+
+void RefractoryProbability::resync(std::size_t t, std::size_t r0, std::size_t r1) {
+    const std::size_t L = W_.size() + 1, n = rows_;
+    for (std::size_t p = 0; p < pieces_.size(); p++) {
+        double *S0 = &sums_[2 * p * n], *S1 = &sums_[(2 * p + 1) * n];
+        std::fill(S0 + r0, S0 + r1, 0.0);
+        std::fill(S1 + r0, S1 + r1, 0.0);
+        for (std::size_t k = pieces_[p].first; k <= pieces_[p].last && k <= t; k++) {
+            const double *past = &ring_[((t - k) % L) * n];
+            for (std::size_t row = r0; row < r1; row++) {
+                S0[row] += past[row];
+                S1[row] += k * past[row];
+            }
+        }
+    }
+}
+
+template void RefractoryProbability::apply(const double *, double *, std::size_t);
+template void RefractoryProbability::apply(const float *, float *, std::size_t);
+
+template <typename T>
+void apply_refractoriness(const T *prob, T *probref, std::size_t rows, std::size_t cols, const double *W,
+                          std::size_t n_W, int n_threads) {
+    RefractoryProbability(std::vector<double>(W, W + n_W), rows, n_threads).apply(prob, probref, cols);
+}
+
+template void apply_refractoriness(const double *, double *, std::size_t, std::size_t, const double *, std::size_t,
+                                   int);
+template void apply_refractoriness(const float *, float *, std::size_t, std::size_t, const double *, std::size_t,
+                                   int);
+
+} // namespace earing
@@ -0,0 +1,261 @@
+#include "earing/spike_analysis.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+#include "earing/parallel.hpp"
+
+namespace earing {
+
+template <typename T>
+void rate_spike_train(const T *spikes, std::size_t rows, std::size_t cols, const double *begin, std::size_t n_begin,
+                      const double *window, std::size_t n_window, T *rate, int n_threads) {
+    for (std::size_t k = 0; k < n_begin; k++) {
+        if (!(begin[k] >= 0) || (std::size_t)begin[k] + n_window > rows) {
+            throw std::invalid_argument("rate_spike_train: window " + std::to_string(k + 1) +
+                                        " goes past the spike trains");
+        }
+    }
+    parallel_for(
+        cols,
+        [&](std::size_t c0, std::size_t c1) {
+            for (std::size_t col = c0; col < c1; col++) {
+                for (std::size_t k = 0; k < n_begin; k++) {
+                    const T *spk = spikes + col * rows + (std::size_t)begin[k];
+                    double val = 0;
+                    for (std::size_t j = 0; j < n_window; j++) {
+                        val += spk[j] * window[j];
+                    }
+                    rate[k + col * n_begin] = (T)val;
+                }
+            }
+        },
+        n_threads);
+}
+
+template void rate_spike_train(const double *, std::size_t, std::size_t, const double *, std::size_t,
+                               const double *, std::size_t, double *, int);
+template void rate_spike_train(const float *, std::size_t, std::size_t, const double *, std::size_t,
+                               const double *, std::size_t, float *, int);
+
+void rate_spike_events(const std::size_t *col_start, const std::size_t *row_index, const double *values,
+                       std::size_t rows, std::size_t cols, const double *begin, std::size_t n_begin,
+                       const double *window, std::size_t n_window, double *rate, int n_threads) {
+    for (std::size_t k = 0; k < n_begin; k++) {
+        if (!(begin[k] >= 0) || (std::size_t)begin[k] + n_window > rows) {
+            throw std::invalid_argument("rate_spike_events: window " + std::to_string(k + 1) +
+                                        " goes past the spike trains");
+        }
+        if (k > 0 && begin[k] < begin[k - 1]) {
+            throw std::invalid_argument("rate_spike_events: the windows should be in increasing order");
+        }
+    }
+    parallel_for(
+        cols,
+        [&](std::size_t c0, std::size_t c1) {
+            for (std::size_t col = c0; col < c1; col++) {
+                double *r = rate + col * n_begin;
+                std::fill(r, r + n_begin, 0.0);
+                /* Windows [lo, hi) hold the current spike: begin <= t < begin + n_window */
+                std::size_t lo = 0, hi = 0;
+                for (std::size_t ind = col_start[col]; ind < col_start[col + 1]; ind++) {
+                    const std::size_t t = row_index[ind];
+                    const double value = values != nullptr ? values[ind] : 1.0;
+                    while (hi < n_begin && (std::size_t)begin[hi] <= t) {
+                        hi++;
+                    }
+                    while (lo < hi && (std::size_t)begin[lo] + n_window <= t) {
+                        lo++;
+                    }
+                    for (std::size_t k = lo; k < hi; k++) {
+                        r[k] += value * window[t - (std::size_t)begin[k]];
+                    }
+                }
+            }
+        },
+        n_threads);
+}
+
+void rate_spike_events(const SpikeTrains &trains, const double *begin, std::size_t n_begin, const double *window,
+                       std::size_t n_window, double *rate, int n_threads) {
+    rate_spike_events(trains.fiber_start.data(), trains.frames.data(), nullptr, trains.n_frames, trains.n_fibers,
+                      begin, n_begin, window, n_window, rate, n_threads);
+}
+
+void spikes_to_isi(const double *spikes, std::size_t rows, std::size_t cols, double *isi, int n_threads) {
+    parallel_for(
+        cols,
+        [&](std::size_t c0, std::size_t c1) {
+            for (std::size_t col = c0; col < c1; col++) {
+                const double *spk = spikes + col * rows;
+                double *out = isi + col * rows;
+                std::size_t start = 0;
+                while (start < rows) {
+                    /* Next spike after start */
+                    std::size_t end = start + 1;
+                    while (end < rows && spk[end] < 0.5) {
+                        end++;
+                    }
+                    for (std::size_t row = start; row < end; row++) {
+                        out[row] = (double)(end - start);
+                    }
+                    start = end;
+                }
+            }
+        },
+        n_threads);
+}
+
+void subsample_spike_trains(double *spikes, std::size_t rows, std::size_t cols, std::size_t n, int n_threads) {
+    if (n == 0) {
+        throw std::invalid_argument("subsample_spike_trains: n should be positive");
+    }
+    parallel_for(
+        cols,
+        [&](std::size_t c0, std::size_t c1) {
+            for (std::size_t col = c0; col < c1; col++) {
+                double *spk = spikes + col * rows;
+                std::size_t count = 0;
+                for (std::size_t row = 0; row < rows; row++) {
+                    if (spk[row] == 1 && count++ % n != 0) {
+                        spk[row] = 0;
+                    }
+                }
+            }
+        },
+        n_threads);
+}
+
+void isi_spike_events(const std::size_t *col_start, const std::size_t *row_index, std::size_t rows,
+                      std::size_t cols, double *isi, bool inverse, int n_threads) {
+    /* Trains go by groups sharing the cache lines of isi, walked frame by frame */
+    const std::size_t kGroup = 8;
+    parallel_for(
+        cols,
+        [&](std::size_t c0, std::size_t c1) {
+            for (std::size_t g0 = c0; g0 < c1; g0 += kGroup) {
+                const std::size_t width = std::min(kGroup, c1 - g0);
+                /* Per train: next spike to look at, end of the current interval and its value */
+                std::size_t next[kGroup], end[kGroup];
+                double value[kGroup];
+                /* Starts an interval at frame start: it runs to the next spike after it */
+                auto open = [&](std::size_t j, std::size_t start) {
+                    const std::size_t last = col_start[g0 + j + 1];
+                    while (next[j] < last && row_index[next[j]] <= start) {
+                        next[j]++;
+                    }
+                    end[j] = next[j] < last ? row_index[next[j]] : rows;
+                    const double length = (double)(end[j] - start);
+                    value[j] = inverse ? 1 / length : length;
+                };
+                for (std::size_t j = 0; j < width; j++) {
+                    next[j] = col_start[g0 + j];
+                    open(j, 0);
+                }
+                for (std::size_t t = 0; t < rows; t++) {
+                    double *out = isi + t * cols + g0;
+                    for (std::size_t j = 0; j < width; j++) {
+                        if (t == end[j]) {
+                            open(j, t);
+                        }
+                        out[j] = value[j];
+                    }
+                }
+            }
+        },
+        n_threads, kGroup, kGroup);
+}
+
+void isi_spike_events(const SpikeTrains &trains, double *isi, bool inverse, int n_threads) {
+    isi_spike_events(trains.fiber_start.data(), trains.frames.data(), trains.n_frames, trains.n_fibers, isi, inverse,
+                     n_threads);
+}
+
+std::size_t subsample_spike_events(const std::size_t *col_start, const std::size_t *row_index, std::size_t cols,
+                                   std::size_t n, std::size_t *out_col_start, std::size_t *out_row_index,
+                                   int n_threads) {
+    if (n == 0) {
+        throw std::invalid_argument("subsample_spike_events: n should be positive");
+    }
+    out_col_start[0] = 0;
+    for (std::size_t col = 0; col < cols; col++) {
+        const std::size_t count = col_start[col + 1] - col_start[col];
+        out_col_start[col + 1] = out_col_start[col] + (count + n - 1) / n;
+    }
+    parallel_for(
+        cols,
+        [&](std::size_t c0, std::size_t c1) {
+            for (std::size_t col = c0; col < c1; col++) {
+                std::size_t *out = out_row_index + out_col_start[col];
+                for (std::size_t ind = col_start[col]; ind < col_start[col + 1]; ind += n) {
+                    *out++ = row_index[ind];
+                }
+            }
+        },
+        n_threads);
+    return out_col_start[cols];
+}
+
+SpikeTrains subsample_spike_events(const SpikeTrains &trains, std::size_t n, int n_threads) {
+    SpikeTrains out;
+    out.n_fibers = trains.n_fibers;
+    out.n_frames = trains.n_frames;
+    out.fiber_start.resize(trains.n_fibers + 1);
+    out.frames.resize(trains.n_spikes());
+    std::size_t n_kept = subsample_spike_events(trains.fiber_start.data(), trains.frames.data(), trains.n_fibers, n,
+                                                out.fiber_start.data(), out.frames.data(), n_threads);
+    out.frames.resize(n_kept);
+    return out;
+}
+
+void spike_counts(const std::size_t *col_start, const std::size_t *row_index, std::size_t cols,
+                  std::size_t first_frame, std::size_t last_frame, std::size_t *counts, int n_threads) {
+    parallel_for(
+        cols,
+        [&](std::size_t c0, std::size_t c1) {
+            for (std::size_t col = c0; col < c1; col++) {
+                const std::size_t *begin = row_index + col_start[col], *end = row_index + col_start[col + 1];
+                const std::size_t *lo = std::lower_bound(begin, end, first_frame);
+                const std::size_t *hi = std::lower_bound(lo, end, std::max(first_frame, last_frame));
+                counts[col] = (std::size_t)(hi - lo);
+            }
+        },
+        n_threads);
+}
+
+void spike_counts(const SpikeTrains &trains, std::size_t first_frame, std::size_t last_frame, std::size_t *counts,
+                  int n_threads) {
+    spike_counts(trains.fiber_start.data(), trains.frames.data(), trains.n_fibers, first_frame, last_frame, counts,
+                 n_threads);
+}
+
+template <typename T>
+void average_channels(const T *feats, std::size_t rows, std::size_t cols, std::size_t n_features, T *mean,
+                      int n_threads) {
+    if (n_features == 0 || rows <= n_features) {
+        throw std::invalid_argument("average_channels: there are less channels than required features");
+    }
+    const std::size_t n = rows / n_features, last_n = rows - (n_features - 1) * n;
+    parallel_for(
+        cols,
+        [&](std::size_t c0, std::size_t c1) {
+            for (std::size_t col = c0; col < c1; col++) {
+                const T *f = feats + col * rows;
+                for (std::size_t k = 0; k < n_features; k++) {
+                    std::size_t group = k + 1 < n_features ? n : last_n;
+                    double val = 0;
+                    for (std::size_t j = 0; j < group; j++) {
+                        val += f[k * n + j];
+                    }
+                    mean[k + col * n_features] = (T)(val / (double)group);
+                }
+            }
+        },
+        n_threads);
+}
+
+template void average_channels(const double *, std::size_t, std::size_t, std::size_t, double *, int);
+template void average_channels(const float *, std::size_t, std::size_t, std::size_t, float *, int);
+
+} // namespace earing
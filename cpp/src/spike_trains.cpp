@@ -0,0 +1,417 @@
+#include "earing/spike_trains.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "earing/parallel.hpp"
+
+namespace earing {
+
+namespace {
+
+/* Fibers are handed to threads in multiples of a cache line of dense spikes */
+constexpr std::size_t kFiberAlign = 64;
+/* Same for PSTH counts */
+constexpr std::size_t kCountAlign = 64 / sizeof(std::uint16_t);
+
+/* Simulate an expo(lambda) random variable */
+double getExp(RandomStream &rng, double lambda) {
+    return -std::log(rng.uniform()) / lambda;
+}
+
+/* Calculate a random refractory period */
+std::size_t getRefractoryPeriod(double uniform, int AbsRefInt) {
+    return (std::size_t)(AbsRefInt + std::floor(uniform * AbsRefInt));
+}
+
+std::size_t getRefractoryPeriod(RandomStream &rng, int AbsRefInt) {
+    return getRefractoryPeriod(rng.uniform(), AbsRefInt);
+}
+
+/* Uniform variables compared with the rate at a time by the binning algorithm */
+constexpr std::size_t kBinningBatch = 64;
+/* Rate rows converted to binning thresholds at once, reading the rate a cache
+ * line of a column at a time, over tiles of kThresholdCols columns that their
+ * fibers go through together, so that the thresholds (128 KiB) do not grow
+ * with the block */
+constexpr std::size_t kThresholdRows = 8;
+constexpr std::size_t kThresholdCols = 2048;
+
+/* rate > (b + 1) * 2^-53, the uniform variable of the random bits b (see
+ * RandomStream::to_uniform), iff b < binning_threshold(rate): the product by
+ * 2^53 is exact, and for an integer n, n < x iff n < ceil(x). The threshold is
+ * at most 2^60, so that b < threshold iff b - threshold has its top bit set */
+std::uint64_t binning_threshold(double rate) {
+    const double x = rate * 0x1p53;
+    if (!(x > 0)) {
+        return 0;
+    }
+    if (x >= 0x1p60) {
+        return (std::uint64_t)1 << 60;
+    }
+    /* ceil(x) - 1, without a call to ceil */
+    const std::uint64_t t = (std::uint64_t)x;
+    return (double)t == x ? t - 1 : t;
+}
+
+} // namespace
+
+/* Buffers of a thread, over one block */
+struct SpikeGenerator::Workspace {
+    /* Binning thresholds of kThresholdRows rate rows over a tile, row after row */
+    std::vector<std::uint64_t> thresholds;
+    /* Spikes of the fibers going through the tiles together (of one fiber at
+     * a time if not ordered), and the column each of them resumes at in the
+     * next tile */
+    std::vector<std::vector<std::size_t>> frames;
+    std::vector<std::size_t> resume;
+    std::uint64_t bits[kBinningBatch];
+};
+
+void to_csc(const SpikeTrains &trains, std::size_t *col_start, std::size_t *row_index) {
+    /* Counting sort of the spikes by frame; fibers are visited in order, so
+     * that row indices are sorted within each column */
+    std::fill(col_start, col_start + trains.n_frames + 1, 0);
+    for (std::size_t frame : trains.frames) {
+        col_start[frame + 1]++;
+    }
+    for (std::size_t col = 0; col < trains.n_frames; col++) {
+        col_start[col + 1] += col_start[col];
+    }
+    std::vector<std::size_t> next(col_start, col_start + trains.n_frames);
+    for (std::size_t fiber = 0; fiber < trains.n_fibers; fiber++) {
+        for (std::size_t k = trains.fiber_start[fiber]; k < trains.fiber_start[fiber + 1]; k++) {
+            row_index[next[trains.frames[k]]++] = fiber;
+        }
+    }
+}
+
+void to_dense(const SpikeTrains &trains, unsigned char *spikes) {
+    for (std::size_t fiber = 0; fiber < trains.n_fibers; fiber++) {
+        for (std::size_t k = trains.fiber_start[fiber]; k < trains.fiber_start[fiber + 1]; k++) {
+            spikes[fiber + trains.frames[k] * trains.n_fibers] = 1;
+        }
+    }
+}
+
+SpikeGenerator::SpikeGenerator(std::size_t rows, int n_fibers, int abs_refractory_bins, SpikeAlgorithm algo,
+                               std::uint64_t seed, std::uint64_t first_stream, int n_threads, int n_repetitions)
+    : rows_(rows), n_fibers_(n_fibers), abs_refractory_bins_(abs_refractory_bins), algo_(algo),
+      n_threads_(n_threads), n_repetitions_(n_repetitions) {
+    /* Counts of a bin go up to n_repetitions */
+    if (n_repetitions < 1 || n_repetitions > 65535) {
+        throw std::invalid_argument("SpikeGenerator: n_repetitions should be between 1 and 65535");
+    }
+    const std::size_t n_rows = rows * n_fibers * n_repetitions;
+    dead_bins_.assign(n_rows, 0);
+    streams_.reserve(n_rows);
+    for (std::size_t row = 0; row < n_rows; row++) {
+        streams_.emplace_back(seed, first_stream + row);
+    }
+}
+
+template <typename T>
+std::vector<double> SpikeGenerator::max_rates(const T *rate, std::size_t cols) const {
+    /* The rate should be positive or null */
+    std::vector<double> lambdaMax(rows_, 0.0);
+    if (algo_ == SpikeAlgorithm::Thinning) {
+        for (std::size_t col = 0; col < cols; col++) {
+            for (std::size_t row = 0; row < rows_; row++) {
+                lambdaMax[row] = std::max(lambdaMax[row], (double)rate[row + col * rows_]);
+            }
+        }
+    }
+    return lambdaMax;
+}
+
+template <typename T>
+void SpikeGenerator::thinning_spikes(const T *rate, std::size_t cols, std::size_t row, double lambdaMax,
+                                     std::vector<std::size_t> &frames) {
+    /* Rate row of the fiber, whatever its repetition */
+    const std::size_t row_release = row % (rows_ * n_fibers_) / n_fibers_;
+    const std::size_t first = frames.size();
+    const bool refractory = abs_refractory_bins_ >= 1;
+    RandomStream &rng = streams_[row];
+    /* First frame out of the current refractory period: after each spike, the
+     * refractory period is drawn and generation resumes after it */
+    std::size_t alive_from = dead_bins_[row];
+
+    /* Inter-event times are memoryless: restarting at alive_from is the
+     * same as drawing the events of the refractory period and removing them */
+    double expo = (double)alive_from + getExp(rng, lambdaMax);
+    /* Even though expo should always be finite, lambdaMax = 0 gives infinity */
+    while (std::isfinite(expo) && expo >= 0 && expo < (double)cols) {
+        std::size_t col = (std::size_t)expo;
+        /* Accept if no spike already (to account for expos < 1) */
+        if ((frames.size() == first || frames.back() != col) &&
+            rate[row_release + col * rows_] / lambdaMax > rng.uniform()) {
+            frames.push_back(col);
+            if (refractory) {
+                alive_from = col + 1 + getRefractoryPeriod(rng, abs_refractory_bins_);
+                expo = (double)alive_from;
+            }
+        }
+        expo += getExp(rng, lambdaMax);
+    }
+
+    /* Refractory bins carried over to the next block */
+    dead_bins_[row] = refractory && alive_from > cols ? alive_from - cols : 0;
+}
+
+std::size_t SpikeGenerator::binning_spikes(const std::uint64_t *threshold, std::size_t c0, std::size_t c1,
+                                           std::size_t from, std::size_t row, std::uint64_t *bits,
+                                           std::vector<std::size_t> &frames) {
+    /* One uniform variable per bin out of the refractory periods, as
+     * rate > rng.uniform(), but kBinningBatch at a time, as integers. The
+     * streams being counter-based, the next tile continues from position next:
+     * batches stop at the end of the tile (and the refractory period of a
+     * spike on its last column), and start on the blocks of values that
+     * RandomStream::bits computes at once, so that few bits are drawn twice */
+    const bool refractory = abs_refractory_bins_ >= 1;
+    RandomStream &rng = streams_[row];
+    /* bits[b] is the uniform variable of stream position next, if b < n_bits */
+    std::uint64_t next = rng.position();
+    std::size_t b = 0, n_bits = 0;
+    std::size_t col = from;
+    auto refill = [&] {
+        const std::uint64_t start = next - next % (2 * kPhiloxLanes);
+        b = (std::size_t)(next - start);
+        n_bits = std::min(kBinningBatch, b + c1 - col + 1);
+        rng.bits(start, bits, n_bits);
+    };
+    while (col < c1) {
+        if (b == n_bits) {
+            refill();
+        }
+        const std::size_t m = std::min(n_bits - b, c1 - col);
+        const std::uint64_t *t = threshold + (col - c0);
+        /* Most batches have no spike: their test is vectorised */
+        std::uint64_t any = 0;
+        for (std::size_t j = 0; j < m; j++) {
+            any |= bits[b + j] - t[j];
+        }
+        if ((any >> 63) == 0) {
+            col += m;
+            b += m;
+            next += m;
+            continue;
+        }
+        std::size_t j = 0;
+        while (bits[b + j] >= t[j]) {
+            j++;
+        }
+        frames.push_back(col + j);
+        col += j + 1;
+        b += j + 1;
+        next += j + 1;
+        if (refractory) {
+            if (b == n_bits) {
+                refill();
+            }
+            col += getRefractoryPeriod(RandomStream::to_uniform(bits[b]), abs_refractory_bins_);
+            b++;
+            next++;
+        }
+    }
+    rng.seek(next);
+    return col;
+}
+
+template <typename T, typename Sink>
+void SpikeGenerator::fibers_spikes(const T *rate, std::size_t cols, std::size_t f0, std::size_t f1, std::size_t r0,
+                                   std::size_t r1, const std::vector<double> &lambdaMax, bool ordered,
+                                   Workspace &workspace, Sink &&sink) {
+    const std::size_t n_rows = rows_ * n_fibers_;
+    std::vector<std::vector<std::size_t>> &frames = workspace.frames;
+    if (algo_ == SpikeAlgorithm::Thinning) {
+        frames.resize(1);
+        for (std::size_t fiber = f0; fiber < f1; fiber++) {
+            for (std::size_t r = r0; r < r1; r++) {
+                frames[0].clear();
+                thinning_spikes(rate, cols, r * n_rows + fiber, lambdaMax[fiber % n_rows / n_fibers_], frames[0]);
+                sink(r * n_rows + fiber, frames[0]);
+            }
+        }
+        return;
+    }
+
+    /* Streams k = (fiber - g0) * n_reps + r - r0 of the fibers of at most
+     * kThresholdRows rate rows, tile after tile (fibers may be streams of the
+     * repetitions too, from n_rows on) */
+    const std::size_t n_reps = r1 - r0;
+    auto stream_row = [&](std::size_t g0, std::size_t k) { return (r0 + k % n_reps) * n_rows + g0 + k / n_reps; };
+    for (std::size_t g0 = f0; g0 < f1;) {
+        const std::size_t first_channel = g0 % n_rows / n_fibers_;
+        const std::size_t n_channels = std::min(kThresholdRows, rows_ - first_channel);
+        const std::size_t g1 = std::min(f1, g0 - g0 % n_rows + (first_channel + n_channels) * n_fibers_);
+        const std::size_t n_streams = (g1 - g0) * n_reps;
+        frames.resize(std::max(frames.size(), ordered ? n_streams : 1));
+        workspace.resume.resize(n_streams);
+        for (std::size_t k = 0; k < n_streams; k++) {
+            frames[ordered ? k : 0].clear();
+            workspace.resume[k] = dead_bins_[stream_row(g0, k)];
+        }
+        for (std::size_t c0 = 0; c0 < cols; c0 += kThresholdCols) {
+            const std::size_t c1 = std::min(cols, c0 + kThresholdCols), tile = c1 - c0;
+            workspace.thresholds.resize(n_channels * tile);
+            for (std::size_t col = c0; col < c1; col++) {
+                const T *column = rate + first_channel + col * rows_;
+                for (std::size_t c = 0; c < n_channels; c++) {
+                    workspace.thresholds[c * tile + col - c0] = binning_threshold((double)column[c]);
+                }
+            }
+            for (std::size_t k = 0; k < n_streams; k++) {
+                const std::size_t row = stream_row(g0, k);
+                const std::size_t channel = row % n_rows / n_fibers_;
+                std::vector<std::size_t> &out = frames[ordered ? k : 0];
+                workspace.resume[k] = binning_spikes(workspace.thresholds.data() + (channel - first_channel) * tile,
+                                                     c0, c1, std::max(workspace.resume[k], c0), row, workspace.bits,
+                                                     out);
+                if (!ordered) {
+                    sink(row, out);
+                    out.clear();
+                }
+            }
+        }
+        for (std::size_t k = 0; k < n_streams; k++) {
+            const std::size_t row = stream_row(g0, k), resume = workspace.resume[k];
+            /* Refractory bins carried over to the next block */
+            dead_bins_[row] = resume > cols ? resume - cols : 0;
+            if (ordered) {
+                sink(row, frames[k]);
+            }
+        }
+        g0 = g1;
+    }
+}
+
+template <typename T>
+void SpikeGenerator::apply(const T *rate, std::size_t cols, SpikeTrains &trains) {
+    const std::size_t n_rows = streams_.size();
+    const std::vector<double> lambdaMax = max_rates(rate, cols);
+
+    /* Fibers are split in parts generated independently, then concatenated */
+    const std::size_t n_parts = std::min<std::size_t>(n_rows, 4 * (n_threads_ > 0 ? n_threads_ : num_threads()));
+    std::vector<std::vector<std::size_t>> part_frames(n_parts);
+    trains.n_fibers = n_rows;
+    trains.n_frames = cols;
+    trains.fiber_start.assign(n_rows + 1, 0);
+    parallel_for(
+        n_parts,
+        [&](std::size_t p0, std::size_t p1) {
+            Workspace workspace;
+            for (std::size_t part = p0; part < p1; part++) {
+                std::vector<std::size_t> &out = part_frames[part];
+                fibers_spikes(rate, cols, n_rows * part / n_parts, n_rows * (part + 1) / n_parts, 0, 1, lambdaMax,
+                              true, workspace, [&](std::size_t row, const std::vector<std::size_t> &frames) {
+                                  out.insert(out.end(), frames.begin(), frames.end());
+                                  trains.fiber_start[row + 1] = out.size();
+                              });
+            }
+        },
+        n_threads_);
+
+    /* fiber_start holds the end of each fiber within its part */
+    std::size_t offset = 0;
+    trains.frames.clear();
+    for (std::size_t part = 0; part < n_parts; part++) {
+        for (std::size_t row = n_rows * part / n_parts; row < n_rows * (part + 1) / n_parts; row++) {
+            trains.fiber_start[row + 1] += offset;
+        }
+        offset += part_frames[part].size();
+        trains.frames.insert(trains.frames.end(), part_frames[part].begin(), part_frames[part].end());
+    }
+}
+
+template <typename T>
+void SpikeGenerator::apply(unsigned char *spikes, const T *rate, std::size_t cols) {
+    const std::size_t n_rows = streams_.size();
+    const std::vector<double> lambdaMax = max_rates(rate, cols);
+    parallel_for(
+        n_rows,
+        [&](std::size_t f0, std::size_t f1) {
+            Workspace workspace;
+            fibers_spikes(rate, cols, f0, f1, 0, 1, lambdaMax, false, workspace,
+                          [&](std::size_t row, const std::vector<std::size_t> &frames) {
+                              for (std::size_t col : frames) {
+                                  spikes[row + col * n_rows] = 1;
+                              }
+                          });
+        },
+        n_threads_, kFiberAlign, kFiberAlign);
+}
+
+template <typename T>
+void SpikeGenerator::apply(std::uint16_t *counts, const T *rate, std::size_t cols) {
+    const std::size_t n_rows = rows_ * n_fibers_, n_reps = (std::size_t)n_repetitions_;
+    const std::vector<double> lambdaMax = max_rates(rate, cols);
+
+    /* Adds repetitions r0 ... r1 - 1 of fibers f0 ... f1 - 1 to out */
+    auto accumulate = [&](std::uint16_t *out, std::size_t f0, std::size_t f1, std::size_t r0, std::size_t r1) {
+        Workspace workspace;
+        fibers_spikes(rate, cols, f0, f1, r0, r1, lambdaMax, false, workspace,
+                      [&](std::size_t row, const std::vector<std::size_t> &frames) {
+                          for (std::size_t col : frames) {
+                              out[row % n_rows + col * n_rows]++;
+                          }
+                      });
+    };
+
+    /* Fibers across threads when there are enough, as for the dense spikes,
+     * otherwise repetitions, each thread counting into its own histogram */
+    const std::size_t threads = (std::size_t)(n_threads_ > 0 ? n_threads_ : num_threads());
+    if (n_rows >= kCountAlign * threads || threads == 1 || n_reps == 1) {
+        parallel_for(
+            n_rows, [&](std::size_t f0, std::size_t f1) { accumulate(counts, f0, f1, 0, n_reps); }, n_threads_,
+            kCountAlign, kCountAlign);
+        return;
+    }
+    const std::size_t n_parts = std::min(threads, n_reps);
+    std::vector<std::vector<std::uint16_t>> part_counts(n_parts);
+    parallel_for(
+        n_parts,
+        [&](std::size_t p0, std::size_t p1) {
+            for (std::size_t part = p0; part < p1; part++) {
+                part_counts[part].assign(n_rows * cols, 0);
+                accumulate(part_counts[part].data(), 0, n_rows, n_reps * part / n_parts,
+                           n_reps * (part + 1) / n_parts);
+            }
+        },
+        (int)n_parts);
+    for (const std::vector<std::uint16_t> &part : part_counts) {
+        for (std::size_t k = 0; k < part.size(); k++) {
+            counts[k] = (std::uint16_t)(counts[k] + part[k]);
+        }
+    }
+}
+
+template void SpikeGenerator::apply(const double *, std::size_t, SpikeTrains &);
+template void SpikeGenerator::apply(const float *, std::size_t, SpikeTrains &);
+template void SpikeGenerator::apply(unsigned char *, const double *, std::size_t);
+template void SpikeGenerator::apply(unsigned char *, const float *, std::size_t);
+template void SpikeGenerator::apply(std::uint16_t *, const double *, std::size_t);
+template void SpikeGenerator::apply(std::uint16_t *, const float *, std::size_t);
+
+SpikeTrains generate_poisson_spike_events(const double *rate, std::size_t rows, std::size_t cols, int n_fibers,
+                                          int abs_refractory_bins, SpikeAlgorithm algo, std::uint64_t seed,
+                                          int n_threads) {
+    SpikeTrains trains;
+    SpikeGenerator(rows, n_fibers, abs_refractory_bins, algo, seed, 0, n_threads).apply(rate, cols, trains);
+    return trains;
+}
+
+void generate_poisson_spike_trains(unsigned char *spikes, const double *rate, std::size_t rows,
+                                   std::size_t cols, int n_fibers, int abs_refractory_bins,
+                                   SpikeAlgorithm algo, std::uint64_t seed, int n_threads) {
+    SpikeGenerator(rows, n_fibers, abs_refractory_bins, algo, seed, 0, n_threads).apply(spikes, rate, cols);
+}
+
+void generate_poisson_psth(std::uint16_t *counts, const double *rate, std::size_t rows, std::size_t cols,
+                           int n_fibers, int n_repetitions, int abs_refractory_bins, SpikeAlgorithm algo,
+                           std::uint64_t seed, int n_threads) {
+    SpikeGenerator(rows, n_fibers, abs_refractory_bins, algo, seed, 0, n_threads, n_repetitions)
+        .apply(counts, rate, cols);
+}
+
+} // namespace earing
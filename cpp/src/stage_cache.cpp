@@ -0,0 +1,198 @@
+#include "earing/stage_cache.hpp"
+
+#include "earing/atomic_file.hpp"
+#include "earing/mapped_file.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace earing {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const char magic[8] = {'E', 'A', 'R', 'S', 'T', 'A', 'G', 'E'};
+const std::uint32_t byte_order_mark = 0x01020304;
+const char *const extension = ".stage";
+
+/* Entry header, followed by rows * cols samples; 32 bytes, so that the
+ * samples of a mapped entry are aligned */
+struct EntryHeader {
+    char magic[8];
+    std::uint32_t sample_bytes;
+    std::uint32_t byte_order;
+    std::uint64_t rows;
+    std::uint64_t cols;
+};
+static_assert(sizeof(EntryHeader) == 32, "unexpected padding of the cache entry header");
+
+} // namespace
+
+Fingerprint &Fingerprint::add(const void *bytes, std::size_t n) {
+    /* h = (h ^ byte) * (2^88 + 0x13b) modulo 2^128 */
+    const unsigned char *p = (const unsigned char *)bytes;
+    std::uint64_t hi = hi_, lo = lo_;
+    for (std::size_t k = 0; k < n; k++) {
+        lo ^= p[k];
+        std::uint64_t a = (lo & 0xffffffffULL) * 0x13b;
+        std::uint64_t b = (lo >> 32) * 0x13b;
+        std::uint64_t new_lo = a + (b << 32);
+        std::uint64_t carry = (b >> 32) + (new_lo < a ? 1 : 0);
+        hi = hi * 0x13b + carry + (lo << 24);
+        lo = new_lo;
+    }
+    hi_ = hi;
+    lo_ = lo;
+    return *this;
+}
+
+Fingerprint &Fingerprint::add(const std::vector<double> &x) {
+    std::uint64_t n = x.size();
+    add(&n, sizeof n);
+    return add(x.data(), x.size() * sizeof(double));
+}
+
+Fingerprint &Fingerprint::add(const std::string &s) {
+    std::uint64_t n = s.size();
+    add(&n, sizeof n);
+    return add(s.data(), s.size());
+}
+
+std::string Fingerprint::hex() const {
+    char s[33];
+    std::snprintf(s, sizeof s, "%016llx%016llx", (unsigned long long)hi_, (unsigned long long)lo_);
+    return s;
+}
+
+StageCache::StageCache(const std::string &directory, std::uint64_t max_bytes)
+    : directory_(directory), max_bytes_(max_bytes) {
+    std::error_code error;
+    fs::create_directories(directory_, error);
+    if (!fs::is_directory(directory_, error)) {
+        throw std::runtime_error("Unable to create the cache directory " + directory_);
+    }
+}
+
+std::string StageCache::entry_path(const std::string &key) const {
+    return (fs::path(directory_) / (key + extension)).string();
+}
+
+template <typename T>
+bool StageCache::load(const std::string &key, BasicMatrix<T> &out) {
+    std::string path = entry_path(key);
+    std::error_code error;
+    if (!fs::exists(path, error)) {
+        misses_++;
+        return false;
+    }
+    try {
+        MappedFile file(path);
+        EntryHeader header;
+        if (file.size() < sizeof header) {
+            misses_++;
+            return false;
+        }
+        std::memcpy(&header, file.data(), sizeof header);
+        std::uint64_t n = header.rows * header.cols;
+        if (std::memcmp(header.magic, magic, sizeof magic) != 0 || header.sample_bytes != sizeof(T) ||
+            header.byte_order != byte_order_mark || file.size() != sizeof header + n * sizeof(T)) {
+            misses_++;
+            return false;
+        }
+        out.assign((std::size_t)header.rows, (std::size_t)header.cols);
+        std::memcpy(out.data(), file.data() + sizeof header, (std::size_t)n * sizeof(T));
+    } catch (const std::runtime_error &) {
+        /* Evicted meanwhile */
+        misses_++;
+        return false;
+    }
+    /* Most recently used */
+    fs::last_write_time(path, fs::file_time_type::clock::now(), error);
+    hits_++;
+    return true;
+}
+
+template <typename T>
+void StageCache::store(const std::string &key, const BasicMatrix<T> &x) {
+    EntryHeader header;
+    std::memcpy(header.magic, magic, sizeof magic);
+    header.sample_bytes = sizeof(T);
+    header.byte_order = byte_order_mark;
+    header.rows = x.rows();
+    header.cols = x.cols();
+    if (max_bytes_ > 0 && sizeof header + x.size() * sizeof(T) > max_bytes_) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string path = entry_path(key);
+    AtomicFile file(path);
+    if (std::fwrite(&header, sizeof header, 1, file.get()) != 1 ||
+        std::fwrite(x.data(), sizeof(T), x.size(), file.get()) != x.size()) {
+        throw std::runtime_error("Unable to write to file " + file.path());
+    }
+    file.commit();
+    if (max_bytes_ > 0) {
+        evict_locked();
+    }
+}
+
+void StageCache::evict() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    evict_locked();
+}
+
+void StageCache::evict_locked() {
+    struct Entry {
+        fs::path path;
+        fs::file_time_type time;
+        std::uint64_t size;
+    };
+    std::vector<Entry> entries;
+    std::uint64_t total = 0;
+    std::error_code error;
+    for (const fs::directory_entry &e : fs::directory_iterator(directory_, error)) {
+        if (e.path().extension() != extension || !e.is_regular_file(error)) {
+            continue;
+        }
+        Entry entry = {e.path(), e.last_write_time(error), e.file_size(error)};
+        if (!error) {
+            entries.push_back(entry);
+            total += entry.size;
+        }
+    }
+    if (max_bytes_ == 0 || total <= max_bytes_) {
+        return;
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) { return a.time < b.time; });
+    for (const Entry &entry : entries) {
+        if (total <= max_bytes_) {
+            break;
+        }
+        /* Another process may have removed it already */
+        fs::remove(entry.path, error);
+        total -= entry.size;
+    }
+}
+
+std::uint64_t StageCache::bytes() const {
+    std::uint64_t total = 0;
+    std::error_code error;
+    for (const fs::directory_entry &e : fs::directory_iterator(directory_, error)) {
+        if (e.path().extension() == extension && e.is_regular_file(error)) {
+            std::uint64_t size = e.file_size(error);
+            total += error ? 0 : size;
+        }
+    }
+    return total;
+}
+
+template bool StageCache::load<double>(const std::string &, BasicMatrix<double> &);
+template bool StageCache::load<float>(const std::string &, BasicMatrix<float> &);
+template void StageCache::store<double>(const std::string &, const BasicMatrix<double> &);
+template void StageCache::store<float>(const std::string &, const BasicMatrix<float> &);
+
+} // namespace earing
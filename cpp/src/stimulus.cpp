@@ -0,0 +1,247 @@
+#include "earing/stimulus.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace earing {
+
+namespace {
+
+const double pi = 3.14159265358979323846;
+
+std::uint32_t read_u32(const unsigned char *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((std::uint32_t)p[3] << 24);
+}
+
+std::uint16_t read_u16(const unsigned char *p) {
+    return (std::uint16_t)(p[0] | (p[1] << 8));
+}
+
+std::vector<unsigned char> read_file(const std::string &path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Unable to read from file " + path);
+    }
+    return std::vector<unsigned char>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+double sample_to_double(const unsigned char *p, int format, int bits) {
+    if (format == 3) {
+        if (bits == 32) {
+            float f;
+            std::memcpy(&f, p, 4);
+            return f;
+        }
+        double d;
+        std::memcpy(&d, p, 8);
+        return d;
+    }
+    switch (bits) {
+    case 8:
+        return (p[0] - 128) / 128.0;
+    case 16:
+        return (std::int16_t)read_u16(p) / 32768.0;
+    case 24: {
+        std::int32_t v = (std::int32_t)((std::uint32_t)p[0] << 8 | (std::uint32_t)p[1] << 16 | (std::uint32_t)p[2] << 24);
+        return (v >> 8) / 8388608.0;
+    }
+    default:
+        return (std::int32_t)read_u32(p) / 2147483648.0;
+    }
+}
+
+/* conv(abs(stimulus), hann(n), 'same'), using the cosine form of the Hann
+ * window and complex prefix sums (cost independent of n) */
+std::vector<double> conv_abs_hann_same(const std::vector<double> &x, std::size_t n) {
+    std::size_t L = x.size();
+    std::vector<double> out(L);
+    if (n == 1) {
+        /* hann(1) is 1 */
+        for (std::size_t t = 0; t < L; t++) {
+            out[t] = std::fabs(x[t]);
+        }
+        return out;
+    }
+    const std::size_t period = n - 1;
+    double theta = 2 * pi / (double)period;
+    std::vector<double> P0(L + 1, 0.0);
+    std::vector<std::complex<double>> P1(L + 1);
+    for (std::size_t m = 0; m < L; m++) {
+        double a = std::fabs(x[m]);
+        P0[m + 1] = P0[m] + a;
+        P1[m + 1] = P1[m] + a * std::polar(1.0, -theta * (double)(m % period));
+    }
+    std::size_t h = n / 2;
+    for (std::size_t t = 0; t < L; t++) {
+        /* out[t] = sum_k w[k] |x[t + h - k]|, w[k] = (1 - cos(theta k)) / 2 */
+        std::ptrdiff_t hi = std::min<std::ptrdiff_t>((std::ptrdiff_t)(t + h), (std::ptrdiff_t)L - 1);
+        std::ptrdiff_t lo = std::max<std::ptrdiff_t>((std::ptrdiff_t)(t + h) - (std::ptrdiff_t)n + 1, 0);
+        if (hi < lo) {
+            out[t] = 0;
+            continue;
+        }
+        double s0 = P0[hi + 1] - P0[lo];
+        std::complex<double> s1 = (P1[hi + 1] - P1[lo]) * std::polar(1.0, theta * (double)((t + h) % period));
+        out[t] = 0.5 * (s0 - s1.real());
+    }
+    return out;
+}
+
+/* Modified Bessel function of the first kind, of order 0 */
+double bessel_i0(double x) {
+    double sum = 1, term = 1;
+    for (int k = 1; term > 1e-17 * sum; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+} // namespace
+
+Stimulus read_wav(const std::string &path) {
+    std::vector<unsigned char> bytes = read_file(path);
+    if (bytes.size() < 12 || std::memcmp(bytes.data(), "RIFF", 4) != 0 || std::memcmp(bytes.data() + 8, "WAVE", 4) != 0) {
+        throw std::runtime_error(path + " is not a WAV file");
+    }
+    int format = 0, channels = 0, bits = 0;
+    double fs = 0;
+    std::size_t pos = 12;
+    while (pos + 8 <= bytes.size()) {
+        std::uint32_t chunk_size = read_u32(&bytes[pos + 4]);
+        const unsigned char *chunk = &bytes[pos + 8];
+        std::size_t available = std::min<std::size_t>(chunk_size, bytes.size() - pos - 8);
+        if (std::memcmp(&bytes[pos], "fmt ", 4) == 0 && available >= 16) {
+            format = read_u16(chunk);
+            channels = read_u16(chunk + 2);
+            fs = read_u32(chunk + 4);
+            bits = read_u16(chunk + 14);
+            if (format == 0xFFFE && available >= 26) {
+                format = read_u16(chunk + 24);  /* WAVE_FORMAT_EXTENSIBLE sub-format */
+            }
+        } else if (std::memcmp(&bytes[pos], "data", 4) == 0) {
+            if (channels == 0) {
+                throw std::runtime_error(path + ": data chunk before fmt chunk");
+            }
+            bool supported = (format == 1 && (bits == 8 || bits == 16 || bits == 24 || bits == 32)) ||
+                             (format == 3 && (bits == 32 || bits == 64));
+            if (!supported) {
+                throw std::runtime_error(path + ": unsupported WAV encoding");
+            }
+            std::size_t frame = (std::size_t)channels * (bits / 8);
+            Stimulus stimulus;
+            stimulus.fs = fs;
+            stimulus.samples.resize(available / frame);
+            for (std::size_t k = 0; k < stimulus.samples.size(); k++) {
+                stimulus.samples[k] = sample_to_double(chunk + k * frame, format, bits);
+            }
+            return stimulus;
+        }
+        pos += 8 + chunk_size + (chunk_size & 1);
+    }
+    throw std::runtime_error(path + ": no data chunk");
+}
+
+Stimulus read_raw(const std::string &path, double fs) {
+    std::vector<unsigned char> bytes = read_file(path);
+    Stimulus stimulus;
+    stimulus.fs = fs;
+    stimulus.samples.resize(bytes.size() / sizeof(double));
+    std::memcpy(stimulus.samples.data(), bytes.data(), stimulus.samples.size() * sizeof(double));
+    return stimulus;
+}
+
+std::vector<double> resample(const std::vector<double> &x, double fs, double target_fs) {
+    std::uint64_t p = (std::uint64_t)std::llround(target_fs), q = (std::uint64_t)std::llround(fs);
+    if (p == 0 || q == 0) {
+        throw std::invalid_argument("resample: sample rates should be positive");
+    }
+    std::uint64_t a = p, b = q;
+    while (b != 0) {
+        std::uint64_t r = a % b;
+        a = b;
+        b = r;
+    }
+    p /= a;
+    q /= a;
+    if (p == q) {
+        return x;
+    }
+
+    /* h = firls(L - 1, [0 2fc 2fc 1], [1 1 0 0]) .* kaiser(L, 5)', the
+     * least-squares fit over the whole band being the ideal low-pass */
+    const std::size_t N = 10, beta_n = std::max(p, q), L = 2 * N * beta_n + 1;
+    const double half = (L - 1) / 2.0, beta = 5;
+    std::vector<double> h(L);
+    double sum = 0;
+    for (std::size_t n = 0; n < L; n++) {
+        double t = (n - half) / beta_n;
+        double sinc = t == 0 ? 1 : std::sin(pi * t) / (pi * t);
+        double r = (n - half) / half;
+        h[n] = sinc * bessel_i0(beta * std::sqrt(std::max(0.0, 1 - r * r))) / bessel_i0(beta);
+        sum += h[n];
+    }
+    for (double &v : h) {
+        v *= p / sum;
+    }
+
+    /* Delay so that downsampling by q hits the centre tap, nz zeros being
+     * prepended to h */
+    const std::size_t Lhalf = (L - 1) / 2;
+    const std::size_t nz = q - Lhalf % q;
+    const std::size_t delay = (Lhalf + nz) / q;
+    const std::size_t Lx = x.size(), Ly = (std::size_t)((Lx * p + q - 1) / q);
+
+    /* upfirdn(x, [zeros(1, nz) h], p, q) from sample delay on */
+    std::vector<double> y(Ly);
+    for (std::size_t i = 0; i < Ly; i++) {
+        /* Output sample j of the filter of the upsampled input */
+        const std::size_t j = (i + delay) * q;
+        /* Taps j - k p of the delayed filter, in [nz, nz + L) */
+        std::size_t k_end = j >= nz ? std::min<std::size_t>((j - nz) / p + 1, Lx) : 0;
+        std::size_t k_begin = j + 1 > nz + L ? (j + 1 - nz - L + p - 1) / p : 0;
+        double s = 0;
+        for (std::size_t k = k_begin; k < k_end; k++) {
+            s += x[k] * h[j - k * p - nz];
+        }
+        y[i] = s;
+    }
+    return y;
+}
+
+void renormalise_to_dB(std::vector<double> &stimulus, double fs, double level_dB_SPL) {
+    if (stimulus.empty()) {
+        return;
+    }
+    /* soundLevel = 20 * log10(rms / 20) */
+    double newRms = 20 * std::pow(10.0, level_dB_SPL / 20);
+
+    /* rms of the high-energy samples: convabs > max(convabs) / 7 */
+    double timebin = 160e-3;  /* seconds */
+    std::size_t nbBin = (std::size_t)std::floor(timebin * fs);
+    std::vector<double> convabs = conv_abs_hann_same(stimulus, std::max<std::size_t>(nbBin, 1));
+    double threshold = *std::max_element(convabs.begin(), convabs.end()) / 7;
+    double sum_sq = 0;
+    std::size_t count = 0;
+    for (std::size_t t = 0; t < stimulus.size(); t++) {
+        if (convabs[t] > threshold) {
+            sum_sq += stimulus[t] * stimulus[t];
+            count++;
+        }
+    }
+    if (count == 0 || sum_sq == 0) {
+        return;  /* silence: nothing to renormalise */
+    }
+    double initRms = std::sqrt(sum_sq / count);
+    for (double &s : stimulus) {
+        s *= newRms / initRms;
+    }
+}
+
+} // namespace earing
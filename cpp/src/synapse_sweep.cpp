@@ -0,0 +1,154 @@
+#include "earing/synapse_sweep.hpp"
+
+#include "earing/parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace earing {
+
+template <typename T>
+void BasicSynapseSweep<T>::init(double ihc_cilia_restingV, std::size_t n_BFs, double fs) {
+    if (settings.empty()) {
+        throw std::invalid_argument("SynapseSweep: no settings");
+    }
+    const std::size_t K = settings.size();
+    dt_ = 1 / fs;
+    n_BFs_ = n_BFs;
+
+    gmaxca_.resize(K);
+    C_.resize(K);
+    one_minus_C_.resize(K);
+    thresh_.resize(K);
+    for (std::size_t k = 0; k < K; k++) {
+        gmaxca_[k] = settings[k].gmaxca;
+        C_[k] = 1 - dt_ / settings[k].tauCa;
+        one_minus_C_[k] = 1 - C_[k];
+        thresh_[k] = std::pow(settings[k].ca_thresh, synapse.power);
+    }
+
+    /* Startup state, as AnIhcSynapse::init for each setting */
+    double m0 = 1 / (1 + std::exp(-synapse.gamma * ihc_cilia_restingV) / synapse.beta);
+    mICaCurrent_.assign(n_BFs, m0);
+    CaCurrent_.resize(n_BFs * K);
+    synapse.kt0.resize(n_BFs * K);
+    for (std::size_t k = 0; k < K; k++) {
+        double ICa = settings[k].gmaxca * std::pow(m0, 3) * (ihc_cilia_restingV - synapse.ECa);
+        double Ca = -ICa * settings[k].tauCa;
+        double kt0 = synapse.z * std::pow(Ca, synapse.power);
+        for (std::size_t bf = 0; bf < n_BFs; bf++) {
+            CaCurrent_[bf * K + k] = Ca;
+            synapse.kt0[bf * K + k] = kt0;
+        }
+    }
+    synapse.dt = dt_;
+    synapse.n_BFs = n_BFs;
+    synapse.n_AN_channels = n_BFs * K;
+    an.init(synapse, fs);
+}
+
+template <typename T>
+void BasicSynapseSweep<T>::run(const BasicMatrix<T> &ihc_receptor_potential, double ihc_cilia_restingV, double fs) {
+    init(ihc_cilia_restingV, ihc_receptor_potential.rows(), fs);
+    apply(ihc_receptor_potential, nullptr, true);
+}
+
+template <typename T>
+void BasicSynapseSweep<T>::apply(const BasicMatrix<T> &ihc_receptor_potential, Profile *profile, bool flush) {
+    Stopwatch watch;
+    std::size_t signal_length = ihc_receptor_potential.cols();
+    vesicle_release_rate.assign(n_BFs_ * settings.size(), signal_length);
+
+    /* As AnIhcSynapse::apply: BFs across threads when there are enough,
+     * otherwise time */
+    const std::size_t kRowAlign = 8;
+    const std::size_t threads = (std::size_t)(n_threads > 0 ? n_threads : num_threads());
+    if (n_BFs_ >= kRowAlign * threads || threads == 1) {
+        parallel_for(
+            n_BFs_,
+            [&](std::size_t b0, std::size_t b1) {
+                run_kernel(ihc_receptor_potential, b0, b1, 0, signal_length, mICaCurrent_.data(),
+                           CaCurrent_.data());
+            },
+            n_threads, kRowAlign, kRowAlign);
+    } else {
+        std::vector<double> state(mICaCurrent_);
+        state.insert(state.end(), CaCurrent_.begin(), CaCurrent_.end());
+        parallel_in_time(
+            state, signal_length,
+            [&](double *s, std::size_t c0, std::size_t c1) {
+                run_kernel(ihc_receptor_potential, 0, n_BFs_, c0, c1, s, s + n_BFs_);
+            },
+            n_threads);
+        std::copy(state.begin(), state.begin() + n_BFs_, mICaCurrent_.begin());
+        std::copy(state.begin() + n_BFs_, state.end(), CaCurrent_.begin());
+    }
+    if (profile != nullptr) {
+        profile->record("synapse_sweep", watch.seconds(), signal_length, vesicle_release_rate.bytes());
+    }
+    an.apply(vesicle_release_rate, profile, flush);
+}
+
+template <typename T>
+void BasicSynapseSweep<T>::run_kernel(const BasicMatrix<T> &ihc_receptor_potential, std::size_t b0, std::size_t b1,
+                                      std::size_t c0, std::size_t c1, double *m, double *Ca) {
+    const std::size_t K = settings.size();
+    const double c = 1 - dt_ / synapse.tauM;
+    const double gamma = synapse.gamma, beta = synapse.beta, ECa = synapse.ECa, z = synapse.z;
+    const double power = synapse.power;
+    const bool cube = power == 3;
+    const double *__restrict gmaxca = gmaxca_.data();
+    const double *__restrict C = C_.data();
+    const double *__restrict one_minus_C = one_minus_C_.data();
+    const double *__restrict thresh = thresh_.data();
+
+    for (std::size_t col = c0; col < c1; col++) {
+        const T *V = ihc_receptor_potential.data() + col * n_BFs_;
+        T *rate = vesicle_release_rate.data() + col * n_BFs_ * K;
+        for (std::size_t bf = b0; bf < b1; bf++) {
+            /* mICa, shared by all settings */
+            double mICaINF = 1 / (1 + std::exp((T)(-gamma * V[bf])) / beta);
+            double mi = m[bf] * c + mICaINF * (1 - c);
+            m[bf] = mi;
+            const double m3 = mi * mi * mi, dV = V[bf] - ECa;
+
+            /* Settings in lanes, with the arithmetic of AnIhcSynapse */
+            double *__restrict ca = Ca + bf * K;
+            T *__restrict r = rate + bf * K;
+            if (cube) {
+                for (std::size_t k = 0; k < K; k++) {
+                    double v = ca[k] * C[k] + gmaxca[k] * m3 * dV * one_minus_C[k];
+                    ca[k] = v;
+                    r[k] = (T)std::max(z * (-v * -v * -v - thresh[k]), 0.0);
+                }
+            } else {
+                for (std::size_t k = 0; k < K; k++) {
+                    double v = ca[k] * C[k] + gmaxca[k] * m3 * dV * one_minus_C[k];
+                    ca[k] = v;
+                    r[k] = (T)std::max(z * (std::pow(-v, power) - thresh[k]), 0.0);
+                }
+            }
+        }
+    }
+}
+
+template <typename T>
+BasicMatrix<T> BasicSynapseSweep<T>::setting_output(const BasicMatrix<T> &output, std::size_t k) const {
+    const std::size_t K = settings.size();
+    if (k >= K || output.rows() != n_BFs_ * K) {
+        throw std::invalid_argument("SynapseSweep: no such setting in this output");
+    }
+    BasicMatrix<T> out(n_BFs_, output.cols());
+    for (std::size_t col = 0; col < output.cols(); col++) {
+        for (std::size_t bf = 0; bf < n_BFs_; bf++) {
+            out(bf, col) = output(bf * K + k, col);
+        }
+    }
+    return out;
+}
+
+template class BasicSynapseSweep<double>;
+template class BasicSynapseSweep<float>;
+
+} // namespace earing
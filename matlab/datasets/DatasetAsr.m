@@ -47,6 +47,26 @@ classdef DatasetAsr < Dataset
             obj.init_subsets();  % .data
             obj.run()            % copy files
         end
+        
+        function write_batch_list(obj, list_path, output_folder)
+            % List of 'wav usr' pairs for the native batch runner, with the
+            % .usr paths of SingleRunAsr.wav2usr in output_folder:
+            %   earing_run --features r_l_d_dd --list list_path
+            % runs them on all cores, longest first, skipping existing files
+            % (the wav files being resampled to 1e5 Hz as audioread_at_given_dB)
+            f = fopen(list_path, 'w');
+            assert(f >= 0, list_path)
+            for wav_file = obj.data.input
+                usr_folder = fullfile(output_folder, wav_file.type);
+                if ~exist(usr_folder, 'dir')
+                    mkdir(usr_folder);
+                end
+                usr_name = strcat(strrep(wav_file.name, '.wav', ''), '.usr');
+                fprintf(f, '%s\t%s\n', fullfile(obj.folder.input, wav_file.name), ...
+                    fullfile(usr_folder, usr_name));
+            end
+            fclose(f);
+        end
     end
     
     methods (Access=private)
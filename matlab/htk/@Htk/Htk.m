@@ -247,12 +247,22 @@ classdef Htk < RunObject
             data = htkread(usr_path);
         end
         
+        function header = load_header(usr_path)
+            % n_frames, n_features, samp_period, parm_kind; reads 12 bytes only
+            header = htkreadheader(usr_path);
+        end
+        
         function save(usr_path, data)
             % Save in HTK format: a row per time step
             parent_folder = fileparts(usr_path);
             assert(exist(parent_folder, 'dir')==7, usr_path)
             assert(endsWith(usr_path, '.usr'), usr_path)
-            htkwrite(data', usr_path, 9);
+            if exist(['htkWriteFile.' mexext], 'file')
+                % Native writer; takes a column per time step as data
+                htkWriteFile(usr_path, double(data), 9);
+            else
+                htkwrite(data', usr_path, 9);
+            end
         end
         
         function write_to_file(file_path, input, option)
@@ -14,6 +14,14 @@ function [ DATA, HTKCode ] = htkread( Filename )
 % July 3, 2002
 % Based on function mfcc_read written by Alexis Bernard
 %
+% Uses the native reader htkReadFile (memory-mapped, see mex/) when built.
+%
+
+if exist(['htkReadFile.' mexext], 'file')
+    [DATA, HTKCode] = htkReadFile(Filename);
+    DATA = DATA';
+    return;
+end
 
 fid=fopen(Filename,'r','b');
 if fid<0,
@@ -0,0 +1,36 @@
+function header = htkreadheader( Filename )
+% header = htkreadheader( Filename )
+%
+% Read the header of an HTK format file only, without its data.
+%
+% Filename (string) - Name of the file to read from
+% header - struct with n_frames and n_features (size(htkread(Filename))),
+%  samp_period (in 100ns units) and parm_kind (HTKCode)
+%
+% Uses the native reader htkReadHeader (see mex/) when built.
+%
+
+if exist(['htkReadHeader.' mexext], 'file')
+    header = htkReadHeader(Filename);
+    return;
+end
+
+fid=fopen(Filename,'r','b');
+if fid<0,
+    error(sprintf('Unable to read from file %s',Filename));
+end
+
+% Same fields as htkread
+nSamp = fread(fid,1,'int32');
+sampPeriod = fread(fid,1,'int32');
+sampSize = fread(fid,1,'int16');
+HTKCode = fread(fid,1,'int16');
+fclose(fid);
+
+if bitget(HTKCode, 11),
+    header = struct('n_frames', nSamp-4, 'n_features', sampSize/2, ...
+        'samp_period', sampPeriod, 'parm_kind', HTKCode);
+else
+    header = struct('n_frames', nSamp, 'n_features', sampSize/4, ...
+        'samp_period', sampPeriod, 'parm_kind', HTKCode);
+end
@@ -23,6 +23,8 @@ function htkwrite( DATA, Filename, HTKCode, sampPeriod )
 % July 3, 2002
 % Based on function mfcc_write written by Alexis Bernard
 %
+% Uses the native writer htkWriteFile (see mex/) when built.
+%
 
 % Find out whether or not compression is requested
 if nargin<3, 
@@ -30,6 +32,14 @@ if nargin<3,
    HTKCode = bitset(HTKCode, 7); % Set the energy bit
    HTKCode = bitset(HTKCode, 11); % Set the compression bit
 end
+if nargin<4,
+    sampPeriod = 100000;
+end
+
+if exist(['htkWriteFile.' mexext], 'file')
+    htkWriteFile(Filename, double(DATA'), HTKCode, sampPeriod);
+    return;
+end
 
 % Open the file
 fid=fopen(Filename,'w','ieee-be');
@@ -40,11 +50,6 @@ end
 % Find nSamp and NCOFS
 [ nSamp, NCOFS ] = size(DATA);
 
-% Write sampPeriod
-if nargin<4,
-    sampPeriod = 100000;
-end
-
 % If data are compressed, write compression parameters and compressed data
 if bitget(HTKCode, 11),
     sampSize = 2*NCOFS;
@@ -23,21 +23,27 @@ classdef AuditoryNerve < RunObject
         dt
         tauCas
         
-        prob_firing
+        prob_firing  % of the class of the vesicle release rate (double or single)
         prob_firing_refractory % probability of firing with refractoriness
-        % speedUpFactor % should be put back 
+        % spdupf:spdupf:signal_length, spdupf = ceil(fs / spikesTargetSampleRate):
+        % prob_firing and the spikes are computed at fs / spdupf
         speedup_vector
         refractory_period
         lengthAbsRefractory
         
         % PSTH 
         % If psth>1, MAP_AN_generatePoissonSpikeTrains generates PSTH
-        % (double array) instead of spike trains (logical array),
+        % (uint16 array) instead of spike trains (logical array),
         % counting the nnumber of spikes falling in each bins for 'PSTH'
-        % repetitions of the stimulus (useful for easy firing rate evaluation)
+        % repetitions of the stimulus (useful for easy firing rate evaluation),
+        % and spikes_sparse holds these counts divided by psth
         psth = 1 
         spikes_sparse  % output of run_spike
         
+        % Seed of the spike trains: [] for new ones at each run, or a
+        % non-negative integer for reproducible spikes
+        seed = []
+        
         % Reservoirs
         cleft
         available
@@ -48,6 +54,16 @@ classdef AuditoryNerve < RunObject
         output_mode {mustBeMember(output_mode,{'SPIKE','PROB'})} = 'SPIKE'
         
         refractoriness = false  % if True, calculate the refractoriness
+        
+        % If true, spikes are fired by n_fibers_per_channel stochastic
+        % synapses per channel (binomial vesicle release, see the stochastic
+        % mode of MAP_finalForLoop_mex) instead of drawn from prob_firing
+        quantal_release = false
+        
+        % Wall time of the steps of the last run (an_prob, an_refractoriness,
+        % an_spikes) and the property holding their output, for the profile
+        % of EarSumner2002
+        timings = struct('stage', {}, 'seconds', {}, 'output', {})
     end
     
     methods
@@ -89,16 +105,28 @@ classdef AuditoryNerve < RunObject
             an.init_speedUpFactor(stimulus, fs, synapse.spikesTargetSampleRate)
             an.init(synapse);
             
+            % Starting reservoirs, before run_prob changes them in place
+            reservoirs = {an.available + 0, an.cleft + 0, an.reprocess + 0};
+            t = tic;
             an.run_prob(synapse.vesicle_release_rate)
+            an.timings = struct('stage', 'an_prob', 'seconds', toc(t), 'output', 'prob_firing');
             
             if an.refractoriness
+                t = tic;
                 an.run_prob_refractoriness()
+                an.timings(end+1) = struct('stage', 'an_refractoriness', 'seconds', toc(t), 'output', 'prob_firing_refractory');
             end
             
             switch an.output_mode
                 case 'PROB'  % all done
                 case 'SPIKE' % actually, more to do...
-                    an.run_spike()
+                    t = tic;
+                    if an.quantal_release
+                        an.run_quantal_release(synapse.vesicle_release_rate, reservoirs{:})
+                    else
+                        an.run_spike()
+                    end
+                    an.timings(end+1) = struct('stage', 'an_spikes', 'seconds', toc(t), 'output', 'spikes_sparse');
             end
             an.has_run = 1;
         end
@@ -146,7 +174,6 @@ classdef AuditoryNerve < RunObject
         end
         
         function init_speedUpFactor(an, stimulus, fs, synapse_spikesTargetSampleRate)
-            % warning('init_speedUpFactor: NOT REIMPLEMENTED YET; probably shouldn''t be at this point in pipeline');
             spdupf = ceil(fs / synapse_spikesTargetSampleRate);
             
             % stimulus = obj.input.stimulus;
@@ -188,52 +215,42 @@ classdef AuditoryNerve < RunObject
         end
         
         function run_prob(an, synapse_vesicle_release_rate)
-            % speed up code removed out of sheer laziness
+            % Decimated by spdupf (first value of speedup_vector) in the MEX
+            % file, with an.dt already the decimated time frame
             prob_release = synapse_vesicle_release_rate * an.dt;
             an.prob_firing = MAP_finalForLoop_mex(1, prob_release, an.available, an.reprocess, an.M, an.xdt, an.ydt, an.rdt_plus_ldt,an.rdt,an.cleft,int32(an.speedup_vector),an.lengthAbsRefractory);
         end
         
+        function run_quantal_release(an, synapse_vesicle_release_rate, available, cleft, reprocess)
+            prob_release = synapse_vesicle_release_rate * an.dt;
+            n_threads = 0;  % default
+            an.spikes_sparse = MAP_finalForLoop_mex(an.n_fibers_per_channel, prob_release, available, reprocess, an.M, an.xdt, an.ydt, an.rdt_plus_ldt, an.rdt, cleft, int32(an.speedup_vector), an.lengthAbsRefractory, an.seed, n_threads);
+        end
+        
         function run_prob_refractoriness(an)
             an.prob_firing_refractory = MAP_addRefractoriness(an.prob_firing, an.lengthAbsRefractory * an.dt, an.dt);
         end
         
         function run_spike(an)
-            n_fiberPerInd = 1;
-            
+            % The spike generators take double rates only
+            prob_firing_ = double(an.prob_firing);
             if an.psth == 1
-                an.spikes_sparse = sparse(an.n_channels * an.n_fibers_per_channel, size(an.prob_firing,2));
-                for k = 1:an.n_fibers_per_channel
-                    spikes_partial = get_spikes(an, n_fiberPerInd);
-                    if an.n_fibers_per_channel == 1
-                        % fast enough
-                        an.spikes_sparse = sparse(spikes_partial); 
-                    else
-                        % very, very slow
-                        an.spikes_sparse(k:an.n_fibers_per_channel:end) = sparse(spikes_partial); 
-                    end
-                end
+                % All fibers of all channels at once, directly as a sparse matrix
+                algo = 1;
+                n_threads = 0;  % default
+                an.spikes_sparse = MAP_AN_generateSparseSpikeTrains(an.n_fibers_per_channel, ...
+                    an.lengthAbsRefractory, prob_firing_, algo, an.seed, n_threads);
                 return
             end
             
-            spa_ANspikes = sparse(an.n_fibers .* size(an.prob_release,1), size(an.prob_release,2));
-            for kk = 1:(an.n_fibers / n_fiberPerInd)
-                % strides 
-                cind = kk - 1 + 1:(an.n_fibers / n_fiberPerInd):an.n_fibers;
-                spikes = get_spikes(an, n_fiberPerInd);
-                for pp = 2:an.psth
-                    spikes = spikes + get_spikes(an, n_fiberPerInd);
-                end
-                
-                % This is slow, but haven't seen faster:
-                spa_ANspikes(cind, :) = sparse(spikes/an.psth); %#ok
-            end
-            an.spikes_sparse = spa_ANspikes;
-        end
-        
-        function spikes = get_spikes(an, n_fiberPerInd)
+            % PSTH: spike counts of the psth repetitions of all fibers,
+            % accumulated in parallel by the MEX file without the spike trains
             algo = 1;
             print_stuff = 0;
-            spikes =  MAP_AN_generatePoissonSpikeTrains(n_fiberPerInd, an.lengthAbsRefractory, an.prob_firing, algo, print_stuff);
+            n_threads = 0;  % default
+            counts = MAP_AN_generatePoissonSpikeTrains(an.n_fibers_per_channel, an.lengthAbsRefractory, ...
+                prob_firing_, algo, print_stuff, an.seed, n_threads, an.psth);
+            an.spikes_sparse = sparse(double(counts) / an.psth);
         end
         
     end
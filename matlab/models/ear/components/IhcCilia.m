@@ -28,14 +28,14 @@ classdef IhcCilia < RunObject
         C    =  16;       % gain factor (dB)
         C_s  double       % scalar version of C  % used 
         Ga double         % leakage
-        Gu double
+        Gu  % class of the cilia displacement
         restingCiliaCond double
         restingV double
         
-        cilia_displacement double % first run part output
+        cilia_displacement % first run part output, of the class of bm_velocity
         run_cilia_displacement = @run_CD_mex  % fastest option; requires mex
         
-        receptor_potential double % second run part output
+        receptor_potential % second run part output, of the class of bm_velocity
         run_receptor_potential = @run_RP_mex  % fastest (x80 run_RP_for_loop)
     end
     
@@ -57,9 +57,9 @@ classdef IhcCilia < RunObject
             
             % init
             o.dt = 1/fs;
-            o.init_cilia_displacement(n_BFs, signal_length);
+            o.init_cilia_displacement(n_BFs, signal_length, class(bm_velocity));
             % o.C_s = 10 ^ (o.C / 20); % Scalar conversion; used later? should be calculated later then
-            o.init_receptor_potential(n_BFs, signal_length);
+            o.init_receptor_potential(n_BFs, signal_length, class(bm_velocity));
             
             % Apply gain
             bm_velocity_g = bm_velocity * o.C_s; 
@@ -84,13 +84,13 @@ classdef IhcCilia < RunObject
         
         %%%%%%% RECEPTOR POTENTIAL %%%%%%%
         
-        function init_receptor_potential(o, n_BFs, signal_length)
-            o.receptor_potential = zeros(n_BFs, signal_length);
+        function init_receptor_potential(o, n_BFs, signal_length, class_name)
+            o.receptor_potential = zeros(n_BFs, signal_length, class_name);
         end
         
         function [IHC_Vnow, C, A] = get_RP_inputs(o)
             n_BFs = size(o.cilia_displacement, 1);
-            IHC_Vnow = o.restingV * ones(n_BFs,1);
+            IHC_Vnow = o.restingV * ones(n_BFs, 1, class(o.receptor_potential));
             C = 1 + (- o.Gk - o.Gu) * o.dt / o.Cab;
             A = (o.Gu .* o.Et + o.Gk * o.Ekp) * o.dt / o.Cab;
         end
@@ -110,15 +110,16 @@ classdef IhcCilia < RunObject
         
         %%%%%%% CILIA_DISPLACEMENT %%%%%%%
         
-        function init_cilia_displacement(o, n_BFs, signal_length)
-            o.cilia_displacement = zeros(n_BFs,signal_length);
+        function init_cilia_displacement(o, n_BFs, signal_length, class_name)
+            o.cilia_displacement = zeros(n_BFs,signal_length, class_name);
         end
         
         function [uNow,cParam,A] = get_CD_inputs(o, DRNLresponse)
             [n_BFs, ~] = size(o.cilia_displacement);
             A = o.dt * DRNLresponse;    % Matrix
-            uNow = zeros(n_BFs, 1);     % Vector
-            cParam = (1-o.dt/o.tc);     % Double
+            % Same class as the matrix for MAP_AN_forLoop_mex
+            uNow = zeros(n_BFs, 1, class(A));          % Vector
+            cParam = cast(1-o.dt/o.tc, class(A));      % Scalar
         end
         
         function run_CD_mex(o, uNow,cParam,A)
@@ -59,7 +59,7 @@ classdef AnIhcSynapse < IhcPreSynapse
             [n_BFs, signal_length] = size(ihc_receptor_potential);
             % init
             o.dt = 1/fs;
-            o.init(signal_length, ihc_cilia_restingV, n_BFs);
+            o.init(signal_length, ihc_cilia_restingV, n_BFs, class(ihc_receptor_potential));
             
             % Replicate IHC_RP for each fiber type to obtain the driving voltage
             Vsynapse = repmat(ihc_receptor_potential, o.n_AN_fiber_types, 1);
@@ -98,7 +98,9 @@ classdef AnIhcSynapse < IhcPreSynapse
         end
         
         function run_mICa_mex(o, c, mICaINF)
-            MAP_AN_forLoop_mex(o.mICa, o.mICaCurrent, c, mICaINF * (1-c))
+            % All inputs of the class of mICa (double or single)
+            class_name = class(o.mICa);
+            MAP_AN_forLoop_mex(o.mICa, cast(o.mICaCurrent, class_name), cast(c, class_name), mICaINF * (1-c))
         end
         
         function run_mICa_fft(o, c, mICaINF)
@@ -125,7 +127,8 @@ classdef AnIhcSynapse < IhcPreSynapse
         
         function run_SCa_mex(o, CaCurrent, C, ICa)
             A = bsxfun(@times, ICa, 1-C);       % matrix
-            MAP_AN_forLoop_mex(o.synapticCa, CaCurrent, C, A);
+            class_name = class(o.synapticCa);
+            MAP_AN_forLoop_mex(o.synapticCa, cast(CaCurrent, class_name), cast(C, class_name), A);
             o.synapticCa = -o.synapticCa;
         end
         
@@ -146,12 +149,13 @@ classdef AnIhcSynapse < IhcPreSynapse
         
         %%%%%%%%
       
-        function init(o, signal_length, ihc_cilia_restingV, n_BFs)
+        function init(o, signal_length, ihc_cilia_restingV, n_BFs, class_name)
             n_AN_fiber_types_ = length(o.tauCa); % TODO: this is strange though...
             n_AN_channels_ = n_AN_fiber_types_ * n_BFs;
 
-            o.synapticCa = zeros(n_AN_channels_, signal_length);
-            o.mICa = zeros(n_AN_channels_, signal_length);
+            % Of the class of the receptor potential (double or single)
+            o.synapticCa = zeros(n_AN_channels_, signal_length, class_name);
+            o.mICa = zeros(n_AN_channels_, signal_length, class_name);
             
             % tauCas vector is established across channels to allow vectorization
             %  (one tauCa per channel).
@@ -7,10 +7,30 @@ classdef EarSumner2002 < Ear
     % - ear.cilia.run: simulates the IHC cilia potential and resting voltage
     % - ear.synapse.run: simulates the synapses molecular variations
     % - ear.an.run: simulates the probability of firing (and optionally the spikes)
+    %
+    % With profiling = true, run records the wall time, throughput, bytes
+    % held and peak resident set after every stage in ear.profile (the AN
+    % being split into an_prob, an_refractoriness and an_spikes); with
+    % profile_log set as well, each run appends them to that CSV file (as
+    % earing_run --profile-log), e.g. across the files of a dataset.
+    %
+    % With single = true, the stages from the cilia on run in single
+    % precision (the MEX files taking and returning single arrays), halving
+    % the memory of their matrices; the reservoirs of the AN and the spike
+    % generation stay in double.
     
     properties 
         db double = 80
         best_frequencies double  % set at initialisation for consistency
+        
+        profiling logical = false
+        profile_log char = ''
+        
+        single logical = false
+    end
+    
+    properties (SetAccess=private)
+        profile = struct('stage', {}, 'seconds', {}, 'samples', {}, 'samples_per_second', {}, 'bytes', {}, 'peak_rss', {})
     end
     
     properties (Access=private)
@@ -39,7 +59,7 @@ classdef EarSumner2002 < Ear
             
             % Checks
             if length(stimulus) > 10000000
-                warning('Cut unless you have a lot of memory'); end
+                warning('Cut unless you have a lot of memory (or run it in chunks with the native earing_run --chunk)'); end
             if abs(fs_ - ear.fs)>10
                 error('The sample rate should be 1e5 Hz: Use function ''resample''.'); end
             
@@ -52,19 +72,68 @@ classdef EarSumner2002 < Ear
         
         function run(ear, wav_file_or_signal)
             stimulus = init_input(ear, wav_file_or_signal);
+            ear.profile = ear.profile([]);
             
+            t = tic;
             ear.ome.run(stimulus, ear.fs);
+            ear.add_profile('ome', toc(t), length(stimulus), component_bytes(ear.ome));
+            t = tic;
             ear.bm.run(ear.ome.stapes_velocity, ear.ome.stapes_scalar, ear.fs); % TODO: remove stapes_scalar transmission
-            ear.cilia.run(ear.bm.velocity, ear.fs);
+            ear.add_profile('bm', toc(t), length(stimulus), component_bytes(ear.bm));
+            t = tic;
+            if ear.single
+                ear.cilia.run(single(ear.bm.velocity), ear.fs);
+            else
+                ear.cilia.run(ear.bm.velocity, ear.fs);
+            end
+            ear.add_profile('cilia', toc(t), length(stimulus), component_bytes(ear.cilia));
+            t = tic;
             ear.synapse.run(ear.cilia.receptor_potential, ear.cilia.restingV, ear.fs);
+            ear.add_profile('synapse', toc(t), length(stimulus), component_bytes(ear.synapse));
             ear.an.run(ear.synapse, stimulus, ear.fs);  % TODO: relocate init_speedUpFactor
+            for timing = ear.an.timings
+                output = ear.an.(timing.output); %#ok
+                info = whos('output');
+                ear.add_profile(timing.stage, timing.seconds, length(stimulus), info.bytes);
+            end
             ear.has_run = true;
+            
+            if ear.profiling && ~isempty(ear.profile_log)
+                ear.append_profile(wav_file_or_signal);
+            end
         end
      
     end
     
     methods (Access=private)
         
+        function add_profile(ear, stage, seconds, samples, bytes)
+            if ~ear.profiling
+                return
+            end
+            ear.profile(end+1) = struct('stage', stage, 'seconds', seconds, 'samples', samples, ...
+                'samples_per_second', samples / seconds, 'bytes', bytes, 'peak_rss', peak_resident_set());
+        end
+        
+        function append_profile(ear, wav_file_or_signal)
+            % Same columns as earing_run --profile-log, one call per stage
+            label = '';
+            if ischar(wav_file_or_signal)
+                label = wav_file_or_signal;
+            end
+            new_file = ~exist(ear.profile_log, 'file');
+            fid = fopen(ear.profile_log, 'a');
+            if fid < 0
+                error('Unable to write to file %s', ear.profile_log); end
+            if new_file
+                fprintf(fid, 'label,stage,calls,seconds,samples,samples_per_second,bytes,peak_rss\n'); end
+            for s = ear.profile
+                fprintf(fid, '%s,%s,1,%g,%d,%g,%d,%d\n', label, s.stage, s.seconds, s.samples, ...
+                    s.samples_per_second, s.bytes, s.peak_rss);
+            end
+            fclose(fid);
+        end
+        
         function prob_firing = run_prob(obj, wav_file)
             obj.run(wav_file);
             if obj.ear.refractoriness
@@ -75,4 +144,32 @@ classdef EarSumner2002 < Ear
         end
     end
 
-end
\ No newline at end of file
+end
+
+function bytes = component_bytes(component)
+% Bytes of the arrays held by the properties of an ear component
+bytes = 0;
+for p = properties(component)'
+    value = component.(p{1});
+    if isnumeric(value) || islogical(value)
+        info = whos('value');
+        bytes = bytes + info.bytes;
+    end
+end
+end
+
+function bytes = peak_resident_set()
+% Peak resident set of the Matlab process (Linux; current memory use on
+% Windows), 0 where unknown
+bytes = 0;
+if ispc
+    m = memory;
+    bytes = m.MemUsedMATLAB;
+elseif exist('/proc/self/status', 'file')
+    status = fileread('/proc/self/status');
+    kb = regexp(status, 'VmHWM:\s*(\d+)', 'tokens', 'once');
+    if ~isempty(kb)
+        bytes = str2double(kb{1}) * 1024;
+    end
+end
+end
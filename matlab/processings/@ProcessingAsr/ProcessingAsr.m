@@ -93,7 +93,7 @@ classdef ProcessingAsr < Processing
                 
                 case {'ISI'}
                     % Calculate the ISI matrix (column-wise)
-                    data = calculateISI(data);
+                    data = calculateISI(data, false);
                     
                 case {'l','l0', 'log10'}
                     data = log10(1+data);
@@ -174,7 +174,7 @@ classdef ProcessingAsr < Processing
                     data = calculateRate(data, obj.fs, obj.window, obj.rate_window_duration, obj.rate_time_step);
                     
                 case {'ri', 'RI', 'rateInverse'}
-                    data = 1./calculateISI(data);
+                    data = calculateISI(data, true);
                     
                 case {'s', 'sgbfb'}
                     data = sgbfb(data);
@@ -201,12 +201,20 @@ classdef ProcessingAsr < Processing
 
 end
 
-function featsISI = calculateISI(feats)
-% calculate ISI matrix
+function featsISI = calculateISI(feats, inverse)
+% calculate ISI matrix (its inverse if inverse)
+if issparse(feats)
+    % Spike trains stay sparse: spikes2ISI returns one row per train
+    featsISI = spikes2ISI(feats', inverse);
+    return;
+end
 hSp = full(feats)';
 count = zeros(size(hSp));
 spikes2ISI(hSp, count);
 featsISI = count';
+if inverse
+    featsISI = 1./featsISI;
+end
 end
 
 function feats = averagingNeighbours(feats, nbFeat, comp)
@@ -291,21 +299,21 @@ if isempty(beginInd)
 end
 
 if ~exist(['rateSpikeTrain.' mexext], 'file')
-    try
-        mex 'rateSpikeTrain.c';
-    catch
-        % Without mex file. You may
-        fprintf('speechreco_extractFeatures.m < batchRate: Couldn''t mex file for rate\n');
-        nbCol = size(feats, 2);
-        movingHann = @(b)[ zeros(1,b-1) window(nbSamp)' zeros(1,1+nbCol-(b+nbSamp)) ];
-        hannWindows_spkTr_rate = cell2mat(arrayfun(movingHann, beginInd, 'uni', false)');
-        nfeats = feats*hannWindows_spkTr_rate';
-        return;
-    end
+    % Without mex file (built with the native library, see README)
+    fprintf('ProcessingAsr.m < batchRate: rateSpikeTrain not found, rate computed in Matlab\n');
+    nbCol = size(feats, 2);
+    movingHann = @(b)[ zeros(1,b-1) window(nbSamp)' zeros(1,1+nbCol-(b+nbSamp)) ];
+    hannWindows_spkTr_rate = cell2mat(arrayfun(movingHann, beginInd, 'uni', false)');
+    nfeats = feats*hannWindows_spkTr_rate';
+    return;
+end
+% with mex file; tranpose to concatenate later
+if issparse(feats)
+    % Spike trains stay sparse: each spike is added to its windows only
+    cfeat = feats';
+else
+    cfeat = double(full(feats'));
 end
-% with mex file
-cfeat = double(full(feats'));
-% tranpose to concatenate later
 w = window(nbSamp);
 nfeats = rateSpikeTrain(cfeat, beginInd, w)'/sum(w);
 end
@@ -321,8 +329,8 @@ assert(nbSamp<nbCol, sprintf('size(feats)=%d,%d, slice=%f, nbSamp=%d, nbCol=%d',
 % Indices at which we convolve a Hann window
 beginInd = 1:floor(time_step*fs):floor(nbCol-nbSamp);
 
-% Allocate and loop if too big
-if numel(feats) < 1e9
+% Allocate and loop if too big (sparse spike trains are never made dense)
+if issparse(feats) || numel(feats) < 1e9
     nfeats = batchRate(feats, window, beginInd, nbSamp);
 else
     nfeats = zeros(size(feats,1),length(beginInd));
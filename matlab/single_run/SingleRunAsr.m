@@ -73,13 +73,14 @@ classdef SingleRunAsr < RunObject
                     % Clear
                     return
                 else
-                    % Was run and saved, but object got reinitialised
-                    data = this.htk.load(usr_path);
+                    % Was run and saved, but object got reinitialised: the
+                    % header is enough to know the number of features
+                    header = this.htk.load_header(usr_path);
                     k = length(this.output);
                     this.output(k+1).path = usr_path;
                     this.output(k+1).name = usr_name;
                     this.output(k+1).type = usr_type;
-                    this.output(k+1).n_features = size(data, 2);  % here, size(,2)=n_features
+                    this.output(k+1).n_features = header.n_features;
                     return
                 end
             end
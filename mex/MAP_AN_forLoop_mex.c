@@ -1,11 +1,16 @@
 /* Based on the c file generated by Matlab
  * Mex file doing the computation to compute IHC_RP, synapticCa, ...
+ * Thin wrapper over earing_first_order_recurrence (cpp/src/recurrence.cpp).
  *
  * Inputs: See list below. matrix_in is the matrix in which the output will be put.
- *  All inputs are double arrays, except for the first that is expected to be int32.
- * Output: None at the moment. Code given below if we want to allocate memory and make an output.
+ *  All inputs are double arrays, or all single arrays (earing_first_order_recurrence_single: the
+ *  recurrence is still carried in double within a call, vector being rounded at its end).
+ * Output: None at the moment.
  * Beware: The values of matrix_in and vector_in are changed by the MEX file.
- * Run in Matlab "mex MAP_AN_forLoop.c" to use this file, then MAP_AN_forLoop(int32(.),.,.,.,. )
+ * Build the native library first (see README), then MAP_AN_forLoop_mex(matrix, vector, C, A)
+ * or MAP_AN_forLoop_mex(matrix, vector, C, A, nThreads). Rows are processed in parallel, by
+ * default on as many threads as cores (or EARING_NUM_THREADS); the result does not depend
+ * on nThreads.
  *
 
   case 1: matrix=IHCciliaDisplacement,  vector=uNow,          C double
@@ -16,16 +21,9 @@
   Main body: loop over columns, loop over rows. 
   for (idx = 0; idx < matrix_size2 ; idx++) {
     for (row = 0; row < matrix_size1; row++){
-       // Current index: ind = row + idx * matrix_size1; 
-      ind++; 
-
-      // Read release probability (c not defined) 
       c = [ *C  or  C[row]  or  C[ind] ]
-      val = vector_in[row] * c + A[ind];
-
-      // Save in the current index 
-      vector[row] = val;
-      matrix[ind] = [+ or -] val;
+      vector[row] = vector[row] * c + A[ind];
+      matrix[ind] = vector[row];
     }
   } 
   
@@ -33,6 +31,7 @@
 
 #include "mex.h"
 #include "matrix.h"
+#include "earing/earing.h"
 
 void mexFunction(int nlhs, mxArray *plhs[],int nrhs, const mxArray *prhs[])
 {
@@ -41,62 +40,35 @@ void mexFunction(int nlhs, mxArray *plhs[],int nrhs, const mxArray *prhs[])
   #define vector_in prhs[1]
   #define C_in prhs[2]
   #define A_in prhs[3]
+  #define n_threads_in prhs[4]
 
-  /* Variables */
-  int ind = 0;        /* Running index */
-  int idx;            /* Column index */
-  int row;            /* Row index */
-  double val;         /* Value to calculate */
-  double *C, *A, *vector, *matrix; /* Copy inputs */
-  int mat_size1, mat_size2, C_size1, C_size2; /* Size of C and matrix */
+  size_t mat_size1, mat_size2; /* Size of matrix */
+  int n_threads = 0;           /* Default number of threads */
+  int status;
 
-  /* Copy original input vectors, get size of C and matrix */
-  C         = (double *) mxGetPr(C_in);
-  A         = (double *) mxGetPr(A_in);
-  vector    = (double *) mxGetPr(vector_in);  
-  matrix    = (double *) mxGetPr(matrix_in);
-  C_size1   = (int) mxGetM(C_in);
-  C_size2   = (int) mxGetN(C_in);
-  mat_size1 = (int) mxGetM(matrix_in);
-  mat_size2 = (int) mxGetN(matrix_in);
+  if (nrhs < 4){ mexErrMsgTxt("MAP_AN_forLoop_mex(matrix, vector, C, A): not enough input arguments\n"); }
 
-  if (C_size1 == 1 && C_size2 == 1){
-    /* printf("Case 1: IHCciliaDisplacement or mICa\n"); */
-    for (idx = 0; idx < mat_size2 ; idx++) {
-      for (row = 0; row < mat_size1; row++){
-        val = vector[row] * *C + A[ind];
-        vector[row]   = val;
-        matrix[ind++] = val;
-      }
-    } 
+  mat_size1 = mxGetM(matrix_in);
+  mat_size2 = mxGetN(matrix_in);
+  if (mxGetM(A_in) != mat_size1 || mxGetN(A_in) != mat_size2){ mexErrMsgTxt("A should have the size of matrix\n"); }
+  if (mxGetNumberOfElements(vector_in) != mat_size1){         mexErrMsgTxt("vector should have one value per row of matrix\n"); }
+  if (!mxIsDouble(matrix_in) && !mxIsSingle(matrix_in)){ mexErrMsgTxt("matrix should be double or single\n"); }
+  if (mxGetClassID(vector_in) != mxGetClassID(matrix_in) || mxGetClassID(C_in) != mxGetClassID(matrix_in) ||
+      mxGetClassID(A_in) != mxGetClassID(matrix_in)){
+    mexErrMsgTxt("matrix, vector, C and A should be all double or all single\n");
   }
+  if (nrhs > 4){ n_threads = (int)mxGetScalar(n_threads_in); }
 
-  if (C_size1 != 1 && C_size2 == 1){
-    /* printf("Case 2: - synapticCa\n"); */
-    for (idx = 0; idx < mat_size2 ; idx++) {
-      for (row = 0; row < mat_size1; row++){
-        val = vector[row] * C[row] + A[ind];
-        vector[row]   = val;
-        matrix[ind++] = val;
-      }
-    }   
+  if (mxIsSingle(matrix_in)){
+    status = earing_first_order_recurrence_single((float *)mxGetData(matrix_in), (float *)mxGetData(vector_in),
+                                                  (const float *)mxGetData(C_in), mxGetM(C_in), mxGetN(C_in),
+                                                  (const float *)mxGetData(A_in), mat_size1, mat_size2, n_threads);
+  } else {
+    status = earing_first_order_recurrence(mxGetPr(matrix_in), mxGetPr(vector_in), mxGetPr(C_in),
+                                           mxGetM(C_in), mxGetN(C_in), mxGetPr(A_in), mat_size1, mat_size2,
+                                           n_threads);
   }
-
-  if (C_size1 != 1 && C_size2 != 1){
-    /* printf("Case 3: IHC_RP\n"); */
-    for (idx = 0; idx < mat_size2 ; idx++) {
-      for (row = 0; row < mat_size1; row++){
-        val = vector[row] * C[ind] + A[ind];
-        vector[row]   = val;
-        matrix[ind++] = val;
-      }
-    } 
-  }
-
-  if (C_size1 == 1 && C_size2 != 1){
-    printf("C is expected to be a double, a vertical array or matrix, not horizontal.\n");
-    abort();
+  if (status != 0){
+    mexErrMsgTxt("C is expected to be a scalar, a vertical array or matrix, not horizontal.\n");
   }
- 
-  return;
 }
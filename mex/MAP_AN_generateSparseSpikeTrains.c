@@ -0,0 +1,81 @@
+/*
+
+Mex file generating the same spike trains as MAP_AN_generatePoissonSpikeTrains, directly as a
+sparse logical matrix (and optionally as lists of spike times), without going through the
+dense logical matrix. All the fibers of all channels are generated in one call.
+Thin wrapper over earing_generate_poisson_spike_events (cpp/src/spike_trains.cpp):
+build the native library first (see README).
+
+Usage:
+
+spkTrains = MAP_AN_generateSparseSpikeTrains(nbFiber, nbBinsRefrac, arrayRate)
+spkTrains = MAP_AN_generateSparseSpikeTrains(nbFiber, nbBinsRefrac, arrayRate, algo, seed, nThreads)
+[spkTrains, spkTimes] = MAP_AN_generateSparseSpikeTrains(...)
+
+Inputs: nbFiber, nbBinsRefrac, arrayRate, algo, seed and nThreads as in MAP_AN_generatePoissonSpikeTrains
+    (seed = [] or no seed for a new random seed). With the same seed, spkTrains equals
+    sparse(MAP_AN_generatePoissonSpikeTrains(nbFiber, nbBinsRefrac, arrayRate, algo, 0, seed)).
+
+Outputs:
+- spkTrains is a sparse logical array of size (nbFiber * size(arrayRate,1)) x size(arrayRate, 2), with the
+    rows ordered as in MAP_AN_generatePoissonSpikeTrains.
+- spkTimes (optional) is a cell array with one row vector per fiber (row of spkTrains), holding
+    the indices of the columns of its spikes.
+
+*/
+
+#include "mex.h"
+#include "matrix.h"
+#include "earing/earing.h"
+#include "earing_mex_spikes.h"
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[]){
+
+  /* Outputs */
+  #define ANspikes_out plhs[0]
+  #define ANspikeTimes_out plhs[1]
+
+  /* Inputs */
+  #define nFibersPerChannel_in prhs[0]
+  #define lengthAbsRefractory_in prhs[1]
+  #define ANproboutput_in prhs[2]
+  #define algo_in prhs[3]
+  #define seed_in prhs[4]
+  #define n_threads_in prhs[5]
+
+  /* Variables */
+    int algo = 1;       /* Default is 1 (thinning method) */
+    int nThreads = 0;   /* Default number of threads */
+    int nFibPerChan, AbsRefInt;
+    unsigned long long seed;
+    size_t ANspik_sizeM, ANspik_sizeN;
+    earing_spike_trains *trains;
+
+    if (nrhs < 3){              mexErrMsgTxt("Not enough input arguments: (int) nbFibers, (int)nbBinsAbsoluteRefractoriness, (double array)rate of firing, (opt int) algorithmID, (opt) seed, (opt) nThreads");}
+    if (sizeof(mwIndex) != sizeof(size_t)){ mexErrMsgTxt("Compile with 64-bit indices (-largeArrayDims)\n"); }
+
+  /* Read inputs */
+    AbsRefInt    = (int) mxGetScalar(lengthAbsRefractory_in);
+    nFibPerChan  = (int) mxGetScalar(nFibersPerChannel_in);
+    ANspik_sizeM = mxGetM(ANproboutput_in);
+    ANspik_sizeN = mxGetN(ANproboutput_in);
+    if (nrhs >= 4){  algo = (int)mxGetScalar(algo_in); }
+    if (nrhs >= 5 && !mxIsEmpty(seed_in)){
+      if (mxGetScalar(seed_in) < 0){ mexErrMsgTxt("The seed should be a non-negative integer\n"); }
+      seed = (unsigned long long)mxGetScalar(seed_in);
+    } else {
+      seed = earing_random_seed();
+    }
+    if (nrhs >= 6){  nThreads = (int)mxGetScalar(n_threads_in); }
+
+  /* Verifications */
+    if (ANspik_sizeM == 0 || ANspik_sizeN == 0){ mexErrMsgTxt("Size of ANproboutput_in not as expected\n"); }
+    if (nFibPerChan < 1){        mexErrMsgTxt("nFibPerChan is not as expected\n"); }
+    if (algo != 1 && algo != 2){ mexErrMsgTxt("Fourth argument should be 1 (thinning method) or 2 (binwise simulation)\n"); }
+
+    trains = earing_generate_poisson_spike_events(mxGetPr(ANproboutput_in), ANspik_sizeM, ANspik_sizeN,
+                                                  nFibPerChan, AbsRefInt, algo, seed, nThreads);
+    if (trains == NULL){ mexErrMsgTxt("Unable to generate the spike trains (out of memory?)\n"); }
+    earing_mex_spike_outputs(trains, (size_t)nFibPerChan * ANspik_sizeM, ANspik_sizeN, &ANspikes_out,
+                             nlhs >= 2 ? &ANspikeTimes_out : NULL);
+}
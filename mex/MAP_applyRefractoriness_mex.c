@@ -1,7 +1,17 @@
-
+/* Mex file computing the probability of firing with refractoriness, for MAP_addRefractoriness.m:
+ *   probref(:, t) = prob(:, t) .* (1 - sum_k Wfull(k) * probref(:, t-k))
+ * Thin wrapper over earing_apply_refractoriness (cpp/src/refractoriness.cpp), which updates the sum
+ * recursively when Wfull is piecewise linear (refract1, refract2) and spreads rows over threads.
+ *
+ * Usage: probref = MAP_applyRefractoriness_mex(prob, Wfull, dt, horiz)
+ *        probref = MAP_applyRefractoriness_mex(prob, Wfull, dt, horiz, nThreads)
+ * Only the first floor(horiz/dt) values of Wfull are used. prob may be single, probref being single as well
+ * (earing_apply_refractoriness_single, the history of probref being kept in double); Wfull is double.
+ */
 
 #include "mex.h"
 #include "matrix.h"
+#include "earing/earing.h"
 
 void mexFunction(int nlhs, mxArray *plhs[],int nrhs, const mxArray *prhs[])
 {
@@ -13,46 +23,33 @@ void mexFunction(int nlhs, mxArray *plhs[],int nrhs, const mxArray *prhs[])
 	#define Wfull_in prhs[1]
 	#define dt_in prhs[2]
 	#define horiz_in prhs[3]
-
-
-	double *probref, *prob, *Wfull;
-	int ind, col, row, col_b, cHoriz;   
-	double su, dt, horiz; /* sum  and differential time */  
-
-
-    prob  = (double *)mxGetPr(prob_in); 
-    Wfull = (double *)mxGetPr(Wfull_in); 
-	dt    = (double)mxGetScalar(dt_in); 
-	horiz = (double)mxGetScalar(horiz_in); 
-
-	int dims[2];
-    dims[0] = mxGetM(prob_in);
-    dims[1] = mxGetN(prob_in);
-
-    probref_out = mxCreateDoubleMatrix((mwSize) dims[0], (mwSize) dims[1], mxREAL);
-    probref = (double *)mxGetPr(probref_out);
-
-
-    /* Declare first column */ 
-    for (ind=0; ind < dims[0] ; ind ++){
-    	probref[ind] = prob[ind];
-    }
-    for (col=1; col < dims[1] ; col ++){
-
-
-    	/* Calculate with probref's columns between 0 and col-1 or col-horiz and col-1 */
-    	cHoriz = (col * dt < horiz ? col : (int)(horiz/dt));
-
-    	for (row = 0; row < dims[0] ; row++) {
-    		ind = row+col*dims[0];
-    		su = 0.0;
-    		for (col_b = 0; col_b < cHoriz; col_b++){
-	    		/*printf("col_b=%d, col-1-col_b=%d\n", col_b, col-1-col_b);*/
-    			su += Wfull[col_b] * probref[row+(col-1-col_b)*dims[0]]; /*Check second index, might be + or - 1 */
-    		}
-    		probref[ind] = prob[ind] * (1 - su);
-    	}
-    	
-
-    }
-}
\ No newline at end of file
+	#define n_threads_in prhs[4]
+
+	double dt, horiz;
+	size_t nW;
+	int nThreads = 0; /* Default number of threads */
+	int status;
+
+	if (nrhs < 4){ mexErrMsgTxt("MAP_applyRefractoriness_mex(prob, Wfull, dt, horiz): not enough input arguments\n"); }
+
+	dt    = mxGetScalar(dt_in);
+	horiz = mxGetScalar(horiz_in);
+	if (dt <= 0 || horiz < 0){ mexErrMsgTxt("dt should be positive and horiz non-negative\n"); }
+	if (!mxIsDouble(prob_in) && !mxIsSingle(prob_in)){ mexErrMsgTxt("prob should be double or single\n"); }
+	if (!mxIsDouble(Wfull_in)){ mexErrMsgTxt("Wfull should be double\n"); }
+	nW = (size_t)(horiz/dt);
+	if (nW > mxGetNumberOfElements(Wfull_in)){ nW = mxGetNumberOfElements(Wfull_in); }
+	if (nrhs > 4){ nThreads = (int)mxGetScalar(n_threads_in); }
+
+	probref_out = mxCreateNumericMatrix((mwSize)mxGetM(prob_in), (mwSize)mxGetN(prob_in), mxGetClassID(prob_in), mxREAL);
+	if (mxIsSingle(prob_in)){
+		status = earing_apply_refractoriness_single((const float *)mxGetData(prob_in), (float *)mxGetData(probref_out),
+		                                            mxGetM(prob_in), mxGetN(prob_in), mxGetPr(Wfull_in), nW, nThreads);
+	} else {
+		status = earing_apply_refractoriness(mxGetPr(prob_in), mxGetPr(probref_out), mxGetM(prob_in), mxGetN(prob_in),
+		                                     mxGetPr(Wfull_in), nW, nThreads);
+	}
+	if (status != 0){
+		mexErrMsgTxt("Unable to apply the refractoriness (out of memory?)\n");
+	}
+}
@@ -8,11 +8,14 @@ Usage:
 		[31, 3]
 
 Written by Alban, January 2017
+Thin wrapper over earing_average_channels (cpp/src/spike_analysis.cpp); an optional
+third input sets the number of threads. feats may be single, the features being
+single as well (earing_average_channels_single).
 */ 
 
 #include "mex.h"
 #include "matrix.h"
-#include <math.h>     /* For pow() power function */
+#include "earing/earing.h"
 
 void mexFunction(int nlhs, mxArray *plhs[],int nrhs, const mxArray *prhs[])
 {
@@ -22,48 +25,27 @@ void mexFunction(int nlhs, mxArray *plhs[],int nrhs, const mxArray *prhs[])
 	/* Inputs */
 	#define feats_in prhs[0]
 	#define nbFeat_in prhs[1]
-
-	 /* Variables */
-	int ind, indFeats, kk;        		/* Running indices */
-	int initNbFeat = 0, final_n; 		/* Numner of fibers */
-	int col, n, nn, maxInd, nbFeat;  	/*  */
-	double val;         /* Value to calculate */
- 	double *feats, *nbFeat_do, *meanfeat;  /* Copy inputs */
-
-
-	/* Copy original input vectors, get size of C and matrix */
-	feats 		= (double *) mxGetPr(feats_in);
-	nbFeat_do  	= (double *) mxGetPr(nbFeat_in);
-	nbFeat 		= (int) *nbFeat_do;
-	initNbFeat  = (int) mxGetM(feats_in);
-	
-	/* n: Number of channels averaged per feature (only the last one may be bigger) */
-	n = floor((float)initNbFeat/(float)nbFeat); 
-	/* some fibers might be missing */
-	final_n = n + initNbFeat - nbFeat * n;
-	if (initNbFeat <= nbFeat){  mexErrMsgTxt("There are less channels than required features\n"); }
-
-
-	 /* Output */
-	int dims[2];  
-    dims[0]   = (int) nbFeat;
-    dims[1]   = (int) mxGetN(feats_in);
-    meanfeat_out = mxCreateDoubleMatrix((mwSize) dims[0], (mwSize) dims[1], mxREAL);
-    meanfeat = (double *)mxGetPr(meanfeat_out);
-
-	ind = 0;
-	indFeats = 0;
-	for (col = 0; col < dims[1] ; col++) {
-		for (nn = 1; nn <= dims[0]; nn++) {
-			val = 0;
-			maxInd = ( nn < nbFeat ? n : final_n );
-      		for (kk = 0; kk < maxInd; kk++) { 
-				val += feats[indFeats++];
-      		}
-      		meanfeat[ind++] = val/(double)maxInd;
-    	}
-    } 
-	return;
-
-	
- }
\ No newline at end of file
+	#define n_threads_in prhs[2]
+
+	double nbFeat;
+	int nThreads = 0; /* Default number of threads */
+	int status;
+
+	if (nrhs < 2){ mexErrMsgTxt("averageChannels(feats, nbFeat): not enough input arguments\n"); }
+	nbFeat = mxGetScalar(nbFeat_in);
+	if (nbFeat < 1){ mexErrMsgTxt("nbFeat should be positive\n"); }
+	if (!mxIsDouble(feats_in) && !mxIsSingle(feats_in)){ mexErrMsgTxt("feats should be double or single\n"); }
+	if (nrhs > 2){ nThreads = (int)mxGetScalar(n_threads_in); }
+
+	meanfeat_out = mxCreateNumericMatrix((mwSize)nbFeat, (mwSize)mxGetN(feats_in), mxGetClassID(feats_in), mxREAL);
+	if (mxIsSingle(feats_in)){
+		status = earing_average_channels_single((const float *)mxGetData(feats_in), mxGetM(feats_in), mxGetN(feats_in),
+		                                        (size_t)nbFeat, (float *)mxGetData(meanfeat_out), nThreads);
+	} else {
+		status = earing_average_channels(mxGetPr(feats_in), mxGetM(feats_in), mxGetN(feats_in), (size_t)nbFeat,
+		                                 mxGetPr(meanfeat_out), nThreads);
+	}
+	if (status != 0){
+		mexErrMsgTxt("There are less channels than required features\n");
+	}
+}
@@ -0,0 +1,54 @@
+/* Matlab outputs of native spike trains (earing_spike_trains, see cpp/include/earing/earing.h), shared by
+ * MAP_AN_generateSparseSpikeTrains and the stochastic mode of MAP_finalForLoop_mex:
+ * - spikes_out: sparse logical array of size nRows x nCols, filled in place;
+ * - times_out (if not NULL): cell array with one row vector per fiber (row of spikes_out), holding the
+ *   1-based indices of the columns of its spikes.
+ * trains is freed, also when an error is raised. mwIndex should be size_t (checked by the callers).
+ */
+
+#ifndef EARING_MEX_SPIKES_H
+#define EARING_MEX_SPIKES_H
+
+#include "mex.h"
+#include "matrix.h"
+#include "earing/earing.h"
+
+static void earing_mex_spike_outputs(earing_spike_trains *trains, size_t nRows, size_t nCols, mxArray **spikes_out,
+                                     mxArray **times_out)
+{
+  size_t nSpikes, fib, k;
+  size_t *fiberStart, *frames;
+  mxLogical *values;
+  mxArray *times;
+  double *timesPr;
+
+  nSpikes = earing_spike_trains_count(trains);
+
+  /* Sparse logical matrix, filled in place */
+  *spikes_out = mxCreateSparseLogicalMatrix((mwSize)nRows, (mwSize)nCols, (mwSize)(nSpikes > 0 ? nSpikes : 1));
+  if (earing_spike_trains_csc(trains, (size_t *)mxGetJc(*spikes_out), (size_t *)mxGetIr(*spikes_out)) != 0){
+    earing_free_spike_trains(trains);
+    mexErrMsgTxt("Unable to sort the spikes (out of memory?)\n");
+  }
+  values = mxGetLogicals(*spikes_out);
+  for (k = 0; k < nSpikes; k++){ values[k] = 1; }
+
+  /* Spike times per fiber, 1-based */
+  if (times_out != NULL){
+    fiberStart = (size_t *)mxMalloc((nRows + 1) * sizeof(size_t));
+    frames = (size_t *)mxMalloc((nSpikes > 0 ? nSpikes : 1) * sizeof(size_t));
+    earing_spike_trains_lists(trains, fiberStart, frames);
+    *times_out = mxCreateCellMatrix((mwSize)nRows, 1);
+    for (fib = 0; fib < nRows; fib++){
+      times = mxCreateDoubleMatrix(1, (mwSize)(fiberStart[fib + 1] - fiberStart[fib]), mxREAL);
+      timesPr = mxGetPr(times);
+      for (k = fiberStart[fib]; k < fiberStart[fib + 1]; k++){ timesPr[k - fiberStart[fib]] = (double)(frames[k] + 1); }
+      mxSetCell(*times_out, (mwIndex)fib, times);
+    }
+    mxFree(fiberStart);
+    mxFree(frames);
+  }
+  earing_free_spike_trains(trains);
+}
+
+#endif /* EARING_MEX_SPIKES_H */
@@ -0,0 +1,46 @@
+/*
+Reads an HTK feature file, possibly compressed (the file is memory-mapped).
+
+Usage:
+	[DATA, HTKCode, sampPeriod] = htkReadFile('file.usr');
+	size(DATA) =
+		[n_features, n_frames]   (one column per frame, htkread.m gives DATA')
+
+Thin wrapper over earing_htk_read (cpp/src/htk.cpp).
+*/
+
+#include "mex.h"
+#include "matrix.h"
+#include "earing/earing.h"
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	/* Outputs */
+	#define data_out plhs[0]
+	#define code_out plhs[1]
+	#define period_out plhs[2]
+
+	/* Inputs */
+	#define path_in prhs[0]
+
+	earing_htk_header header;
+	char *path;
+	int status;
+
+	if (nrhs < 1 || !mxIsChar(path_in)){ mexErrMsgTxt("htkReadFile(path): path should be a string\n"); }
+	path = mxArrayToString(path_in);
+	status = earing_htk_read_header(path, &header);
+	if (status == 0){
+		data_out = mxCreateDoubleMatrix((mwSize)header.n_features, (mwSize)header.n_frames, mxREAL);
+		status = earing_htk_read(path, mxGetPr(data_out), header.n_features, header.n_frames);
+	}
+	if (status != 0){
+		mexPrintf("%s\n", path);
+		mxFree(path);
+		mexErrMsgTxt("Unable to read the HTK file\n");
+	}
+	mxFree(path);
+
+	if (nlhs > 1){ code_out = mxCreateDoubleScalar((double)header.parm_kind); }
+	if (nlhs > 2){ period_out = mxCreateDoubleScalar((double)header.samp_period); }
+}
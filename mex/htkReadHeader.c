@@ -0,0 +1,43 @@
+/*
+Reads the header of an HTK feature file only (without its frames).
+
+Usage:
+	h = htkReadHeader('file.usr');
+	h.n_frames, h.n_features, h.samp_period (100 ns units), h.parm_kind (HTKCode)
+
+Thin wrapper over earing_htk_read_header (cpp/src/htk.cpp).
+*/
+
+#include "mex.h"
+#include "matrix.h"
+#include "earing/earing.h"
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	/* Outputs */
+	#define header_out plhs[0]
+
+	/* Inputs */
+	#define path_in prhs[0]
+
+	const char *fields[] = {"n_frames", "n_features", "samp_period", "parm_kind"};
+	earing_htk_header header;
+	char *path;
+	int status;
+
+	if (nrhs < 1 || !mxIsChar(path_in)){ mexErrMsgTxt("htkReadHeader(path): path should be a string\n"); }
+	path = mxArrayToString(path_in);
+	status = earing_htk_read_header(path, &header);
+	if (status != 0){
+		mexPrintf("%s\n", path);
+		mxFree(path);
+		mexErrMsgTxt("Unable to read the HTK header of the file\n");
+	}
+	mxFree(path);
+
+	header_out = mxCreateStructMatrix(1, 1, 4, fields);
+	mxSetField(header_out, 0, "n_frames", mxCreateDoubleScalar((double)header.n_frames));
+	mxSetField(header_out, 0, "n_features", mxCreateDoubleScalar((double)header.n_features));
+	mxSetField(header_out, 0, "samp_period", mxCreateDoubleScalar((double)header.samp_period));
+	mxSetField(header_out, 0, "parm_kind", mxCreateDoubleScalar((double)header.parm_kind));
+}
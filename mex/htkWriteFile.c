@@ -0,0 +1,45 @@
+/*
+Writes an HTK feature file, compressed (int16) if HTKCode has bit 11 (1024)
+set, as htkwrite.m.
+
+Usage:
+	htkWriteFile('file.usr', DATA, HTKCode, sampPeriod);
+	DATA is n_features x n_frames (one column per frame, htkwrite.m takes DATA');
+	HTKCode defaults to 9 (USER), sampPeriod to 100000 (10 ms in 100 ns units)
+
+Thin wrapper over earing_htk_write (cpp/src/htk.cpp).
+*/
+
+#include "mex.h"
+#include "matrix.h"
+#include "earing/earing.h"
+
+void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
+{
+	/* Inputs */
+	#define path_in prhs[0]
+	#define data_in prhs[1]
+	#define code_in prhs[2]
+	#define period_in prhs[3]
+
+	int code = 9, period = 100000;
+	char *path;
+	int status;
+
+	if (nrhs < 2){ mexErrMsgTxt("htkWriteFile(path, DATA, HTKCode, sampPeriod): not enough input arguments\n"); }
+	if (!mxIsChar(path_in)){ mexErrMsgTxt("path should be a string\n"); }
+	if (!mxIsDouble(data_in) || mxIsComplex(data_in) || mxIsSparse(data_in)){
+		mexErrMsgTxt("DATA should be a full real double matrix\n");
+	}
+	if (nrhs > 2){ code = (int)mxGetScalar(code_in); }
+	if (nrhs > 3){ period = (int)mxGetScalar(period_in); }
+
+	path = mxArrayToString(path_in);
+	status = earing_htk_write(path, mxGetPr(data_in), mxGetM(data_in), mxGetN(data_in), code, period);
+	if (status != 0){
+		mexPrintf("%s\n", path);
+		mxFree(path);
+		mexErrMsgTxt("Unable to write to the HTK file\n");
+	}
+	mxFree(path);
+}
@@ -3,8 +3,15 @@ Mex file to calculate the rate of a raster plot, using a predefined window
 and the indices at which to start the calculation.
 The spike trains/rate are vertical.
 
-Compile by calling (in mex/ folder)
-	mex rateSpikeTrain.c
+Thin wrapper over earing_rate_spike_train (cpp/src/spike_analysis.cpp), see the
+MEX files section of the README to build it; an optional fourth input sets the
+number of threads (columns are split across threads). spkTr may be sparse
+(logical or double), e.g. the transpose of the spikes_sparse of AuditoryNerve:
+each spike is then only added to the windows it falls in
+(earing_rate_spike_events), at a cost proportional to the number of spikes,
+and beginInd must be increasing. A dense spkTr may also be single, R being
+single as well (earing_rate_spike_train_single); beginInd and hammingWindow
+are double.
 
 Example: 
 
@@ -32,6 +39,7 @@ R = (1:49)'
 
 #include "mex.h"
 #include "matrix.h"
+#include "earing/earing.h"
 
 void mexFunction(int nlhs, mxArray *plhs[],int nrhs, const mxArray *prhs[])
 {
@@ -42,58 +50,50 @@ void mexFunction(int nlhs, mxArray *plhs[],int nrhs, const mxArray *prhs[])
 	#define spikeTrain_in prhs[0]
 	#define beginInd_in prhs[1]
 	#define hammingWindow_in prhs[2]
-
-	 /* Variables */
-	int ind = 0;        /* Running index */
-	int indHann = 0; 	/* Running index in Hann window */
-	int cind; 			/*  */
-	int col;            /* Column index */
-	int row;            /* Row index */
-	double val;         /* Value to calculate */
- 	double *R, *spikeTrain, *hammingWindow; /* Copy inputs */
- 	double *beginInd;
- 	int R_size1, R_size2, spkTr_s1, len_hann, len_beginInd; /* Size of R, Hann, begin_ind */
-
-	/* Copy original input vectors, get size of C and matrix */
-	beginInd   		= (double *) mxGetPr(beginInd_in);
-	spikeTrain    	= (double *) mxGetPr(spikeTrain_in);
-	hammingWindow 	= (double *) mxGetPr(hammingWindow_in);  
-
-	/* Get sizes */
-	/* Begin_ind and hann: Horizontal or vertical  */
-	/* len_beginInd Should be equal to R_size1 */
-	len_beginInd = (int) (mxGetM(beginInd_in)<mxGetN(beginInd_in) ? mxGetN(beginInd_in) : mxGetM(beginInd_in));
-	len_hann     = (int) (mxGetM(hammingWindow_in)<mxGetN(hammingWindow_in) ? mxGetN(hammingWindow_in) : mxGetM(hammingWindow_in));
-  
-  	if (mxGetM(beginInd_in) == 0      || mxGetN(beginInd_in) == 0){          mexErrMsgTxt("Size of len_beginInd is 0\n"); }
-  	if (mxGetM(hammingWindow_in) == 0 || mxGetN(hammingWindow_in) == 0){     mexErrMsgTxt("Size of len_hann is 0\n"); }
-
-	 /*	Allocate memory for R */
-    int dims[2];   /*mxGetM(beginInd_in); */
-    dims[0]   = (int) len_beginInd;
-    dims[1]   = (int) mxGetN(spikeTrain_in);
-	spkTr_s1  = (int) mxGetM(spikeTrain_in);
-    R_out = mxCreateDoubleMatrix((mwSize) dims[0], (mwSize) dims[1], mxREAL);
-    R = (double *)mxGetPr(R_out);
-
-	/*R_size1 = (int) mxGetM(R_out);
-	R_size2 = (int) mxGetN(R_out);*/
-	/*printf("%d, %d, %d\n", dims[0], dims[1], (dims[1]-1) * spkTr_s1 + beginInd[dims[0]-1]);*/
-    if (spkTr_s1*(dims[1]-1)+beginInd[len_beginInd-1]+hammingWindow[len_hann-1]>spkTr_s1*dims[1]){ mexErrMsgTxt("beginInd seems to be too long; consider removing last indices\n"); }
-	
-
-	/* Run the loop */
-	for (col = 0; col < dims[1] ; col++) {
-      for (row = 0; row < dims[0]; row++) { /* R or beginInd, because same size */
-
-      	/* Initial index in spikeTrain, column-major */
-        cind = (int) col * spkTr_s1 + beginInd[row];
-        /* printf("%d, %d, %d, %f, %d\n", cind, ind, (int) beginInd[row], R[ind], (int) R[ind]); */
-        val = 0;
-        for (indHann = 0; indHann < len_hann; indHann++) {
-        	val += spikeTrain[cind + indHann] * hammingWindow[indHann];
-        }
-        R[ind++]   = val;
-      }
-    } 
- }
\ No newline at end of file
+	#define n_threads_in prhs[3]
+
+	int nThreads = 0; /* Default number of threads */
+	int status;
+
+	if (nrhs < 3){ mexErrMsgTxt("rateSpikeTrain(spkTr, beginInd, hammingWindow): not enough input arguments\n"); }
+	if (mxGetNumberOfElements(beginInd_in) == 0){      mexErrMsgTxt("Size of len_beginInd is 0\n"); }
+	if (mxGetNumberOfElements(hammingWindow_in) == 0){ mexErrMsgTxt("Size of len_hann is 0\n"); }
+	if (!mxIsDouble(beginInd_in) || !mxIsDouble(hammingWindow_in)){
+		mexErrMsgTxt("beginInd and hammingWindow should be double\n");
+	}
+	if (nrhs > 3){ nThreads = (int)mxGetScalar(n_threads_in); }
+
+	/* Begin_ind and hann: Horizontal or vertical */
+	if (mxIsSparse(spikeTrain_in)){
+		R_out = mxCreateDoubleMatrix((mwSize)mxGetNumberOfElements(beginInd_in), (mwSize)mxGetN(spikeTrain_in), mxREAL);
+		if (sizeof(mwIndex) != sizeof(size_t)){ mexErrMsgTxt("Compile with 64-bit indices (-largeArrayDims)\n"); }
+		if (earing_rate_spike_events((const size_t *)mxGetJc(spikeTrain_in), (const size_t *)mxGetIr(spikeTrain_in),
+		                             mxIsLogical(spikeTrain_in) ? NULL : mxGetPr(spikeTrain_in),
+		                             mxGetM(spikeTrain_in), mxGetN(spikeTrain_in), mxGetPr(beginInd_in),
+		                             mxGetNumberOfElements(beginInd_in), mxGetPr(hammingWindow_in),
+		                             mxGetNumberOfElements(hammingWindow_in), mxGetPr(R_out), nThreads) != 0){
+			mexErrMsgTxt("beginInd should be increasing, and not too long; consider removing last indices\n");
+		}
+		return;
+	}
+	if (!mxIsDouble(spikeTrain_in) && !mxIsSingle(spikeTrain_in)){
+		mexErrMsgTxt("spkTr should be a double or single array, or sparse\n");
+	}
+	R_out = mxCreateNumericMatrix((mwSize)mxGetNumberOfElements(beginInd_in), (mwSize)mxGetN(spikeTrain_in),
+	                              mxGetClassID(spikeTrain_in), mxREAL);
+	if (mxIsSingle(spikeTrain_in)){
+		status = earing_rate_spike_train_single((const float *)mxGetData(spikeTrain_in), mxGetM(spikeTrain_in),
+		                                        mxGetN(spikeTrain_in), mxGetPr(beginInd_in),
+		                                        mxGetNumberOfElements(beginInd_in), mxGetPr(hammingWindow_in),
+		                                        mxGetNumberOfElements(hammingWindow_in), (float *)mxGetData(R_out),
+		                                        nThreads);
+	} else {
+		status = earing_rate_spike_train(mxGetPr(spikeTrain_in), mxGetM(spikeTrain_in), mxGetN(spikeTrain_in),
+		                                 mxGetPr(beginInd_in), mxGetNumberOfElements(beginInd_in),
+		                                 mxGetPr(hammingWindow_in), mxGetNumberOfElements(hammingWindow_in),
+		                                 mxGetPr(R_out), nThreads);
+	}
+	if (status != 0){
+		mexErrMsgTxt("beginInd seems to be too long; consider removing last indices\n");
+	}
+}
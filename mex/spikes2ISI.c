@@ -1,6 +1,13 @@
 /* Mex file computing the ISI matrix: column-wise, a (full and double) spike train is transformed
  * into a vector of the same size, where every value is the current Interspike-Interval
- * (number of 0s between the previous and next spike).  
+ * (number of 0s between the previous and next spike).
+ * Thin wrapper over earing_spikes_to_isi (cpp/src/spike_analysis.cpp); an optional third
+ * input sets the number of threads.
+ *
+ * Sparse spike trains (logical, or ones), e.g. the transpose of the spikes_sparse of
+ * AuditoryNerve, are not expanded: isi = spikes2ISI(spkTr, inverse, n_threads) returns the
+ * ISI transposed, one row per train as the features of ProcessingAsr, or 1./ISI if inverse
+ * (earing_isi_spike_events); inverse and n_threads are optional.
  *
  * Example in Matlab, after running 'mex path/to/spikes2ISI.c'
  
@@ -24,65 +31,42 @@ data =
 
 #include "mex.h"
 #include "matrix.h"
+#include "earing/earing.h"
 
 void mexFunction(int nlhs, mxArray *plhs[],int nrhs, const mxArray *prhs[])
 {
+  /* Outputs (sparse input) */
+  #define matrix_ISI_out plhs[0]
+
   /* Inputs */
   #define matrix_spk_in prhs[0]
   #define matrix_ISI_in prhs[1]
+  #define inverse_in prhs[1]
+  #define n_threads_in prhs[2]
 
-  /* Variables */
-  double ISI;          /* ISI value. Could be integer, but float for consistency of matrices */
-  int ind = 0;        /* Running index */
-  int indExplo = 0;   /* Index that will go from 'row' to the index of next spike */ 
-  int prevCol;        /* To avoid calculating product (mat_size1 * idx) many times*/
-  int rowBase;        /* Current row position before searching for next spike */
-  int idx;            /* Column index */
-  int row;            /* Row index */
-  int mat_size1, mat_size2;   /* Size of matrices (assumed same for matrices) */
-  int mat_size1c, mat_size2c; /* Size of matrices (check it's the same) */
-  double *matrix_ISI, *matrix_spk; /* Copy inputs */
-
-  /* Copy original input vectors, get size of C and matrix */
-  matrix_ISI = (double *) mxGetPr(matrix_ISI_in);  
-  matrix_spk = (double *) mxGetPr(matrix_spk_in);
-  mat_size1  = (int) mxGetM(matrix_spk_in);
-  mat_size2  = (int) mxGetN(matrix_spk_in);
-  mat_size1c = (int) mxGetM(matrix_ISI_in);
-  mat_size2c = (int) mxGetN(matrix_ISI_in);
+  int n_threads = 0; /* Default number of threads */
 
-  if (mat_size1c != mat_size1 || mat_size2c != mat_size2){
-    printf("The two matrices given as input should have the same size!'\n");
+  if (nrhs > 0 && mxIsSparse(matrix_spk_in)){
+    int inverse = nrhs > 1 && !mxIsEmpty(inverse_in) && mxGetScalar(inverse_in) != 0;
+    if (nrhs > 2){ n_threads = (int)mxGetScalar(n_threads_in); }
+    if (sizeof(mwIndex) != sizeof(size_t)){ mexErrMsgTxt("Compile with 64-bit indices (-largeArrayDims)\n"); }
+    matrix_ISI_out = mxCreateDoubleMatrix(mxGetN(matrix_spk_in), mxGetM(matrix_spk_in), mxREAL);
+    if (earing_isi_spike_events((const size_t *)mxGetJc(matrix_spk_in), (const size_t *)mxGetIr(matrix_spk_in),
+                                mxGetM(matrix_spk_in), mxGetN(matrix_spk_in), mxGetPr(matrix_ISI_out), inverse,
+                                n_threads) != 0){
+      mexErrMsgTxt("Unable to compute the ISI (out of memory?)\n");
+    }
+    return;
   }
+  if (nrhs < 2){ mexErrMsgTxt("spikes2ISI(spikes, data): not enough input arguments\n"); }
+  if (mxGetM(matrix_ISI_in) != mxGetM(matrix_spk_in) || mxGetN(matrix_ISI_in) != mxGetN(matrix_spk_in)){
+    mexErrMsgTxt("The two matrices given as input should have the same size!\n");
+  }
+  if (nrhs > 2){ n_threads = (int)mxGetScalar(n_threads_in); }
 
-    /* printf("Per column\n 0 mat_size2 60 61"); */
-    for (idx = 0; idx < mat_size2 ; idx++) {
-      row = 0;
-      rowBase = 0;
-      prevCol = mat_size1 * idx;
-      while ( rowBase < mat_size1 ){
-
-        /* The next 'while' loop is an exploration to obtain the ISI: until spike found*/
-        indExplo = rowBase;
-
-        /* When a spike is found along a column, stop search */
-        do { 
-          indExplo++;
-        }
-        while ( indExplo < mat_size1 && matrix_spk[prevCol+indExplo] < 0.5 );
-          
-          
-        ISI = (double) (indExplo - rowBase);
-
-        /* Fill rows up to index indExplo with ISI */
-        for (row = rowBase; row < indExplo; row++){
-          matrix_ISI[row + prevCol] = ISI; 
-        }
-        rowBase = indExplo;
-
-        
-      }
-    } 
- 
-  return;
+  /* data is written in place */
+  if (earing_spikes_to_isi(mxGetPr(matrix_spk_in), mxGetM(matrix_spk_in), mxGetN(matrix_spk_in),
+                           mxGetPr(matrix_ISI_in), n_threads) != 0){
+    mexErrMsgTxt("Unable to compute the ISI (out of memory?)\n");
+  }
 }
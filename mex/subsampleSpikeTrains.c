@@ -1,9 +1,13 @@
-/* Mex file subsampling spike trains.
+/* Mex file subsampling spike trains: keeps one spike (== 1) out of every n of each
+ * (vertical) spike train, starting with the first one.
+ * Thin wrapper over earing_subsample_spike_trains (cpp/src/spike_analysis.cpp), see the MEX
+ * files section of the README to build it; an optional third input sets the number of
+ * threads. A double spike matrix is modified in place, as in the example below. Sparse spike
+ * trains (logical, or ones) cannot be: B = subsampleSpikeTrains(A, n) returns the kept spikes
+ * as a new logical sparse matrix, at a cost proportional to the number of spikes
+ * (earing_subsample_spike_events).
  *
- * Example in Matlab, after running 'mex path/to/thisFile.c' 
- * Applied this: http://fr.mathworks.com/matlabcentral/answers/246507-
- * why-can-t-mex-find-a-supported-compiler-in-matlab-r2015b-after-i-upgraded-to-xcode-7-0
- * to get mex to work
+ * Example in Matlab:
  
 A = [0 0 1 1 1 1 1 1 0 0 1; 0 0 1 0 1 0 0 1 0 0 1; 0 0 0 0 0 0 0 0 0 0 0]'
 
@@ -43,60 +47,51 @@ A =
 
 #include "mex.h"
 #include "matrix.h"
+#include "earing/earing.h"
 
 void mexFunction(int nlhs, mxArray *plhs[],int nrhs, const mxArray *prhs[])
 {
+  /* Outputs (sparse input) */
+  #define matrix_spk_out plhs[0]
+
   /* Inputs */
   #define matrix_spk_in prhs[0]
   #define n_in prhs[1]
+  #define n_threads_in prhs[2]
 
-  /* Variables */
-  int ind = 0;        /* Running index */
-  int indExplo = 0;   /* Index that will go from 'row' to the index of next spike */ 
-  int col;            /* Column index */
-  int row;            /* Row index */
-  int mat_size1, mat_size2;   /* Size of matrices (assumed same for matrices) */
-  int n_size1c, n_size2c;     /* Size of matrices (check it's the same) */
-  double  *n_double, *matrix_spk;        /* Copy inputs */
-  int n;
-
-  /* Copy original input vectors, get size of n and matrix */
-  n_double = (double *) mxGetPr(n_in);  
-  n = (int) *n_double;
-  matrix_spk = (double *) mxGetPr(matrix_spk_in);
-  mat_size1  = (int) mxGetM(matrix_spk_in);
-  mat_size2  = (int) mxGetN(matrix_spk_in);
-  n_size1c = (int) mxGetM(n_in);
-  n_size2c = (int) mxGetN(n_in);
+  int n_threads = 0; /* Default number of threads */
+  double n;
+  size_t k, cols;
+  mxLogical *kept;
 
-  if (n_size1c != 1 || n_size2c != 1){
-    printf("The second input of subsampleSpikeTrains should be an integer!'\n");
+  if (nrhs < 2){ mexErrMsgTxt("subsampleSpikeTrains(spikes, n): not enough input arguments\n"); }
+  if (mxGetNumberOfElements(n_in) != 1){
+    mexErrMsgTxt("The second input of subsampleSpikeTrains should be an integer!\n");
   }
+  n = mxGetScalar(n_in);
+  if (!(n >= 1)){ mexErrMsgTxt("The second input of subsampleSpikeTrains should be positive\n"); }
+  if (nrhs > 2){ n_threads = (int)mxGetScalar(n_threads_in); }
+
+  if (mxIsSparse(matrix_spk_in)){
+    if (sizeof(mwIndex) != sizeof(size_t)){ mexErrMsgTxt("Compile with 64-bit indices (-largeArrayDims)\n"); }
+    cols = mxGetN(matrix_spk_in);
+    /* Room for every spike; the kept ones end at Jc[cols] */
+    k = ((const size_t *)mxGetJc(matrix_spk_in))[cols];
+    matrix_spk_out = mxCreateSparseLogicalMatrix(mxGetM(matrix_spk_in), cols, k > 0 ? k : 1);
+    if (earing_subsample_spike_events((const size_t *)mxGetJc(matrix_spk_in), (const size_t *)mxGetIr(matrix_spk_in),
+                                      cols, (size_t)n, (size_t *)mxGetJc(matrix_spk_out),
+                                      (size_t *)mxGetIr(matrix_spk_out), n_threads) != 0){
+      mexErrMsgTxt("Unable to subsample the spike trains (out of memory?)\n");
+    }
+    kept = mxGetLogicals(matrix_spk_out);
+    for (k = 0; k < ((const size_t *)mxGetJc(matrix_spk_out))[cols]; k++){ kept[k] = 1; }
+    return;
+  }
+  if (!mxIsDouble(matrix_spk_in)){ mexErrMsgTxt("spikes should be a double array, or sparse\n"); }
 
-
-  for (col = 0; col < mat_size2 ; col++) {
-
-    indExplo = 0;
-
-    for (row = 0; row < mat_size1 ; row++) {
-
-      /* Index in the matrix */
-      ind++;
-
-      /* Counting number of spikes in a column */
-      if ( matrix_spk[ind] == 1 ){
-
-        /* Keeps one spike every $n$, while incrementing indExplo. Always keeps the first spike. */
-        if ( indExplo++ % n != 0 ){
-          /* printf("ind=%d,indExplo=%d,n=%d\n",ind,indExplo,n); */
-
-          matrix_spk[ind] = 0;
-        }
-      }
-
-        
-      }
-    } 
- 
-  return;
+  /* In place */
+  if (earing_subsample_spike_trains(mxGetPr(matrix_spk_in), mxGetM(matrix_spk_in), mxGetN(matrix_spk_in), (size_t)n,
+                                    n_threads) != 0){
+    mexErrMsgTxt("Unable to subsample the spike trains (out of memory?)\n");
+  }
 }
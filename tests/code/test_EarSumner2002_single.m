@@ -0,0 +1,67 @@
+function test_EarSumner2002_single(earing_run)
+% Accuracy gate of the single-precision native model (earing_run --single):
+% firing rates of LSR/MSR/HSR fibers to sinusoids at their best frequency
+% against the reference rates of test_EarSumner2002 ('mark' filters, the
+% native ones), within max(10 spikes/s, 10%).
+% earing_run: path of the earing_run binary (default build/cpp/earing_run)
+
+root = fullfile(fileparts(mfilename('fullpath')), '..', '..');
+if nargin < 1
+    earing_run = fullfile(root, 'build', 'cpp', 'earing_run');
+end
+a = load(fullfile(root, 'tests', 'data', 'test_EarSumner2002.mat'));
+results_test = a.results_test.mark;
+
+best_frequencies = [250, 500, 1000, 3000, 6000, 12000, 24000];
+list_dbs = [0, 30, 60, 90];
+types_an = struct(...
+    'HSR', struct('gmaxca', 7.2e-9, 'ca_thresh', 0), ...
+    'MSR', struct('gmaxca', 2.4e-9, 'ca_thresh', 3.35e-14), ...
+    'LSR', struct('gmaxca', 1.6e-9, 'ca_thresh', 1.4e-11));
+
+fs = 1e5;
+signal_duration = 5; % seconds
+initial_time_remove = 0.3; % seconds; time before adaptation
+stimulus_file = [tempname, '.raw'];
+events_file = [tempname, '.bin'];
+cleanup = onCleanup(@() delete_files({stimulus_file, events_file}));
+bfs = sprintf('%g,', best_frequencies);
+
+n_failed = 0;
+for type_name = fieldnames(types_an)'
+    type_an = types_an.(type_name{1});
+    reference = results_test.(type_name{1});
+    for frequency = best_frequencies
+        fid = fopen(stimulus_file, 'w');
+        fwrite(fid, sin(2*pi*frequency*(0:1/fs:signal_duration)), 'double');
+        fclose(fid);
+        for db = list_dbs
+            command = sprintf('"%s" --single --raw --db %g --bfs %s --gmaxca %g --ca-thresh %g --fibers 1 --stage events --output "%s" "%s"', ...
+                earing_run, db, bfs(1:end-1), type_an.gmaxca, type_an.ca_thresh, events_file, stimulus_file);
+            [status, out] = system(command);
+            assert(status == 0, out);
+            fid = fopen(events_file);
+            events = fread(fid, [2, Inf], 'double');
+            fclose(fid);
+
+            % Spikes of the fiber at BF=sound frequency, after adaptation
+            fiber = find(best_frequencies == frequency);
+            rate = sum(events(1, :) == fiber & events(2, :) >= floor(fs*initial_time_remove)) / (signal_duration - initial_time_remove);
+            expected = reference([reference.frequency] == frequency & [reference.db] == db).rate;
+            ok = abs(rate - expected) <= max(10, 0.1*expected);
+            fprintf('%s, frequency: %g, db: %g, rate: %f, reference: %f%s\n', type_name{1}, frequency, db, rate, expected, ...
+                repmat(' FAILED', 1, ~ok));
+            n_failed = n_failed + ~ok;
+        end
+    end
+end
+assert(n_failed == 0, '%d rates out of tolerance', n_failed);
+end
+
+function delete_files(files)
+for k = 1:length(files)
+    if exist(files{k}, 'file')
+        delete(files{k});
+    end
+end
+end
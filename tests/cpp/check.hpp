@@ -0,0 +1,31 @@
+#pragma once
+
+/* Minimal checking macros for the native tests: each test is an executable
+ * returning the number of failed checks. */
+
+#include <cmath>
+#include <cstdio>
+
+namespace earing_test {
+inline int failures = 0;
+}
+
+#define CHECK(cond)                                                                   \
+    do {                                                                              \
+        if (!(cond)) {                                                                \
+            std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);      \
+            earing_test::failures++;                                                  \
+        }                                                                             \
+    } while (0)
+
+#define CHECK_CLOSE(a, b, tol)                                                        \
+    do {                                                                              \
+        double a_ = (a), b_ = (b);                                                    \
+        if (!(std::fabs(a_ - b_) <= (tol))) {                                         \
+            std::printf("%s:%d: CHECK_CLOSE(%s, %s) failed: %.17g != %.17g\n",        \
+                        __FILE__, __LINE__, #a, #b, a_, b_);                          \
+            earing_test::failures++;                                                  \
+        }                                                                             \
+    } while (0)
+
+#define TEST_MAIN_RETURN() return earing_test::failures == 0 ? 0 : 1
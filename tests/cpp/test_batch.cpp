@@ -0,0 +1,175 @@
+/* Batch runner: scheduling, resumption from existing outputs, failures,
+ * atomic outputs and WAV inputs not sampled at 1e5 Hz */
+
+#include "check.hpp"
+
+#include "earing/atomic_file.hpp"
+#include "earing/batch.hpp"
+#include "earing/ear_sumner2002.hpp"
+#include "earing/stimulus.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace earing;
+
+static bool exists(const std::string &path) {
+    return std::ifstream(path).good();
+}
+
+static std::vector<BatchJob> make_jobs(std::size_t n) {
+    std::vector<BatchJob> jobs(n);
+    for (std::size_t k = 0; k < n; k++) {
+        jobs[k].input = "job" + std::to_string(k);
+        jobs[k].output = "test_batch_" + std::to_string(k) + ".out";
+        jobs[k].cost = (k * 7) % n;
+        std::remove(jobs[k].output.c_str());
+    }
+    return jobs;
+}
+
+static void write_output(const BatchJob &job) {
+    AtomicFile file(job.output);
+    std::fputs(job.input.c_str(), file.get());
+    file.commit();
+}
+
+/* One worker runs the longest jobs first */
+static void test_order() {
+    std::vector<BatchJob> jobs = make_jobs(10);
+    std::vector<std::uint64_t> costs;
+    BatchReport report = run_batch(jobs, write_output, 1,
+                                   [&](const BatchJob &job, double, bool, std::size_t, std::size_t) {
+                                       costs.push_back(job.cost);
+                                   });
+    CHECK(report.done == 10);
+    CHECK(costs.size() == 10);
+    for (std::size_t k = 1; k < costs.size(); k++) {
+        CHECK(costs[k - 1] >= costs[k]);
+    }
+    for (const BatchJob &job : jobs) {
+        CHECK(exists(job.output));
+        std::remove(job.output.c_str());
+    }
+}
+
+/* Existing outputs are skipped, failures do not stop the others */
+static void test_resume() {
+    std::vector<BatchJob> jobs = make_jobs(25);
+    for (std::size_t k = 0; k < 5; k++) {
+        write_output(jobs[k]);
+    }
+    std::mutex mutex;
+    std::vector<std::string> ran;
+    BatchReport report = run_batch(
+        jobs,
+        [&](const BatchJob &job) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ran.push_back(job.input);
+            }
+            AtomicFile file(job.output);
+            std::fputs(job.input.c_str(), file.get());
+            if (job.input == "job13") {
+                throw std::runtime_error("broken");
+            }
+            file.commit();
+        },
+        4);
+    CHECK(report.skipped == 5);
+    CHECK(report.done == 19);
+    CHECK(report.failed == 1);
+    CHECK(report.errors.size() == 1 && report.errors[0] == "job13: broken");
+    CHECK(ran.size() == 20);
+    CHECK(!exists(jobs[13].output));
+    CHECK(!exists(jobs[13].output + ".part"));
+
+    /* Second run: only the failed job is left */
+    report = run_batch(jobs, write_output, 4);
+    CHECK(report.skipped == 24 && report.done == 1);
+    for (const BatchJob &job : jobs) {
+        std::remove(job.output.c_str());
+    }
+    CHECK(run_batch(std::vector<BatchJob>(), write_output).done == 0);
+}
+
+/* Mono 16-bit PCM WAV */
+static void write_wav(const std::string &path, const std::vector<double> &samples, std::uint32_t fs) {
+    std::ofstream file(path, std::ios::binary);
+    auto u32 = [&](std::uint32_t v) {
+        for (int b = 0; b < 4; b++) {
+            file.put((char)((v >> (8 * b)) & 0xff));
+        }
+    };
+    auto u16 = [&](std::uint32_t v) {
+        file.put((char)(v & 0xff));
+        file.put((char)((v >> 8) & 0xff));
+    };
+    std::uint32_t bytes = (std::uint32_t)(2 * samples.size());
+    file.write("RIFF", 4);
+    u32(36 + bytes);
+    file.write("WAVEfmt ", 8);
+    u32(16);
+    u16(1);
+    u16(1);
+    u32(fs);
+    u32(2 * fs);
+    u16(2);
+    u16(16);
+    file.write("data", 4);
+    u32(bytes);
+    for (double s : samples) {
+        u16((std::uint16_t)(std::int16_t)std::lround(s * 32767));
+    }
+}
+
+/* Datasets are not at 1e5 Hz: their WAV files are resampled as Matlab's
+ * resample(x, 25, 4) for 16 kHz */
+static void test_wav_sample_rate() {
+    const double pi = 3.14159265358979323846;
+    std::vector<double> samples(1601);
+    for (std::size_t t = 0; t < samples.size(); t++) {
+        samples[t] = 0.5 * std::sin(2 * pi * 1000 * t / 16000.);
+    }
+    write_wav("test_batch.wav", samples, 16000);
+
+    std::vector<double> resampled = resample(read_wav("test_batch.wav").samples, 16000, 1e5);
+    CHECK(resampled.size() == 10007);  /* ceil(1601 * 25 / 4) */
+    /* Away from the edges (10 input samples, the half length of the filter) */
+    double error = 0;
+    for (std::size_t t = 100; t + 100 < resampled.size(); t++) {
+        error = std::max(error, std::fabs(resampled[t] - 0.5 * std::sin(2 * pi * 1000 * t / 1e5)));
+    }
+    CHECK(error < 2e-3);
+
+    std::vector<BatchJob> jobs(1);
+    jobs[0].input = "test_batch.wav";
+    jobs[0].output = "test_batch_wav.out";
+    std::remove(jobs[0].output.c_str());
+    std::size_t cols = 0;
+    BatchReport report = run_batch(jobs, [&](const BatchJob &job) {
+        Stimulus stimulus = read_wav(job.input);
+        EarSumner2002 ear({1000});
+        ear.run(stimulus.samples, stimulus.fs);
+        cols = ear.drnl.response.cols();
+        write_output(job);
+    });
+    CHECK(report.done == 1 && report.failed == 0);
+    CHECK(cols == resampled.size());
+    std::remove(jobs[0].output.c_str());
+    std::remove("test_batch.wav");
+}
+
+int main() {
+    test_order();
+    test_resume();
+    test_wav_sample_rate();
+    TEST_MAIN_RETURN();
+}
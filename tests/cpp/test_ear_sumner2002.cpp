@@ -0,0 +1,333 @@
+/* Whole-pipeline sanity checks of the native Sumner2002 ear */
+
+#include "check.hpp"
+
+#include "earing/ear_sumner2002.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace earing;
+
+static std::vector<double> sinusoid(double frequency, double duration, double fs) {
+    std::vector<double> s((std::size_t)(duration * fs));
+    for (std::size_t t = 0; t < s.size(); t++) {
+        s[t] = std::sin(2 * 3.14159265358979323846 * frequency * t / fs);
+    }
+    return s;
+}
+
+static double row_mean(const Matrix &m, std::size_t row) {
+    double sum = 0;
+    for (std::size_t col = 0; col < m.cols(); col++) {
+        sum += m(row, col);
+    }
+    return sum / m.cols();
+}
+
+static void test_run() {
+    EarSumner2002 ear({250, 1000, 6000});
+    ear.synapse.n_fibers_per_type_per_channel = 2;
+    ear.run(sinusoid(1000, 0.05, 1e5));
+
+    std::size_t n = 5000;
+    CHECK(ear.ome.stapes_velocity.size() == n);
+    CHECK(ear.drnl.response.rows() == 3 && ear.drnl.response.cols() == n);
+    CHECK(ear.cilia.receptor_potential.rows() == 3);
+    CHECK(ear.synapse.vesicle_release_rate.rows() == 3);
+    CHECK(ear.an.prob_firing.rows() == 3 && ear.an.prob_firing.cols() == n);
+    CHECK(ear.an.spike_trains.n_fibers == 6 && ear.an.spike_trains.n_frames == n);
+
+    for (std::size_t ind = 0; ind < ear.an.prob_firing.size(); ind++) {
+        double p = ear.an.prob_firing.data()[ind];
+        CHECK(std::isfinite(p) && p >= 0 && p <= 1);
+        if (!(std::isfinite(p) && p >= 0 && p <= 1)) { break; }
+    }
+
+    /* The 1 kHz channel responds the most to a 1 kHz tone */
+    CHECK(row_mean(ear.an.prob_firing, 1) > row_mean(ear.an.prob_firing, 0));
+    CHECK(row_mean(ear.an.prob_firing, 1) > row_mean(ear.an.prob_firing, 2));
+
+    /* The receptor potential starts at rest */
+    CHECK_CLOSE(ear.cilia.receptor_potential(0, 0), ear.cilia.restingV, 1e-4);
+}
+
+/* Stimuli at other rates are resampled to 1e5 Hz first */
+static void test_sample_rate() {
+    EarSumner2002 ear({1000});
+    ear.run(sinusoid(1000, 0.01, 44100), 44100);
+    CHECK(ear.drnl.response.cols() == 1000);
+
+    EarSumner2002 reference({1000});
+    reference.run(sinusoid(1000, 0.01, 1e5));
+    CHECK_CLOSE(row_mean(ear.cilia.receptor_potential, 0), row_mean(reference.cilia.receptor_potential, 0), 1e-3);
+}
+
+static void test_chunked() {
+    std::vector<double> stimulus = sinusoid(500, 0.03, 1e5);
+    EarSumner2002 whole({500, 3000});
+    whole.synapse.n_fibers_per_type_per_channel = 1;
+    whole.an.refractoriness = true;
+    whole.run(stimulus);
+
+    EarSumner2002 chunked({500, 3000});
+    chunked.synapse.n_fibers_per_type_per_channel = 1;
+    chunked.an.refractoriness = true;
+    std::size_t n_frames = 0, n_chunks = 0;
+    chunked.run_chunked(stimulus, 1e5, 700, [&](const EarSumner2002 &ear, std::size_t first, std::size_t n) {
+        CHECK(first == n_frames);
+        CHECK(ear.an.prob_firing.cols() == n && n <= 700);
+        CHECK(ear.an.spike_trains.n_frames == n);
+        for (std::size_t col = 0; col < n; col++) {
+            for (std::size_t row = 0; row < 2; row++) {
+                CHECK_CLOSE(ear.an.prob_firing(row, col), whole.an.prob_firing(row, first + col), 1e-15);
+                CHECK_CLOSE(ear.an.prob_firing_refractory(row, col),
+                            whole.an.prob_firing_refractory(row, first + col), 1e-15);
+                CHECK_CLOSE(ear.cilia.receptor_potential(row, col), whole.cilia.receptor_potential(row, first + col), 1e-15);
+            }
+        }
+        n_frames += n;
+        n_chunks++;
+    });
+    CHECK(n_frames == stimulus.size());
+    CHECK(n_chunks == (stimulus.size() + 699) / 700);
+}
+
+/* The fused cilia kernel against the separate displacement, conductance and
+ * potential passes, and split in time over threads */
+static void test_cilia_fused() {
+    std::vector<double> tone = sinusoid(800, 0.7, 1e5);
+    Matrix velocity(1, tone.size());
+    for (std::size_t col = 0; col < tone.size(); col++) {
+        velocity(0, col) = 1e-5 * tone[col];
+    }
+
+    IhcCilia cilia;
+    cilia.keep_intermediates = true;
+    cilia.n_threads = 1;
+    cilia.run(velocity, 1e5);
+
+    double dt = 1 / 1e5, u = 0, V = cilia.restingV;
+    bool same = true;
+    for (std::size_t col = 0; col < velocity.cols(); col++) {
+        u = u * (1 - dt / cilia.tc) + dt * velocity(0, col) * cilia.C_s;
+        double g = cilia.Ga + cilia.Gmax / (1 + std::exp(-(u - cilia.u0) / cilia.s0) *
+                                                    (1 + std::exp(-(u - cilia.u1) / cilia.s1)));
+        V = V * (1 + (-cilia.Gk - g) * dt / cilia.Cab) + (g * cilia.Et + cilia.Gk * cilia.Ekp) * dt / cilia.Cab;
+        same = same && cilia.cilia_displacement(0, col) == u && cilia.Gu(0, col) == g &&
+               cilia.receptor_potential(0, col) == V;
+    }
+    CHECK(same);
+
+    IhcCilia split;
+    split.n_threads = 4;
+    split.run(velocity, 1e5);
+    CHECK(split.cilia_displacement.size() == 0 && split.Gu.size() == 0);
+    same = split.IHC_Vnow == cilia.IHC_Vnow && split.uNow == cilia.uNow;
+    for (std::size_t ind = 0; ind < velocity.size(); ind++) {
+        same = same && split.receptor_potential.data()[ind] == cilia.receptor_potential.data()[ind];
+    }
+    CHECK(same);
+}
+
+/* The fused synapse kernel against per-channel mICa and Ca recurrences, and
+ * split in time over threads */
+static void test_synapse_fused() {
+    std::vector<double> tone = sinusoid(600, 0.7, 1e5);
+    IhcCilia cilia;
+    Matrix V(1, tone.size());
+    for (std::size_t col = 0; col < tone.size(); col++) {
+        V(0, col) = cilia.restingV + 0.01 * tone[col];
+    }
+
+    AnIhcSynapse synapse;
+    synapse.tauCa = {1e-4, 0.75e-4, 0.5e-4};
+    synapse.keep_intermediates = true;
+    synapse.n_threads = 1;
+    synapse.run(V, cilia.restingV, 1e5);
+    CHECK(synapse.vesicle_release_rate.rows() == 3 && synapse.mICa.rows() == 1);
+
+    double dt = 1 / 1e5, c = 1 - dt / synapse.tauM;
+    double thresh = std::pow(synapse.ca_thresh, synapse.power);
+    double max_error = 0;
+    for (std::size_t ch = 0; ch < 3; ch++) {
+        double m = 1 / (1 + std::exp(-synapse.gamma * cilia.restingV) / synapse.beta);
+        double Ca = synapse.gmaxca * std::pow(m, 3) * (cilia.restingV - synapse.ECa) * -synapse.tauCa[ch];
+        double C = 1 - dt / synapse.tauCa[ch];
+        for (std::size_t col = 0; col < V.cols(); col++) {
+            m = m * c + 1 / (1 + std::exp(-synapse.gamma * V(0, col)) / synapse.beta) * (1 - c);
+            Ca = Ca * C + synapse.gmaxca * std::pow(m, 3) * (V(0, col) - synapse.ECa) * (1 - C);
+            double rate = std::max(synapse.z * (std::pow(-Ca, synapse.power) - thresh), 0.0);
+            max_error = std::max(max_error, std::abs(synapse.vesicle_release_rate(ch, col) - rate) / (1 + rate));
+        }
+    }
+    CHECK(max_error < 1e-10);
+
+    AnIhcSynapse split;
+    split.tauCa = synapse.tauCa;
+    split.n_threads = 4;
+    split.run(V, cilia.restingV, 1e5);
+    CHECK(split.mICa.size() == 0 && split.synapticCa.size() == 0);
+    bool same = split.CaCurrent == synapse.CaCurrent && split.mICaCurrent == synapse.mICaCurrent;
+    for (std::size_t ind = 0; ind < split.vesicle_release_rate.size(); ind++) {
+        same = same && split.vesicle_release_rate.data()[ind] == synapse.vesicle_release_rate.data()[ind];
+    }
+    CHECK(same);
+}
+
+/* AN stages at a quarter of the sample rate: shorter outputs, the same mean
+ * release, and chunks and a stimulus that are not a multiple of the
+ * decimation, the trailing incomplete group giving a last column */
+static void test_decimated() {
+    std::vector<double> stimulus = sinusoid(500, 0.031, 1e5);
+    stimulus.resize(3003);
+    EarSumner2002 full({500, 3000});
+    full.synapse.n_fibers_per_type_per_channel = 0;
+    full.run(stimulus);
+
+    EarSumner2002 whole({500, 3000});
+    whole.synapse.n_fibers_per_type_per_channel = 1;
+    whole.synapse.spikesTargetSampleRate = 25000;
+    whole.run(stimulus);
+    CHECK(whole.an.decimation == 4);
+    CHECK(whole.an.prob_firing.cols() == 751);
+    CHECK(whole.an.spike_trains.n_frames == 751);
+    for (std::size_t row = 0; row < 2; row++) {
+        double ratio = row_mean(whole.an.prob_firing, row) / (4 * row_mean(full.an.prob_firing, row));
+        CHECK(ratio > 0.95 && ratio < 1.05);
+    }
+
+    EarSumner2002 chunked({500, 3000});
+    chunked.synapse.n_fibers_per_type_per_channel = 1;
+    chunked.synapse.spikesTargetSampleRate = 25000;
+    std::size_t n_frames = 0;
+    chunked.run_chunked(stimulus, 1e5, 701, [&](const EarSumner2002 &ear, std::size_t, std::size_t) {
+        for (std::size_t col = 0; col < ear.an.prob_firing.cols(); col++) {
+            for (std::size_t row = 0; row < 2; row++) {
+                CHECK_CLOSE(ear.an.prob_firing(row, col), whole.an.prob_firing(row, n_frames + col), 1e-15);
+            }
+        }
+        n_frames += ear.an.prob_firing.cols();
+    });
+    CHECK(n_frames == 751);
+
+    /* As the MEX and C API (decimated_reservoir_release flushing at the end) */
+    EarSumner2002 reference({500, 3000});
+    reference.synapse.n_fibers_per_type_per_channel = 1;
+    reference.synapse.spikesTargetSampleRate = 25000;
+    reference.init_stream();
+    const Matrix &rate = whole.synapse.vesicle_release_rate;
+    std::vector<double> prob_release(rate.size()), prob_sum(2, 0.0);
+    for (std::size_t ind = 0; ind < rate.size(); ind++) {
+        prob_release[ind] = rate.data()[ind] * reference.an.dt;
+    }
+    Matrix prob_firing(2, 751);
+    std::size_t n_summed = 0;
+    AuditoryNerve &an = reference.an;
+    CHECK(decimated_reservoir_release(prob_firing.data(), prob_release.data(), 2, rate.cols(), 4, prob_sum.data(),
+                                      n_summed, true, an.available.data(), an.cleft.data(), an.reprocess.data(),
+                                      an.M, an.xdt.data(), an.ydt.data(), an.rdt_plus_ldt.data(),
+                                      an.rdt.data()) == 751);
+    bool same = true;
+    for (std::size_t ind = 0; ind < prob_firing.size(); ind++) {
+        same = same && prob_firing.data()[ind] == whole.an.prob_firing.data()[ind];
+    }
+    CHECK(same);
+
+    /* The same group averages alone (as for the quantal release), the last
+     * one over 3 frames */
+    Matrix decimated(2, 751);
+    n_summed = 0;
+    CHECK(decimate_release_prob(decimated.data(), prob_release.data(), 2, rate.cols(), 4, prob_sum.data(), n_summed,
+                                true) == 751);
+    CHECK_CLOSE(decimated(1, 750),
+                (prob_release[2 * 3000 + 1] + prob_release[2 * 3001 + 1] + prob_release[2 * 3002 + 1]) / 3, 1e-15);
+}
+
+/* EarSumner2002Single against the double reference: stage outputs within a
+ * small fraction of their range, and the same mean firing probabilities */
+static void test_single_precision() {
+    std::vector<double> stimulus = sinusoid(1000, 0.1, 1e5);
+    EarSumner2002 ref({250, 1000, 6000});
+    EarSumner2002Single single({250, 1000, 6000});
+    ref.synapse.n_fibers_per_type_per_channel = 0;
+    single.synapse.n_fibers_per_type_per_channel = 0;
+    ref.run(stimulus);
+    single.run(stimulus);
+
+    auto max_error = [](const auto &a, const Matrix &b) {
+        double error = 0, range = 0;
+        for (std::size_t k = 0; k < b.size(); k++) {
+            error = std::max(error, std::abs((double)a.data()[k] - b.data()[k]));
+            range = std::max(range, std::abs(b.data()[k]));
+        }
+        return error / range;
+    };
+    CHECK(single.drnl.response.rows() == 3 && single.drnl.response.cols() == stimulus.size());
+    CHECK(max_error(single.drnl.response, ref.drnl.response) < 1e-5);
+    CHECK(max_error(single.cilia.receptor_potential, ref.cilia.receptor_potential) < 1e-5);
+    CHECK(max_error(single.synapse.vesicle_release_rate, ref.synapse.vesicle_release_rate) < 1e-5);
+    CHECK(max_error(single.an.prob_firing, ref.an.prob_firing) < 1e-5);
+    for (std::size_t row = 0; row < ref.an.prob_firing.rows(); row++) {
+        double mean = 0;
+        for (std::size_t col = 0; col < single.an.prob_firing.cols(); col++) {
+            mean += single.an.prob_firing(row, col);
+        }
+        mean /= single.an.prob_firing.cols();
+        CHECK_CLOSE(mean, row_mean(ref.an.prob_firing, row), 1e-5 * row_mean(ref.an.prob_firing, row));
+    }
+}
+
+/* Every stage recorded once per chunk, and nothing unless profiling */
+static void test_profile() {
+    std::vector<double> stimulus = sinusoid(1000, 0.03, 1e5);
+    EarSumner2002 ear({500, 3000});
+    ear.an.refractoriness = true;
+    ear.run(stimulus);
+    CHECK(ear.profile.stages.empty());
+
+    ear.profiling = true;
+    ear.run_chunked(stimulus, 1e5, 1000, [](const EarSumner2002 &, std::size_t, std::size_t) {});
+    const char *stages[] = {"ome", "bm", "cilia", "synapse", "an_prob", "an_refractoriness", "an_spikes"};
+    CHECK(ear.profile.stages.size() == 7);
+    for (std::size_t k = 0; k < ear.profile.stages.size() && k < 7; k++) {
+        const StageProfile &s = ear.profile.stages[k];
+        CHECK(s.stage == stages[k]);
+        CHECK(s.calls == 3 && s.samples == stimulus.size());
+        CHECK(s.seconds >= 0 && s.bytes > 0);
+    }
+    CHECK(ear.profile.stages[1].bytes >= 2 * 1000 * sizeof(double));
+
+    /* Appended twice to a new log: a single header line */
+    const char *path = "test_profile_log.csv";
+    std::remove(path);
+    ear.profile.append_csv(path, "a");
+    ear.profile.append_csv(path, "b");
+    std::ifstream log(path);
+    std::string line;
+    std::size_t n_lines = 0, n_headers = 0;
+    while (std::getline(log, line)) {
+        n_lines++;
+        n_headers += line.rfind("label,", 0) == 0;
+    }
+    CHECK(n_headers == 1 && n_lines == 1 + 2 * 7);
+    log.close();
+    std::remove(path);
+}
+
+int main() {
+    test_run();
+    test_sample_rate();
+    test_chunked();
+    test_cilia_fused();
+    test_synapse_fused();
+    test_decimated();
+    test_single_precision();
+    test_profile();
+    TEST_MAIN_RETURN();
+}
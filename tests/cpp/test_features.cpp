@@ -0,0 +1,302 @@
+/* Streaming feature pipeline against whole-utterance versions of the steps of
+ * ProcessingAsr.run_single_features, with the input cut in uneven blocks */
+
+#include "check.hpp"
+
+#include "earing/features.hpp"
+#include "earing/random.hpp"
+#include "earing/spike_analysis.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+using namespace earing;
+
+static const double pi = 3.14159265358979323846;
+
+/* Runs the pipeline on blocks of cols columns of x and concatenates the frames */
+static Matrix run_blocks(FeaturePipeline &pipeline, const Matrix &x, std::size_t cols) {
+    std::vector<double> values;
+    std::size_t rows = 0;
+    pipeline.init();
+    for (std::size_t first = 0; first < x.cols() + cols; first += cols) {
+        if (first < x.cols()) {
+            std::size_t n = std::min(cols, x.cols() - first);
+            Matrix block(x.rows(), n);
+            std::copy(x.col(first), x.col(first) + x.rows() * n, block.data());
+            pipeline.apply(block);
+        } else {
+            pipeline.finish();
+        }
+        if (!pipeline.frames.empty()) {
+            rows = pipeline.frames.rows();
+            values.insert(values.end(), pipeline.frames.data(), pipeline.frames.data() + pipeline.frames.size());
+        }
+    }
+    Matrix out(rows, rows > 0 ? values.size() / rows : 0);
+    std::copy(values.begin(), values.end(), out.data());
+    return out;
+}
+
+/* calculateRate: Hann windows of n frames every hop frames, from frame 1 */
+static Matrix reference_rate(const Matrix &x, std::size_t n, std::size_t hop) {
+    std::vector<double> window(n), begin;
+    double norm = 0;
+    for (std::size_t j = 0; j < n; j++) {
+        window[j] = 0.5 * (1 - std::cos(2 * pi * j / (n - 1)));
+        norm += window[j];
+    }
+    for (std::size_t b = 1; b + n <= x.cols(); b += hop) {
+        begin.push_back((double)b);
+    }
+    std::vector<double> xt(x.size());
+    for (std::size_t row = 0; row < x.rows(); row++) {
+        for (std::size_t col = 0; col < x.cols(); col++) {
+            xt[col + row * x.cols()] = x(row, col);
+        }
+    }
+    std::vector<double> rate(begin.size() * x.rows());
+    rate_spike_train(xt.data(), x.cols(), x.rows(), begin.data(), begin.size(), window.data(), n, rate.data());
+    Matrix out(x.rows(), begin.size());
+    for (std::size_t row = 0; row < x.rows(); row++) {
+        for (std::size_t k = 0; k < begin.size(); k++) {
+            out(row, k) = rate[k + row * begin.size()] / norm;
+        }
+    }
+    return out;
+}
+
+static Matrix reference_dct(const Matrix &x, std::size_t n_coeff) {
+    Matrix out(n_coeff, x.cols());
+    std::size_t n = x.rows();
+    for (std::size_t col = 0; col < x.cols(); col++) {
+        for (std::size_t k = 0; k < n_coeff; k++) {
+            double sum = 0;
+            for (std::size_t j = 0; j < n; j++) {
+                sum += x(j, col) * std::cos(pi * (2 * j + 1) * k / (2.0 * n));
+            }
+            out(k, col) = sum * std::sqrt((k == 0 ? 1.0 : 2.0) / n);
+        }
+    }
+    return out;
+}
+
+/* conv2(x, linspace(-1, 1, 2 * half + 1), 'same'), zeros outside */
+static Matrix conv_same(const Matrix &x, std::size_t half) {
+    Matrix out(x.rows(), x.cols());
+    for (std::size_t col = 0; col < x.cols(); col++) {
+        for (std::size_t j = 0; j <= 2 * half; j++) {
+            double h = half > 0 ? -1.0 + (double)j / half : 1.0;
+            long src = (long)col + (long)half - (long)j;
+            if (src < 0 || src >= (long)x.cols()) {
+                continue;
+            }
+            for (std::size_t row = 0; row < x.rows(); row++) {
+                out(row, col) += h * x(row, (std::size_t)src);
+            }
+        }
+    }
+    return out;
+}
+
+static Matrix reference_deltas(const Matrix &x, std::size_t delta, std::size_t ddelta) {
+    std::size_t context = delta + ddelta, cols = x.cols() + 2 * context;
+    Matrix padded(x.rows(), cols);
+    for (std::size_t col = 0; col < cols; col++) {
+        std::size_t src = col < context ? 0 : std::min(col - context, x.cols() - 1);
+        std::copy(x.col(src), x.col(src) + x.rows(), padded.col(col));
+    }
+    Matrix d = conv_same(padded, delta), dd = conv_same(d, ddelta);
+    Matrix out(3 * x.rows(), x.cols());
+    for (std::size_t col = 0; col < x.cols(); col++) {
+        for (std::size_t row = 0; row < x.rows(); row++) {
+            out(row, col) = padded(row, col + context);
+            out(row + x.rows(), col) = d(row, col + context);
+            out(row + 2 * x.rows(), col) = dd(row, col + context);
+        }
+    }
+    return out;
+}
+
+static double max_difference(const Matrix &a, const Matrix &b) {
+    if (a.rows() != b.rows() || a.cols() != b.cols()) {
+        return INFINITY;
+    }
+    double diff = 0;
+    for (std::size_t k = 0; k < a.size(); k++) {
+        diff = std::max(diff, std::fabs(a.data()[k] - b.data()[k]));
+    }
+    return diff;
+}
+
+static Matrix random_matrix(std::size_t rows, std::size_t cols, std::uint64_t seed) {
+    Matrix x(rows, cols);
+    RandomStream rng(seed, 0);
+    for (std::size_t k = 0; k < x.size(); k++) {
+        x.data()[k] = rng.uniform();
+    }
+    return x;
+}
+
+/* r_l_d_dd, the usual MFCC-like string, at 1e4 Hz (30 and 10 ms: 300 and 100 frames) */
+static void test_rate_log_dct_deltas() {
+    FeatureParams params;
+    params.fs = 1e4;
+    Matrix x = random_matrix(40, 4321, 1);
+
+    Matrix expected = reference_rate(x, 300, 100);
+    for (std::size_t k = 0; k < expected.size(); k++) {
+        expected.data()[k] = std::log10(1 + expected.data()[k]);
+    }
+    expected = reference_deltas(reference_dct(expected, 13), 2, 2);
+
+    FeaturePipeline pipeline("SPIKE_r_l_d_dd", params);
+    CHECK(pipeline.steps().size() == 4);
+    for (std::size_t cols : {4321, 777, 100, 1}) {
+        Matrix features = run_blocks(pipeline, x, cols);
+        CHECK(features.rows() == 39);
+        CHECK(features.cols() == 41);
+        CHECK(max_difference(features, expected) < 1e-12);
+    }
+
+    /* The rate alone is the one of rate_spike_train */
+    FeaturePipeline rate("r", params);
+    CHECK(max_difference(run_blocks(rate, x, 1000), reference_rate(x, 300, 100)) == 0);
+}
+
+/* The rate window is Matlab's hann(n), zero at both ends: hann(5) is
+ * [0 0.5 1 0.5 0], read backwards by the windows over an impulse */
+static void test_hann_window() {
+    FeatureParams params;
+    params.fs = 1e4;
+    params.rate_window_duration = 5e-4;
+    params.rate_time_step = 1e-4;
+    Matrix x(1, 20);
+    x(0, 10) = 1;
+
+    const double hann5[] = {0, 0.5, 1, 0.5, 0};
+    FeaturePipeline rate("r", params);
+    Matrix features = run_blocks(rate, x, 7);
+    CHECK(features.rows() == 1 && features.cols() == 15);
+    for (std::size_t k = 0; k < features.cols(); k++) {
+        /* Window k covers frames 1 + k ... 5 + k, divided by sum(hann(5)) = 2 */
+        double expected = k + 1 <= 10 && 10 <= k + 5 ? hann5[10 - (k + 1)] / 2 : 0;
+        CHECK_CLOSE(features(0, k), expected, 1e-15);
+    }
+}
+
+/* Spike trains give the rate of the same spikes as a dense matrix */
+static void test_spike_input() {
+    FeatureParams params;
+    params.fs = 1e4;
+    const std::size_t fibers = 12, n_frames = 3000, block = 700;
+    Matrix dense(fibers, n_frames);
+    RandomStream rng(2, 0);
+    for (std::size_t k = 0; k < dense.size(); k++) {
+        dense.data()[k] = rng.uniform() < 0.05 ? 1 : 0;
+    }
+    FeaturePipeline from_dense("r_el", params), from_spikes("r_el", params);
+    Matrix expected = run_blocks(from_dense, dense, block);
+
+    std::vector<double> values;
+    for (std::size_t first = 0; first < n_frames; first += block) {
+        SpikeTrains trains;
+        trains.n_fibers = fibers;
+        trains.n_frames = std::min(block, n_frames - first);
+        trains.fiber_start.push_back(0);
+        for (std::size_t fiber = 0; fiber < fibers; fiber++) {
+            for (std::size_t t = 0; t < trains.n_frames; t++) {
+                if (dense(fiber, first + t) != 0) {
+                    trains.frames.push_back(t);
+                }
+            }
+            trains.fiber_start.push_back(trains.frames.size());
+        }
+        from_spikes.apply(trains);
+        values.insert(values.end(), from_spikes.frames.data(),
+                      from_spikes.frames.data() + from_spikes.frames.size());
+    }
+    CHECK(expected.rows() == fibers + 1);
+    CHECK(values.size() == expected.size());
+    CHECK(std::equal(values.begin(), values.end(), expected.data()));
+
+    bool thrown = false;
+    try {
+        FeaturePipeline("l", params).apply(SpikeTrains());
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+/* z and ga over the whole utterance, and with running statistics */
+static void test_normalisation() {
+    Matrix x = random_matrix(5, 200, 3);
+    Matrix z(x.rows(), x.cols()), ga(x.rows(), x.cols());
+    for (std::size_t row = 0; row < x.rows(); row++) {
+        double mean = 0, ss = 0;
+        for (std::size_t col = 0; col < x.cols(); col++) {
+            mean += x(row, col) / x.cols();
+        }
+        for (std::size_t col = 0; col < x.cols(); col++) {
+            z(row, col) = x(row, col) - mean;
+            ss += z(row, col) * z(row, col);
+        }
+        for (std::size_t col = 0; col < x.cols(); col++) {
+            ga(row, col) = z(row, col) / std::sqrt(ss / (x.cols() - 1));
+        }
+    }
+    FeaturePipeline cmn("z"), gauss("ga");
+    CHECK(max_difference(run_blocks(cmn, x, 33), z) < 1e-12);
+    CHECK(max_difference(run_blocks(gauss, x, 33), ga) < 1e-12);
+
+    /* Running statistics: frames go through at once, and the last one sees
+     * the statistics of the whole utterance */
+    FeatureParams params;
+    params.running_statistics = true;
+    FeaturePipeline running("e_ga", params);
+    running.apply(x);
+    CHECK(running.frames.cols() == x.cols());
+    CHECK(running.frames.rows() == x.rows() + 1);
+    running.finish();
+    CHECK(running.frames.cols() == 0);
+
+    FeaturePipeline last("z", params);
+    Matrix out = run_blocks(last, x, 7);
+    for (std::size_t row = 0; row < x.rows(); row++) {
+        CHECK_CLOSE(out(row, x.cols() - 1), z(row, x.cols() - 1), 1e-12);
+    }
+}
+
+static void test_element_wise() {
+    Matrix x = random_matrix(62, 10, 4);
+    x(0, 0) = 0;
+    FeaturePipeline lu("lu"), l3("l3"), avg("f");
+    Matrix a = run_blocks(lu, x, 3), b = run_blocks(l3, x, 3), c = run_blocks(avg, x, 3);
+    CHECK(a(0, 0) == 0);
+    CHECK_CLOSE(a(1, 0), std::max(std::log10(x(1, 0)), -5.0) + 5, 1e-15);
+    CHECK_CLOSE(b(7, 9), std::log10(1 + 1000 * x(7, 9)), 1e-15);
+    CHECK(c.rows() == 31);
+    CHECK_CLOSE(c(30, 4), (x(60, 4) + x(61, 4)) / 2, 1e-15);
+
+    for (const char *features : {"g", "r_l_r", "l_r", "x"}) {
+        bool thrown = false;
+        try {
+            FeaturePipeline pipeline(features);
+        } catch (const std::invalid_argument &) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+}
+
+int main() {
+    test_rate_log_dct_deltas();
+    test_hann_window();
+    test_spike_input();
+    test_normalisation();
+    test_element_wise();
+    TEST_MAIN_RETURN();
+}
@@ -0,0 +1,224 @@
+/* Filters and recurrences against reference values (Matlab) and naive loops */
+
+#include "check.hpp"
+
+#include "earing/filters.hpp"
+#include "earing/recurrence.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+using namespace earing;
+
+static void test_butter() {
+    /* [b, a] = butter(2, 0.2) */
+    IirCoefficients lp = butter_lowpass(2, 0.2);
+    CHECK(lp.b.size() == 3 && lp.a.size() == 3);
+    CHECK_CLOSE(lp.b[0], 0.067455273889072, 1e-12);
+    CHECK_CLOSE(lp.b[1], 0.134910547778144, 1e-12);
+    CHECK_CLOSE(lp.b[2], 0.067455273889072, 1e-12);
+    CHECK_CLOSE(lp.a[0], 1.0, 1e-12);
+    CHECK_CLOSE(lp.a[1], -1.142980502539901, 1e-12);
+    CHECK_CLOSE(lp.a[2], 0.412801598096189, 1e-12);
+
+    /* [b, a] = butter(1, [0.2 0.5]) */
+    IirCoefficients bp = butter_bandpass(1, 0.2, 0.5);
+    CHECK(bp.b.size() == 3 && bp.a.size() == 3);
+    CHECK_CLOSE(bp.b[0], 0.337540151883547, 1e-12);
+    CHECK_CLOSE(bp.b[1], 0.0, 1e-12);
+    CHECK_CLOSE(bp.b[2], -0.337540151883547, 1e-12);
+    CHECK_CLOSE(bp.a[1], -0.675080303767095, 1e-12);
+    CHECK_CLOSE(bp.a[2], 0.324919696232906, 1e-12);
+}
+
+static void test_filter_in_pieces() {
+    IirCoefficients c = butter_lowpass(2, 0.1);
+    std::vector<double> x(1000), whole(1000), pieces(1000);
+    for (std::size_t t = 0; t < x.size(); t++) {
+        x[t] = (t * 7919 % 101) / 50.0 - 1;
+    }
+    IirFilter(c).apply(x.data(), whole.data(), x.size());
+    IirFilter f(c);
+    f.apply(x.data(), pieces.data(), 333);
+    f.apply(x.data() + 333, pieces.data() + 333, x.size() - 333);
+    for (std::size_t t = 0; t < x.size(); t++) {
+        CHECK_CLOSE(pieces[t], whole[t], 1e-12);
+    }
+
+    /* Difference equation y(n) = sum b(k) x(n-k) - sum a(k) y(n-k) */
+    for (std::size_t t = 0; t < x.size(); t++) {
+        double y = 0;
+        for (std::size_t k = 0; k < 3 && k <= t; k++) {
+            y += c.b[k] * x[t - k] - (k > 0 ? c.a[k] * whole[t - k] : 0.0);
+        }
+        CHECK_CLOSE(whole[t], y, 1e-12);
+    }
+}
+
+/* Each lane of a filter bank is the cascade of IirFilters of its coefficients */
+static void test_filter_bank() {
+    std::vector<IirCoefficients> coefficients = {butter_lowpass(2, 0.1), butter_lowpass(2, 0.3),
+                                                 {{0.2, -0.1}, {1.0, -0.5, 0.1}}};
+    const std::size_t lanes = coefficients.size(), n = 500;
+    const int cascade = 3;
+    IirFilterBank bank(coefficients, cascade);
+    std::vector<double> out(lanes * n);
+    for (std::size_t t = 0; t < n; t++) {
+        for (std::size_t lane = 0; lane < lanes; lane++) {
+            out[lane + t * lanes] = std::sin(0.05 * t * (lane + 1));
+        }
+        bank.step(&out[t * lanes], 0, lanes);
+    }
+    for (std::size_t lane = 0; lane < lanes; lane++) {
+        std::vector<double> x(n);
+        for (std::size_t t = 0; t < n; t++) {
+            x[t] = std::sin(0.05 * t * (lane + 1));
+        }
+        for (int k = 0; k < cascade; k++) {
+            IirFilter(coefficients[lane]).apply(x.data(), x.data(), n);
+        }
+        for (std::size_t t = 0; t < n; t++) {
+            CHECK(out[lane + t * lanes] == x[t]);
+        }
+    }
+}
+
+static void test_recurrence() {
+    const std::size_t rows = 5, cols = 300;
+    std::vector<double> A(rows * cols), Cfull(rows * cols), Ccol(rows);
+    for (std::size_t k = 0; k < A.size(); k++) {
+        A[k] = (k * 31 % 17) / 17.0;
+        Cfull[k] = 0.5 + (k * 13 % 7) / 20.0;
+    }
+    for (std::size_t row = 0; row < rows; row++) {
+        Ccol[row] = 0.9 - row * 0.1;
+    }
+    double Cscalar = 0.95;
+
+    struct Case { CoefficientShape shape; const double *C; };
+    for (Case c : {Case{CoefficientShape::Scalar, &Cscalar}, Case{CoefficientShape::Column, Ccol.data()},
+                   Case{CoefficientShape::Full, Cfull.data()}}) {
+        std::vector<double> matrix(rows * cols), vector(rows, 1.0);
+        first_order_recurrence(matrix.data(), vector.data(), c.C, c.shape, A.data(), rows, cols);
+        for (std::size_t row = 0; row < rows; row++) {
+            double v = 1.0;
+            for (std::size_t col = 0; col < cols; col++) {
+                std::size_t ind = row + col * rows;
+                double coef = c.shape == CoefficientShape::Scalar ? *c.C
+                            : c.shape == CoefficientShape::Column ? c.C[row] : c.C[ind];
+                v = v * coef + A[ind];
+                CHECK_CLOSE(matrix[ind], v, 1e-12);
+            }
+            CHECK_CLOSE(vector[row], v, 1e-12);
+        }
+    }
+}
+
+/* More rows than a tile and enough work to be split: every thread count gives
+ * exactly the single-threaded result */
+static void test_recurrence_threads() {
+    const std::size_t rows = 600, cols = 700;
+    std::vector<double> A(rows * cols), C(rows * cols);
+    for (std::size_t k = 0; k < A.size(); k++) {
+        A[k] = (k * 31 % 17) / 17.0;
+        C[k] = 0.5 + (k * 13 % 7) / 20.0;
+    }
+    std::vector<double> serial(rows * cols), serial_state(rows, 1.0);
+    first_order_recurrence(serial.data(), serial_state.data(), C.data(), CoefficientShape::Full, A.data(),
+                           rows, cols, 1);
+    for (int n_threads : {2, 3, 8}) {
+        std::vector<double> matrix(rows * cols), vector(rows, 1.0);
+        first_order_recurrence(matrix.data(), vector.data(), C.data(), CoefficientShape::Full, A.data(),
+                               rows, cols, n_threads);
+        CHECK(matrix == serial);
+        CHECK(vector == serial_state);
+    }
+}
+
+/* Few rows and many frames: the parallel-in-time scan matches the sequential
+ * recurrence, whatever the number of threads */
+static void test_recurrence_scan() {
+    const std::size_t rows = 3, cols = 50000;
+    std::vector<double> A(rows * cols), C(rows * cols);
+    for (std::size_t k = 0; k < A.size(); k++) {
+        A[k] = std::sin(k * 1e-3);
+        C[k] = 0.999 - (k * 13 % 7) * 1e-4;
+    }
+    double Cscalar = 0.9995;
+    std::vector<double> Ccol = {0.99, 0.999, 0.9999};
+
+    struct Case { CoefficientShape shape; const double *C; };
+    for (Case c : {Case{CoefficientShape::Scalar, &Cscalar}, Case{CoefficientShape::Column, Ccol.data()},
+                   Case{CoefficientShape::Full, C.data()}}) {
+        std::vector<double> expected(rows * cols), v(rows, 2.0);
+        for (std::size_t col = 0; col < cols; col++) {
+            for (std::size_t row = 0; row < rows; row++) {
+                std::size_t ind = row + col * rows;
+                double coef = c.shape == CoefficientShape::Scalar ? *c.C
+                            : c.shape == CoefficientShape::Column ? c.C[row] : c.C[ind];
+                v[row] = v[row] * coef + A[ind];
+                expected[ind] = v[row];
+            }
+        }
+        std::vector<double> serial(rows * cols), serial_state(rows, 2.0);
+        first_order_recurrence(serial.data(), serial_state.data(), c.C, c.shape, A.data(), rows, cols, 1);
+        double err = 0;
+        for (std::size_t ind = 0; ind < serial.size(); ind++) {
+            err = std::max(err, std::fabs(serial[ind] - expected[ind]));
+        }
+        CHECK_CLOSE(err, 0.0, 1e-10);
+        for (std::size_t row = 0; row < rows; row++) {
+            CHECK(serial_state[row] == serial[row + (cols - 1) * rows]);
+        }
+
+        std::vector<double> matrix(rows * cols), state(rows, 2.0);
+        first_order_recurrence(matrix.data(), state.data(), c.C, c.shape, A.data(), rows, cols, 4);
+        CHECK(matrix == serial);
+        CHECK(state == serial_state);
+    }
+}
+
+/* float matrices (Matlab single arrays): the state being carried in double,
+ * the outputs of the row mode are the double recurrence of the same inputs
+ * rounded to float; those of the scan mode, whose blocks are stored in float
+ * before the carries are added, are within a few float roundings of it */
+static void test_recurrence_single() {
+    for (std::size_t rows : {600, 3}) {
+        const std::size_t cols = rows == 3 ? 50000 : 700;
+        std::vector<float> A(rows * cols), C(rows * cols);
+        for (std::size_t k = 0; k < A.size(); k++) {
+            A[k] = (float)std::sin(k * 1e-3);
+            C[k] = (float)(0.999 - (k * 13 % 7) * 1e-4);
+        }
+        std::vector<double> Ad(A.begin(), A.end()), Cd(C.begin(), C.end());
+        std::vector<double> expected(rows * cols), expected_state(rows, 2.0);
+        first_order_recurrence(expected.data(), expected_state.data(), Cd.data(), CoefficientShape::Full,
+                               Ad.data(), rows, cols, 1);
+
+        std::vector<float> matrix(rows * cols), state(rows, 2.0f);
+        first_order_recurrence(matrix.data(), state.data(), C.data(), CoefficientShape::Full, A.data(), rows, cols,
+                               4);
+        const double tolerance = rows == 3 ? 1e-6 : 0;
+        double err = 0, range = 0;
+        for (std::size_t ind = 0; ind < matrix.size(); ind++) {
+            err = std::max(err, std::fabs(matrix[ind] - (double)(float)expected[ind]));
+            range = std::max(range, std::fabs(expected[ind]));
+        }
+        CHECK(err <= tolerance * range);
+        for (std::size_t row = 0; row < rows; row++) {
+            CHECK(std::fabs(state[row] - (double)(float)expected_state[row]) <= tolerance * range);
+        }
+    }
+}
+
+int main() {
+    test_butter();
+    test_filter_in_pieces();
+    test_filter_bank();
+    test_recurrence();
+    test_recurrence_threads();
+    test_recurrence_scan();
+    test_recurrence_single();
+    TEST_MAIN_RETURN();
+}
@@ -0,0 +1,152 @@
+/* HTK files against the byte layout of htkwrite.m, written block by block and
+ * read back, header only or whole */
+
+#include "check.hpp"
+
+#include "earing/htk.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+using namespace earing;
+
+static std::vector<unsigned char> file_bytes(const char *path) {
+    std::vector<unsigned char> bytes;
+    FILE *file = std::fopen(path, "rb");
+    if (file != nullptr) {
+        int c;
+        while ((c = std::fgetc(file)) != EOF) {
+            bytes.push_back((unsigned char)c);
+        }
+        std::fclose(file);
+    }
+    return bytes;
+}
+
+/* Two features over three frames (columns) */
+static Matrix example() {
+    Matrix x(2, 3);
+    double values[] = {0, -2, 1, 2, 0.5, 1};
+    std::copy(values, values + 6, x.data());
+    return x;
+}
+
+static void test_uncompressed() {
+    const char *path = "test_htk_float.usr";
+    Matrix x = example();
+    {
+        HtkWriter writer(path, htk_user, 100000);
+        Matrix first(2, 1), rest(2, 2);
+        std::copy(x.data(), x.data() + 2, first.data());
+        std::copy(x.data() + 2, x.data() + 6, rest.data());
+        writer.write(first);
+        writer.write(rest);
+        writer.close();
+    }
+    std::vector<unsigned char> bytes = file_bytes(path);
+    /* nSamples 3, sampPeriod 100000, sampSize 8, parmKind 9, then -2.0f at offset 16 */
+    std::vector<unsigned char> head = {0, 0, 0, 3, 0, 1, 0x86, 0xa0, 0, 8, 0, 9};
+    CHECK(bytes.size() == 12 + 4 * 6);
+    CHECK(std::equal(head.begin(), head.end(), bytes.begin()));
+    CHECK(bytes[16] == 0xc0 && bytes[17] == 0 && bytes[18] == 0 && bytes[19] == 0);
+
+    HtkHeader header = read_htk_header(path);
+    CHECK(header.n_frames == 3);
+    CHECK(header.n_features == 2);
+    CHECK(header.samp_period == 100000);
+    CHECK(!header.compressed());
+    Matrix y = read_htk(path);
+    CHECK(y.rows() == 2 && y.cols() == 3);
+    for (std::size_t k = 0; k < x.size(); k++) {
+        CHECK(y.data()[k] == x.data()[k]);
+    }
+    std::remove(path);
+}
+
+static void test_compressed() {
+    const char *path = "test_htk_short.usr";
+    const int kind = htk_user | htk_compressed;
+    write_htk(path, example(), kind);
+    std::vector<unsigned char> bytes = file_bytes(path);
+    /* nSamples 3 + 4, sampSize 4; A = [65534 16383.5], B = [32767 0], then
+     * round(A x - B): [-32767 -32767; 32767 32767; 0 16384] (16383.5 rounds up) */
+    CHECK(bytes.size() == 12 + 16 + 2 * 6);
+    CHECK(bytes[3] == 7 && bytes[9] == 4 && bytes[10] == 0x04 && bytes[11] == 9);
+    std::vector<unsigned char> data = {0x80, 0x01, 0x80, 0x01, 0x7f, 0xff, 0x7f, 0xff, 0x00, 0x00, 0x40, 0x00};
+    CHECK(std::equal(data.begin(), data.end(), bytes.begin() + 28));
+
+    HtkHeader header;
+    Matrix y = read_htk(path, &header);
+    CHECK(header.compressed());
+    CHECK(header.n_frames == 3);
+    CHECK(header.n_features == 2);
+    Matrix x = example();
+    for (std::size_t k = 0; k < x.size(); k++) {
+        CHECK_CLOSE(y.data()[k], x.data()[k], 1e-4);
+    }
+
+    /* A constant feature comes back exactly */
+    Matrix c(1, 4, 0.25);
+    write_htk(path, c, kind);
+    y = read_htk(path);
+    CHECK(y.cols() == 4 && y(0, 3) == 0.25);
+    std::remove(path);
+}
+
+static void test_errors() {
+    const char *path = "test_htk_bad.usr";
+    Matrix x = example();
+    write_htk(path, x);
+    std::vector<unsigned char> bytes = file_bytes(path);
+    FILE *file = std::fopen(path, "wb");
+    std::fwrite(bytes.data(), 1, bytes.size() - 4, file);
+    std::fclose(file);
+    CHECK(read_htk_header(path).n_frames == 3);
+    bool thrown = false;
+    try {
+        read_htk(path);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    std::remove(path);
+
+    thrown = false;
+    try {
+        read_htk_header(path);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+
+    thrown = false;
+    HtkWriter writer(path);
+    writer.write(x);
+    try {
+        writer.write(Matrix(3, 1));
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+    writer.close();
+    CHECK(read_htk_header(path).n_frames == 3);
+    std::remove(path);
+
+    /* Nothing is left by a writer that was not closed */
+    {
+        HtkWriter unfinished(path);
+        unfinished.write(x);
+    }
+    CHECK(file_bytes(path).empty());
+    CHECK(file_bytes("test_htk_bad.usr.part").empty());
+}
+
+int main() {
+    test_uncompressed();
+    test_compressed();
+    test_errors();
+    TEST_MAIN_RETURN();
+}
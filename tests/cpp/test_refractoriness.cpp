@@ -0,0 +1,111 @@
+/* Probability of firing with refractoriness against the loop of
+ * MAP_applyRefractoriness_mex.c, for the direct and recursive sums */
+
+#include "check.hpp"
+
+#include "earing/refractoriness.hpp"
+
+#include <cmath>
+#include <vector>
+
+using namespace earing;
+
+/* Loop of MAP_applyRefractoriness_mex.c */
+static std::vector<double> naive(const std::vector<double> &prob, std::size_t rows, std::size_t cols,
+                                 const std::vector<double> &W) {
+    std::vector<double> probref(prob.size());
+    for (std::size_t row = 0; row < rows; row++) {
+        probref[row] = prob[row];
+    }
+    for (std::size_t col = 1; col < cols; col++) {
+        std::size_t cHoriz = col < W.size() ? col : W.size();
+        for (std::size_t row = 0; row < rows; row++) {
+            double su = 0.0;
+            for (std::size_t col_b = 0; col_b < cHoriz; col_b++) {
+                su += W[col_b] * probref[row + (col - 1 - col_b) * rows];
+            }
+            probref[row + col * rows] = prob[row + col * rows] * (1 - su);
+        }
+    }
+    return probref;
+}
+
+static std::vector<double> test_prob(std::size_t rows, std::size_t cols) {
+    std::vector<double> prob(rows * cols);
+    for (std::size_t row = 0; row < rows; row++) {
+        for (std::size_t col = 0; col < cols; col++) {
+            prob[row + col * rows] = 0.002 + 0.01 * std::pow(std::sin(col * 1e-3 * (row + 1)), 2);
+        }
+    }
+    return prob;
+}
+
+static void check_against_naive(const std::vector<double> &W, bool recursive) {
+    const std::size_t rows = 21, cols = 9000;
+    std::vector<double> prob = test_prob(rows, cols);
+    std::vector<double> expected = naive(prob, rows, cols, W);
+
+    for (int n_threads : {1, 3}) {
+        RefractoryProbability engine(W, rows, n_threads);
+        CHECK(engine.recursive() == recursive);
+        /* In blocks, crossing the periodic resynchronisation */
+        std::vector<double> probref(prob.size());
+        for (std::size_t first = 0; first < cols; first += 2500) {
+            std::size_t n = std::min<std::size_t>(2500, cols - first);
+            engine.apply(&prob[first * rows], &probref[first * rows], n);
+        }
+        double err = 0;
+        for (std::size_t ind = 0; ind < prob.size(); ind++) {
+            err = std::max(err, std::fabs(probref[ind] - expected[ind]));
+        }
+        CHECK_CLOSE(err, 0.0, 1e-14);
+    }
+}
+
+static void test_refract1() {
+    /* 0.75 ms at 1e5 Hz, as in AuditoryNerve and ProcessingAsr */
+    std::vector<double> W = refractory_weights(0.75e-3, 1e-5);
+    CHECK(W.size() == 150);
+    CHECK(W[0] == 1 && W[74] == 1);
+    CHECK_CLOSE(W[112], 1 - (113e-5 - 0.75e-3) / 0.75e-3, 1e-15);
+    check_against_naive(W, true);
+
+    /* Heaviside (refract2) */
+    check_against_naive(std::vector<double>(40, 1.0), true);
+}
+
+static void test_general() {
+    std::vector<double> W(60);
+    for (std::size_t k = 0; k < W.size(); k++) {
+        W[k] = std::exp(-(double)k / 20);
+    }
+    check_against_naive(W, false);
+}
+
+/* float prob (Matlab single arrays) against the naive loop on the same
+ * inputs, the history being kept in double */
+static void test_single() {
+    const std::size_t rows = 21, cols = 9000;
+    std::vector<double> W = refractory_weights(0.75e-3, 1e-5);
+    std::vector<float> prob(rows * cols);
+    std::vector<double> prob_double = test_prob(rows, cols);
+    for (std::size_t ind = 0; ind < prob.size(); ind++) {
+        prob[ind] = (float)prob_double[ind];
+        prob_double[ind] = prob[ind];
+    }
+    std::vector<double> expected = naive(prob_double, rows, cols, W);
+    std::vector<float> probref(prob.size());
+    apply_refractoriness(prob.data(), probref.data(), rows, cols, W.data(), W.size(), 3);
+    double err = 0;
+    for (std::size_t ind = 0; ind < prob.size(); ind++) {
+        err = std::max(err, std::fabs(probref[ind] - expected[ind]));
+    }
+    CHECK_CLOSE(err, 0.0, 1e-9);
+}
+
+int main() {
+    test_refract1();
+    test_general();
+    test_single();
+    TEST_MAIN_RETURN();
+}
@@ -0,0 +1,219 @@
+/* Spike train post-processing against the examples of rateSpikeTrain.c,
+ * spikes2ISI.c, subsampleSpikeTrains.c and averageChannels.c, and sparse
+ * rates, ISI, subsampling and counts against dense ones */
+
+#include "check.hpp"
+
+#include "earing/random.hpp"
+#include "earing/spike_analysis.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+using namespace earing;
+
+static void test_spikes_to_isi() {
+    /* A = [0 0 1;0 0 0; 1 0 1; 0 1 0]' of spikes2ISI.c: 4 columns of 3 frames */
+    std::vector<double> A = {0, 0, 1, 0, 0, 0, 1, 0, 1, 0, 1, 0};
+    std::vector<double> expected = {2, 2, 1, 3, 3, 3, 2, 2, 1, 1, 2, 2};
+    for (int n_threads : {1, 3}) {
+        std::vector<double> isi(A.size());
+        spikes_to_isi(A.data(), 3, 4, isi.data(), n_threads);
+        CHECK(isi == expected);
+    }
+}
+
+static void test_subsample() {
+    std::vector<double> A = {0, 0, 1, 1, 1, 1, 1, 1, 0, 0, 1,
+                             0, 0, 1, 0, 1, 0, 0, 1, 0, 0, 1,
+                             0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    std::vector<double> expected = {0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 1,
+                                    0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 1,
+                                    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+    subsample_spike_trains(A.data(), 11, 3, 3, 2);
+    CHECK(A == expected);
+
+    bool thrown = false;
+    try {
+        subsample_spike_trains(A.data(), 11, 3, 0);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+static void test_rate() {
+    /* One spike per column, windows [1 2 1] starting at frames 0, 2 and 4 */
+    std::vector<double> spikes = {0, 0, 1, 0, 0, 0, 0,
+                                  0, 0, 0, 0, 0, 1, 0};
+    std::vector<double> begin = {0, 2, 4}, window = {1, 2, 1};
+    std::vector<double> rate(6);
+    rate_spike_train(spikes.data(), 7, 2, begin.data(), 3, window.data(), 3, rate.data());
+    std::vector<double> expected = {1, 1, 0, 0, 0, 2};
+    CHECK(rate == expected);
+
+    /* Single precision spike trains and rates */
+    std::vector<float> spikes_single(spikes.begin(), spikes.end()), rate_single(6);
+    rate_spike_train(spikes_single.data(), 7, 2, begin.data(), 3, window.data(), 3, rate_single.data());
+    CHECK(std::vector<double>(rate_single.begin(), rate_single.end()) == expected);
+
+    bool thrown = false;
+    begin[2] = 5;
+    try {
+        rate_spike_train(spikes.data(), 7, 2, begin.data(), 3, window.data(), 3, rate.data());
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+/* Sparse spike trains give the dense rates exactly, windows overlapping as in
+ * ProcessingAsr (30 ms windows every 10 ms, here scaled down) */
+static void test_rate_events() {
+    const std::size_t rows = 5000, cols = 7, n_window = 300;
+    std::vector<double> spikes(rows * cols, 0.0);
+    SpikeTrains trains;
+    trains.n_fibers = cols;
+    trains.n_frames = rows;
+    trains.fiber_start.push_back(0);
+    RandomStream rng(5, 0);
+    for (std::size_t col = 0; col < cols; col++) {
+        for (std::size_t row = 0; row < rows; row++) {
+            if (rng.uniform() < 0.02 * col) {
+                spikes[row + col * rows] = 1;
+                trains.frames.push_back(row);
+            }
+        }
+        trains.fiber_start.push_back(trains.frames.size());
+    }
+    std::vector<double> window(n_window), begin;
+    for (std::size_t j = 0; j < n_window; j++) {
+        window[j] = 0.5 - 0.5 * std::cos(2 * 3.14159265358979323846 * (j + 1) / (n_window + 1));
+    }
+    for (std::size_t b = 1; b + n_window <= rows; b += 100) {
+        begin.push_back((double)b);
+    }
+
+    std::vector<double> expected(begin.size() * cols), rate(begin.size() * cols);
+    rate_spike_train(spikes.data(), rows, cols, begin.data(), begin.size(), window.data(), n_window,
+                     expected.data());
+    for (int n_threads : {1, 3}) {
+        rate_spike_events(trains, begin.data(), begin.size(), window.data(), n_window, rate.data(), n_threads);
+        CHECK(rate == expected);
+    }
+
+    /* Weighted spikes (PSTH) */
+    std::vector<double> values(trains.n_spikes());
+    for (std::size_t k = 0; k < values.size(); k++) {
+        values[k] = (double)(k % 3 + 1);
+        spikes[trains.frames[k] + (std::size_t)(std::upper_bound(trains.fiber_start.begin(),
+                                                                 trains.fiber_start.end(), k) -
+                                                trains.fiber_start.begin() - 1) * rows] = values[k];
+    }
+    rate_spike_train(spikes.data(), rows, cols, begin.data(), begin.size(), window.data(), n_window,
+                     expected.data());
+    rate_spike_events(trains.fiber_start.data(), trains.frames.data(), values.data(), rows, cols, begin.data(),
+                      begin.size(), window.data(), n_window, rate.data());
+    CHECK(rate == expected);
+
+    bool thrown = false;
+    std::swap(begin[0], begin[1]);
+    try {
+        rate_spike_events(trains, begin.data(), begin.size(), window.data(), n_window, rate.data());
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+/* Event ISI, subsampling and counts against the dense kernels, on more trains
+ * than a group of isi_spike_events, one of them firing at frame 0 */
+static void test_events() {
+    const std::size_t rows = 2000, cols = 11;
+    std::vector<double> spikes(rows * cols, 0.0);
+    SpikeTrains trains;
+    trains.n_fibers = cols;
+    trains.n_frames = rows;
+    trains.fiber_start.push_back(0);
+    RandomStream rng(7, 0);
+    for (std::size_t col = 0; col < cols; col++) {
+        for (std::size_t row = 0; row < rows; row++) {
+            if (rng.uniform() < 0.01 * col || (col == 3 && row == 0)) {
+                spikes[row + col * rows] = 1;
+                trains.frames.push_back(row);
+            }
+        }
+        trains.fiber_start.push_back(trains.frames.size());
+    }
+
+    std::vector<double> dense(rows * cols), isi(rows * cols);
+    spikes_to_isi(spikes.data(), rows, cols, dense.data());
+    for (int n_threads : {1, 3}) {
+        isi_spike_events(trains, isi.data(), false, n_threads);
+        bool same = true;
+        for (std::size_t row = 0; row < rows; row++) {
+            for (std::size_t col = 0; col < cols; col++) {
+                same = same && isi[col + row * cols] == dense[row + col * rows];
+            }
+        }
+        CHECK(same);
+    }
+    isi_spike_events(trains, isi.data(), true);
+    CHECK(isi[3 + 5 * cols] == 1 / dense[5 + 3 * rows]);
+
+    std::vector<std::size_t> counts(cols);
+    spike_counts(trains, 100, 1500, counts.data(), 2);
+    for (std::size_t col = 0; col < cols; col++) {
+        CHECK(counts[col] == (std::size_t)std::count(spikes.begin() + col * rows + 100,
+                                                     spikes.begin() + col * rows + 1500, 1.0));
+    }
+
+    SpikeTrains kept = subsample_spike_events(trains, 3, 2);
+    subsample_spike_trains(spikes.data(), rows, cols, 3);
+    std::vector<double> from_events(rows * cols, 0.0);
+    for (std::size_t col = 0; col < cols; col++) {
+        for (std::size_t k = kept.fiber_start[col]; k < kept.fiber_start[col + 1]; k++) {
+            from_events[kept.frames[k] + col * rows] = 1;
+        }
+    }
+    CHECK(from_events == spikes);
+    CHECK(kept.fiber_start[cols] == kept.n_spikes());
+
+    bool thrown = false;
+    try {
+        subsample_spike_events(trains, 0);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+static void test_average() {
+    /* 7 channels in 3 features: 2, 2 and 3 channels */
+    std::vector<double> feats = {1, 3, 5, 7, 9, 11, 13,
+                                 0, 0, 0, 0, 3, 3, 3};
+    std::vector<double> mean(6);
+    average_channels(feats.data(), 7, 2, 3, mean.data(), 2);
+    CHECK_CLOSE(mean[0], 2, 1e-15);
+    CHECK_CLOSE(mean[1], 6, 1e-15);
+    CHECK_CLOSE(mean[2], 11, 1e-15);
+    CHECK_CLOSE(mean[3], 0, 1e-15);
+    CHECK_CLOSE(mean[4], 0, 1e-15);
+    CHECK_CLOSE(mean[5], 3, 1e-15);
+
+    std::vector<float> feats_single(feats.begin(), feats.end()), mean_single(6);
+    average_channels(feats_single.data(), 7, 2, 3, mean_single.data(), 2);
+    CHECK(std::vector<double>(mean_single.begin(), mean_single.end()) == mean);
+}
+
+int main() {
+    test_spikes_to_isi();
+    test_subsample();
+    test_rate();
+    test_rate_events();
+    test_events();
+    test_average();
+    TEST_MAIN_RETURN();
+}
@@ -0,0 +1,313 @@
+/* Random streams and spike trains: reproducibility with a seed, independence
+ * from the number of threads, regeneration of a single fiber, binning against
+ * one trial per bin, PSTH counts */
+
+#include "check.hpp"
+
+#include "earing/auditory_nerve.hpp"
+#include "earing/quantal_release.hpp"
+#include "earing/random.hpp"
+#include "earing/spike_trains.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+using namespace earing;
+
+/* Known answers of Philox4x32-10 (Random123) */
+static void test_philox() {
+    std::array<std::uint32_t, 4> zero = philox4x32(0, 0, 0);
+    CHECK(zero[0] == 0x6627e8d5u && zero[1] == 0xe169c58du && zero[2] == 0xbc57ac4cu && zero[3] == 0x9b00dbd8u);
+    std::array<std::uint32_t, 4> ones = philox4x32(~0ull, ~0ull, ~0ull);
+    CHECK(ones[0] == 0x408f276du && ones[1] == 0x41c83b0eu && ones[2] == 0xa20bc7c6u && ones[3] == 0x6d5451fdu);
+
+    RandomStream rng(1, 2);
+    double sum = 0;
+    for (int k = 0; k < 100000; k++) {
+        double u = rng.uniform();
+        CHECK(u > 0 && u <= 1);
+        sum += u;
+    }
+    CHECK_CLOSE(sum / 100000, 0.5, 0.01);
+
+    /* Blocks in lanes, and uniform variables as bits from any position */
+    std::uint32_t w[4][kPhiloxLanes];
+    philox4x32_lanes(~0ull, ~0ull, ~0ull - 3, w);
+    CHECK(w[0][3] == ones[0] && w[1][3] == ones[1] && w[2][3] == ones[2] && w[3][3] == ones[3]);
+    std::vector<double> reference(100);
+    RandomStream stream(7, 3);
+    for (double &u : reference) {
+        u = stream.uniform();
+    }
+    CHECK(stream.position() == 100);
+    std::vector<std::uint64_t> bits(61);
+    stream.bits(37, bits.data(), bits.size());
+    bool same = true;
+    for (std::size_t k = 0; k < bits.size(); k++) {
+        same = same && RandomStream::to_uniform(bits[k]) == reference[37 + k];
+    }
+    stream.seek(13);
+    same = same && stream.uniform() == reference[13] && stream.position() == 14;
+    CHECK(same);
+}
+
+static std::vector<double> test_rate(std::size_t rows, std::size_t cols) {
+    std::vector<double> rate(rows * cols);
+    for (std::size_t k = 0; k < rate.size(); k++) {
+        rate[k] = 0.002 + 0.05 * (k * 7 % 11) / 11.0;
+    }
+    return rate;
+}
+
+static void test_threads_and_fibers() {
+    const std::size_t rows = 7, cols = 3000;
+    const int n_fibers = 20;
+    std::vector<double> rate = test_rate(rows, cols);
+
+    for (SpikeAlgorithm algo : {SpikeAlgorithm::Thinning, SpikeAlgorithm::Binning}) {
+        std::vector<unsigned char> serial(n_fibers * rows * cols, 0);
+        generate_poisson_spike_trains(serial.data(), rate.data(), rows, cols, n_fibers, 30, algo, 42, 1);
+        std::size_t n_spikes = 0;
+        for (unsigned char s : serial) {
+            n_spikes += s;
+        }
+        CHECK(n_spikes > 0);
+
+        for (int n_threads : {2, 3}) {
+            std::vector<unsigned char> spikes(serial.size(), 0);
+            generate_poisson_spike_trains(spikes.data(), rate.data(), rows, cols, n_fibers, 30, algo, 42, n_threads);
+            CHECK(spikes == serial);
+        }
+
+        std::vector<unsigned char> other(serial.size(), 0);
+        generate_poisson_spike_trains(other.data(), rate.data(), rows, cols, n_fibers, 30, algo, 43, 1);
+        CHECK(other != serial);
+
+        /* Fiber 5 of channel 3 alone, from its rate row and stream */
+        const std::size_t ch = 3, fiber = 5, row = ch * n_fibers + fiber;
+        std::vector<double> rate_row(cols);
+        for (std::size_t col = 0; col < cols; col++) {
+            rate_row[col] = rate[ch + col * rows];
+        }
+        std::vector<unsigned char> alone(cols, 0);
+        SpikeGenerator(1, 1, 30, algo, 42, row).apply(alone.data(), rate_row.data(), cols);
+        bool same = true;
+        for (std::size_t col = 0; col < cols; col++) {
+            same = same && alone[col] == serial[row + col * n_fibers * rows];
+        }
+        CHECK(same);
+    }
+}
+
+/* Binning against one Bernoulli trial per bin, with rates at the edges of the
+ * integer comparison, refractoriness and blocks */
+static void test_binning() {
+    const std::size_t rows = 10, cols = 3000;
+    const int n_fibers = 3;
+    std::vector<double> rate = test_rate(rows, cols);
+    const double edges[] = {0, -1, 1, 2, 0x1p-53, 0x1p-52, 1 - 0x1p-53, 0.5 + 0x1p-40};
+    for (std::size_t col = 0; col < cols; col += 13) {
+        rate[col * rows + 1] = edges[col % 8];
+    }
+    for (int R : {0, 25}) {
+        std::vector<unsigned char> spikes(n_fibers * rows * cols, 0);
+        SpikeGenerator blocks(rows, n_fibers, R, SpikeAlgorithm::Binning, 11, 0, 2);
+        blocks.apply(spikes.data(), rate.data(), 1000);
+        blocks.apply(spikes.data() + 1000 * n_fibers * rows, rate.data() + 1000 * rows, cols - 1000);
+
+        bool same = true;
+        for (std::size_t row = 0; row < n_fibers * rows; row++) {
+            RandomStream rng(11, row);
+            for (std::size_t col = 0; col < cols; col++) {
+                bool spike = rate[row / n_fibers + col * rows] > rng.uniform();
+                same = same && spikes[row + col * n_fibers * rows] == spike;
+                if (spike && R > 0) {
+                    col += R + (std::size_t)std::floor(rng.uniform() * R);
+                }
+            }
+        }
+        CHECK(same);
+    }
+}
+
+/* Spike lists hold the spikes of the dense output; their CSC form is Matlab's */
+static void test_events() {
+    const std::size_t rows = 5, cols = 2000;
+    const int n_fibers = 30;
+    std::vector<double> rate = test_rate(rows, cols);
+
+    for (SpikeAlgorithm algo : {SpikeAlgorithm::Thinning, SpikeAlgorithm::Binning}) {
+        std::vector<unsigned char> dense(n_fibers * rows * cols, 0);
+        generate_poisson_spike_trains(dense.data(), rate.data(), rows, cols, n_fibers, 20, algo, 5, 3);
+        SpikeTrains trains = generate_poisson_spike_events(rate.data(), rows, cols, n_fibers, 20, algo, 5, 2);
+        CHECK(trains.n_fibers == n_fibers * rows && trains.n_frames == cols);
+        CHECK(trains.fiber_start.size() == trains.n_fibers + 1 && trains.fiber_start.back() == trains.n_spikes());
+
+        std::vector<unsigned char> from_events(dense.size(), 0);
+        to_dense(trains, from_events.data());
+        CHECK(from_events == dense);
+
+        std::vector<std::size_t> col_start(cols + 1), row_index(trains.n_spikes());
+        to_csc(trains, col_start.data(), row_index.data());
+        std::size_t k = 0;
+        bool same = col_start[0] == 0;
+        for (std::size_t col = 0; col < cols; col++) {
+            for (std::size_t row = 0; row < trains.n_fibers; row++) {
+                if (dense[row + col * trains.n_fibers]) {
+                    same = same && k < row_index.size() && row_index[k] == row;
+                    k++;
+                }
+            }
+            same = same && col_start[col + 1] == k;
+        }
+        CHECK(same);
+    }
+}
+
+/* Constant rate lambda per bin with a refractory period uniform in [R, 2R):
+ * the mean inter-spike interval is 1 + (3R - 1) / 2 + E[floor(expo)] bins */
+static void test_refractoriness() {
+    const std::size_t rows = 2, cols = 20000;
+    const int n_fibers = 100, R = 50;
+    const double lambda = 0.01;
+    std::vector<double> rate(rows * cols, lambda);
+    const double floor_expo = 1 / std::expm1(lambda);
+    const double expected = (double)(n_fibers * rows) * cols / (1 + (3 * R - 1) / 2.0 + floor_expo);
+
+    for (SpikeAlgorithm algo : {SpikeAlgorithm::Thinning, SpikeAlgorithm::Binning}) {
+        SpikeTrains trains = generate_poisson_spike_events(rate.data(), rows, cols, n_fibers, R, algo, 9);
+        CHECK_CLOSE(trains.n_spikes() / expected, 1.0, 0.03);
+        std::size_t min_isi = cols;
+        for (std::size_t fiber = 0; fiber < trains.n_fibers; fiber++) {
+            for (std::size_t k = trains.fiber_start[fiber] + 1; k < trains.fiber_start[fiber + 1]; k++) {
+                min_isi = std::min(min_isi, trains.frames[k] - trains.frames[k - 1]);
+            }
+        }
+        CHECK(min_isi >= (std::size_t)R + 1);
+    }
+}
+
+/* PSTH counts: the sum of the repetitions as spike trains, whatever the
+ * threads (over fibers or repetitions) and blocks */
+static void test_psth() {
+    const std::size_t rows = 3, cols = 2000;
+    const int n_fibers = 4, n_reps = 50;
+    const std::size_t n_rows = rows * n_fibers;
+    std::vector<double> rate = test_rate(rows, cols);
+
+    for (SpikeAlgorithm algo : {SpikeAlgorithm::Thinning, SpikeAlgorithm::Binning}) {
+        std::vector<std::uint16_t> counts(n_rows * cols, 0);
+        generate_poisson_psth(counts.data(), rate.data(), rows, cols, n_fibers, n_reps, 20, algo, 7, 1);
+
+        std::vector<unsigned char> trains(n_rows * n_reps * cols, 0);
+        SpikeGenerator(rows, n_fibers, 20, algo, 7, 0, 1, n_reps).apply(trains.data(), rate.data(), cols);
+        std::vector<std::uint16_t> sum(counts.size(), 0);
+        for (std::size_t col = 0; col < cols; col++) {
+            for (std::size_t row = 0; row < n_rows * n_reps; row++) {
+                sum[row % n_rows + col * n_rows] += trains[row + col * n_rows * n_reps];
+            }
+        }
+        CHECK(counts == sum);
+
+        /* The first repetition is the spike trains of a single run */
+        std::vector<unsigned char> single(n_rows * cols, 0);
+        generate_poisson_spike_trains(single.data(), rate.data(), rows, cols, n_fibers, 20, algo, 7, 1);
+        bool same = true;
+        for (std::size_t col = 0; col < cols; col++) {
+            for (std::size_t row = 0; row < n_rows; row++) {
+                same = same && single[row + col * n_rows] == trains[row + col * n_rows * n_reps];
+            }
+        }
+        CHECK(same);
+
+        /* Few fibers: repetitions across threads */
+        std::vector<std::uint16_t> threaded(counts.size(), 0);
+        generate_poisson_psth(threaded.data(), rate.data(), rows, cols, n_fibers, n_reps, 20, algo, 7, 3);
+        CHECK(threaded == counts);
+
+        /* Binning draws the same numbers in blocks (thinning depends on the
+         * maximal rate of the block) */
+        if (algo == SpikeAlgorithm::Binning) {
+            SpikeGenerator blocks(rows, n_fibers, 20, algo, 7, 0, 2, n_reps);
+            std::vector<std::uint16_t> counts_blocks(counts.size(), 0);
+            blocks.apply(counts_blocks.data(), rate.data(), 700);
+            blocks.apply(counts_blocks.data() + 700 * n_rows, rate.data() + 700 * rows, cols - 700);
+            CHECK(counts_blocks == counts);
+        }
+    }
+
+    bool thrown = false;
+    try {
+        SpikeGenerator(rows, n_fibers, 20, SpikeAlgorithm::Binning, 7, 0, 1, 0);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+/* Stochastic synapses: their mean release follows the deterministic reservoir
+ * model, and blocks and threads do not change them */
+static void test_quantal_release() {
+    const std::size_t rows = 2, cols = 20000;
+    const int n_fibers = 200;
+    std::vector<double> prob(rows * cols);
+    for (std::size_t col = 0; col < cols; col++) {
+        prob[col * rows] = 0.002;
+        prob[col * rows + 1] = col < cols / 2 ? 0.0005 : 0.005;
+    }
+    /* Sumner2002 reservoir rates at 1e5 Hz, starting at rest */
+    double dt = 1e-5, M = 10;
+    std::vector<double> xdt(rows, 66.3 * dt), ydt(rows, 10 * dt), rdt(rows, 6580 * dt), rdt_plus_ldt(rows, 9160 * dt);
+    std::vector<double> available(rows, 9), cleft(rows, 0.01), reprocess(rows, 1);
+
+    SpikeTrains whole;
+    QuantalRelease(rows, n_fibers, available.data(), cleft.data(), reprocess.data(), M, xdt.data(), ydt.data(),
+                   rdt_plus_ldt.data(), rdt.data(), 0, 3, 0, 1)
+        .apply(prob.data(), cols, whole);
+    CHECK(whole.n_fibers == rows * n_fibers && whole.n_frames == cols);
+
+    std::vector<double> mean(rows * cols), a = available, c = cleft, r = reprocess;
+    reservoir_release(mean.data(), prob.data(), rows, cols, a.data(), c.data(), r.data(), M, xdt.data(),
+                      ydt.data(), rdt_plus_ldt.data(), rdt.data());
+    for (std::size_t row = 0; row < rows; row++) {
+        double expected = 0;
+        for (std::size_t col = 0; col < cols; col++) {
+            expected += mean[col * rows + row];
+        }
+        std::size_t n_spikes = whole.fiber_start[(row + 1) * n_fibers] - whole.fiber_start[row * n_fibers];
+        CHECK_CLOSE(n_spikes / (expected * n_fibers), 1.0, 0.1);
+    }
+
+    QuantalRelease blocks(rows, n_fibers, available.data(), cleft.data(), reprocess.data(), M, xdt.data(),
+                          ydt.data(), rdt_plus_ldt.data(), rdt.data(), 0, 3, 0, 3);
+    std::vector<std::size_t> frames(whole.n_fibers * cols, 0), frames_blocks(whole.n_fibers * cols, 0);
+    for (std::size_t first = 0; first < cols; first += 7000) {
+        SpikeTrains block;
+        blocks.apply(prob.data() + first * rows, std::min<std::size_t>(7000, cols - first), block);
+        for (std::size_t fiber = 0; fiber < block.n_fibers; fiber++) {
+            for (std::size_t k = block.fiber_start[fiber]; k < block.fiber_start[fiber + 1]; k++) {
+                frames_blocks[fiber * cols + first + block.frames[k]] = 1;
+            }
+        }
+    }
+    for (std::size_t fiber = 0; fiber < whole.n_fibers; fiber++) {
+        for (std::size_t k = whole.fiber_start[fiber]; k < whole.fiber_start[fiber + 1]; k++) {
+            frames[fiber * cols + whole.frames[k]] = 1;
+        }
+    }
+    CHECK(frames == frames_blocks);
+}
+
+int main() {
+    test_philox();
+    test_threads_and_fibers();
+    test_binning();
+    test_events();
+    test_refractoriness();
+    test_psth();
+    test_quantal_release();
+    TEST_MAIN_RETURN();
+}
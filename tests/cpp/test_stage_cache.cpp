@@ -0,0 +1,165 @@
+/* Stage cache: fingerprints, entries, eviction, and cached ear runs against
+ * uncached ones */
+
+#include "check.hpp"
+
+#include "earing/ear_sumner2002.hpp"
+#include "earing/stage_cache.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace earing;
+namespace fs = std::filesystem;
+
+static const char *directory = "test_stage_cache.d";
+
+static std::vector<double> sinusoid(double frequency, double duration, double fs) {
+    std::vector<double> s((std::size_t)(duration * fs));
+    for (std::size_t t = 0; t < s.size(); t++) {
+        s[t] = std::sin(2 * 3.14159265358979323846 * frequency * t / fs);
+    }
+    return s;
+}
+
+static bool same(const Matrix &a, const Matrix &b) {
+    if (a.rows() != b.rows() || a.cols() != b.cols()) {
+        return false;
+    }
+    for (std::size_t k = 0; k < a.size(); k++) {
+        if (a.data()[k] != b.data()[k]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_fingerprint() {
+    /* FNV-1a 128-bit test vectors */
+    CHECK(Fingerprint().hex() == "6c62272e07bb014262b821756295c58d");
+    CHECK(Fingerprint().add("a", 1).hex() == "d228cb696f1a8caf78912b704e4a8964");
+    CHECK(Fingerprint().add(1.0).hex() != Fingerprint().add(2.0).hex());
+}
+
+static void test_entries() {
+    fs::remove_all(directory);
+    StageCache cache(directory);
+    Matrix x(3, 4);
+    for (std::size_t k = 0; k < x.size(); k++) {
+        x.data()[k] = 0.5 * k - 1;
+    }
+    Matrix y;
+    CHECK(!cache.load("x", y));
+    cache.store("x", x);
+    CHECK(cache.load("x", y));
+    CHECK(same(x, y));
+    CHECK(cache.bytes() == 32 + 12 * sizeof(double));
+
+    /* Stored as double, not found as float */
+    BasicMatrix<float> f;
+    CHECK(!cache.load("x", f));
+    CHECK(cache.hits() == 1 && cache.misses() == 2);
+    fs::remove_all(directory);
+}
+
+static void test_eviction() {
+    fs::remove_all(directory);
+    Matrix x(10, 10, 1.0);
+    std::uint64_t entry = 32 + 100 * sizeof(double);
+    StageCache cache(directory, 2 * entry);
+    cache.store("a", x);
+    cache.store("b", x);
+    /* Make a the least recently used, then use it */
+    auto old = fs::file_time_type::clock::now() - std::chrono::hours(1);
+    fs::last_write_time(fs::path(directory) / "a.stage", old - std::chrono::minutes(1));
+    fs::last_write_time(fs::path(directory) / "b.stage", old);
+    Matrix y;
+    CHECK(cache.load("a", y));
+    cache.store("c", x);
+    CHECK(cache.bytes() == 2 * entry);
+    CHECK(cache.load("a", y));
+    CHECK(!cache.load("b", y));
+    CHECK(cache.load("c", y));
+
+    /* Larger than the budget: not stored */
+    cache.store("d", Matrix(20, 20));
+    CHECK(!cache.load("d", y));
+    fs::remove_all(directory);
+}
+
+static void test_ear() {
+    fs::remove_all(directory);
+    StageCache cache(directory);
+    std::vector<double> stimulus = sinusoid(1000, 0.02, 1e5);
+    std::vector<double> bfs = {250, 1000, 4000};
+    auto make_ear = [&](double ca_thresh) {
+        EarSumner2002 ear(bfs);
+        ear.synapse.n_fibers_per_type_per_channel = 0;
+        ear.synapse.ca_thresh = ca_thresh;
+        ear.cilia.keep_intermediates = true;
+        ear.synapse.keep_intermediates = true;
+        return ear;
+    };
+
+    EarSumner2002 reference = make_ear(4.48e-11);
+    reference.run(stimulus);
+    EarSumner2002 cached = make_ear(4.48e-11);
+    cached.cache = &cache;
+    cached.run(stimulus);
+    CHECK(same(cached.an.prob_firing, reference.an.prob_firing));
+    CHECK(cache.hits() == 0);
+
+    /* Same ear: starts from the release rate */
+    cached.profiling = true;
+    cached.run(stimulus);
+    CHECK(cache.hits() == 1);
+    CHECK(cached.drnl.response.empty());
+    /* Nothing left of the stages skipped, from the first run */
+    CHECK(cached.cilia.receptor_potential.empty() && cached.cilia.Gu.empty() &&
+          cached.cilia.cilia_displacement.empty());
+    CHECK(cached.synapse.mICa.empty() && cached.synapse.synapticCa.empty());
+    CHECK(!cached.profile.stages.empty() && cached.profile.stages[0].stage == "cache");
+    for (const StageProfile &stage : cached.profile.stages) {
+        CHECK(stage.stage != "bm" && stage.stage != "synapse");
+    }
+    CHECK(same(cached.an.prob_firing, reference.an.prob_firing));
+
+    /* A different synapse: starts from the receptor potential */
+    reference = make_ear(2e-11);
+    reference.run(stimulus);
+    cached = make_ear(2e-11);
+    cached.run(stimulus);
+    cached.cache = &cache;
+    cached.run(stimulus);
+    CHECK(cache.hits() == 2);
+    CHECK(cached.cilia.Gu.empty() && cached.cilia.cilia_displacement.empty());
+    CHECK(same(cached.cilia.receptor_potential, reference.cilia.receptor_potential));
+    CHECK(cached.synapse.mICa.cols() == stimulus.size());
+    CHECK(same(cached.synapse.vesicle_release_rate, reference.synapse.vesicle_release_rate));
+    CHECK(same(cached.an.prob_firing, reference.an.prob_firing));
+
+    /* Asking for the BM velocity: loaded rather than the release rate */
+    cached.cache_until = EarSumner2002::Stage::bm;
+    cached.run(stimulus);
+    CHECK(cache.hits() == 3);
+    CHECK(same(cached.drnl.response, reference.drnl.response));
+    CHECK(same(cached.an.prob_firing, reference.an.prob_firing));
+
+    /* A different sound level changes every key */
+    std::size_t misses = cache.misses();
+    cached.db = 60;
+    cached.run(stimulus);
+    CHECK(cache.hits() == 3 && cache.misses() == misses + 1);
+    fs::remove_all(directory);
+}
+
+int main() {
+    test_fingerprint();
+    test_entries();
+    test_eviction();
+    test_ear();
+    TEST_MAIN_RETURN();
+}
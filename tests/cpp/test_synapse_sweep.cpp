@@ -0,0 +1,105 @@
+/* Synapse sweep against one synapse and AN run per setting */
+
+#include "check.hpp"
+
+#include "earing/ear_sumner2002.hpp"
+#include "earing/synapse_sweep.hpp"
+
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+using namespace earing;
+
+static std::vector<double> sinusoid(double frequency, double duration, double fs) {
+    std::vector<double> s((std::size_t)(duration * fs));
+    for (std::size_t t = 0; t < s.size(); t++) {
+        s[t] = std::sin(2 * 3.14159265358979323846 * frequency * t / fs);
+    }
+    return s;
+}
+
+static bool same(const Matrix &a, const Matrix &b) {
+    if (a.rows() != b.rows() || a.cols() != b.cols()) {
+        return false;
+    }
+    for (std::size_t k = 0; k < a.size(); k++) {
+        if (a.data()[k] != b.data()[k]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::vector<SynapseSetting> settings() {
+    std::vector<SynapseSetting> s(4);
+    s[1].ca_thresh = 2e-11;
+    s[2].gmaxca = 7e-9;
+    s[2].ca_thresh = 1e-12;
+    s[3].tauCa = 1e-4;
+    return s;
+}
+
+static void test_settings() {
+    EarSumner2002 ear({250, 1000, 4000});
+    ear.synapse.n_fibers_per_type_per_channel = 0;
+    ear.run(sinusoid(1000, 0.03, 1e5));
+    const Matrix &rp = ear.cilia.receptor_potential;
+
+    SynapseSweep sweep;
+    sweep.synapse.n_fibers_per_type_per_channel = 0;
+    sweep.settings = settings();
+    sweep.n_threads = 1;
+    sweep.run(rp, ear.cilia.restingV, ear.fs);
+    CHECK(sweep.vesicle_release_rate.rows() == 12 && sweep.an.prob_firing.rows() == 12);
+
+    for (std::size_t k = 0; k < sweep.n_settings(); k++) {
+        AnIhcSynapse synapse;
+        synapse.n_fibers_per_type_per_channel = 0;
+        synapse.gmaxca = sweep.settings[k].gmaxca;
+        synapse.ca_thresh = sweep.settings[k].ca_thresh;
+        synapse.tauCa = {sweep.settings[k].tauCa};
+        synapse.run(rp, ear.cilia.restingV, ear.fs);
+        AuditoryNerve an;
+        an.run(synapse, ear.fs);
+        /* Same arithmetic, same results */
+        CHECK(same(sweep.setting_output(sweep.vesicle_release_rate, k), synapse.vesicle_release_rate));
+        CHECK(same(sweep.setting_output(sweep.an.prob_firing, k), an.prob_firing));
+    }
+
+    /* Fewer BFs than threads: the state is copied for a split in time */
+    SynapseSweep threaded;
+    threaded.synapse.n_fibers_per_type_per_channel = 0;
+    threaded.settings = settings();
+    threaded.n_threads = 2;
+    threaded.run(rp, ear.cilia.restingV, ear.fs);
+    const Matrix &a = threaded.vesicle_release_rate, &b = sweep.vesicle_release_rate;
+    for (std::size_t k = 0; k < a.size(); k++) {
+        CHECK_CLOSE(a.data()[k], b.data()[k], 1e-9 * std::fabs(b.data()[k]) + 1e-12);
+    }
+
+    bool thrown = false;
+    try {
+        sweep.setting_output(sweep.vesicle_release_rate, 4);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+static void test_errors() {
+    SynapseSweep sweep;
+    bool thrown = false;
+    try {
+        sweep.init(-0.05, 3, 1e5);
+    } catch (const std::invalid_argument &) {
+        thrown = true;
+    }
+    CHECK(thrown);
+}
+
+int main() {
+    test_settings();
+    test_errors();
+    TEST_MAIN_RETURN();
+}